@@ -120,7 +120,7 @@ static void pushEventToWebsocket(const Event &event, AlarmSystem *alarmSys, WebS
         map[QLatin1String(event.what(), suffixOffset - 1)] = map2;
     }
 
-    webSocket->broadcastTextMessage(Json::serialize(map));
+    webSocket->broadcastEvent(map);
 }
 
 
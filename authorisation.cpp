@@ -151,68 +151,66 @@ void DeRestPluginPrivate::authorise(ApiRequest &req, ApiResponse &rsp)
         return;
     }
 
-    std::vector<ApiAuth>::iterator i = apiAuths.begin();
-    std::vector<ApiAuth>::iterator end = apiAuths.end();
-
-    for (size_t pos = 0; i != end; ++i, pos++)
+    if (!apiAuthCacheValid)
     {
-        if (apikey == i->apikey && i->state == ApiAuth::StateNormal)
-        {
-            apiAuthCurrent = pos;
-            i->lastUseDate = QDateTime::currentDateTimeUtc();
+        flushApiAuthUsage();
+        apiAuthCache.clear();
 
-            // fill in useragent string if not already exist
-            if (i->useragent.isEmpty())
+        for (size_t pos = 0; pos < apiAuths.size(); pos++)
+        {
+            const ApiAuth &auth = apiAuths[pos];
+            if (auth.state == ApiAuth::StateNormal)
             {
-                if (req.hdr.hasKey(QLatin1String("User-Agent")))
-                {
-                    i->useragent = req.hdr.value(QLatin1String("User-Agent"));
-                    DBG_Printf(DBG_HTTP, "set useragent '%s' for apikey '%s'\n", qPrintable(i->useragent), qPrintable(i->apikey));
-                }
+                ApiAuthCacheEntry &entry = apiAuthCache[auth.apikey];
+                entry.index = pos;
+                entry.mode = apiModeForAuth(auth);
             }
+        }
+        apiAuthCacheValid = true;
+    }
 
-            if (req.sock)
-            {
-                for (TcpClient &cl : openClients)
-                {
-                    if (cl.sock == req.sock && cl.closeTimeout > 0)
-                    {
-                        cl.closeTimeout = AUTH_KEEP_ALIVE;
-                        break;
-                    }
-                }
-            }
+    auto i = apiAuthCache.find(apikey);
+    if (i == apiAuthCache.end())
+    {
+        return;
+    }
 
-            if ((!(i->useragent.isEmpty()) && i->useragent.startsWith(QLatin1String("iConnect"))) || i->devicetype.startsWith(QLatin1String("iConnectHue")))
-            {
-                req.mode = ApiModeStrict;
-            }
-            else if (i->devicetype.startsWith(QLatin1String("Echo")))
-            {
-                req.mode = ApiModeEcho;
-            }
-            else if (i->devicetype.startsWith(QLatin1String("Hue Essentials")))
-            {
-                // supports deCONZ specifics
-            }
-            else if (i->devicetype.startsWith(QLatin1String("hue_")) ||
-                     i->devicetype.startsWith(QLatin1String("Hue ")) ||
-                     gwHueMode)
-            {
-                req.mode = ApiModeHue;
-            }
-            DBG_Printf(DBG_HTTP, "ApiMode: %d\n", req.mode);
+    DBG_Assert(i->index < apiAuths.size());
+    ApiAuth &auth = apiAuths[i->index];
+    apiAuthCurrent = i->index;
 
-            i->needSaveDatabase = true;
-            if (!apiAuthSaveDatabaseTime.isValid() || apiAuthSaveDatabaseTime.elapsed() > (1000 * 60 * 30))
-            {
-                apiAuthSaveDatabaseTime.start();
-                queSaveDb(DB_AUTH, DB_HUGE_SAVE_DELAY);
-            }
-            req.auth = ApiAuthFull;
+    // fill in useragent string if not already exist
+    if (auth.useragent.isEmpty())
+    {
+        if (req.hdr.hasKey(QLatin1String("User-Agent")))
+        {
+            auth.useragent = req.hdr.value(QLatin1String("User-Agent"));
+            auth.needSaveDatabase = true;
+            i->mode = apiModeForAuth(auth);
+            DBG_Printf(DBG_HTTP, "set useragent '%s' for apikey '%s'\n", qPrintable(auth.useragent), qPrintable(auth.apikey));
         }
     }
 
+    if (req.sock)
+    {
+        httpConnections.extend(req.sock, AUTH_KEEP_ALIVE);
+    }
+
+    if (i->mode != ApiModeNormal)
+    {
+        req.mode = i->mode;
+    }
+    DBG_Printf(DBG_HTTP, "ApiMode: %d\n", req.mode);
+
+    // lastUseDate is updated in flushApiAuthUsage()
+    if (!i->used)
+    {
+        i->used = true;
+        apiAuthUsed.push_back(i->index);
+    }
+
+    req.auth = ApiAuthFull;
+
 #if 0
     // allow non registered devices to use the api if the link button is pressed
     if (gwLinkButton)
@@ -230,3 +228,75 @@ void DeRestPluginPrivate::authorise(ApiRequest &req, ApiResponse &rsp)
 #endif
 
 }
+
+/*! Returns the API mode for the clients using \p auth.
+ */
+ApiMode DeRestPluginPrivate::apiModeForAuth(const ApiAuth &auth) const
+{
+    if ((!auth.useragent.isEmpty() && auth.useragent.startsWith(QLatin1String("iConnect"))) || auth.devicetype.startsWith(QLatin1String("iConnectHue")))
+    {
+        return ApiModeStrict;
+    }
+    else if (auth.devicetype.startsWith(QLatin1String("Echo")))
+    {
+        return ApiModeEcho;
+    }
+    else if (auth.devicetype.startsWith(QLatin1String("Hue Essentials")))
+    {
+        // supports deCONZ specifics
+    }
+    else if (auth.devicetype.startsWith(QLatin1String("hue_")) ||
+             auth.devicetype.startsWith(QLatin1String("Hue ")) ||
+             gwHueMode)
+    {
+        return ApiModeHue;
+    }
+
+    return ApiModeNormal;
+}
+
+/*! Marks the API key cache for rebuild, must be called when apiAuths are added or deleted.
+ */
+void DeRestPluginPrivate::invalidateApiAuthCache()
+{
+    apiAuthCacheValid = false;
+}
+
+/*! Writes the last use date of all API keys used since the last call.
+    Called periodically, the database is saved at most every 30 minutes.
+ */
+void DeRestPluginPrivate::flushApiAuthUsage()
+{
+    if (apiAuthUsed.empty())
+    {
+        return;
+    }
+
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+
+    for (size_t pos : apiAuthUsed)
+    {
+        if (pos >= apiAuths.size())
+        {
+            continue;
+        }
+
+        ApiAuth &auth = apiAuths[pos];
+        auth.lastUseDate = now;
+        auth.needSaveDatabase = true;
+
+        auto i = apiAuthCache.find(auth.apikey);
+        if (i != apiAuthCache.end())
+        {
+            i->used = false;
+        }
+    }
+
+    apiAuthUsed.clear();
+
+    if (!apiAuthSaveDatabaseTime.isValid() || apiAuthSaveDatabaseTime.elapsed() > (1000 * 60 * 30))
+    {
+        apiAuthSaveDatabaseTime.start();
+        queSaveDb(DB_AUTH, DB_HUGE_SAVE_DELAY);
+    }
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "cbor_writer.h"
+#include "resource.h"
+
+// major types
+enum CborMajor
+{
+    CborUnsigned = 0,
+    CborNegative = 1,
+    CborText     = 3,
+    CborArray    = 4,
+    CborMap      = 5,
+    CborSimple   = 7
+};
+
+CborWriter::CborWriter(int reserve)
+{
+    m_buf.reserve(reserve);
+}
+
+void CborWriter::clear()
+{
+    m_buf.resize(0);
+    m_error = false;
+}
+
+/*! Appends the initial byte(s) of a data item with the shortest argument encoding.
+ */
+void CborWriter::appendHead(quint8 major, quint64 val)
+{
+    const char m = char(major << 5);
+
+    if (val < 24)
+    {
+        m_buf.append(char(m | char(val)));
+        return;
+    }
+
+    int n;
+    if (val <= 0xFF)             { m_buf.append(char(m | 24)); n = 1; }
+    else if (val <= 0xFFFF)      { m_buf.append(char(m | 25)); n = 2; }
+    else if (val <= 0xFFFFFFFFU) { m_buf.append(char(m | 26)); n = 4; }
+    else                         { m_buf.append(char(m | 27)); n = 8; }
+
+    for (int i = n - 1; i >= 0; i--) // big endian
+    {
+        m_buf.append(char((val >> (i * 8)) & 0xFF));
+    }
+}
+
+CborWriter &CborWriter::beginObject()
+{
+    m_buf.append(char(0xBF)); // indefinite length map
+    return *this;
+}
+
+CborWriter &CborWriter::endObject()
+{
+    m_buf.append(char(0xFF)); // break
+    return *this;
+}
+
+CborWriter &CborWriter::beginArray()
+{
+    m_buf.append(char(0x9F)); // indefinite length array
+    return *this;
+}
+
+CborWriter &CborWriter::endArray()
+{
+    m_buf.append(char(0xFF));
+    return *this;
+}
+
+CborWriter &CborWriter::null()
+{
+    m_buf.append(char(0xF6));
+    return *this;
+}
+
+CborWriter &CborWriter::value(bool val)
+{
+    m_buf.append(char(val ? 0xF5 : 0xF4));
+    return *this;
+}
+
+CborWriter &CborWriter::value(qint64 val)
+{
+    if (val < 0)
+    {
+        appendHead(CborNegative, quint64(-(val + 1)));
+    }
+    else
+    {
+        appendHead(CborUnsigned, quint64(val));
+    }
+    return *this;
+}
+
+CborWriter &CborWriter::value(quint64 val)
+{
+    appendHead(CborUnsigned, val);
+    return *this;
+}
+
+CborWriter &CborWriter::value(double val)
+{
+    if (std::isnan(val) || std::isinf(val))
+    {
+        return null(); // like JSON
+    }
+
+    // integral values are the common case in ZCL attributes
+    if (val >= -9007199254740992.0 && val <= 9007199254740992.0 && std::floor(val) == val)
+    {
+        return value(qint64(val));
+    }
+
+    const float f = float(val);
+    if (double(f) == val)
+    {
+        quint32 bits;
+        memcpy(&bits, &f, sizeof(bits));
+        m_buf.append(char(0xFA));
+        for (int i = 3; i >= 0; i--)
+        {
+            m_buf.append(char((bits >> (i * 8)) & 0xFF));
+        }
+        return *this;
+    }
+
+    quint64 bits;
+    memcpy(&bits, &val, sizeof(bits));
+    m_buf.append(char(0xFB));
+    for (int i = 7; i >= 0; i--)
+    {
+        m_buf.append(char((bits >> (i * 8)) & 0xFF));
+    }
+    return *this;
+}
+
+CborWriter &CborWriter::value(QLatin1String val)
+{
+    const char *s = val.data();
+    const char *end = s + val.size();
+
+    if (std::all_of(s, end, [](char c) { return uchar(c) < 0x80; }))
+    {
+        appendHead(CborText, quint64(val.size()));
+        m_buf.append(s, val.size());
+        return *this;
+    }
+
+    return value(QString(val));
+}
+
+CborWriter &CborWriter::value(const QString &val)
+{
+    const QByteArray utf8 = val.toUtf8();
+    appendHead(CborText, quint64(utf8.size()));
+    m_buf.append(utf8);
+    return *this;
+}
+
+/*! Writes a QVariant hierarchy, the types are mapped like in JsonWriter::value(const QVariant&).
+ */
+CborWriter &CborWriter::value(const QVariant &val)
+{
+    if (!val.isValid())
+    {
+        return null();
+    }
+
+    const QVariant::Type type = val.type();
+
+    if (type == QVariant::List)
+    {
+        const QVariantList list = val.toList();
+        beginArray();
+        for (const QVariant &v : list)
+        {
+            value(v);
+        }
+        return endArray();
+    }
+    else if (type == QVariant::StringList)
+    {
+        const QStringList list = val.toStringList();
+        beginArray();
+        for (const QString &s : list)
+        {
+            if (s.isNull()) { null(); }
+            else            { value(s); }
+        }
+        return endArray();
+    }
+    else if (type == QVariant::Map)
+    {
+        const QVariantMap map = val.toMap();
+        beginObject();
+        for (auto i = map.cbegin(); i != map.cend(); ++i)
+        {
+            key(i.key()).value(i.value());
+        }
+        return endObject();
+    }
+    else if (val.isNull())
+    {
+        return null();
+    }
+    else if (type == QVariant::String || type == QVariant::ByteArray)
+    {
+        return value(val.toString());
+    }
+    else if (type == QVariant::Double)
+    {
+        return value(val.toDouble());
+    }
+    else if (type == QVariant::Bool)
+    {
+        return value(val.toBool());
+    }
+    else if (type == QVariant::ULongLong)
+    {
+        return value(quint64(val.value<qulonglong>()));
+    }
+    else if (val.canConvert<qlonglong>())
+    {
+        return value(qint64(val.value<qlonglong>()));
+    }
+    else if (val.canConvert<QString>())
+    {
+        return value(val.toString());
+    }
+
+    m_error = true;
+    return null();
+}
+
+/*! Writes the value of \p item directly, without converting it to a QVariant.
+ */
+CborWriter &CborWriter::value(const ResourceItem &item)
+{
+    if (!item.lastSet().isValid())
+    {
+        return null();
+    }
+
+    switch (item.descriptor().type)
+    {
+    case DataTypeString:
+    case DataTypeTimePattern:
+    case DataTypeTime:
+    {
+        const QString &str = item.toString();
+        return str.isNull() ? null() : value(str);
+    }
+
+    case DataTypeBool:
+        return value(item.toBool());
+
+    case DataTypeReal:
+        return value(item.toVariant());
+
+    default:
+        break;
+    }
+
+    return value(qint64(item.toNumber()));
+}
+
+/*! Writes a map with all items of \p r which suffix starts with \p prefix.
+    The prefix is stripped from the keys, keys are sorted like in JsonWriter::resourceItems().
+ */
+CborWriter &CborWriter::resourceItems(const Resource &r, const char *prefix)
+{
+    const size_t len = strlen(prefix);
+
+    m_items.clear();
+    for (int i = 0; i < r.itemCount(); i++)
+    {
+        const ResourceItem *item = r.itemForIndex(size_t(i));
+        if (item && strncmp(item->descriptor().suffix, prefix, len) == 0)
+        {
+            m_items.push_back(item);
+        }
+    }
+
+    std::sort(m_items.begin(), m_items.end(), [len](const ResourceItem *a, const ResourceItem *b)
+    {
+        return strcmp(a->descriptor().suffix + len, b->descriptor().suffix + len) < 0;
+    });
+
+    beginObject();
+    for (const ResourceItem *item : m_items)
+    {
+        key(item->descriptor().suffix + len).value(*item);
+    }
+    return endObject();
+}
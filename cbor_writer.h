@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <vector>
+#include <QByteArray>
+#include <QLatin1String>
+#include <QString>
+#include <QVariant>
+
+class Resource;
+class ResourceItem;
+
+/*! \class CborWriter
+
+    Single pass CBOR (RFC 8949) writer with the same interface and schema as
+    JsonWriter, used for websocket clients which negotiated binary events.
+
+    Objects and arrays are written with indefinite length, so no counts are
+    needed upfront. Numbers without fraction are written as integers, others
+    as single precision float if lossless, else as double.
+
+        CborWriter cbor;
+        cbor.beginObject();
+        cbor.key("power").value(*item);
+        cbor.endObject();
+ */
+class CborWriter
+{
+public:
+    explicit CborWriter(int reserve = 256);
+    void clear();
+    const QByteArray &buffer() const { return m_buf; }
+    bool hasError() const { return m_error; }
+
+    CborWriter &beginObject();
+    CborWriter &endObject();
+    CborWriter &beginArray();
+    CborWriter &endArray();
+
+    CborWriter &key(const char *key) { return value(QLatin1String(key)); }
+    CborWriter &key(QLatin1String key) { return value(key); }
+    CborWriter &key(const QString &key) { return value(key); }
+
+    CborWriter &null();
+    CborWriter &value(bool val);
+    CborWriter &value(int val) { return value(qint64(val)); }
+    CborWriter &value(uint val) { return value(quint64(val)); }
+    CborWriter &value(qint64 val);
+    CborWriter &value(quint64 val);
+    CborWriter &value(double val);
+    CborWriter &value(const char *val) { return value(QLatin1String(val)); }
+    CborWriter &value(QLatin1String val);
+    CborWriter &value(const QString &val);
+    CborWriter &value(const QVariant &val);
+    CborWriter &value(const ResourceItem &item);
+
+    CborWriter &resourceItems(const Resource &r, const char *prefix);
+
+private:
+    void appendHead(quint8 major, quint64 val);
+
+    QByteArray m_buf;
+    std::vector<const ResourceItem*> m_items; // scratch for resourceItems()
+    bool m_error = false;
+};
+
+#endif // CBOR_WRITER_H
@@ -9,12 +9,20 @@
  */
 
 #define __STDC_FORMAT_MACROS
+#include <algorithm>
 #include <inttypes.h>
+#include <memory>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QString>
 #include <QStringBuilder>
-#include <QElapsedTimer>
 #include <unistd.h>
 #include "database.h"
+#include "database_writer.h"
 #include "de_web_plugin_private.h"
 #include "deconz/dbg_trace.h"
 #include "device_descriptions.h"
@@ -33,6 +41,7 @@ static const char *pragmaFreeListCount = "PRAGMA freelist_count";
 
 static sqlite3 *db = nullptr; // TODO should be member of Database class
 static char sqlBuf[MAX_SQL_LEN];
+static std::vector<QByteArray> dbSaveRetryStatements; // saveDb() snapshot of a failed transaction, executed first with the next save
 
 static StaticJsonDocument<1024 * 1024 * 2> dbJson; /* 2 mega bytes*/
 
@@ -46,6 +55,8 @@ struct DB_Callback {
                     Local prototypes
 ******************************************************************************/
 static bool initAlarmSystemsTable();
+static void DB_FinalizeCachedStatements();
+static void DB_ClearSubDeviceIdCache();
 static bool initSecretsTable();
 static int sqliteLoadAuthCallback(void *user, int ncols, char **colval , char **colname);
 static int sqliteLoadConfigCallback(void *user, int ncols, char **colval , char **colname);
@@ -903,27 +914,10 @@ void DeRestPluginPrivate::refreshDeviceDb(const deCONZ::Address &addr)
     queSaveDb(DB_QUERY_QUEUE, DB_SHORT_SAVE_DELAY);
 }
 
-/*! Push/update a zdp descriptor in the database to cache node data.
-  */
-void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoint, quint16 type, const QByteArray &data)
+/*! Writes a zdp descriptor via \p conn unless the same one is already stored.
+ */
+static void DB_StoreZdpDescriptor(sqlite3 *conn, const QString &uniqueid, quint8 endpoint, quint16 type, const QByteArray &data, qint64 now)
 {
-    DBG_Printf(DBG_INFO_L2, "DB pushZdpDescriptorDb()\n");
-
-    openDb();
-    DBG_Assert(db);
-    if (!db)
-    {
-        return;
-    }
-
-    // store now to make sure 'devices' table is populated
-    if (!dbQueryQueue.empty())
-    {
-        saveDb();
-    }
-
-    qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
-    const QString uniqueid = generateUniqueId(extAddress, 0, 0);
     char mac[23 + 1];
     strncpy(mac, qPrintable(uniqueid), uniqueid.size());
     mac[23] = '\0';
@@ -937,7 +931,7 @@ void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoin
                        " AND type = ?3"
                        " AND data = ?4";
 
-    rc = sqlite3_prepare_v2(db, sql, -1, &res, nullptr);
+    rc = sqlite3_prepare_v2(conn, sql, -1, &res, nullptr);
     DBG_Assert(res);
     DBG_Assert(rc == SQLITE_OK);
 
@@ -992,7 +986,7 @@ void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoin
           " AND type = ?5";
 
 
-    rc = sqlite3_prepare_v2(db, sql, -1, &res, nullptr);
+    rc = sqlite3_prepare_v2(conn, sql, -1, &res, nullptr);
     DBG_Assert(res);
     DBG_Assert(rc == SQLITE_OK);
 
@@ -1028,7 +1022,7 @@ void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoin
 
     if (rc != SQLITE_OK)
     {
-        DBG_Printf(DBG_INFO, "DB failed %s\n", sqlite3_errmsg(db));
+        DBG_Printf(DBG_INFO, "DB failed %s\n", sqlite3_errmsg(conn));
         if (res)
         {
             rc = sqlite3_finalize(res);
@@ -1050,7 +1044,7 @@ void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoin
     rc = sqlite3_step(res);
     if (rc == SQLITE_DONE)
     {
-        changes = sqlite3_changes(db);
+        changes = sqlite3_changes(conn);
     }
     DBG_Assert(rc == SQLITE_DONE);
 
@@ -1073,7 +1067,7 @@ void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoin
           " SELECT id, ?1, ?2, ?3, ?4"
           " FROM devices WHERE mac = ?5";
 
-    rc = sqlite3_prepare_v2(db, sql, -1, &res, nullptr);
+    rc = sqlite3_prepare_v2(conn, sql, -1, &res, nullptr);
     DBG_Assert(res);
     DBG_Assert(rc == SQLITE_OK);
 
@@ -1109,7 +1103,7 @@ void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoin
 
     if (rc != SQLITE_OK)
     {
-        DBG_Printf(DBG_INFO, "DB failed %s\n", sqlite3_errmsg(db));
+        DBG_Printf(DBG_INFO, "DB failed %s\n", sqlite3_errmsg(conn));
         if (res)
         {
             rc = sqlite3_finalize(res);
@@ -1130,11 +1124,48 @@ void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoin
     rc = sqlite3_step(res);
     if (rc == SQLITE_DONE)
     {
-        changes = sqlite3_changes(db);
+        changes = sqlite3_changes(conn);
         DBG_Assert(changes == 1);
     }
     rc = sqlite3_finalize(res);
     DBG_Assert(rc == SQLITE_OK);
+}
+
+/*! Push/update a zdp descriptor in the database to cache node data.
+  */
+void DeRestPluginPrivate::pushZdpDescriptorDb(quint64 extAddress, quint8 endpoint, quint16 type, const QByteArray &data)
+{
+    DBG_Printf(DBG_INFO_L2, "DB pushZdpDescriptorDb()\n");
+
+    openDb();
+    DBG_Assert(db);
+    if (!db)
+    {
+        return;
+    }
+
+    // store now to make sure 'devices' table is populated,
+    // the writer thread executes the descriptor after the queued devices entry
+    if (!dbQueryQueue.empty())
+    {
+        saveDb();
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const QString uniqueid = generateUniqueId(extAddress, 0, 0);
+
+    if (DB_WriterIsRunning())
+    {
+        DB_WriterPost([uniqueid, endpoint, type, data, now](sqlite3 *conn)
+        {
+            DB_StoreZdpDescriptor(conn, uniqueid, endpoint, type, data, now);
+        });
+    }
+    else
+    {
+        DB_StoreZdpDescriptor(db, uniqueid, endpoint, type, data, now);
+    }
+
     closeDb();
 }
 
@@ -1148,39 +1179,172 @@ void DeRestPluginPrivate::pushZclValueDb(quint64 extAddress, quint8 endpoint, qu
         return; // zcl value datastore disabled
     }
 
-    /*
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+    TS_Store *store = timeSeriesStore();
+    if (!store)
+    {
+        return;
+    }
 
-    select mac, printf('0x%04X', cluster), data, datetime(zcl_values.timestamp,'unixepoch','localtime')
-    from zcl_values inner join devices ON zcl_values.device_id = devices.id
-    where zcl_values.timestamp > strftime('%s','now') - 300;
+    TS_Key key;
+    key.extAddress = extAddress;
+    key.endpoint = endpoint;
+    key.clusterId = clusterId;
+    key.attributeId = attributeId;
 
-    */
-    qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
-    QString sql = QString(QLatin1String(
-                              "INSERT INTO zcl_values (device_id,endpoint,cluster,attribute,data,timestamp) "
-                              "SELECT id, %2, %3, %4, %5, %6 "
-                              "FROM devices WHERE mac = '%1'"))
-            .arg(generateUniqueId(extAddress, 0, 0))
-            .arg(endpoint)
-            .arg(clusterId)
-            .arg(attributeId)
-            .arg(data)
-            .arg(now);
+    store->append(key, now, data);
+}
 
-    dbQueryQueue.push_back(sql);
-    queSaveDb(DB_QUERY_QUEUE, (dbQueryQueue.size() > 30) ? DB_SHORT_SAVE_DELAY : DB_LONG_SAVE_DELAY);
+/*! Queues deleting the zcl_values rows up to \p maxId, saveDb() repeats failed transactions.
+ */
+static void DB_QueueClearZclValues(qint64 maxId)
+{
+    DeRestPluginPrivate *d = DeRestPluginPrivate::instance();
+    d->dbQueryQueue.push_back(QString(QLatin1String("DELETE FROM zcl_values WHERE id <= %1")).arg(maxId));
+    d->queSaveDb(DB_QUERY_QUEUE, DB_SHORT_SAVE_DELAY);
+}
 
-    // add a cleanup command if not already queued
-    for (const QString &q : dbQueryQueue)
+/*! Moves the samples of the zcl_values table, which was used before the time-series store, into \p store.
+
+    The highest migrated zcl_values.id is recorded in \p markerPath after the samples are written
+    by the store. Only newer rows are migrated, so no sample is duplicated if the migrated rows
+    couldn't be deleted. Deleting is queued after the marker is written and on each start.
+ */
+static void DB_MigrateZclValues(sqlite3 *db, TS_Store *store, const QString &markerPath, qint64 minTimestamp)
+{
+    qint64 migratedId = 0;
     {
-        if (q.startsWith(QLatin1String("DELETE FROM zcl_values")))
+        QFile marker(markerPath);
+        if (marker.open(QIODevice::ReadOnly))
         {
-            return; // already queued
+            migratedId = marker.readAll().trimmed().toLongLong();
         }
     }
 
-    sql = QString(QLatin1String("DELETE FROM zcl_values WHERE timestamp < %1")).arg(now - dbZclValueMaxAge);
-    dbQueryQueue.push_back(sql);
+    if (migratedId > 0)
+    {
+        DB_QueueClearZclValues(migratedId); // no-op once the table is empty
+    }
+
+    sqlite3_stmt *stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, "SELECT MAX(id) FROM zcl_values", -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+    {
+        return; // no zcl_values table
+    }
+
+    qint64 maxId = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        maxId = sqlite3_column_int64(stmt, 0); // 0 for NULL if the table is empty
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (maxId <= migratedId)
+    {
+        return;
+    }
+
+    const char *sql = "SELECT devices.mac, zcl_values.endpoint, zcl_values.cluster, zcl_values.attribute, zcl_values.data, zcl_values.timestamp"
+                      " FROM zcl_values INNER JOIN devices ON zcl_values.device_id = devices.id"
+                      " WHERE zcl_values.id > ?1 AND zcl_values.id <= ?2 AND zcl_values.timestamp >= ?3"
+                      " ORDER BY zcl_values.timestamp ASC";
+
+    stmt = nullptr;
+    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK)
+    {
+        return;
+    }
+
+    sqlite3_bind_int64(stmt, 1, migratedId);
+    sqlite3_bind_int64(stmt, 2, maxId);
+    sqlite3_bind_int64(stmt, 3, minTimestamp);
+
+    int count = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char *mac = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (!mac)
+        {
+            continue;
+        }
+
+        bool ok = false;
+        TS_Key key;
+        key.extAddress = QString(QLatin1String(mac)).remove(QLatin1Char(':')).toULongLong(&ok, 16);
+        key.endpoint = quint8(sqlite3_column_int(stmt, 1));
+        key.clusterId = quint16(sqlite3_column_int(stmt, 2));
+        key.attributeId = quint16(sqlite3_column_int(stmt, 3));
+
+        if (ok)
+        {
+            store->append(key, sqlite3_column_int64(stmt, 5), sqlite3_column_int64(stmt, 4));
+            count++;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    store->flush(QDateTime::currentMSecsSinceEpoch() / 1000, true);
+
+    // executed after the file jobs of the flush, rows older than minTimestamp are dropped as well
+    store->post([markerPath, maxId]()
+    {
+        QDir().mkpath(QFileInfo(markerPath).absolutePath()); // no sample might have been written
+        QSaveFile marker(markerPath);
+        if (!marker.open(QIODevice::WriteOnly) || marker.write(QByteArray::number(maxId)) < 0 || !marker.commit())
+        {
+            DBG_Printf(DBG_ERROR, "DB failed to write %s\n", qPrintable(markerPath));
+            return;
+        }
+
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [maxId]()
+        {
+            DB_QueueClearZclValues(maxId);
+        }, Qt::QueuedConnection);
+    });
+
+    DBG_Printf(DBG_INFO, "DB moved %d zcl_values samples to the time-series store\n", count);
+}
+
+/*! Returns the time-series store for ZCL attribute history, created on first use.
+    \returns nullptr if the history is disabled (zclvaluemaxage).
+ */
+TS_Store *DeRestPluginPrivate::timeSeriesStore()
+{
+    if (dbZclValueMaxAge <= 0)
+    {
+        return nullptr;
+    }
+
+    if (!timeSeries)
+    {
+        const QString dataPath = deCONZ::getStorageLocation(deCONZ::ApplicationsDataLocation);
+        timeSeries.reset(new TS_Store(dataPath + QLatin1String("/timeseries")));
+        // file I/O on an own thread, the worker executes pending jobs when the store is destroyed
+        auto worker = std::make_shared<TS_Worker>();
+        timeSeries->setExecutor([worker](std::function<void()> job)
+        {
+            worker->post(std::move(job));
+        });
+
+        // samples were stored in the zcl_values table before
+        openDb();
+        if (db)
+        {
+            const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+            timeSeries->setMaxAge(dbZclValueMaxAge);
+            DB_MigrateZclValues(db, timeSeries.get(), dataPath + QLatin1String("/timeseries/zcl_values.migrated"), now - dbZclValueMaxAge);
+        }
+    }
+
+    timeSeries->setMaxAge(dbZclValueMaxAge);
+    return timeSeries.get();
 }
 
 bool DeRestPluginPrivate::dbIsOpen() const
@@ -1212,6 +1376,11 @@ void DeRestPluginPrivate::openDb()
     const char *sql = "PRAGMA foreign_keys = ON"; // must be enabled at runtime for each connection
     rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
     DBG_Assert(rc == SQLITE_OK);
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT);
+
+    // persistent, but set on each connection as the writer thread might not be running
+    rc = sqlite3_exec(db, "PRAGMA journal_mode=WAL", nullptr, nullptr, nullptr);
+    DBG_Assert(rc == SQLITE_OK);
 
     ttlDataBaseConnection = idleTotalCounter + DB_CONNECTION_TTL;
 }
@@ -1325,6 +1494,8 @@ void DeRestPluginPrivate::loadAuthFromDb()
             sqlite3_free(errmsg);
         }
     }
+
+    invalidateApiAuthCache();
 }
 
 /*! Sqlite callback to load configuration data.
@@ -2432,20 +2603,60 @@ void DeRestPluginPrivate::loadAllSchedulesFromDb()
 }
 
 
-/*! Load sensor data from database.
+/*! Appends the history of \p key as raw samples or, if \p bucket > 0, as aggregates per bucket.
  */
-void DeRestPluginPrivate::loadSensorDataFromDb(Sensor *sensor, QVariantList &ls, qint64 fromTime, int max)
+static void appendHistory(const TS_Store &store, const TS_Key &key, const char *suffix, QVariantList &ls, qint64 fromTime, qint64 toTime, int max, qint64 bucket)
 {
-    DBG_Assert(db);
+    const auto toString = [](qint64 timestamp)
+    {
+        QDateTime dateTime;
+        dateTime.setMSecsSinceEpoch(timestamp * 1000);
+        return dateTime.toString(QLatin1String("yyyy-MM-ddTHH:mm:ss"));
+    };
 
-    if (!db)
+    if (bucket <= 0)
     {
+        const auto samples = store.query(key, fromTime + 1, toTime);
+
+        for (size_t i = 0; i < samples.size() && int(i) < max; i++)
+        {
+            QVariantMap map;
+            map[suffix] = samples[i].value;
+            map["t"] = toString(samples[i].timestamp);
+            ls.append(map);
+        }
         return;
     }
 
+    const auto buckets = store.aggregate(key, fromTime, toTime, bucket);
+
+    for (size_t i = 0; i < buckets.size() && int(i) < max; i++)
+    {
+        const TS_Aggregate &agg = buckets[i];
+        QVariantMap value;
+        value["min"] = agg.min;
+        value["max"] = agg.max;
+        value["avg"] = agg.avg();
+        value["last"] = agg.last;
+        value["count"] = agg.count;
+
+        QVariantMap map;
+        map[suffix] = value;
+        map["t"] = toString(agg.timestamp);
+        ls.append(map);
+    }
+}
+
+/*! Load sensor data from the time-series store.
+    \param bucket - if > 0 returns min/max/avg/last per bucket of \p bucket seconds
+ */
+void DeRestPluginPrivate::loadSensorDataFromDb(Sensor *sensor, QVariantList &ls, qint64 fromTime, qint64 toTime, int max, qint64 bucket)
+{
     DBG_Assert(sensor);
 
-    if (!sensor)
+    TS_Store *store = timeSeriesStore();
+
+    if (!sensor || !store)
     {
         return;
     }
@@ -2468,98 +2679,33 @@ void DeRestPluginPrivate::loadSensorDataFromDb(Sensor *sensor, QVariantList &ls,
         { nullptr, 0, 0 }
     };
 
-    const RMap *r = rmap;
-
-    while (r->item)
+    for (const RMap *r = rmap; r->item; r++)
     {
-        for (int i  = 0; i < sensor->itemCount(); i++)
+        if (!sensor->item(r->item))
         {
-            ResourceItem *item = sensor->itemForIndex(static_cast<size_t>(i));
-
-            if (r->item != item->descriptor().suffix)
-            {
-                continue;
-            }
-
-            const char *sql = "SELECT data,timestamp FROM sensor_device_value_view "
-                              "WHERE sensor_id = ?1 AND timestamp > ?2 AND cluster_id = ?3 limit ?4";
-
-            int rc;
-            int sid = sensor->id().toInt();
-            sqlite3_stmt *res = nullptr;
-
-            rc = sqlite3_prepare_v2(db, sql, -1, &res, nullptr);
-            DBG_Assert(res != nullptr);
-            DBG_Assert(rc == SQLITE_OK);
-
-            if (rc == SQLITE_OK)
-            {
-                rc = sqlite3_bind_int(res, 1, sid);
-                DBG_Assert(rc == SQLITE_OK);
-            }
-
-            if (rc == SQLITE_OK)
-            {
-                rc = sqlite3_bind_int64(res, 2, fromTime);
-                DBG_Assert(rc == SQLITE_OK);
-            }
-
-            if (rc == SQLITE_OK)
-            {
-                rc = sqlite3_bind_int(res, 3, r->clusterId);
-                DBG_Assert(rc == SQLITE_OK);
-            }
-
-            if (rc == SQLITE_OK)
-            {
-                rc = sqlite3_bind_int(res, 4, max);
-                DBG_Assert(rc == SQLITE_OK);
-            }
-
-            if (rc != SQLITE_OK)
-            {
-                if (res)
-                {
-                    rc = sqlite3_finalize(res);
-                    DBG_Assert(rc == SQLITE_OK);
-                }
-                continue;
-            }
-
-            while (sqlite3_step(res) == SQLITE_ROW)
-            {
-                QVariantMap map;
-                qint64 val = sqlite3_column_int64(res, 0);
-                qint64 timestamp = sqlite3_column_int64(res, 1);
+            continue;
+        }
 
-                QDateTime dateTime;
-                dateTime.setMSecsSinceEpoch(timestamp * 1000);
-                map[item->descriptor().suffix] = val;
-                map["t"] = dateTime.toString(QLatin1String("yyyy-MM-ddTHH:mm:ss"));
-                ls.append(map);
-            }
+        TS_Key key;
+        key.extAddress = sensor->address().ext();
+        key.endpoint = sensor->fingerPrint().endpoint;
+        key.clusterId = r->clusterId;
+        key.attributeId = r->attributeId;
 
-            rc = sqlite3_finalize(res);
-            DBG_Assert(rc == SQLITE_OK);
-        }
-        r++;
+        appendHistory(*store, key, r->item, ls, fromTime, toTime, max, bucket);
     }
 }
 
-/*! Load light from database.
+/*! Load light data from the time-series store.
+    \param bucket - if > 0 returns min/max/avg/last per bucket of \p bucket seconds
  */
-void DeRestPluginPrivate::loadLightDataFromDb(LightNode *lightNode, QVariantList &ls, qint64 fromTime, int max)
+void DeRestPluginPrivate::loadLightDataFromDb(LightNode *lightNode, QVariantList &ls, qint64 fromTime, qint64 toTime, int max, qint64 bucket)
 {
-    DBG_Assert(db);
-
-    if (!db)
-    {
-        return;
-    }
-
     DBG_Assert(lightNode);
 
-    if (!lightNode)
+    TS_Store *store = timeSeriesStore();
+
+    if (!lightNode || !store)
     {
         return;
     }
@@ -2577,89 +2723,20 @@ void DeRestPluginPrivate::loadLightDataFromDb(LightNode *lightNode, QVariantList
         { nullptr, 0, 0 }
     };
 
-    for (int i  = 0; i < lightNode->itemCount(); i++)
+    for (const RMap *r = rmap; r->item; r++)
     {
-        ResourceItem *item = lightNode->itemForIndex(i);
-        const RMap *found = nullptr;
-        const RMap *r = rmap;
-
-        while (!found && r->item)
-        {
-            if (r->item == item->descriptor().suffix)
-            {
-              found = r;
-              break;
-            }
-            r++;
-        }
-
-        if (!found)
-        {
-            continue;
-        }
-
-        const char *sql = "SELECT data,timestamp FROM light_device_value_view "
-                          "WHERE light_id = ?1 AND timestamp > ?2 AND cluster_id = ?3 limit ?4";
-
-        int rc;
-        int sid = lightNode->id().toInt();
-        sqlite3_stmt *res = nullptr;
-
-        rc = sqlite3_prepare_v2(db, sql, -1, &res, 0);
-        DBG_Assert(res != nullptr);
-        DBG_Assert(rc == SQLITE_OK);
-
-        if (rc == SQLITE_OK)
-        {
-            rc = sqlite3_bind_int(res, 1, sid);
-            DBG_Assert(rc == SQLITE_OK);
-        }
-
-        if (rc == SQLITE_OK)
-        {
-            rc = sqlite3_bind_int(res, 2, fromTime);
-            DBG_Assert(rc == SQLITE_OK);
-        }
-
-        if (rc == SQLITE_OK)
-        {
-            rc = sqlite3_bind_int(res, 3, found->clusterId);
-            DBG_Assert(rc == SQLITE_OK);
-        }
-
-        // TODO zcl attribute
-
-        if (rc == SQLITE_OK)
-        {
-            rc = sqlite3_bind_int(res, 4, max);
-            DBG_Assert(rc == SQLITE_OK);
-        }
-
-        if (rc != SQLITE_OK)
+        if (!lightNode->item(r->item))
         {
-            if (res)
-            {
-                rc = sqlite3_finalize(res);
-                DBG_Assert(rc == SQLITE_OK);
-            }
             continue;
         }
 
-        while (sqlite3_step(res) == SQLITE_ROW)
-        {
-            QVariantMap map;
-            qint64 val = sqlite3_column_int64(res, 0);
-            qint64 timestamp = sqlite3_column_int64(res, 1);
-
-            QDateTime dateTime;
-            dateTime.setMSecsSinceEpoch(timestamp * 1000);
-            map[item->descriptor().suffix] = val;
-            map["t"] = dateTime.toString(QLatin1String("yyyy-MM-ddTHH:mm:ss"));
-            ls.append(map);
-        }
+        TS_Key key;
+        key.extAddress = lightNode->address().ext();
+        key.endpoint = lightNode->haEndpoint().endpoint();
+        key.clusterId = r->clusterId;
+        key.attributeId = r->attributeId;
 
-        rc = sqlite3_finalize(res);
-        DBG_Assert(rc == SQLITE_OK);
+        appendHistory(*store, key, r->item, ls, fromTime, toTime, max, bucket);
     }
 }
 
@@ -3137,6 +3214,7 @@ static int sqliteLoadAllRulesCallback(void *user, int ncols, char **colval , cha
             // append to cache if not already known
             d->updateEtag(rule.etag);
             d->rules.push_back(rule);
+            d->ruleHandleIndex.insert(rule.handle(), d->rules.size() - 1);
         }
     }
 
@@ -4685,23 +4763,68 @@ void DeRestPluginPrivate::saveApiKey(QString apikey)
     }
 }
 
-/*! Saves all nodes, groups and scenes to the database.
+/*! Executes the statements of a saveDb() snapshot via \p conn within an open transaction.
+    Statements failing on their own are logged and skipped. For errors of the database
+    itself, like a locked or full database, the transaction is rolled back; on the writer
+    thread this repeats the whole batch.
+    \returns SQLITE_OK or the error code which caused the rollback
  */
-void DeRestPluginPrivate::saveDb()
+static int DB_ExecSaveStatements(sqlite3 *conn, const std::vector<QByteArray> &statements)
 {
-    DBG_Assert(db != 0);
-
-    if (!db)
+    for (const QByteArray &sql : statements)
     {
-        return;
-    }
+        char *errmsg = nullptr;
+        const int rc = sqlite3_exec(conn, sql.constData(), nullptr, nullptr, &errmsg);
 
-    if (saveDatabaseItems == 0)
-    {
-        return;
-    }
+        if (rc == SQLITE_OK)
+        {
+            continue;
+        }
 
-    if (saveDatabaseItems & DB_NOSAVE)
+        if (errmsg)
+        {
+            DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", sql.constData(), errmsg);
+            sqlite3_free(errmsg);
+        }
+
+        switch (rc & 0xFF) // primary result code
+        {
+        case SQLITE_BUSY:
+        case SQLITE_LOCKED:
+        case SQLITE_NOMEM:
+        case SQLITE_IOERR:
+        case SQLITE_FULL:
+            if (sqlite3_get_autocommit(conn) == 0) // might be rolled back by SQLite already
+            {
+                sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
+            }
+            return rc;
+
+        default:
+            break;
+        }
+    }
+
+    return SQLITE_OK;
+}
+
+/*! Saves all nodes, groups and scenes to the database.
+ */
+void DeRestPluginPrivate::saveDb()
+{
+    DBG_Assert(db != 0);
+
+    if (!db)
+    {
+        return;
+    }
+
+    if (saveDatabaseItems == 0)
+    {
+        return;
+    }
+
+    if (saveDatabaseItems & DB_NOSAVE)
     {
         return;
     }
@@ -4731,26 +4854,10 @@ void DeRestPluginPrivate::saveDb()
         }
     }
 
-    // make the whole save process one transaction otherwise each insert would become
-    // a transaction which is extremly slow
-    errmsg = NULL;
-    rc = sqlite3_exec(db, "BEGIN", 0, 0, &errmsg);
-    if (rc != SQLITE_OK)
-    {
-        if (errmsg)
-        {
-            DBG_Printf(DBG_ERROR, "DB SQL exec failed: BEGIN, error: %s\n", errmsg);
-            sqlite3_free(errmsg);
-        }
-
-        if (rc == SQLITE_BUSY)
-        {
-            DBG_Printf(DBG_INFO, "DB locked by another process, retry later\n");
-        }
-
-        queSaveDb(saveDatabaseItems, DB_SHORT_SAVE_DELAY);
-        return;
-    }
+    // the statements are collected first and executed as one transaction, either by the
+    // writer thread or below, the dirty flags are only cleared once the snapshot is taken
+    std::vector<QByteArray> statements;
+    statements.swap(dbSaveRetryStatements);
 
     DBG_Printf(DBG_INFO_L2, "DB save zll database items 0x%08X\n", saveDatabaseItems);
 
@@ -4775,17 +4882,7 @@ void DeRestPluginPrivate::saveDb()
                 QString sql = QString(QLatin1String("DELETE FROM auth WHERE apikey='%1'")).arg(i->apikey);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
             else if (i->state == ApiAuth::StateNormal)
             {
@@ -4801,17 +4898,7 @@ void DeRestPluginPrivate::saveDb()
 
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
         }
 
@@ -4882,17 +4969,7 @@ void DeRestPluginPrivate::saveDb()
                         .arg(i.value().toString());
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
         }
 
@@ -4914,17 +4991,7 @@ void DeRestPluginPrivate::saveDb()
                         .arg(i.value().toString());
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
         }
 
@@ -4937,17 +5004,7 @@ void DeRestPluginPrivate::saveDb()
             gwUserParameterToDelete.pop_back();
 
             DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
-                {
-                    DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
-                }
-            }
+            statements.push_back(sql.toUtf8());
         }
 
         saveDatabaseItems &= ~DB_USERPARAM;
@@ -4975,17 +5032,7 @@ void DeRestPluginPrivate::saveDb()
                 QString sql = QString(QLatin1String("DELETE FROM gateways WHERE uuid='%1'")).arg(gw->uuid());
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
             else
             {
@@ -5014,17 +5061,7 @@ void DeRestPluginPrivate::saveDb()
                         .arg(qPrintable(cgroups));
 
                 DBG_Printf(DBG_INFO_L2, "sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
         }
 
@@ -5051,18 +5088,9 @@ void DeRestPluginPrivate::saveDb()
                 // delete LightNode from db (if exist)
                 QString sql = QString("DELETE FROM nodes WHERE mac='%1'").arg(i->uniqueId());
                 sql.append(QString("; DELETE FROM devices WHERE mac = '%1'").arg(generateUniqueId(i->address().ext(), 0, 0)));
+                DB_ClearSubDeviceIdCache();
 
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
 
                 continue;
             }
@@ -5103,17 +5131,7 @@ void DeRestPluginPrivate::saveDb()
                     .arg(ritems);
 
             DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
-                {
-                    DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
-                }
-            }
+            statements.push_back(sql.toUtf8());
 
             // prevent deletion of nodes with numeric only mac address
             bool deleteUpperCase = false;
@@ -5133,17 +5151,7 @@ void DeRestPluginPrivate::saveDb()
                 sql = QString("DELETE FROM nodes WHERE mac='%1'").arg(i->uniqueId().toUpper());
             }
 
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
-                {
-                    DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
-                }
-            }
+            statements.push_back(sql.toUtf8());
         }
 
         saveDatabaseItems &= ~DB_LIGHTS;
@@ -5165,17 +5173,7 @@ void DeRestPluginPrivate::saveDb()
                 QString sql = QString(QLatin1String("DELETE FROM scenes WHERE gid='%1'")).arg(gid);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
 
             if (i->state() == Group::StateDeleteFromDB)
@@ -5184,17 +5182,7 @@ void DeRestPluginPrivate::saveDb()
                 QString sql = QString(QLatin1String("DELETE FROM groups WHERE gid='%1'")).arg(gid);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
                 continue;
             }
 
@@ -5222,17 +5210,7 @@ void DeRestPluginPrivate::saveDb()
                     .arg(uniqueid);
 
             DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
-                {
-                    DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
-                }
-            }
+            statements.push_back(sql.toUtf8());
 
             if (i->state() == Group::StateNormal)
             {
@@ -5266,17 +5244,7 @@ void DeRestPluginPrivate::saveDb()
                             .arg(lights);
                     }
                     DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                    errmsg = NULL;
-                    rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                    if (rc != SQLITE_OK)
-                    {
-                        if (errmsg)
-                        {
-                            DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                            sqlite3_free(errmsg);
-                        }
-                    }
+                    statements.push_back(sql.toUtf8());
                 }
             }
         }
@@ -5300,17 +5268,7 @@ void DeRestPluginPrivate::saveDb()
                 QString sql = QString(QLatin1String("DELETE FROM rules WHERE rid='%1'")).arg(rid);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
 
                 continue;
             }
@@ -5339,17 +5297,7 @@ void DeRestPluginPrivate::saveDb()
 
 
             DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
-                {
-                    DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
-                }
-            }
+            statements.push_back(sql.toUtf8());
         }
 
         saveDatabaseItems &= ~DB_RULES;
@@ -5375,34 +5323,14 @@ void DeRestPluginPrivate::saveDb()
                         .arg(json);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
             else if (rl.state == Resourcelinks::StateDeleted)
             {
                 QString sql = QString(QLatin1String("DELETE FROM resourcelinks WHERE id='%1'")).arg(rl.id);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
         }
 
@@ -5424,34 +5352,14 @@ void DeRestPluginPrivate::saveDb()
                         .arg(i->jsonString);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
             }
             else if (i->state == Schedule::StateDeleted)
             {
                 QString sql = QString(QLatin1String("DELETE FROM schedules WHERE id='%1'")).arg(i->id);
 
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
                 else
                 {
                     //i = schedules.erase(i);
@@ -5483,18 +5391,9 @@ void DeRestPluginPrivate::saveDb()
                 // delete sensor from db (if exist)
                 QString sql = QString("DELETE FROM sensors WHERE uniqueid='%1'").arg(i->uniqueId());
                 sql.append(QString("; DELETE FROM devices WHERE mac = '%1'").arg(generateUniqueId(i->address().ext(), 0, 0)));
+                DB_ClearSubDeviceIdCache();
 
-                errmsg = NULL;
-                rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-                if (rc != SQLITE_OK)
-                {
-                    if (errmsg)
-                    {
-                        DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                        sqlite3_free(errmsg);
-                    }
-                }
+                statements.push_back(sql.toUtf8());
 
                 continue;
             }
@@ -5540,17 +5439,7 @@ void DeRestPluginPrivate::saveDb()
                     .arg(i->lastAnnounced());
 
             DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
-                {
-                    DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
-                }
-            }
+            statements.push_back(sql.toUtf8());
         }
 
         saveDatabaseItems &= ~DB_SENSORS;
@@ -5566,51 +5455,113 @@ void DeRestPluginPrivate::saveDb()
                 DBG_Printf(DBG_INFO_L2, "DB sql exec %s\n", qPrintable(sql));
             }
 
-            errmsg = NULL;
-            rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
-
-            if (rc != SQLITE_OK)
-            {
-                if (errmsg)
-                {
-                    DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: %s, error: %s\n", qPrintable(sql), errmsg);
-                    sqlite3_free(errmsg);
-                }
-            }
+            statements.push_back(sql.toUtf8());
         }
 
         dbQueryQueue.clear();
         saveDatabaseItems &= ~DB_QUERY_QUEUE;
     }
 
+    const bool syncFs = (saveDatabaseItems & DB_SYNC) != 0;
+    saveDatabaseItems &= ~DB_SYNC;
+
+    if (DB_WriterIsRunning())
+    {
+        // the writer repeats the whole batch if the transaction fails
+        DB_WriterCompletion done;
+#ifdef Q_OS_LINUX
+        if (syncFs)
+        {
+            done = []()
+            {
+                QElapsedTimer measTimer;
+                measTimer.start();
+                sync();
+                DBG_Printf(DBG_INFO_L2, "sync() in %d ms\n", int(measTimer.elapsed()));
+            };
+        }
+#endif
+        const int count = int(statements.size());
+        DB_WriterPost([statements = std::move(statements)](sqlite3 *conn)
+        {
+            DB_ExecSaveStatements(conn, statements);
+        }, nullptr, std::move(done));
+
+        DB_FlushSubDeviceItems();
+        DBG_Printf(DBG_INFO_L2, "DB save queued %d statements in %ld ms\n", count, measTimer.elapsed());
+        return;
+    }
+
+    // take the write lock upfront, with a deferred BEGIN the statements could fail
+    // on the lock upgrade while the database is locked by another process
     errmsg = NULL;
-    rc = sqlite3_exec(db, "COMMIT", 0, 0, &errmsg);
+    rc = sqlite3_exec(db, "BEGIN IMMEDIATE", 0, 0, &errmsg);
     if (rc != SQLITE_OK)
     {
         if (errmsg)
         {
-            DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: COMMIT, error: %s (%d)\n", errmsg, rc);
+            DBG_Printf(DBG_ERROR, "DB SQL exec failed: BEGIN IMMEDIATE, error: %s\n", errmsg);
             sqlite3_free(errmsg);
         }
 
-        // if the transaction is still intact (SQLITE_BUSY) it will be committed on the next run of saveDb()
+        if (rc == SQLITE_BUSY)
+        {
+            DBG_Printf(DBG_INFO, "DB locked by another process, retry later\n");
+        }
     }
 
     if (rc == SQLITE_OK)
     {
-        DBG_Printf(DBG_INFO_L2, "DB saved in %ld ms\n", measTimer.elapsed());
+        rc = DB_ExecSaveStatements(db, statements);
+    }
 
-        if (saveDatabaseItems & DB_SYNC)
+    if (rc == SQLITE_OK)
+    {
+        // with the write lock held COMMIT only waits for readers of a checkpoint
+        for (int i = 0; i < DB_MAX_COMMIT_RETRIES; i++)
         {
-#ifdef Q_OS_LINUX
-            QElapsedTimer measTimer;
-            measTimer.restart();
-            sync();
-            DBG_Printf(DBG_INFO_L2, "sync() in %d ms\n", int(measTimer.elapsed()));
-#endif
-            saveDatabaseItems &= ~DB_SYNC;
+            errmsg = NULL;
+            rc = sqlite3_exec(db, "COMMIT", 0, 0, &errmsg);
+            if (errmsg)
+            {
+                DBG_Printf(DBG_ERROR, "DB sqlite3_exec failed: COMMIT, error: %s (%d)\n", errmsg, rc);
+                sqlite3_free(errmsg);
+            }
+
+            if (rc != SQLITE_BUSY)
+            {
+                break;
+            }
         }
+
+        if (rc != SQLITE_OK && sqlite3_get_autocommit(db) == 0)
+        {
+            sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+        }
+    }
+
+    if (rc != SQLITE_OK)
+    {
+        // keep the snapshot, it is executed before newer statements with the next save
+        DBG_Printf(DBG_INFO, "DB save of %d statements failed (%d), retry later\n", int(statements.size()), rc);
+        dbSaveRetryStatements = std::move(statements);
+        queSaveDb(DB_QUERY_QUEUE | (syncFs ? DB_SYNC : 0), DB_SHORT_SAVE_DELAY);
+        return;
+    }
+
+    DB_FlushSubDeviceItems(); // the writer thread isn't running, uses an own transaction
+
+    DBG_Printf(DBG_INFO_L2, "DB saved in %ld ms\n", measTimer.elapsed());
+
+#ifdef Q_OS_LINUX
+    if (syncFs)
+    {
+        QElapsedTimer measTimer;
+        measTimer.restart();
+        sync();
+        DBG_Printf(DBG_INFO_L2, "sync() in %d ms\n", int(measTimer.elapsed()));
     }
+#endif
 }
 
 /*! Closes the database.
@@ -5625,6 +5576,12 @@ void DeRestPluginPrivate::closeDb()
             return;
         }
 
+        DB_FlushSubDeviceItems();
+        if (!DB_WriterIsRunning())
+        {
+            DB_FinalizeCachedStatements();
+        }
+
         int ret = sqlite3_close(db);
         if (ret == SQLITE_OK)
         {
@@ -5672,6 +5629,16 @@ void DeRestPluginPrivate::queSaveDb(int items, int msec)
     databaseTimer->start(msec);
 }
 
+/*! Request writing of buffered sub device items (write-behind of DB_StoreSubDeviceItem()).
+ */
+void DeRestPluginPrivate::queFlushDbItems()
+{
+    if (!databaseItemTimer->isActive())
+    {
+        databaseItemTimer->start(DB_ITEM_FLUSH_DELAY);
+    }
+}
+
 static int sqliteLastZbconfCallback(void *user, int ncols, char **colval , char **colname)
 {
     Q_UNUSED(colname);
@@ -5782,6 +5749,9 @@ void DeRestPluginPrivate::deleteDeviceDb(const QString &uniqueId)
         return;
     }
 
+    DB_FlushSubDeviceItems();
+    DB_ClearSubDeviceIdCache();
+
     char *errmsg = nullptr;
     const auto sql = QString("DELETE FROM devices WHERE mac = '%1'").arg(uniqueId);
     int rc = sqlite3_exec(db, sql.toUtf8().constData(), NULL, NULL, &errmsg);
@@ -5981,6 +5951,21 @@ void DeRestPluginPrivate::saveDatabaseTimerFired()
     }
 }
 
+/*! Timer handler for writing buffered sub device items.
+ */
+void DeRestPluginPrivate::flushDatabaseItemsTimerFired()
+{
+    if (DB_WriterIsRunning())
+    {
+        DB_FlushSubDeviceItems();
+        return;
+    }
+
+    openDb();
+    DB_FlushSubDeviceItems();
+    closeDb();
+}
+
 bool DB_StoreSecret(const DB_Secret &secret)
 {
     if (!db || secret.uniqueId.empty())
@@ -6439,166 +6424,349 @@ bool DB_StoreSubDevice(const QString &parentUniqueId, const QString &uniqueId)
     return true;
 }
 
-struct SelectDeviceItemData
+/*! Write-behind buffer for DB_StoreSubDeviceItem().
+
+    Item updates are coalesced per (sub device, item) and written by DB_FlushSubDeviceItems()
+    in one transaction with cached prepared statements, instead of two sqlite3_exec()
+    calls per update on the main thread.
+ */
+struct DB_PendingSubDeviceItem
 {
-    unsigned valueLength;
-    char value[128];
-    uint64_t timestamp;
-    bool isValid;
+    QString uniqueId; // sub device uniqueid
+    const char *suffix = nullptr; // interned ResourceItem suffix
+    QByteArray value;
+    uint64_t timestamp = 0; // seconds since Epoch
+    ApiDataType type = DataTypeUnknown;
 };
 
-/*! Sqlite callback to check if an resource item entry already exists.
-    [0] item suffix
-    [1] value
-    [2] timestamp
+static std::vector<DB_PendingSubDeviceItem> dbPendingItems;
+static QHash<QPair<QString, const char*>, size_t> dbPendingItemIndex; // (uniqueid, suffix) -> index in dbPendingItems
+static QHash<QString, qint64> dbSubDeviceIds; // sub_devices.uniqueid -> sub_devices.id
+static std::vector<std::shared_ptr<const std::vector<DB_PendingSubDeviceItem>>> dbUncommittedItems; // handed to the writer thread, not yet visible to db
+static sqlite3_stmt *dbStmtSelectSubDeviceId = nullptr;
+static sqlite3_stmt *dbStmtSelectItem = nullptr;
+static sqlite3_stmt *dbStmtInsertItem = nullptr;
+
+/*! Returns the cached prepared statement \p stmt, prepares it on first use.
  */
-static int sqliteSelectDeviceItemCallback(void *user, int ncols, char **colval , char **colname)
+static sqlite3_stmt *DB_PrepareCached(sqlite3 *conn, sqlite3_stmt **stmt, const char *sql)
 {
-    assert(user);
-    assert(ncols == 3);
-
-    Q_UNUSED(colname)
+    if (*stmt && sqlite3_db_handle(*stmt) != conn)
+    {
+        sqlite3_finalize(*stmt); // prepared for the other connection
+        *stmt = nullptr;
+    }
 
-    SelectDeviceItemData *result = static_cast<SelectDeviceItemData*>(user);
+    if (*stmt)
+    {
+        sqlite3_reset(*stmt);
+        sqlite3_clear_bindings(*stmt);
+        return *stmt;
+    }
 
-    result->valueLength = U_StringLength(colval[1]);
-    result->isValid = false;
-    if (result->valueLength < sizeof(result->value))
+    int rc = sqlite3_prepare_v2(conn, sql, -1, stmt, nullptr);
+    if (rc != SQLITE_OK)
     {
-        result->timestamp = U_ParseUint64(colval[2], -1, 10);
-        memcpy(&result->value[0], colval[1], result->valueLength);
-        result->value[result->valueLength] = '\0';
-        result->isValid = true;
-        return 0;
+        DBG_Printf(DBG_ERROR, "DB prepare failed: %s, error: %s (%d)\n", sql, sqlite3_errmsg(conn), rc);
+        sqlite3_finalize(*stmt);
+        *stmt = nullptr;
     }
 
-    result->valueLength = 0;
-    result->isValid = false;
-    return 1;
+    return *stmt;
 }
 
-bool DB_StoreSubDeviceItem(const Resource *sub, const ResourceItem *item)
+/*! Finalizes all cached prepared statements, must be called before the connection is closed.
+    The statements belong to the writer thread connection while it is running.
+ */
+static void DB_FinalizeCachedStatements()
 {
-    const ResourceItem *uniqueId = sub->item(RAttrUniqueId);
-    if (!uniqueId)
+    for (sqlite3_stmt **stmt : { &dbStmtSelectSubDeviceId, &dbStmtSelectItem, &dbStmtInsertItem })
     {
-        return false;
+        if (*stmt)
+        {
+            sqlite3_finalize(*stmt);
+            *stmt = nullptr;
+        }
     }
+}
 
-    DeRestPluginPrivate::instance()->openDb();
-    if (!db)
+/*! Returns the sub_devices.id of \p uniqueId or -1 if not found.
+ */
+static qint64 DB_GetSubDeviceId(sqlite3 *conn, const QString &uniqueId)
+{
+    const auto i = dbSubDeviceIds.constFind(uniqueId);
+    if (i != dbSubDeviceIds.cend())
     {
-        return false;
+        return i.value();
     }
 
-    if (!item->lastChanged().isValid())
+    sqlite3_stmt *stmt = DB_PrepareCached(conn, &dbStmtSelectSubDeviceId, "SELECT id FROM sub_devices WHERE uniqueid = ?1");
+    if (!stmt)
     {
-        return false;
+        return -1;
     }
 
-    int ret = 0;
-    uint64_t dt = 0; // delta in seconds from timestamp in database
-    SelectDeviceItemData dbResult;
-    dbResult.isValid = false;
-    const uint64_t timestamp = item->lastChanged().toMSecsSinceEpoch() / 1000;
-    const auto value = dbEscapeString(item->toVariant().toString()).toUtf8();
+    const QByteArray uid = uniqueId.toUtf8();
+    qint64 id = -1;
+
+    if (sqlite3_bind_text(stmt, 1, uid.constData(), uid.size(), SQLITE_STATIC) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        id = sqlite3_column_int64(stmt, 0);
+        dbSubDeviceIds.insert(uniqueId, id);
+    }
+
+    sqlite3_reset(stmt);
+    return id;
+}
+
+/*! Writes a buffered item if needed, must be called within a transaction.
+ */
+static void DB_WriteSubDeviceItem(sqlite3 *conn, const DB_PendingSubDeviceItem &pending)
+{
+    const qint64 subDeviceId = DB_GetSubDeviceId(conn, pending.uniqueId);
+    if (subDeviceId < 0)
+    {
+        DBG_Printf(DBG_INFO_L2, "DB sub device %s not found, skip %s\n", qPrintable(pending.uniqueId), pending.suffix);
+        return;
+    }
 
     // 1) check insert or update needed
 
-    ret = snprintf(sqlBuf, sizeof(sqlBuf),
-                   "SELECT item,value,timestamp FROM resource_items"
-                   " WHERE sub_device_id = (SELECT id FROM sub_devices WHERE uniqueid = '%s')"
-                   " AND item = '%s'",
-                   uniqueId->toCString(),
-                   item->descriptor().suffix);
+    sqlite3_stmt *stmt = DB_PrepareCached(conn, &dbStmtSelectItem, "SELECT value,timestamp FROM resource_items"
+                                                             " WHERE sub_device_id = ?1 AND item = ?2");
+    if (!stmt)
+    {
+        return;
+    }
 
-    assert(size_t(ret) < sizeof(sqlBuf));
-    if (size_t(ret) < sizeof(sqlBuf))
+    sqlite3_bind_int64(stmt, 1, subDeviceId);
+    sqlite3_bind_text(stmt, 2, pending.suffix, -1, SQLITE_STATIC);
+
+    if (sqlite3_step(stmt) == SQLITE_ROW)
     {
-        char *errmsg = nullptr;
-        int rc = sqlite3_exec(db, sqlBuf, sqliteSelectDeviceItemCallback, &dbResult, &errmsg);
+        const auto *dbValue = sqlite3_column_text(stmt, 0);
+        const int dbValueLength = sqlite3_column_bytes(stmt, 0);
+        const uint64_t dbTimestamp = uint64_t(sqlite3_column_int64(stmt, 1));
+        uint64_t dt = 0; // delta in seconds from timestamp in database
 
-        if (rc != SQLITE_OK)
+        const bool isEqual = dbValue && dbValueLength == pending.value.size() &&
+                             memcmp(pending.value.constData(), dbValue, size_t(dbValueLength)) == 0;
+
+        if (dbTimestamp < pending.timestamp)
         {
-            if (errmsg)
-            {
-                DBG_Printf(DBG_ERROR_L2, "SQL exec failed: %s, error: %s (%d)\n", sqlBuf, errmsg, rc);
-                sqlite3_free(errmsg);
-            }
+            dt = pending.timestamp - dbTimestamp;
+        }
+
+        sqlite3_reset(stmt);
+
+        if (isEqual && pending.type == DataTypeString)
+        {
+            return; // don't check timestamp for strings
+        }
+
+        // only update 'value' and 'timestamp' every 10 minutes
+        // TODO(mpi): extend the item descriptor to specify storage intervals
+        // we don't need to write the DB for rapid changing values
+        if (pending.suffix[0] == 's' && dt < 600) // state/*
+        {
+            return;
         }
+    }
+    else
+    {
+        sqlite3_reset(stmt);
+    }
+
+    // 2) update or insert
+
+    stmt = DB_PrepareCached(conn, &dbStmtInsertItem, "INSERT INTO resource_items (sub_device_id,item,value,source,timestamp)"
+                                                     " VALUES (?1, ?2, ?3, 'dev', ?4)");
+    if (!stmt)
+    {
+        return;
+    }
+
+    sqlite3_bind_int64(stmt, 1, subDeviceId);
+    sqlite3_bind_text(stmt, 2, pending.suffix, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, pending.value.constData(), pending.value.size(), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, qint64(pending.timestamp));
+
+    DBG_Printf(DBG_INFO_L2, "DB store %s/%s = %s\n", qPrintable(pending.uniqueId), pending.suffix, pending.value.constData());
+
+    const int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        DBG_Printf(DBG_ERROR_L2, "DB store %s/%s failed, error: %s (%d)\n", qPrintable(pending.uniqueId), pending.suffix, sqlite3_errmsg(conn), rc);
+    }
+
+    sqlite3_reset(stmt);
+}
 
-        if (dbResult.isValid)
+/*! Writes all buffered sub device items.
+    The items are handed over to the writer thread if it is running, otherwise they are written
+    via the main connection which must be open. This joins the current transaction if one is open.
+ */
+void DB_FlushSubDeviceItems()
+{
+    if (dbPendingItems.empty())
+    {
+        return;
+    }
+
+    std::vector<DB_PendingSubDeviceItem> items;
+    items.swap(dbPendingItems);
+    dbPendingItemIndex.clear();
+
+    if (DB_WriterIsRunning())
+    {
+        auto batch = std::make_shared<const std::vector<DB_PendingSubDeviceItem>>(std::move(items));
+        auto attempts = std::make_shared<int>(0);
+        dbUncommittedItems.push_back(batch);
+
+        DB_WriterPost([batch, attempts](sqlite3 *conn)
         {
-            bool isEqual = false;
-            if (dbResult.valueLength == (unsigned)value.size())
+            if ((*attempts)++ > 0)
             {
-                if (memcmp(value.constData(), &dbResult.value[0], dbResult.valueLength) == 0)
-                {
-                    isEqual = true;
-                }
+                dbSubDeviceIds.clear(); // ids cached in the rolled back transaction might be gone
             }
 
-            if (dbResult.timestamp < timestamp)
+            for (const DB_PendingSubDeviceItem &pending : *batch)
             {
-                dt = timestamp - dbResult.timestamp;
+                DB_WriteSubDeviceItem(conn, pending);
             }
+        }, nullptr, [batch]()
+        {
+            dbUncommittedItems.erase(std::remove(dbUncommittedItems.begin(), dbUncommittedItems.end(), batch), dbUncommittedItems.end());
+        });
+        return;
+    }
 
-            if (isEqual)
-            {
-                if (item->descriptor().type == DataTypeString)
-                {
-                    return true; // don't check timestamp for strings
-                }
+    if (!db)
+    {
+        return;
+    }
 
-                if (item->descriptor().suffix[0] == 's' && dt < 600) // state/*
-                {
-                    return true; // only update timestamp every 10 minutes
-                }
+    QElapsedTimer measTimer;
+    measTimer.start();
+
+    const bool ownTransaction = sqlite3_get_autocommit(db) != 0;
+
+    if (ownTransaction)
+    {
+        char *errmsg = nullptr;
+        int rc = sqlite3_exec(db, "BEGIN", nullptr, nullptr, &errmsg);
+        if (rc != SQLITE_OK)
+        {
+            if (errmsg)
+            {
+                DBG_Printf(DBG_ERROR, "DB SQL exec failed: BEGIN, error: %s (%d)\n", errmsg, rc);
+                sqlite3_free(errmsg);
             }
-            else
+            items.swap(dbPendingItems); // retry with next flush, newer items haven't been queued in between
+            for (size_t i = 0; i < dbPendingItems.size(); i++)
             {
-                // only update 'value' and 'timestamp' every 10 minutes if changed
-                // TODO(mpi): extend the item descriptor to specify storage intervals
-                // we don't need to write the DB for rapid changing values
-                if (item->descriptor().suffix[0] == 's' && dt < 600) // state/*
-                {
-                    return true;
-                }
+                dbPendingItemIndex.insert(qMakePair(dbPendingItems[i].uniqueId, dbPendingItems[i].suffix), i);
             }
+            return;
         }
     }
 
-    // 2) update or insert
-
-    ret = snprintf(sqlBuf, sizeof(sqlBuf),
-                       "INSERT INTO resource_items (sub_device_id,item,value,source,timestamp)"
-                       " SELECT id, '%s', '%s', 'dev', %" PRIu64
-                       " FROM sub_devices WHERE uniqueid = '%s'",
-                       item->descriptor().suffix,
-                       value.constData(),
-                       timestamp, uniqueId->toCString());
-
-
-    DBG_Assert(size_t(ret) < sizeof(sqlBuf));
-    if (size_t(ret) < sizeof(sqlBuf))
+    for (const DB_PendingSubDeviceItem &pending : items)
     {
-        DBG_Printf(DBG_INFO_L2, "%s\n", &sqlBuf[0]);
+        DB_WriteSubDeviceItem(db, pending);
+    }
 
+    if (ownTransaction)
+    {
         char *errmsg = nullptr;
-
-        int rc = sqlite3_exec(db, sqlBuf, nullptr, nullptr, &errmsg);
-
+        int rc = sqlite3_exec(db, "COMMIT", nullptr, nullptr, &errmsg);
         if (rc != SQLITE_OK)
         {
             if (errmsg)
             {
-                DBG_Printf(DBG_ERROR_L2, "SQL exec failed: %s, error: %s (%d)\n", sqlBuf, errmsg, rc);
+                DBG_Printf(DBG_ERROR, "DB SQL exec failed: COMMIT, error: %s (%d)\n", errmsg, rc);
                 sqlite3_free(errmsg);
             }
+            // if the transaction is still intact (SQLITE_BUSY) it will be committed on the next run of saveDb()
         }
     }
 
-    DeRestPluginPrivate::instance()->closeDb();
+    DBG_Printf(DBG_INFO_L2, "DB flushed %d sub device items in %d ms\n", int(items.size()), int(measTimer.elapsed()));
+}
+
+/*! Writes all pending items and stops the writer thread,
+    used before the database file is exported or replaced and on shutdown.
+ */
+void DB_CloseWriter()
+{
+    if (!DB_WriterIsRunning())
+    {
+        return;
+    }
+
+    DB_FlushSubDeviceItems();
+    DB_WriterPost([](sqlite3 *)
+    {
+        DB_FinalizeCachedStatements();
+        dbSubDeviceIds.clear();
+    });
+    DB_StopWriter();
+}
+
+/*! Forgets cached sub_devices.id values, must be called when devices are deleted.
+ */
+static void DB_ClearSubDeviceIdCache()
+{
+    if (DB_WriterIsRunning())
+    {
+        DB_WriterPost([](sqlite3 *) { dbSubDeviceIds.clear(); }); // keep order with queued writes
+    }
+    else
+    {
+        dbSubDeviceIds.clear();
+    }
+}
+
+/*! Queues \p item of \p sub to be written to the database.
+    Multiple updates of the same item are coalesced until the next flush.
+ */
+bool DB_StoreSubDeviceItem(const Resource *sub, const ResourceItem *item)
+{
+    const ResourceItem *uniqueId = sub->item(RAttrUniqueId);
+    if (!uniqueId)
+    {
+        return false;
+    }
+
+    if (!item->lastChanged().isValid())
+    {
+        return false;
+    }
+
+    const auto key = qMakePair(uniqueId->toString(), item->descriptor().suffix);
+    const auto i = dbPendingItemIndex.constFind(key);
+
+    DB_PendingSubDeviceItem *pending = nullptr;
+
+    if (i != dbPendingItemIndex.cend())
+    {
+        pending = &dbPendingItems[i.value()];
+    }
+    else
+    {
+        dbPendingItemIndex.insert(key, dbPendingItems.size());
+        dbPendingItems.emplace_back();
+        pending = &dbPendingItems.back();
+        pending->uniqueId = key.first;
+        pending->suffix = key.second;
+    }
+
+    pending->value = item->toVariant().toString().toUtf8();
+    pending->timestamp = uint64_t(item->lastChanged().toMSecsSinceEpoch() / 1000);
+    pending->type = item->descriptor().type;
+
+    DeRestPluginPrivate::instance()->queFlushDbItems();
     return true;
 }
 
@@ -6621,6 +6789,35 @@ static int DB_LoadSubDeviceItemsCallback(void *user, int ncols, char **colval ,
     return 0;
 };
 
+/*! Applies items of sub devices accepted by \p match which the writer thread hasn't committed yet.
+    The main connection doesn't see them before, loading doesn't need to wait for the writer.
+ */
+template <typename Match>
+static void DB_MergeUncommittedItems(std::vector<DB_ResourceItem> &result, Match match)
+{
+    for (const auto &batch : dbUncommittedItems) // oldest first
+    {
+        for (const DB_PendingSubDeviceItem &pending : *batch)
+        {
+            if (!match(pending.uniqueId))
+            {
+                continue;
+            }
+
+            auto i = std::find_if(result.begin(), result.end(), [&pending](const DB_ResourceItem &ritem) { return ritem.name == pending.suffix; });
+            if (i == result.end())
+            {
+                result.emplace_back();
+                i = result.end() - 1;
+                i->name = pending.suffix;
+            }
+
+            i->value = QString::fromUtf8(pending.value);
+            i->timestampMs = qint64(pending.timestamp) * 1000;
+        }
+    }
+}
+
 std::vector<DB_ResourceItem> DB_LoadSubDeviceItemsOfDevice(QLatin1String deviceUniqueId)
 {
     DBG_Assert(deviceUniqueId.size() == 23); // 64 bit uniqueId with : after each byte
@@ -6639,6 +6836,8 @@ std::vector<DB_ResourceItem> DB_LoadSubDeviceItemsOfDevice(QLatin1String deviceU
         return result;
     }
 
+    DB_FlushSubDeviceItems();
+
     int ret = snprintf(sqlBuf, sizeof(sqlBuf), "SELECT item,value,timestamp FROM resource_items"
                                  " WHERE sub_device_id = (SELECT id FROM sub_devices WHERE uniqueid LIKE '%%%s%%')",
                                  deviceUniqueId.data());
@@ -6655,6 +6854,8 @@ std::vector<DB_ResourceItem> DB_LoadSubDeviceItemsOfDevice(QLatin1String deviceU
         }
     }
 
+    DB_MergeUncommittedItems(result, [deviceUniqueId](const QString &sub) { return sub.startsWith(deviceUniqueId); });
+
     DeRestPluginPrivate::instance()->closeDb();
 
     return result;
@@ -6662,46 +6863,36 @@ std::vector<DB_ResourceItem> DB_LoadSubDeviceItemsOfDevice(QLatin1String deviceU
 
 int DB_GetSubDeviceItemCount(QLatin1String uniqueId)
 {
-    int result = 0;
+    std::vector<DB_ResourceItem> items;
 
     assert(db); // should be called while db is open
     if (!db)
     {
-        return result;
+        return 0;
     }
 
-    int rc = snprintf(sqlBuf, sizeof(sqlBuf), "SELECT COUNT(item) FROM resource_items"
+    DB_FlushSubDeviceItems();
+
+    int ret = snprintf(sqlBuf, sizeof(sqlBuf), "SELECT item,value,timestamp FROM resource_items"
                                          " WHERE sub_device_id = (SELECT id FROM sub_devices WHERE uniqueid = '%s')",
                                          uniqueId.data());
 
-    assert(size_t(rc) < sizeof(sqlBuf));
-    if (size_t(rc) < sizeof(sqlBuf))
+    assert(size_t(ret) < sizeof(sqlBuf));
+    if (size_t(ret) < sizeof(sqlBuf))
     {
-        sqlite3_stmt *res = nullptr;
-
-        int rc = sqlite3_prepare_v2(db, sqlBuf, -1, &res, nullptr);
-        DBG_Assert(res);
-        DBG_Assert(rc == SQLITE_OK);
+        char *errmsg = nullptr;
+        int rc = sqlite3_exec(db, sqlBuf, DB_LoadSubDeviceItemsCallback, &items, &errmsg);
 
-        if (rc == SQLITE_OK)
-        {
-            rc = sqlite3_step(res);
-            DBG_Assert(rc == SQLITE_ROW);
-            if (rc == SQLITE_ROW)
-            {
-                result = sqlite3_column_int(res, 0);
-            }
-        }
-        else
+        if (errmsg)
         {
-            DBG_Printf(DBG_ERROR, "error preparing sql (err: %d): %s\n", rc, sqlBuf);
+            DBG_Printf(DBG_ERROR, "SQL exec failed: %s, error: %s (%d)\n", sqlBuf, errmsg, rc);
+            sqlite3_free(errmsg);
         }
-
-        rc = sqlite3_finalize(res);
-        DBG_Assert(rc == SQLITE_OK);
     }
 
-    return result;
+    DB_MergeUncommittedItems(items, [uniqueId](const QString &sub) { return sub == uniqueId; });
+
+    return int(items.size());
 }
 
 std::vector<DB_ResourceItem> DB_LoadSubDeviceItems(QLatin1String uniqueId)
@@ -6721,6 +6912,8 @@ std::vector<DB_ResourceItem> DB_LoadSubDeviceItems(QLatin1String uniqueId)
         return result;
     }
 
+    DB_FlushSubDeviceItems();
+
     int ret = snprintf(sqlBuf, sizeof(sqlBuf), "SELECT item,value,timestamp FROM resource_items"
                                          " WHERE sub_device_id = (SELECT id FROM sub_devices WHERE uniqueid = '%s')",
                                          uniqueId.data());
@@ -6738,6 +6931,8 @@ std::vector<DB_ResourceItem> DB_LoadSubDeviceItems(QLatin1String uniqueId)
         }
     }
 
+    DB_MergeUncommittedItems(result, [uniqueId](const QString &sub) { return sub == uniqueId; });
+
     DeRestPluginPrivate::instance()->closeDb();
 
     return result;
@@ -86,6 +86,8 @@ int DB_GetSubDeviceItemCount(QLatin1String uniqueId);
 bool DB_StoreSubDevice(const QString &parentUniqueId, const QString &uniqueId);
 bool DB_StoreSubDeviceItem(const Resource *sub, const ResourceItem *item);
 bool DB_StoreSubDeviceItems(const Resource *sub);
+void DB_FlushSubDeviceItems();
+void DB_CloseWriter();
 std::vector<DB_ResourceItem> DB_LoadSubDeviceItemsOfDevice(QLatin1String deviceUniqueId);
 std::vector<DB_ResourceItem> DB_LoadSubDeviceItems(QLatin1String uniqueId);
 bool DB_LoadLegacySensorValue(DB_LegacyItem *litem);
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <sqlite3.h>
+#include "deconz/dbg_trace.h"
+#include "database_writer.h"
+
+#define DB_WRITER_BUSY_TIMEOUT 5000 // ms to wait for locks held by other connections
+#define DB_WRITER_MAX_RETRIES  12 // busy timeouts until queued commands are forced through on stop
+#define DB_WRITER_RETRY_DELAY  1000 // ms to wait before a rolled back batch is repeated
+
+struct DB_WriterCommand
+{
+    std::atomic<DB_WriterCommand*> next{nullptr};
+    DB_WriterWork work;
+    DB_WriterCompletion done; // opaque to the writer thread, invoked on the main thread
+};
+
+/*! Payload of a command taken from the queue, kept until its transaction is committed.
+ */
+struct DB_WriterBatchItem
+{
+    DB_WriterWork work;
+    DB_WriterCompletion done;
+};
+
+/*! Writer thread with intrusive MPSC queue (Vyukov).
+    Producers only do one atomic exchange, the writer thread is the single consumer.
+ */
+class DB_Writer
+{
+public:
+    DB_Writer() : m_head(&m_stub), m_tail(&m_stub) { }
+    ~DB_Writer() { stop(); }
+
+    bool start(const QString &dbPath);
+    void stop();
+    bool isRunning() const { return m_thread.joinable(); }
+    void push(DB_WriterCommand *cmd);
+
+private:
+    DB_WriterCommand *pop();
+    bool empty() const { return m_tail->next.load() == nullptr; } // seq_cst, pairs with push()
+    void run();
+    bool execBatch(bool force);
+    void finishBatch();
+    int exec(const char *sql);
+
+    DB_WriterCommand m_stub;
+    std::atomic<DB_WriterCommand*> m_head; // producers
+    DB_WriterCommand *m_tail; // consumer
+    std::vector<DB_WriterBatchItem> m_batch; // commands of the current transaction, repeated if it is rolled back
+
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_sleeping{false};
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+    sqlite3 *m_db = nullptr;
+    QObject *m_receiver = nullptr; // main thread object to post completions to
+};
+
+static DB_Writer dbWriter;
+
+bool DB_Writer::start(const QString &dbPath)
+{
+    if (isRunning())
+    {
+        return true;
+    }
+
+    int rc = sqlite3_open(qPrintable(dbPath), &m_db);
+    if (rc != SQLITE_OK)
+    {
+        DBG_Printf(DBG_ERROR, "DB writer can't open database: %s\n", sqlite3_errmsg(m_db));
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        return false;
+    }
+
+    rc = sqlite3_exec(m_db, "PRAGMA foreign_keys = ON", nullptr, nullptr, nullptr); // must be enabled at runtime for each connection
+    DBG_Assert(rc == SQLITE_OK);
+    sqlite3_busy_timeout(m_db, DB_WRITER_BUSY_TIMEOUT);
+
+    // readers on the main connection don't block the writer and vice versa
+    rc = sqlite3_exec(m_db, "PRAGMA journal_mode=WAL", nullptr, nullptr, nullptr);
+    DBG_Assert(rc == SQLITE_OK);
+
+    m_receiver = QCoreApplication::instance();
+    m_stop = false;
+    m_thread = std::thread(&DB_Writer::run, this);
+    return true;
+}
+
+/*! Executes all queued commands and stops the thread.
+ */
+void DB_Writer::stop()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    sqlite3_close(m_db);
+    m_db = nullptr;
+}
+
+void DB_Writer::push(DB_WriterCommand *cmd)
+{
+    DB_WriterCommand *prev = m_head.exchange(cmd, std::memory_order_acq_rel);
+
+    // Both the link store and the m_sleeping load are seq_cst, as are m_sleeping = true
+    // and the empty() re-check of the writer. Either the writer sees the new command
+    // or this sees it sleeping, a command can't wait for the next push().
+    prev->next.store(cmd);
+
+    if (m_sleeping.load())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex); // the writer is in wait() or hasn't checked yet
+        m_cond.notify_one();
+    }
+}
+
+/*! Returns the next command or nullptr if the queue is empty.
+    The returned node stays in the queue as stub until the next pop(), only its payload may be taken.
+ */
+DB_WriterCommand *DB_Writer::pop()
+{
+    DB_WriterCommand *next = m_tail->next.load(std::memory_order_acquire);
+    if (!next)
+    {
+        return nullptr;
+    }
+
+    if (m_tail != &m_stub)
+    {
+        delete m_tail; // no producer references it since its next pointer is set
+    }
+
+    m_tail = next;
+    return next;
+}
+
+void DB_Writer::run()
+{
+    int retries = 0;
+
+    for (;;)
+    {
+        if (execBatch(retries >= DB_WRITER_MAX_RETRIES))
+        {
+            retries = 0;
+        }
+        else
+        {
+            // database locked by another connection or transaction rolled back, the commands
+            // stay queued and are retried, sqlite3_busy_timeout() paces the attempts on locks
+            if (m_stop)
+            {
+                retries++;
+            }
+            else if (!m_batch.empty())
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait_for(lock, std::chrono::milliseconds(DB_WRITER_RETRY_DELAY), [this]{ return m_stop.load(); });
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping = true;
+        m_cond.wait(lock, [this]{ return m_stop.load() || !empty(); });
+        m_sleeping = false;
+
+        if (m_stop && empty() && m_batch.empty())
+        {
+            break;
+        }
+    }
+
+    if (m_tail != &m_stub)
+    {
+        delete m_tail;
+        m_tail = &m_stub;
+        m_stub.next = nullptr;
+        m_head = &m_stub;
+    }
+}
+
+/*! Executes \p sql on the writer connection and logs errors other than SQLITE_BUSY.
+ */
+int DB_Writer::exec(const char *sql)
+{
+    char *errmsg = nullptr;
+    const int rc = sqlite3_exec(m_db, sql, nullptr, nullptr, &errmsg);
+
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY && errmsg)
+    {
+        DBG_Printf(DBG_ERROR, "DB writer SQL exec failed: %s, error: %s (%d)\n", sql, errmsg, rc);
+    }
+
+    if (errmsg)
+    {
+        sqlite3_free(errmsg);
+    }
+
+    return rc;
+}
+
+/*! Executes all queued commands in one transaction.
+
+    The write lock is taken upfront by BEGIN IMMEDIATE. A deferred BEGIN would
+    fail on the lock upgrade while another connection writes, with already
+    executed commands and no way to repeat them.
+
+    If the transaction can't be committed or a command rolls it back, the commands
+    are kept and executed again with the next attempt, together with newer ones.
+
+    \param force - execute the commands without transaction if the database stays locked,
+                   a failing transaction is dropped then
+    \returns false if the database is locked or the transaction was rolled back.
+ */
+bool DB_Writer::execBatch(bool force)
+{
+    if (empty() && m_batch.empty())
+    {
+        return true;
+    }
+
+    QElapsedTimer measTimer;
+    measTimer.start();
+
+    int rc = exec("BEGIN IMMEDIATE");
+    if (rc == SQLITE_BUSY && !force)
+    {
+        DBG_Printf(DBG_INFO, "DB writer database locked, retry\n");
+        return false;
+    }
+
+    const bool transaction = rc == SQLITE_OK;
+
+    while (DB_WriterCommand *cmd = pop())
+    {
+        m_batch.push_back({std::move(cmd->work), std::move(cmd->done)});
+    }
+
+    for (DB_WriterBatchItem &item : m_batch)
+    {
+        if (item.work)
+        {
+            item.work(m_db);
+        }
+    }
+
+    if (transaction)
+    {
+        if (sqlite3_get_autocommit(m_db) == 0)
+        {
+            // with the write lock held COMMIT only waits for readers of a checkpoint,
+            // the transaction stays active on SQLITE_BUSY and COMMIT can be repeated
+            for (int i = 0; i < DB_WRITER_MAX_RETRIES; i++)
+            {
+                rc = exec("COMMIT");
+                if (rc != SQLITE_BUSY)
+                {
+                    break;
+                }
+            }
+
+            if (rc != SQLITE_OK)
+            {
+                exec("ROLLBACK");
+            }
+        }
+        else
+        {
+            rc = SQLITE_ABORT; // rolled back by a command or by SQLite on I/O errors
+        }
+    }
+
+    if (rc != SQLITE_OK && transaction)
+    {
+        if (!force)
+        {
+            DBG_Printf(DBG_INFO, "DB writer transaction of %d commands rolled back (%d), retry\n", int(m_batch.size()), rc);
+            return false;
+        }
+
+        DBG_Printf(DBG_ERROR, "DB writer failed to commit %d commands (%d), dropped\n", int(m_batch.size()), rc);
+    }
+
+    const int count = int(m_batch.size());
+    finishBatch();
+
+    DBG_Printf(DBG_INFO_L2, "DB writer executed %d commands in %d ms\n", count, int(measTimer.elapsed()));
+    return true;
+}
+
+/*! Posts the completions of the committed batch to the main thread and clears it.
+ */
+void DB_Writer::finishBatch()
+{
+    for (DB_WriterBatchItem &item : m_batch)
+    {
+        if (item.done && m_receiver)
+        {
+            QMetaObject::invokeMethod(m_receiver, std::move(item.done), Qt::QueuedConnection);
+        }
+    }
+
+    m_batch.clear();
+}
+
+/*! Starts the writer thread with an own connection to \p dbPath.
+ */
+bool DB_StartWriter(const QString &dbPath)
+{
+    return dbWriter.start(dbPath);
+}
+
+/*! Executes all pending commands and stops the writer thread.
+ */
+void DB_StopWriter()
+{
+    dbWriter.stop();
+}
+
+bool DB_WriterIsRunning()
+{
+    return dbWriter.isRunning();
+}
+
+/*! Queues a plain SQL statement.
+ */
+void DB_WriterExec(const QString &sql)
+{
+    const QByteArray utf8 = sql.toUtf8();
+
+    DB_WriterPost([utf8](sqlite3 *db)
+    {
+        char *errmsg = nullptr;
+        int rc = sqlite3_exec(db, utf8.constData(), nullptr, nullptr, &errmsg);
+
+        if (rc != SQLITE_OK)
+        {
+            if (errmsg)
+            {
+                DBG_Printf(DBG_ERROR, "DB writer sqlite3_exec failed: %s, error: %s\n", utf8.constData(), errmsg);
+                sqlite3_free(errmsg);
+            }
+        }
+    });
+}
+
+/*! Queues \p work to be executed on the writer thread.
+    If \p done is set it will be called on the main thread after the transaction
+    is committed, or dropped when the writer is stopped while the database stays locked.
+    It isn't called when \p context is destroyed in the meantime.
+ */
+void DB_WriterPost(DB_WriterWork work, QObject *context, DB_WriterCompletion done)
+{
+    DBG_Assert(dbWriter.isRunning());
+
+    auto *cmd = new DB_WriterCommand;
+    cmd->work = std::move(work);
+
+    if (done)
+    {
+        // the QPointer is only created and dereferenced on the main thread
+        cmd->done = [guard = QPointer<QObject>(context), hasContext = context != nullptr, done = std::move(done)]()
+        {
+            if (!hasContext || guard)
+            {
+                done();
+            }
+        };
+    }
+
+    dbWriter.push(cmd);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef DATABASE_WRITER_H
+#define DATABASE_WRITER_H
+
+#include <functional>
+
+class QObject;
+class QString;
+struct sqlite3;
+
+/*! Database writer thread.
+
+    The writer thread owns a dedicated sqlite3 connection to the same database
+    as the main thread. Write commands are queued from the main thread via a
+    lock-free MPSC queue and executed in order; all commands queued until the
+    writer wakes up are batched into one transaction.
+
+    If a transaction can't be committed it is rolled back and all of its commands
+    are executed again, nothing is dropped unless the writer is stopped while the
+    database stays locked.
+
+    The main thread keeps its own connection for loading data. Both connections
+    use WAL journal mode so reads don't block the writer. Data which is still
+    queued isn't visible to the main connection, completion handlers tell when
+    it is committed.
+ */
+
+/*! Work function executed on the writer thread with the writer connection.
+    It might be executed more than once if the transaction is rolled back and can roll back
+    the transaction itself via "ROLLBACK" to have the whole batch repeated. */
+using DB_WriterWork = std::function<void(sqlite3 *db)>;
+/*! Completion handler executed on the main thread. */
+using DB_WriterCompletion = std::function<void()>;
+
+bool DB_StartWriter(const QString &dbPath);
+void DB_StopWriter();
+bool DB_WriterIsRunning();
+void DB_WriterExec(const QString &sql);
+void DB_WriterPost(DB_WriterWork work, QObject *context = nullptr, DB_WriterCompletion done = {});
+
+#endif // DATABASE_WRITER_H
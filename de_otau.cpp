@@ -96,7 +96,7 @@ void DeRestPluginPrivate::otauDataIndication(const deCONZ::ApsDataIndication &in
 
                 lightNode->setSwBuildId(version);
                 lightNode->setNeedSaveDatabase(true);
-                updateEtag(lightNode->etag);
+                updateLightEtag(lightNode);
 
                 // read real sw build id
                 lightNode->setLastRead(READ_SWBUILD_ID, idleTotalCounter);
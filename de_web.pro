@@ -118,12 +118,14 @@ HEADERS  = bindings.h \
            aps_controller_wrapper.h \
            backup.h \
            button_maps.h \
+           cbor_writer.h \
            colorspace.h \
            crypto/mmohash.h \
            crypto/password.h \
            crypto/random.h \
            crypto/scrypt.h \
            database.h \
+           database_writer.h \
            daylight.h \
            de_web_plugin.h \
            de_web_plugin_private.h \
@@ -140,31 +142,39 @@ HEADERS  = bindings.h \
            event.h \
            event_emitter.h \
            fan_control.h \
+           full_state_cache.h \
            gateway.h \
            gateway_scanner.h \
            green_power.h \
            group.h \
            group_info.h \
+           http_connections.h \
            json.h \
+           json_reader.h \
+           json_writer.h \
            ias_ace.h \
            ias_zone.h \
+           latency_histogram.h \
            light_node.h \
            poll_control.h \
            poll_manager.h \
            product_match.h \
            read_files.h \
            resource.h \
+           resource_index.h \
            resourcelinks.h \
            rest_alarmsystems.h \
            rest_devices.h \
            rest_node_base.h \
            rule.h \
+           rule_engine.h \
            scene.h \
            sensor.h \
            state_change.h \
            simple_metering.h \
            thermostat.h \
            thermostat_ui_configuration.h \
+           timeseries.h \
            tuya.h \
            ui/ddf_bindingeditor.h \
            ui/ddf_editor.h \
@@ -176,6 +186,8 @@ HEADERS  = bindings.h \
            utils/bufstring.h \
            utils/stringcache.h \
            utils/utils.h \
+           websocket_filter.h \
+           websocket_queue.h \
            websocket_server.h \
            xiaomi.h \
            zcl/zcl.h \
@@ -191,6 +203,7 @@ SOURCES  = air_quality.cpp \
            backup.cpp \
            bindings.cpp \
            button_maps.cpp \
+           cbor_writer.cpp \
            change_channel.cpp \
            colorspace.cpp \
            crypto/mmohash.cpp \
@@ -198,6 +211,7 @@ SOURCES  = air_quality.cpp \
            crypto/random.cpp \
            crypto/scrypt.cpp \
            database.cpp \
+           database_writer.cpp \
            daylight.cpp \
            device.cpp \
            device_access_fn.cpp \
@@ -221,6 +235,7 @@ SOURCES  = air_quality.cpp \
            event_queue.cpp \
            fan_control.cpp \
            firmware_update.cpp \
+           full_state_cache.cpp \
            gateway.cpp \
            gateway_scanner.cpp \
            green_power.cpp \
@@ -228,10 +243,14 @@ SOURCES  = air_quality.cpp \
            group_info.cpp \
            gw_uuid.cpp \
            hue.cpp \
+           http_connections.cpp \
            ias_ace.cpp \
            ias_zone.cpp \
            identify.cpp \
            json.cpp \
+           json_reader.cpp \
+           json_writer.cpp \
+           latency_histogram.cpp \
            light_node.cpp \
            occupancy_sensing.cpp \
            poll_control.cpp \
@@ -257,6 +276,7 @@ SOURCES  = air_quality.cpp \
            rest_info.cpp \
            rest_capabilities.cpp \
            rule.cpp \
+           rule_engine.cpp \
            state_change.cpp \
            thermostat_ui_configuration.cpp \
            ui/ddf_bindingeditor.cpp \
@@ -273,6 +293,7 @@ SOURCES  = air_quality.cpp \
            simple_metering.cpp \
            thermostat.cpp \
            time.cpp \
+           timeseries.cpp \
            tuya.cpp \
            basic.cpp \
            appliances.cpp \
@@ -283,6 +304,8 @@ SOURCES  = air_quality.cpp \
            utils/utils.cpp \
            xiaomi.cpp \
            window_covering.cpp \
+           websocket_filter.cpp \
+           websocket_queue.cpp \
            websocket_server.cpp \
            xmas.cpp \
            zcl/zcl.cpp \
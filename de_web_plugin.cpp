@@ -34,6 +34,7 @@
 #include <cmath>
 #include "alarm_system_device_table.h"
 #include "database.h"
+#include "database_writer.h"
 #include "device_ddf_init.h"
 #include "device_descriptions.h"
 #include "device_tick.h"
@@ -45,12 +46,14 @@
 #include "gateway_scanner.h"
 #include "ias_ace.h"
 #include "json.h"
+#include "json_writer.h"
 #include "poll_control.h"
 #include "poll_manager.h"
 #include "product_match.h"
 #include "rest_devices.h"
 #include "rest_alarmsystems.h"
 #include "read_files.h"
+#include "rule_engine.h"
 #include "utils/utils.h"
 #include "xiaomi.h"
 #include "zcl/zcl.h"
@@ -576,6 +579,47 @@ QString ApiRequest::apikey() const
     return QLatin1String("");
 }
 
+/*! Returns the version of a delta request ?since=<version>, 0 if not given.
+    The version is the ETag of a previous collection response without quotes.
+ */
+quint64 ApiRequest::sinceVersion() const
+{
+    const QString url = hdr.url();
+    const int pos = url.indexOf(QLatin1String("since="));
+
+    if (pos <= 0 || (url.at(pos - 1) != QLatin1Char('?') && url.at(pos - 1) != QLatin1Char('&')))
+    {
+        return 0;
+    }
+
+    int end = url.indexOf(QLatin1Char('&'), pos);
+    if (end < 0)
+    {
+        end = url.size();
+    }
+
+    return url.midRef(pos + 6, end - pos - 6).toULongLong();
+}
+
+/*! Parses the JSON content, for HTTP requests directly from the raw UTF-8 body.
+    Rule actions provide their content already parsed.
+ */
+QVariant ApiRequest::parseContent(bool &ok) const
+{
+    if (contentParsed)
+    {
+        ok = true;
+        return *contentParsed;
+    }
+
+    if (!contentUtf8.isEmpty())
+    {
+        return Json::parseUtf8(contentUtf8, ok);
+    }
+
+    return Json::parse(content, ok);
+}
+
 /*! Returns the next ZCL sequence number to use.
  */
 quint8 zclNextSequenceNumber()
@@ -626,7 +670,14 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     databaseTimer = new QTimer(this);
     databaseTimer->setSingleShot(true);
 
+    databaseItemTimer = new QTimer(this);
+    databaseItemTimer->setSingleShot(true);
+    connect(databaseItemTimer, &QTimer::timeout, this, &DeRestPluginPrivate::flushDatabaseItemsTimerFired);
+
     eventEmitter = new EventEmitter(this);
+    eventEmitter->setBudget(EventClassUrgent, deCONZ::appArgumentNumeric("--event-budget-urgent", eventEmitter->budget(EventClassUrgent)));
+    eventEmitter->setBudget(EventClassDevice, deCONZ::appArgumentNumeric("--event-budget-device", eventEmitter->budget(EventClassDevice)));
+    eventEmitter->setBudget(EventClassResource, deCONZ::appArgumentNumeric("--event-budget-resource", eventEmitter->budget(EventClassResource)));
     connect(eventEmitter, &EventEmitter::eventNotify, this, &DeRestPluginPrivate::handleEvent);
     initResourceDescriptors();
 
@@ -715,6 +766,9 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
     // starttime reference counts from here
     starttimeRef.start();
 
+    // etag versions continue above the ones of previous runs (1000 per millisecond)
+    gwEtagVersion = quint64(QDateTime::currentMSecsSinceEpoch()) * 1000;
+
     initConfig();
 
     updateEtag(gwConfigEtag);
@@ -751,6 +805,11 @@ DeRestPluginPrivate::DeRestPluginPrivate(QObject *parent) :
 
     closeDb();
 
+    if (!DB_StartWriter(sqliteDatabaseName))
+    {
+        DBG_Printf(DBG_ERROR, "DB writer thread not started, write on main thread\n");
+    }
+
     initTimezone();
 
     checkConsistency();
@@ -1058,8 +1117,12 @@ void DeRestPluginPrivate::apsdeDataIndicationDevice(const deCONZ::ApsDataIndicat
     auto resources = device->subDevices();
     resources.push_back(device); // self reference
 
-    for (auto &r : resources)
+    const auto &parseItems = DEV_GetParseItems(device, resources, ind, zclFrame);
+
+    for (size_t ri = 0; ri < resources.size(); ri++)
     {
+        Resource *r = resources[ri];
+
         if (ind.clusterId() == BASIC_CLUSTER_ID && zclFrame.commandId() == deCONZ::ZclReadAttributesResponseId)
         { }
         else if (!device->managed())
@@ -1111,9 +1174,14 @@ void DeRestPluginPrivate::apsdeDataIndicationDevice(const deCONZ::ApsDataIndicat
 
         DeviceJs::instance()->clearItemsSet();
 
-        for (int i = 0; i < r->itemCount(); i++)
+        for (const DEV_ParseItem &parseItem : parseItems)
         {
-            ResourceItem *item = r->itemForIndex(i);
+            if (size_t(parseItem.resource) != ri)
+            {
+                continue;
+            }
+
+            ResourceItem *item = r->itemForIndex(parseItem.item);
             DBG_Assert(item);
             if (!item)
             {
@@ -1209,12 +1277,14 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
         return;
     }
 
+    LAT_SetOrigin(LAT_Now()); // events created from the indication carry this timestamp
+
     deCONZ::ZclFrame zclFrame;
     ZclDefaultResponder zclDefaultResponder(&apsCtrlWrapper, ind, zclFrame);
 
     if (DBG_IsEnabled(DBG_MEASURE))
     {
-        DBG_Printf(DBG_INFO, "R stats, str: %u, num: %u, item: %u\n", rStats.toString, rStats.toNumber, rStats.item);
+        DBG_Printf(DBG_INFO, "R stats, str: %u, num: %u, item: %u, item probes: %u\n", rStats.toString, rStats.toNumber, rStats.item, rStats.itemProbe);
         rStats = { };
     }
 
@@ -1493,6 +1563,7 @@ void DeRestPluginPrivate::apsdeDataIndication(const deCONZ::ApsDataIndication &i
         otauDataIndication(ind, deCONZ::ZclFrame());
     }
 
+    LAT_SetOrigin(0);
     eventEmitter->process();
 }
 
@@ -2231,18 +2302,14 @@ QVariantMap errorToMap(int id, const QString &ressource, const QString &descript
 }
 
 /*! Creates a new unique ETag for a resource.
+    The ETag is the next value of a monotonic counter, clients can pass it
+    back as version in delta requests, see U_EtagVersion().
  */
 void DeRestPluginPrivate::updateEtag(QString &etag)
 {
-    QDateTime time = QDateTime::currentDateTime();
-#if QT_VERSION < 0x050000
-    etag = QString(QCryptographicHash::hash(time.toString("yyyy-MM-ddThh:mm:ss.zzz").toAscii(), QCryptographicHash::Md5).toHex());
-#else
-    etag = QString(QCryptographicHash::hash(time.toString("yyyy-MM-ddThh:mm:ss.zzz").toLatin1(), QCryptographicHash::Md5).toHex());
-#endif
+    gwEtagVersion++;
     // quotes are mandatory as described in w3 spec
-    etag.prepend('"');
-    etag.append('"');
+    etag = QLatin1Char('"') + QString::number(gwEtagVersion) + QLatin1Char('"');
 }
 
 /*! Returns the system uptime in seconds.
@@ -2551,8 +2618,9 @@ void DeRestPluginPrivate::addLightNode(const deCONZ::Node *node)
                     queryTime = queryTime.addSecs(1);
 
                     lightNode2->setNeedSaveDatabase(true);
-                    updateEtag(lightNode2->etag);
                 }
+
+                updateLightEtag(lightNode2); // reachable changed
             }
 
             if (lightNode2->uniqueId().isEmpty() || lightNode2->uniqueId().startsWith(QLatin1String("0x")))
@@ -2560,7 +2628,7 @@ void DeRestPluginPrivate::addLightNode(const deCONZ::Node *node)
                 QString uid = generateUniqueId(lightNode2->address().ext(), lightNode2->haEndpoint().endpoint(), 0);
                 lightNode2->setUniqueId(uid);
                 lightNode2->setNeedSaveDatabase(true);
-                updateEtag(lightNode2->etag);
+                updateLightEtag(lightNode2);
             }
 
             continue;
@@ -4053,15 +4121,21 @@ LightNode *DeRestPluginPrivate::updateLightNode(const deCONZ::NodeEvent &event)
  */
 LightNode *DeRestPluginPrivate::getLightNodeForAddress(const deCONZ::Address &addr, quint8 endpoint)
 {
-    for (LightNode &light: nodes)
+    const auto match = [&addr, endpoint](LightNode &light)
     {
-        if (light.state() != LightNode::StateNormal || !light.node())   { continue; }
-        if (light.haEndpoint().endpoint() != endpoint && endpoint != 0) { continue; }
-        if (!isSameAddress(light.address(), addr))                      { continue; }
+        if (light.state() != LightNode::StateNormal || !light.node())   { return false; }
+        if (light.haEndpoint().endpoint() != endpoint && endpoint != 0) { return false; }
+        return isSameAddress(light.address(), addr);
+    };
 
-        return &light;
+    if (!addr.hasExt()) // NWK address only
+    {
+        const auto i = std::find_if(nodes.begin(), nodes.end(), match);
+        return i != nodes.end() ? &*i : nullptr;
     }
-    return nullptr;
+
+    const size_t slot = lightAddressIndex.find(nodes, addr.ext(), true, match);
+    return slot != AddressIndex::NotFound ? &nodes[slot] : nullptr;
 }
 
 /*! Returns the number of Endpoints of a device.
@@ -4087,31 +4161,32 @@ int DeRestPluginPrivate::getNumberOfEndpoints(quint64 extAddr)
  */
 LightNode *DeRestPluginPrivate::getLightNodeForId(const QString &id)
 {
-    std::vector<LightNode>::iterator i;
-    std::vector<LightNode>::iterator end = nodes.end();
+    size_t slot;
 
     if (id.length() < MIN_UNIQUEID_LENGTH)
     {
-        for (i = nodes.begin(); i != end; ++i)
+        slot = lightIdIndex.find(nodes, id, [&id](const LightNode &l)
         {
-            if (i->id() == id && i->state() == LightNode::StateNormal)
-            {
-                return &*i;
-            }
-        }
+            return l.id() == id && l.state() == LightNode::StateNormal;
+        });
     }
     else
     {
-        for (i = nodes.begin(); i != end; ++i)
+        slot = lightUniqueIdIndex.find(nodes, id, [&id](const LightNode &l)
         {
-            if (i->uniqueId() == id && i->state() == LightNode::StateNormal)
-            {
-                return &*i;
-            }
-        }
+            return l.uniqueId() == id && l.state() == LightNode::StateNormal;
+        });
     }
 
-    return nullptr;
+    return slot != ResourceIndex<QString>::NotFound ? &nodes[slot] : nullptr;
+}
+
+/*! Returns a Rule for its given \p handle or nullptr if not found.
+    The returned pointer is only valid until rules are added.
+ */
+Rule *DeRestPluginPrivate::getRuleForHandle(int handle)
+{
+    return RULE_GetForHandle(rules, ruleHandleIndex, handle);
 }
 
 /*! Returns a Rule for its given \p id or 0 if not found.
@@ -9542,29 +9617,38 @@ bool DeRestPluginPrivate::isDeviceSupported(const deCONZ::Node *node, const QStr
  */
 Sensor *DeRestPluginPrivate::getSensorNodeForAddress(quint64 extAddr)
 {
-    std::vector<Sensor>::iterator i = sensors.begin();
-    std::vector<Sensor>::iterator end = sensors.end();
+    size_t slot = sensorAddressIndex.find(sensors, extAddr, false, [](Sensor &s)
+    {
+        return s.deletedState() != Sensor::StateDeleted;
+    });
 
-    for (; i != end; ++i)
+    if (slot == AddressIndex::NotFound)
     {
-        if (i->address().ext() == extAddr && i->deletedState() != Sensor::StateDeleted)
-        {
-            return &(*i);
-        }
+        slot = sensorAddressIndex.find(sensors, extAddr, false, [](Sensor &) { return true; });
     }
 
-    end = sensors.end();
+    return slot != AddressIndex::NotFound ? &sensors[slot] : nullptr;
+}
 
-    for (i = sensors.begin(); i != end; ++i)
+/*! Returns the first Sensor with address \p addr for which \p match returns true or nullptr if not found.
+    Addresses with MAC address are looked up in sensorAddressIndex, NWK only addresses need a scan.
+ */
+template <typename Match>
+static Sensor *getSensorForAddress(std::vector<Sensor> &sensors, AddressIndex &index, const deCONZ::Address &addr, Match match)
+{
+    const auto matchAddress = [&addr, &match](Sensor &sensor)
     {
-        if (i->address().ext() == extAddr)
-        {
-            return &(*i);
-        }
-    }
+        return match(sensor) && isSameAddress(sensor.address(), addr);
+    };
 
-    return 0;
+    if (!addr.hasExt())
+    {
+        const auto i = std::find_if(sensors.begin(), sensors.end(), matchAddress);
+        return i != sensors.end() ? &*i : nullptr;
+    }
 
+    const size_t slot = index.find(sensors, addr.ext(), true, matchAddress);
+    return slot != AddressIndex::NotFound ? &sensors[slot] : nullptr;
 }
 
 /*! Returns the first Sensor for its given \p addr or 0 if not found.
@@ -9572,30 +9656,22 @@ Sensor *DeRestPluginPrivate::getSensorNodeForAddress(quint64 extAddr)
  */
 Sensor *DeRestPluginPrivate::getSensorNodeForAddress(const deCONZ::Address &addr)
 {
-    for (Sensor &sensor: sensors)
+    return getSensorForAddress(sensors, sensorAddressIndex, addr, [](Sensor &sensor)
     {
-        if (sensor.deletedState() != Sensor::StateNormal)                   { continue; }
-        if (!isSameAddress(sensor.address(), addr))                         { continue; }
-
-        return &sensor;
-    }
-    return nullptr;
+        return sensor.deletedState() == Sensor::StateNormal;
+    });
 }
 
 /*! Returns the first Sensor for its given \p Address and \p Endpoint and \p Type or 0 if not found.
  */
 Sensor *DeRestPluginPrivate::getSensorNodeForAddressAndEndpoint(const deCONZ::Address &addr, quint8 ep, const QString &type)
 {
-    for (Sensor &sensor: sensors)
+    return getSensorForAddress(sensors, sensorAddressIndex, addr, [ep, &type](Sensor &sensor)
     {
-        if (sensor.deletedState() != Sensor::StateNormal || !sensor.node()) { continue; }
-        if (sensor.fingerPrint().endpoint != ep)                            { continue; }
-        if (sensor.type() != type)                                          { continue; }
-        if (!isSameAddress(sensor.address(), addr))                         { continue; }
-
-        return &sensor;
-    }
-    return nullptr;
+        if (sensor.deletedState() != Sensor::StateNormal || !sensor.node()) { return false; }
+        if (sensor.fingerPrint().endpoint != ep)                            { return false; }
+        return sensor.type() == type;
+    });
 }
 
 
@@ -9603,32 +9679,23 @@ Sensor *DeRestPluginPrivate::getSensorNodeForAddressAndEndpoint(const deCONZ::Ad
  */
 Sensor *DeRestPluginPrivate::getSensorNodeForAddressAndEndpoint(const deCONZ::Address &addr, quint8 ep)
 {
-    for (Sensor &sensor: sensors)
+    return getSensorForAddress(sensors, sensorAddressIndex, addr, [ep](Sensor &sensor)
     {
-        if (sensor.deletedState() != Sensor::StateNormal || !sensor.node()) { continue; }
-        if (sensor.fingerPrint().endpoint != ep)                            { continue; }
-        if (!isSameAddress(sensor.address(), addr))                         { continue; }
-
-        return &sensor;
-    }
-    return nullptr;
+        if (sensor.deletedState() != Sensor::StateNormal || !sensor.node()) { return false; }
+        return sensor.fingerPrint().endpoint == ep;
+    });
 }
 
 /*! Returns the first Sensor for its given \p Address and \p Endpoint and \p Cluster or nullptr if not found.
  */
 Sensor *DeRestPluginPrivate::getSensorNodeForAddressEndpointAndCluster(const deCONZ::Address &addr, quint8 ep, quint16 cluster)
 {
-    for (Sensor &sensor: sensors)
+    return getSensorForAddress(sensors, sensorAddressIndex, addr, [ep, cluster](Sensor &sensor)
     {
-        if (sensor.deletedState() != Sensor::StateNormal || !sensor.node())                             { continue; }
-        if (sensor.fingerPrint().endpoint != ep)                                                        { continue; }
-        if (!isSameAddress(sensor.address(), addr))                                                     { continue; }
-        if (sensor.fingerPrint().hasInCluster(cluster) || sensor.fingerPrint().hasOutCluster(cluster))  { }
-        else                                                                                            { continue; }
-
-        return &sensor;
-    }
-    return nullptr;
+        if (sensor.deletedState() != Sensor::StateNormal || !sensor.node()) { return false; }
+        if (sensor.fingerPrint().endpoint != ep)                            { return false; }
+        return sensor.fingerPrint().hasInCluster(cluster) || sensor.fingerPrint().hasOutCluster(cluster);
+    });
 }
 
 /*! Returns the first Sensor which matches a fingerprint.
@@ -9650,7 +9717,7 @@ Sensor *DeRestPluginPrivate::getSensorNodeForFingerPrint(quint64 extAddr, const
                     DBG_Printf(DBG_INFO, "updated fingerprint for sensor %s\n", qPrintable(i->name()));
                     i->fingerPrint() = fingerPrint;
                     i->setNeedSaveDatabase(true);
-                    updateEtag(i->etag);
+                    updateSensorEtag(&*i);
                     queSaveDb(DB_SENSORS , DB_SHORT_SAVE_DELAY);
                 }
                 return &(*i);
@@ -9671,7 +9738,7 @@ Sensor *DeRestPluginPrivate::getSensorNodeForFingerPrint(quint64 extAddr, const
                     DBG_Printf(DBG_INFO, "updated fingerprint for sensor %s\n", qPrintable(i->name()));
                     i->fingerPrint() = fingerPrint;
                     i->setNeedSaveDatabase(true);
-                    updateEtag(i->etag);
+                    updateSensorEtag(&*i);
                     queSaveDb(DB_SENSORS , DB_SHORT_SAVE_DELAY);
                 }
                 return &(*i);
@@ -9691,50 +9758,38 @@ Sensor *DeRestPluginPrivate::getSensorNodeForUniqueId(const QString &uniqueId)
         return nullptr;
     }
 
-    for (Sensor &s : sensors)
+    const size_t slot = sensorUniqueIdIndex.find(sensors, uniqueId, [&uniqueId](const Sensor &s)
     {
-        if (s.deletedState() == Sensor::StateNormal && s.uniqueId() == uniqueId)
-        {
-            return &s;
-        }
-    }
+        return s.deletedState() == Sensor::StateNormal && s.uniqueId() == uniqueId;
+    });
 
-    return nullptr;
+    return slot != ResourceIndex<QString>::NotFound ? &sensors[slot] : nullptr;
 }
 
 /*! Returns a Sensor for its given \p id or 0 if not found.
  */
 Sensor *DeRestPluginPrivate::getSensorNodeForId(const QString &id)
 {
-    for (Sensor &s : sensors)
+    const size_t slot = sensorIdIndex.find(sensors, id, [&id](const Sensor &s)
     {
-        if (s.deletedState() == Sensor::StateNormal && s.id() == id)
-        {
-            return &s;
-        }
-    }
+        return s.deletedState() == Sensor::StateNormal && s.id() == id;
+    });
 
-    return nullptr;
+    return slot != ResourceIndex<QString>::NotFound ? &sensors[slot] : nullptr;
 }
 
 /*! Returns a Group for a given group id or 0 if not found.
  */
 Group *DeRestPluginPrivate::getGroupForId(uint16_t id)
 {
-    uint16_t gid = id ? id : gwGroup0;
-
-    std::vector<Group>::iterator i = groups.begin();
-    std::vector<Group>::iterator end = groups.end();
+    const uint16_t gid = id ? id : gwGroup0;
 
-    for (; i != end; ++i)
+    const size_t slot = groupIndex.find(groups, gid, [gid](const Group &g)
     {
-        if (i->address() == gid)
-        {
-            return &(*i);
-        }
-    }
+        return g.address() == gid;
+    });
 
-    return 0;
+    return slot != ResourceIndex<quint16>::NotFound ? &groups[slot] : nullptr;
 }
 
 /*! Returns a Scene for a given group id and Scene id or 0 if not found.
@@ -9795,26 +9850,14 @@ Group *DeRestPluginPrivate::getGroupForId(const QString &id)
 
     // check valid 16-bit group id 0..0xFFFF
     bool ok;
-    uint gid = id.toUInt(&ok, 10);
+    const uint gid = id.toUInt(&ok, 10);
     if (!ok || (gid > 0xFFFFUL))
     {
         DBG_Printf(DBG_INFO, "Get group for id error: invalid group id %s\n", qPrintable(id));
         return nullptr;
     }
-    if (gid == 0)
-    {
-        gid = gwGroup0;
-    }
-
-    for (auto &group : groups)
-    {
-        if (group.address() == gid)
-        {
-            return &group;
-        }
-    }
 
-    return nullptr;
+    return getGroupForId(static_cast<uint16_t>(gid));
 }
 
 /*! Delete a group of a switch from database permanently.
@@ -10887,7 +10930,6 @@ void DeRestPluginPrivate::foundGroup(uint16_t groupId)
     group.hueReal = 0.0f;
     group.sat = 128;
     group.setName(QString());
-    updateEtag(group.etag);
     openDb();
     loadGroupFromDb(&group);
     closeDb();
@@ -10896,6 +10938,7 @@ void DeRestPluginPrivate::foundGroup(uint16_t groupId)
         queSaveDb(DB_GROUPS, DB_SHORT_SAVE_DELAY);
     }
     groups.push_back(group);
+    updateGroupEtag(&groups.back());
     updateEtag(gwConfigEtag);
 }
 
@@ -11124,7 +11167,7 @@ void DeRestPluginPrivate::setSceneName(Group *group, uint8_t sceneId, const QStr
         {
             i->name = name;
             queSaveDb(DB_SCENES, DB_SHORT_SAVE_DELAY);
-            updateEtag(group->etag);
+            updateGroupEtag(group);
             break;
         }
     }
@@ -11273,7 +11316,7 @@ bool DeRestPluginPrivate::removeScene(Group *group, uint8_t sceneId)
             if (i->id == sceneId)
             {
                 i->state = Scene::StateDeleted;
-                updateEtag(group->etag);
+                updateGroupEtag(group);
                 updateEtag(gwConfigEtag);
                 break;
             }
@@ -11591,39 +11634,17 @@ void DeRestPluginPrivate::storeRecoverOnOffBri(LightNode *lightNode)
     recoverOnOff.push_back(rc);
 }
 
-/*! Queues a client for closing the connection.
+/*! Registers a request on the client connection and queues it for closing.
     \param sock the client socket
-    \param closeTimeout timeout in seconds then the socket should be closed
+    \param closeTimeout idle timeout in seconds then the socket should be closed
  */
 void DeRestPluginPrivate::pushClientForClose(QTcpSocket *sock, int closeTimeout)
 {
-    std::vector<TcpClient>::iterator i = openClients.begin();
-    std::vector<TcpClient>::iterator end = openClients.end();
-
-    for ( ;i != end; ++i)
+    if (httpConnections.addRequest(sock, closeTimeout))
     {
-        if (i->sock == sock)
-        {
-            // update
-            if (i->closeTimeout > 0)
-            {
-                if (i->closeTimeout < closeTimeout)
-                {
-                    i->closeTimeout = closeTimeout;
-                }
-            }
-            return;
-        }
+        connect(sock, SIGNAL(destroyed()),
+                this, SLOT(clientSocketDestroyed()));
     }
-
-    TcpClient client;
-    client.sock = sock;
-    client.closeTimeout = closeTimeout;
-
-    connect(sock, SIGNAL(destroyed()),
-            this, SLOT(clientSocketDestroyed()));
-
-    openClients.push_back(client);
 }
 
 /*! Adds a task to the queue.
@@ -11686,6 +11707,8 @@ bool DeRestPluginPrivate::addTask(const TaskItem &task)
                 {
                     DBG_Printf(DBG_INFO, "Replace task %d type %d in queue cluster 0x%04X with newer task %d of same type. %u runnig tasks\n", i->taskId, task.taskType, task.req.clusterId(), task.taskId, runningTasks.size());
                     *i = task;
+                    i->latencyOrigin = ruleLatencyOrigin;
+                    i->latencyTrigger = ruleLatencyTrigger;
                     return true;
                 }
             }
@@ -11694,6 +11717,8 @@ bool DeRestPluginPrivate::addTask(const TaskItem &task)
 
     if (tasks.size() < MaxTasks) {
         tasks.push_back(task);
+        tasks.back().latencyOrigin = ruleLatencyOrigin; // only set while rules are triggered
+        tasks.back().latencyTrigger = ruleLatencyTrigger;
         return true;
     }
 
@@ -11843,6 +11868,7 @@ void DeRestPluginPrivate::processTasks()
                         i->sendTime = idleTotalCounter;
                         if (apsCtrlWrapper.apsdeDataRequest(i->req) == deCONZ::Success)
                         {
+                            traceTaskLatency(*i);
                             group->sendTime = now;
                             if (pushRunning)
                             {
@@ -11881,6 +11907,7 @@ void DeRestPluginPrivate::processTasks()
 
                     if (ret == deCONZ::Success)
                     {
+                        traceTaskLatency(*i);
                         if (pushRunning)
                         {
                             runningTasks.push_back(*i);
@@ -11906,6 +11933,24 @@ void DeRestPluginPrivate::processTasks()
     }
 }
 
+/*! Records the latency of an APS request which was created by a rule.
+ */
+void DeRestPluginPrivate::traceTaskLatency(const TaskItem &task)
+{
+    if (task.latencyTrigger == 0)
+    {
+        return;
+    }
+
+    const qint64 now = LAT_Now();
+    ruleLatency[RuleLatencyTaskQueue].add(now - task.latencyTrigger);
+
+    if (task.latencyOrigin != 0)
+    {
+        ruleLatency[RuleLatencyTotal].add(now - task.latencyOrigin);
+    }
+}
+
 /*! Handler for node events.
     \param event the event which occured
  */
@@ -12380,7 +12425,7 @@ void DeRestPluginPrivate::handleGroupClusterIndication(const deCONZ::ApsDataIndi
                     i->actions &= ~GroupInfo::ActionRemoveFromGroup; // sanity
                     i->actions |= GroupInfo::ActionAddToGroup;
                     i->state = GroupInfo::StateInGroup;
-                    updateEtag(group->etag);
+                    updateGroupEtag(group);
                     updateEtag(gwConfigEtag);
                     lightNode->setNeedSaveDatabase(true);
                     queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -12399,7 +12444,7 @@ void DeRestPluginPrivate::handleGroupClusterIndication(const deCONZ::ApsDataIndi
                         group->m_multiDeviceIds.erase(fi);
                         queSaveDb(DB_GROUPS, DB_SHORT_SAVE_DELAY);
                     }
-                    updateEtag(group->etag);
+                    updateGroupEtag(group);
                     updateEtag(gwConfigEtag);
                     lightNode->setNeedSaveDatabase(true);
                     queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -12408,7 +12453,7 @@ void DeRestPluginPrivate::handleGroupClusterIndication(const deCONZ::ApsDataIndi
                     && i->state == GroupInfo::StateInGroup) // light was removed from group by switch -> remove it from deCONZ group)
                 {
                     i->state = GroupInfo::StateNotInGroup;
-                    updateEtag(group->etag);
+                    updateGroupEtag(group);
                     updateEtag(gwConfigEtag);
                     lightNode->setNeedSaveDatabase(true);
                     queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -13211,7 +13256,7 @@ void DeRestPluginPrivate::handleSceneClusterIndication(const deCONZ::ApsDataIndi
         map["r"] = QLatin1String("scenes");
         map["gid"] = QString::number(groupId);
         map["scid"] = QString::number(sceneId);
-        webSocketServer->broadcastTextMessage(Json::serialize(map));
+        webSocketServer->broadcastEvent(map);
 
         // check if scene exists
 
@@ -13758,7 +13803,7 @@ void DeRestPluginPrivate::taskToLocalData(const TaskItem &task)
     switch (task.taskType)
     {
     case TaskSendOnOffToggle:
-        updateEtag(group->etag);
+        updateGroupEtag(group);
         group->setIsOn(task.onOff);
 
         break;
@@ -13882,7 +13927,7 @@ void DeRestPluginPrivate::taskToLocalData(const TaskItem &task)
             break;
 
         case TaskStopLevel:
-            updateEtag(lightNode->etag);
+            updateLightEtag(lightNode);
             lightNode->enableRead(READ_LEVEL);
             lightNode->mustRead(READ_LEVEL);
             break;
@@ -15080,7 +15125,6 @@ void DeRestPluginPrivate::updateSensorEtag(Sensor *sensorNode)
     {
         updateEtag(sensorNode->etag);
         gwSensorsEtag = sensorNode->etag;
-        gwConfigEtag = sensorNode->etag;
     }
 }
 
@@ -15092,7 +15136,6 @@ void DeRestPluginPrivate::updateLightEtag(LightNode *lightNode)
     {
         updateEtag(lightNode->etag);
         gwLightsEtag = lightNode->etag;
-        gwConfigEtag = lightNode->etag;
     }
 }
 
@@ -15104,7 +15147,6 @@ void DeRestPluginPrivate::updateGroupEtag(Group *group)
     {
         updateEtag(group->etag);
         gwGroupsEtag = group->etag;
-        gwConfigEtag = group->etag;
     }
 }
 
@@ -15893,6 +15935,12 @@ void DeRestPlugin::appAboutToQuit()
         d->saveDatabaseItems |= (DB_SENSORS | DB_RULES | DB_LIGHTS);
         d->openDb();
         d->saveDb();
+        if (d->timeSeries)
+        {
+            d->timeSeries->flush(QDateTime::currentMSecsSinceEpoch() / 1000, true);
+            d->timeSeries.reset(); // waits for the pending file jobs
+        }
+        DB_CloseWriter();
 
         // TODO(mpi): Following is really heavy and already done previously
         //            storing items needs to get more explicit with dirty flags
@@ -16020,10 +16068,11 @@ bool DeRestPlugin::isHttpTarget(const QHttpRequestHeader &hdr)
 int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *sock)
 {
     QString content;
+    QByteArray contentUtf8;
     QTextStream stream(sock);
 
     stream.setCodec(QTextCodec::codecForName("UTF-8"));
-    d->pushClientForClose(sock, 60);
+    d->pushClientForClose(sock, HttpConnectionManager::IdleTimeout);
 
     if (DBG_IsEnabled(DBG_HTTP))
     {
@@ -16038,7 +16087,8 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
     }
     else if (!stream.atEnd())
     {
-        content = stream.readAll();
+        contentUtf8 = sock->readAll();
+        content = QString::fromUtf8(contentUtf8);
         if (DBG_IsEnabled(DBG_HTTP))
         {
             DBG_Printf(DBG_HTTP, "Text Data: \t%s\n", qPrintable(content));
@@ -16056,6 +16106,7 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
 
     QStringList path = QString(hdr.path()).split(QLatin1String("/"), SKIP_EMPTY_PARTS);
     ApiRequest req(hdr, path, sock, content);
+    req.contentUtf8 = contentUtf8;
     req.mode = d->gwHueMode ? ApiModeHue : ApiModeNormal;
 
     ApiResponse rsp;
@@ -16078,7 +16129,7 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
         stream << "HTTP/1.1 200 OK\r\n";
         stream << "Cache-Control: no-store, no-cache, must-revalidate, post-check=0, pre-check=0\r\n";
         stream << "Pragma: no-cache\r\n";
-        stream << "Connection: close\r\n";
+        stream << d->httpConnections.connectionHeaders(req.sock); // keep preflight connections open for the actual request
         stream << "Access-Control-Max-Age: 0\r\n";
         stream << "Access-Control-Allow-Origin: " << origin << " \r\n";
         stream << "Access-Control-Allow-Credentials: true\r\n";
@@ -16305,16 +16356,24 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
     }
 
     QByteArray str;
+    static JsonWriter json(16 * 1024); // reused for all responses, keeps its capacity
 
-    if (!rsp.map.isEmpty())
+    if (!rsp.json.isEmpty())
     {
         rsp.contentType = HttpContentJson;
-        str = Json::serialize(rsp.map);
+        str = rsp.json;
     }
-    else if (!rsp.list.isEmpty())
+    else if (!rsp.map.isEmpty() || !rsp.list.isEmpty())
     {
         rsp.contentType = HttpContentJson;
-        str = Json::serialize(rsp.list);
+        json.clear();
+        if (!rsp.map.isEmpty()) { json.value(QVariant(rsp.map)); }
+        else                    { json.value(QVariant(rsp.list)); }
+
+        if (!json.hasError())
+        {
+            str = json.buffer(); // shared until the response is written
+        }
     }
     else if (!rsp.str.isEmpty())
     {
@@ -16332,6 +16391,7 @@ int DeRestPlugin::handleHttpRequest(const QHttpRequestHeader &hdr, QTcpSocket *s
     stream << "Access-Control-Allow-Origin: *\r\n";
     stream << "Content-Type: " << rsp.contentType << "\r\n";
     stream << "Content-Length: " << str.size() << "\r\n";
+    stream << d->httpConnections.connectionHeaders(sock);
 
     if (!rsp.hdrFields.empty())
     {
@@ -16387,70 +16447,36 @@ bool DeRestPlugin::dbSaveAllowed() const
 }
 
 /*! Checks if some tcp connections could be closed.
+    Also writes the last use date of recently used API keys.
  */
 void DeRestPluginPrivate::openClientTimerFired()
 {
-    std::vector<TcpClient>::iterator i = openClients.begin();
-    std::vector<TcpClient>::iterator end = openClients.end();
-
-    for ( ; i != end; ++i)
+    for (QTcpSocket *sock : httpConnections.tick())
     {
-        i->closeTimeout--;
+        DBG_Assert(sock != nullptr);
 
-        if (i->closeTimeout == 0)
+        if (sock->state() == QTcpSocket::ConnectedState)
         {
-            i->closeTimeout = -1;
-
-            DBG_Assert(i->sock != nullptr);
-
-            if (i->sock)
-            {
-                QTcpSocket *sock = i->sock;
-
-                if (sock->state() == QTcpSocket::ConnectedState)
-                {
-                    DBG_Printf(DBG_INFO_L2, "Close socket port: %u\n", sock->peerPort());
-                    sock->close();
-                }
-                else
-                {
-                    DBG_Printf(DBG_INFO_L2, "Close socket state = %d\n", sock->state());
-                }
-
-                sock->deleteLater();
-                return;
-            }
+            DBG_Printf(DBG_INFO_L2, "Close socket port: %u\n", sock->peerPort());
+            sock->close();
         }
-        else if (i->closeTimeout < -120)
+        else
         {
-            // cleanup here if not already deleted by socket destroyed slot
-            *i = openClients.back();
-            openClients.pop_back();
-            return;
+            DBG_Printf(DBG_INFO_L2, "Close socket state = %d\n", sock->state());
         }
+
+        sock->deleteLater();
     }
+
+    flushApiAuthUsage();
 }
 
 /*! Is called before the client socket will be deleted.
  */
 void DeRestPluginPrivate::clientSocketDestroyed()
 {
-    QObject *obj = sender();
-
-    std::vector<TcpClient>::iterator i = openClients.begin();
-    std::vector<TcpClient>::iterator end = openClients.end();
-
-    for ( ; i != end; ++i)
-    {
-        if (i->sock == obj)
-        {
-            //int dt = i->created.secsTo(QDateTime::currentDateTime());
-            //DBG_Printf(DBG_INFO, "remove socket %s : %u after %d s, %s\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), dt, qPrintable(i->hdr.path()));
-            *i = openClients.back();
-            openClients.pop_back();
-            return;
-        }
-    }
+    // only the pointer value is used, the socket is already partly destroyed
+    httpConnections.remove(static_cast<QTcpSocket*>(sender()));
 }
 
 /*! Returns the endpoint number of the HA endpoint.
@@ -16601,6 +16627,7 @@ Resource *DEV_AddResource(const Sensor &sensor)
         plugin->sensors.push_back(sensor);
         r = &plugin->sensors.back();
         r->setHandle(R_CreateResourceHandle(r, plugin->sensors.size() - 1));
+        plugin->sensorUniqueIdIndex.insert(plugin->sensors.back().uniqueId(), plugin->sensors.size() - 1);
 
         if (plugin->searchSensorsState == DeRestPluginPrivate::SearchSensorsActive || plugin->permitJoinFlag)
         {
@@ -16626,6 +16653,7 @@ Resource *DEV_AddResource(const LightNode &lightNode)
         plugin->nodes.push_back(lightNode);
         r = &plugin->nodes.back();
         r->setHandle(R_CreateResourceHandle(r, plugin->nodes.size() - 1));
+        plugin->lightUniqueIdIndex.insert(plugin->nodes.back().uniqueId(), plugin->nodes.size() - 1);
 
         if (plugin->searchLightsState == DeRestPluginPrivate::SearchLightsActive || plugin->permitJoinFlag)
         {
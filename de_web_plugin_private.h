@@ -29,7 +29,10 @@
 #include "resource.h"
 #include "daylight.h"
 #include "event_emitter.h"
+#include "full_state_cache.h"
 #include "green_power.h"
+#include "http_connections.h"
+#include "latency_histogram.h"
 #include "resource.h"
 #include "rest_node_base.h"
 #include "light_node.h"
@@ -39,6 +42,8 @@
 #include "scene.h"
 #include "sensor.h"
 #include "resourcelinks.h"
+#include "resource_index.h"
+#include "timeseries.h"
 #include "rule.h"
 #include "bindings.h"
 #include <math.h>
@@ -470,8 +475,11 @@ using namespace deCONZ::literals;
 #define DB_LONG_SAVE_DELAY  (15 * 60 * 1000) // 15 minutes
 #define DB_SHORT_SAVE_DELAY (1 *  60 * 1000) // 1 minute
 #define DB_FAST_SAVE_DELAY (1 * 1000) // 1 second
+#define DB_ITEM_FLUSH_DELAY (2 * 1000) // 2 seconds, write-behind delay of DB_StoreSubDeviceItem()
 
 #define DB_CONNECTION_TTL (60 * 15) // 15 minutes
+#define DB_BUSY_TIMEOUT 250 // ms to wait for locks held by the database writer thread
+#define DB_MAX_COMMIT_RETRIES 12 // COMMIT attempts while readers block the checkpoint
 
 // internet discovery
 
@@ -951,6 +959,8 @@ struct TaskItem
     deCONZ::Node *node;
     LightNode *lightNode;
     deCONZ::ZclCluster *cluster;
+    qint64 latencyOrigin = 0; // event origin if the task was created by a rule
+    qint64 latencyTrigger = 0; // LAT_Now() when the rule was triggered
 
 private:
     static int _taskCounter;
@@ -1006,6 +1016,15 @@ enum ApiMode
     ApiModeHue
 };
 
+/*! Cached lookup data of an API key, see DeRestPluginPrivate::authorise().
+ */
+struct ApiAuthCacheEntry
+{
+    size_t index = 0; // into apiAuths
+    ApiMode mode = ApiModeNormal; // derived from useragent and devicetype
+    bool used = false; // lastUseDate is pending to be flushed
+};
+
 /*! \class ApiRequest
 
     Helper to simplify HTTP REST request handling.
@@ -1016,11 +1035,15 @@ public:
     ApiRequest(const QHttpRequestHeader &h, const QStringList &p, QTcpSocket *s, const QString &c);
     QString apikey() const;
     ApiVersion apiVersion() const { return version; }
+    QVariant parseContent(bool &ok) const;
+    quint64 sinceVersion() const;
 
     const QHttpRequestHeader &hdr;
     const QStringList &path;
     QTcpSocket *sock;
     QString content;
+    QByteArray contentUtf8; // raw body of HTTP requests, empty for internal requests
+    const QVariant *contentParsed = nullptr; // parsed body of internal requests, e.g. rule actions
     ApiVersion version;
     ApiAuthorisation auth;
     ApiMode mode;
@@ -1040,6 +1063,7 @@ public:
     QVariantMap map; // json content
     QVariantList list; // json content
     QString str; // json string
+    QByteArray json; // serialized json content
 };
 
 /*! \class ApiConfig
@@ -1052,13 +1076,6 @@ public:
     ApiConfig();
 };
 
-class TcpClient
-{
-public:
-    int closeTimeout; // close socket in n seconds
-    QTcpSocket *sock;
-};
-
 /*! \class DeWebPluginPrivate
 
     Pimpl of DeWebPlugin.
@@ -1083,6 +1100,9 @@ public:
     void initAuthentication();
     bool allowedToCreateApikey(const ApiRequest &req, ApiResponse &rsp, QVariantMap &map);
     void authorise(ApiRequest &req, ApiResponse &rsp);
+    ApiMode apiModeForAuth(const ApiAuth &auth) const;
+    void invalidateApiAuthCache();
+    void flushApiAuthUsage();
 
     // REST API gateways
     int handleGatewaysApi(const ApiRequest &req, ApiResponse &rsp);
@@ -1246,6 +1266,10 @@ public:
     // REST API info
     int handleInfoApi(const ApiRequest &req, ApiResponse &rsp);
     int getInfoTimezones(const ApiRequest &req, ApiResponse &rsp);
+    int getInfoEvents(const ApiRequest &req, ApiResponse &rsp);
+    int getInfoConnections(const ApiRequest &req, ApiResponse &rsp);
+    int getInfoWebsockets(const ApiRequest &req, ApiResponse &rsp);
+    int getInfoRuleLatency(const ApiRequest &req, ApiResponse &rsp);
 
     // REST API capabilities
     int handleCapabilitiesApi(const ApiRequest &req, ApiResponse &rsp);
@@ -1295,6 +1319,7 @@ public Q_SLOTS:
     void networkStateChangeRequest(bool shouldConnect);
     int taskCountForAddress(const deCONZ::Address &address);
     void processTasks();
+    void traceTaskLatency(const TaskItem &task);
     void processGroupTasks();
     void nodeEvent(const deCONZ::NodeEvent &event);
     void initTimezone();
@@ -1314,6 +1339,7 @@ public Q_SLOTS:
     void openClientTimerFired();
     void clientSocketDestroyed();
     void saveDatabaseTimerFired();
+    void flushDatabaseItemsTimerFired();
     void userActivity();
     bool sendBindRequest(BindingTask &bt);
     bool sendConfigureReportingRequest(BindingTask &bt, const std::vector<ConfigureReportingRequest> &requests);
@@ -1448,6 +1474,7 @@ public:
     int getNumberOfEndpoints(quint64 extAddr);
     LightNode *getLightNodeForId(const QString &id);
     Rule *getRuleForId(const QString &id);
+    Rule *getRuleForHandle(int handle);
     Rule *getRuleForName(const QString &name);
     void addSensorNode(const deCONZ::Node *node, const deCONZ::NodeEvent *event = 0);
     void addSensorNode(const deCONZ::Node *node, const SensorFingerprint &fingerPrint, const QString &type, const QString &modelId, const QString &manufacturer);
@@ -1650,6 +1677,7 @@ public:
     void refreshDeviceDb(const deCONZ::Address &addr);
     void pushZdpDescriptorDb(quint64 extAddress, quint8 endpoint, quint16 type, const QByteArray &data);
     void pushZclValueDb(quint64 extAddress, quint8 endpoint, quint16 clusterId, quint16 attributeId, qint64 data);
+    TS_Store *timeSeriesStore();
     bool dbIsOpen() const;
     void openDb();
     void readDb();
@@ -1668,13 +1696,14 @@ public:
     void loadWifiInformationFromDb();
     void loadAllRulesFromDb();
     void loadAllSensorsFromDb();
-    void loadSensorDataFromDb(Sensor *sensor, QVariantList &ls, qint64 fromTime, int max);
-    void loadLightDataFromDb(LightNode *lightNode, QVariantList &ls, qint64 fromTime, int max);
+    void loadSensorDataFromDb(Sensor *sensor, QVariantList &ls, qint64 fromTime, qint64 toTime, int max, qint64 bucket);
+    void loadLightDataFromDb(LightNode *lightNode, QVariantList &ls, qint64 fromTime, qint64 toTime, int max, qint64 bucket);
     void loadAllGatewaysFromDb();
     void saveDb();
     void saveApiKey(QString apikey);
     void closeDb();
     void queSaveDb(int items, int msec);
+    void queFlushDbItems();
     void updateZigBeeConfigDb();
     void getLastZigBeeConfigDb(QString &out);
     void getZigbeeConfigDb(QVariantList &out);
@@ -1688,7 +1717,9 @@ public:
     QString sqliteDatabaseName;
     std::vector<QString> dbQueryQueue;
     qint64 dbZclValueMaxAge;
+    std::unique_ptr<TS_Store> timeSeries; // ZCL attribute history, enabled by dbZclValueMaxAge
     QTimer *databaseTimer;
+    QTimer *databaseItemTimer;
     QString emptyString;
 
     // JSON support
@@ -1706,6 +1737,9 @@ public:
     QElapsedTimer apiAuthSaveDatabaseTime;
     size_t apiAuthCurrent;
     std::vector<ApiAuth> apiAuths;
+    QHash<QString, ApiAuthCacheEntry> apiAuthCache; // apikey -> entry, only StateNormal
+    std::vector<size_t> apiAuthUsed; // apiAuths indexes with pending lastUseDate
+    bool apiAuthCacheValid = false;
     QString gwAdminUserName;
     std::string gwAdminPasswordHash;
 
@@ -1796,6 +1830,8 @@ public:
     QString gwLightsEtag;
     QString gwGroupsEtag;
     QString gwConfigEtag;
+    quint64 gwEtagVersion; // last version assigned by updateEtag()
+    FullStateCache fullStateCache; // serialized resources of GET /api/<apikey>
     QByteArray gwChallenge;
     QDateTime gwLastChallenge;
     bool gwRunFromShellScript;
@@ -2082,6 +2118,20 @@ public:
     std::vector<int> fastRuleCheck;
     QTimer *fastRuleCheckTimer;
 
+    // rule latency trace, see GET /api/<apikey>/info/rules
+    enum RuleLatencyStage
+    {
+        RuleLatencyEventQueue, // event origin -> handleRuleEvent()
+        RuleLatencyEvaluate,   // evaluateRule() of all rules involved in an event
+        RuleLatencyTrigger,    // triggerRule() of all rules triggered by an event
+        RuleLatencyTaskQueue,  // triggerRule() -> APS request sent in processTasks()
+        RuleLatencyTotal,      // event origin -> APS request sent in processTasks()
+        RuleLatencyStageMax
+    };
+    LatencyHistogram ruleLatency[RuleLatencyStageMax];
+    qint64 ruleLatencyOrigin = 0; // origin of the event whose rules are triggered right now
+    qint64 ruleLatencyTrigger = 0; // LAT_Now() when triggering started
+
     // general
     ApiConfig config;
     QTime queryTime;
@@ -2108,6 +2158,15 @@ public:
     size_t daylightOffsetIter = 0;
     std::vector<DL_Result> daylightTimes;
     std::vector<Sensor> sensors;
+    // lookup hints into groups, nodes and sensors, see ResourceIndex
+    ResourceIndex<quint16> groupIndex;
+    ResourceIndex<QString> lightIdIndex;
+    ResourceIndex<QString> lightUniqueIdIndex;
+    ResourceIndex<QString> sensorIdIndex;
+    ResourceIndex<QString> sensorUniqueIdIndex;
+    ResourceIndex<int> ruleHandleIndex;
+    AddressIndex lightAddressIndex;
+    AddressIndex sensorAddressIndex;
     std::list<TaskItem> tasks;
     std::list<TaskItem> runningTasks;
     QTimer *taskTimer;
@@ -2140,7 +2199,7 @@ public:
 
     // TCP connection watcher
     QTimer *openClientTimer;
-    std::vector<TcpClient> openClients;
+    HttpConnectionManager httpConnections;
 
     WebSocketServer *webSocketServer;
 
@@ -21,6 +21,7 @@
 #include "device_descriptions.h"
 #include "event.h"
 #include "event_emitter.h"
+#include "resource_index.h"
 #include "utils/utils.h"
 #include "zcl/zcl.h"
 #include "zdp/zdp.h"
@@ -72,6 +73,7 @@ constexpr int MaxIdleApsConfirmErrors = 16;
 constexpr int MaxSubResources = 8;
 
 static int devManaged = -1;
+static ResourceIndex<DeviceKey> devIndex; // DeviceKey -> slot in DeviceContainer
 
 struct DEV_PollItem
 {
@@ -156,6 +158,30 @@ public:
 
     int maxResponseTime = RxOffWhenIdleResponseTime;
 
+    /*! Dispatch table of parse functions, see DEV_GetParseItems(). */
+    struct ParseEntry
+    {
+        DA_ParseFilter filter;
+        const char *suffix = nullptr; //! to verify \c item still refers to the same ResourceItem
+        quint16 item = 0;
+        quint8 resource = 0;
+    };
+
+    struct ParseResource
+    {
+        Resource::Handle handle;
+        int itemCount = 0;
+    };
+
+    struct
+    {
+        std::vector<ParseResource> resources; //! the resources the table was built for
+        std::vector<ParseEntry> keyed; //! sorted by cluster id
+        std::vector<ParseEntry> any; //! parse functions without filter, called for every frame
+        std::vector<DEV_ParseItem> result;
+        bool valid = false;
+    } parseTable;
+
     struct
     {
         unsigned char hasDdf : 1;
@@ -2319,12 +2345,12 @@ const std::vector<DDF_Binding> &Device::bindings() const
 
 Device *DEV_GetDevice(DeviceContainer &devices, DeviceKey key)
 {
-    auto d = std::find_if(devices.begin(), devices.end(),
+    const size_t slot = devIndex.get(devices, key,
                           [key](const std::unique_ptr<Device> &device) { return device->key() == key; });
 
-    if (d != devices.end())
+    if (slot != ResourceIndex<DeviceKey>::NotFound)
     {
-        return d->get();
+        return devices[slot].get();
     }
 
     return nullptr;
@@ -2334,19 +2360,17 @@ Device *DEV_GetOrCreateDevice(QObject *parent, deCONZ::ApsController *apsCtrl, E
 {
     Q_ASSERT(key != 0);
     Q_ASSERT(apsCtrl);
-    auto d = std::find_if(devices.begin(), devices.end(),
-                          [key](const std::unique_ptr<Device> &device) { return device->key() == key; });
+    Device *d = DEV_GetDevice(devices, key);
 
-    if (d == devices.end())
+    if (!d)
     {
         devices.emplace_back(new Device(key, apsCtrl, parent));
+        devIndex.insert(key, devices.size() - 1);
         QObject::connect(devices.back().get(), SIGNAL(eventNotify(Event)), eventEmitter, SLOT(enqueueEvent(Event)));
         return devices.back().get();
     }
 
-    Q_ASSERT(d != devices.end());
-
-    return d->get();
+    return d;
 }
 
 bool DEV_RemoveDevice(DeviceContainer &devices, DeviceKey key)
@@ -2355,12 +2379,162 @@ bool DEV_RemoveDevice(DeviceContainer &devices, DeviceKey key)
                           [key](const std::unique_ptr<Device> &device) { return device->key() == key; });
     if (i != devices.cend())
     {
+        devIndex.erase(key, size_t(i - devices.cbegin()));
         devices.erase(i);
     }
 
     return false;
 }
 
+static void DEV_BuildParseTable(DevicePrivate *d, const std::vector<Resource*> &resources)
+{
+    auto &tab = d->parseTable;
+
+    tab.resources.clear();
+    tab.keyed.clear();
+    tab.any.clear();
+
+    for (size_t ri = 0; ri < resources.size(); ri++)
+    {
+        const Resource *r = resources[ri];
+        tab.resources.push_back({r->handle(), r->itemCount()});
+
+        for (int ii = 0; ii < r->itemCount(); ii++)
+        {
+            const ResourceItem *item = r->itemForIndex(size_t(ii));
+
+            DevicePrivate::ParseEntry entry;
+            entry.suffix = item->descriptor().suffix;
+            entry.item = quint16(ii);
+            entry.resource = quint8(ri);
+
+            if (DA_GetParseFilter(item, &entry.filter))
+            {
+                tab.keyed.push_back(entry);
+                continue;
+            }
+
+            if (!item->parseFunction())
+            {
+                const auto &ddfItem = DDF_GetItem(item);
+                if (!ddfItem.isValid() || ddfItem.parseParameters.isNull())
+                {
+                    continue; // nothing to parse
+                }
+            }
+
+            tab.any.push_back(entry);
+        }
+    }
+
+    std::stable_sort(tab.keyed.begin(), tab.keyed.end(), [](const auto &a, const auto &b)
+    {
+        return a.filter.clusterId < b.filter.clusterId;
+    });
+
+    tab.valid = true;
+}
+
+static bool DEV_ParseTableIsValid(const DevicePrivate *d, const std::vector<Resource*> &resources)
+{
+    const auto &tab = d->parseTable;
+
+    if (!tab.valid || tab.resources.size() != resources.size())
+    {
+        return false;
+    }
+
+    for (size_t ri = 0; ri < resources.size(); ri++)
+    {
+        if (!(tab.resources[ri].handle == resources[ri]->handle()) || tab.resources[ri].itemCount != resources[ri]->itemCount())
+        {
+            return false;
+        }
+    }
+
+    // parse functions are initialised on their first call, afterwards they can be moved to the keyed table
+    DA_ParseFilter filter;
+    for (const auto &entry : tab.any)
+    {
+        const ResourceItem *item = resources[entry.resource]->itemForIndex(entry.item);
+        if (!item || item->descriptor().suffix != entry.suffix)
+        {
+            return false;
+        }
+
+        if (item->parseFunction() && DA_GetParseFilter(item, &filter))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const std::vector<DEV_ParseItem> &DEV_GetParseItems(Device *device, const std::vector<Resource*> &resources, const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame)
+{
+    Q_ASSERT(device);
+    Q_ASSERT(resources.size() <= MaxSubResources + 1);
+
+    DevicePrivate *d = device->d;
+    auto &tab = d->parseTable;
+
+    if (!DEV_ParseTableIsValid(d, resources))
+    {
+        DEV_BuildParseTable(d, resources);
+    }
+
+    tab.result.clear();
+
+    const auto clusterId = ind.clusterId();
+    auto i = std::lower_bound(tab.keyed.cbegin(), tab.keyed.cend(), clusterId, [](const auto &entry, quint16 cl)
+    {
+        return entry.filter.clusterId < cl;
+    });
+
+    for (; i != tab.keyed.cend() && i->filter.clusterId == clusterId; ++i)
+    {
+        if (!DA_ParseFilterMatches(i->filter, ind, zclFrame))
+        {
+            continue;
+        }
+
+        const ResourceItem *item = resources[i->resource]->itemForIndex(i->item);
+        if (!item || item->descriptor().suffix != i->suffix || !item->parseFunction())
+        {
+            // items changed under the hood, rebuild and hand over all parse functions for this frame
+            DEV_BuildParseTable(d, resources);
+            tab.result.clear();
+            for (const auto &entry : tab.keyed)
+            {
+                tab.result.push_back({entry.resource, entry.item});
+            }
+            break;
+        }
+
+        tab.result.push_back({i->resource, i->item});
+    }
+
+    for (const auto &entry : tab.any)
+    {
+        tab.result.push_back({entry.resource, entry.item});
+    }
+
+    // keep the original item order per resource
+    std::sort(tab.result.begin(), tab.result.end(), [](const DEV_ParseItem &a, const DEV_ParseItem &b)
+    {
+        return a.resource < b.resource || (a.resource == b.resource && a.item < b.item);
+    });
+
+    return tab.result;
+}
+
+void DEV_InvalidateParseItems(Device *device)
+{
+    Q_ASSERT(device);
+    device->d->parseTable.valid = false;
+}
+
 void DEV_SetTestManaged(int enabled)
 {
     if (enabled >= 0 && enabled <= 2)
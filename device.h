@@ -23,7 +23,9 @@ class DDF_Binding;
 namespace deCONZ
 {
     class ApsController;
+    class ApsDataIndication;
     class Node;
+    class ZclFrame;
 }
 
 using DeviceKey = uint64_t; //! uniqueId for an Device, MAC address for physical devices
@@ -165,6 +167,27 @@ const deCONZ::Node *DEV_GetCoreNode(uint64_t extAddress);
 
 void DEV_CheckReachable(Device *device);
 
+/*! An item which parse function may handle a received frame, see DEV_GetParseItems().
+ */
+struct DEV_ParseItem
+{
+    quint8 resource; //! index into the resources passed to DEV_GetParseItems()
+    quint16 item;    //! index for Resource::itemForIndex()
+};
+
+/*! Returns the items of \p resources which parse functions need to be called for a received frame.
+
+    The result is taken from a per device dispatch table keyed by cluster id and filtered by endpoint,
+    manufacturer code and command id. The table is rebuilt when \p resources or their items change.
+
+    \param resources - the sub-devices of \p device and \p device itself
+ */
+const std::vector<DEV_ParseItem> &DEV_GetParseItems(Device *device, const std::vector<Resource*> &resources, const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame);
+
+/*! Forces a rebuild of the parse dispatch table, e.g. after the DDF was reloaded.
+ */
+void DEV_InvalidateParseItems(Device *device);
+
 void DEV_SetTestManaged(int enabled);
 bool DEV_TestManaged();
 bool DEV_TestStrict();
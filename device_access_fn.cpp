@@ -1962,6 +1962,88 @@ ParseFunction_t DA_GetParseFunction(const QVariant &params)
     return result;
 }
 
+/*! Fills \p filter with the frame properties the initialised parse function of \p item checks first.
+
+    The filter mirrors the early returns of the respective parse function, a frame which doesn't
+    match would be rejected by the parse function anyway.
+
+    \returns false if the parse function isn't initialised yet or has no fixed filter,
+             in this case the parse function needs to be called for every frame.
+ */
+bool DA_GetParseFilter(const ResourceItem *item, DA_ParseFilter *filter)
+{
+    Q_ASSERT(item);
+    Q_ASSERT(filter);
+
+    const ParseFunction_t fn = item->parseFunction();
+    const ZCL_Param &zclParam = item->zclParam();
+
+    if (fn == parseZclAttribute && zclParam.valid)
+    {
+        filter->clusterId = zclParam.clusterId;
+        filter->manufacturerCode = zclParam.manufacturerCode;
+        filter->endpoint = zclParam.endpoint < BroadcastEndpoint ? zclParam.endpoint : quint8(BroadcastEndpoint);
+        filter->commandId = zclParam.commandId;
+        filter->flags = DA_ParseFilter::FilterManufacturerCode;
+
+        if (!zclParam.hasCommandId)
+        {
+            filter->flags |= DA_ParseFilter::FilterAttributeCommand;
+        }
+        else if (zclParam.attributeCount == 0)
+        {
+            filter->flags |= DA_ParseFilter::FilterCommandId;
+        }
+
+        return true;
+    }
+    else if (fn == parseTuyaData)
+    {
+        // Tuya datapoints are matched by DPID in the payload, the endpoint isn't checked
+        filter->clusterId = TUYA_CLUSTER_ID;
+        filter->manufacturerCode = 0;
+        filter->endpoint = BroadcastEndpoint;
+        filter->commandId = 0;
+        filter->flags = 0;
+        return true;
+    }
+
+    return false;
+}
+
+/*! Returns true if a frame matches \p filter and needs to be handed to the parse function.
+ */
+bool DA_ParseFilterMatches(const DA_ParseFilter &filter, const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame)
+{
+    if (filter.clusterId != ind.clusterId())
+    {
+        return false;
+    }
+
+    if (filter.endpoint < BroadcastEndpoint && filter.endpoint != ind.srcEndpoint())
+    {
+        return false;
+    }
+
+    if ((filter.flags & DA_ParseFilter::FilterManufacturerCode) && filter.manufacturerCode != zclFrame.manufacturerCode())
+    {
+        return false;
+    }
+
+    if ((filter.flags & DA_ParseFilter::FilterAttributeCommand) &&
+        zclFrame.commandId() != deCONZ::ZclReadAttributesResponseId && zclFrame.commandId() != deCONZ::ZclReportAttributesId)
+    {
+        return false;
+    }
+
+    if ((filter.flags & DA_ParseFilter::FilterCommandId) && filter.commandId != zclFrame.commandId())
+    {
+        return false;
+    }
+
+    return true;
+}
+
 ReadFunction_t DA_GetReadFunction(const QVariant &params)
 {
     ReadFunction_t result = nullptr;
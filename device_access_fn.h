@@ -39,9 +39,29 @@ typedef bool (*ParseFunction_t)(Resource *r, ResourceItem *item, const deCONZ::A
 typedef DA_ReadResult (*ReadFunction_t)(const Resource *r, const ResourceItem *item, deCONZ::ApsController *apsCtrl, const QVariant &readParameters);
 typedef bool (*WriteFunction_t)(const Resource *r, const ResourceItem *item, deCONZ::ApsController *apsCtrl, const QVariant &writeParameters);
 
+/*! Frame properties an initialised parse function checks before doing any work, see DA_GetParseFilter().
+ */
+struct DA_ParseFilter
+{
+    enum Flags
+    {
+        FilterManufacturerCode = 0x01, //! frame manufacturer code must equal \c manufacturerCode
+        FilterCommandId        = 0x02, //! frame command id must equal \c commandId
+        FilterAttributeCommand = 0x04  //! frame must be a read attributes response or attribute report
+    };
+
+    quint16 clusterId = 0;
+    quint16 manufacturerCode = 0;
+    quint8 endpoint = 255; //! 255 matches any source endpoint
+    quint8 commandId = 0;
+    quint8 flags = 0;
+};
+
 // temporary expose parseTuyaData for check in tuya.cpp
 bool parseTuyaData(Resource *r, ResourceItem *item, const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame, const QVariant &parseParameters);
 ParseFunction_t DA_GetParseFunction(const QVariant &params);
+bool DA_GetParseFilter(const ResourceItem *item, DA_ParseFilter *filter);
+bool DA_ParseFilterMatches(const DA_ParseFilter &filter, const deCONZ::ApsDataIndication &ind, const deCONZ::ZclFrame &zclFrame);
 ReadFunction_t DA_GetReadFunction(const QVariant &params);
 WriteFunction_t DA_GetWriteFunction(const QVariant &params);
 
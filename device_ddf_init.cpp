@@ -197,6 +197,8 @@ bool DEV_InitDeviceFromDescription(Device *device, const DeviceDescription &ddf)
     size_t subCount = 0;
     auto *dd = DeviceDescriptions::instance();
 
+    DEV_InvalidateParseItems(device); // parse functions of all items are reset below
+
     for (const auto &sub : ddf.subDevices)
     {
         Q_ASSERT(sub.isValid());
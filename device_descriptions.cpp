@@ -8,6 +8,10 @@
  *
  */
 
+#include <atomic>
+#include <cstdarg>
+#include <mutex>
+#include <thread>
 #include <QDirIterator>
 #include <QFile>
 #include <QJsonArray>
@@ -28,6 +32,8 @@
 #define HND_MAX_ITEMS        1023
 #define HND_MAX_SUB_DEVS     15
 
+#define DDF_MAX_READ_THREADS 4
+
 /*! \union ItemHandlePack
 
     Packs location to an DDF item into a opaque 32-bit unsigned int handle.
@@ -49,6 +55,22 @@ union ItemHandlePack
 
 static DeviceDescriptions *_instance = nullptr;
 static DeviceDescriptionsPrivate *_priv = nullptr;
+static std::mutex ddfDescriptorMutex; // DDF files are parsed on worker threads
+
+/*! Diagnostics of a DDF file parsed on a worker thread, printed on the main thread after all workers finished. */
+struct DDF_LogLine
+{
+    int level;
+    QByteArray text;
+};
+
+static thread_local std::vector<DDF_LogLine> *ddfLog = nullptr; // set while a worker parses a file
+
+static void DDF_LogBuffered(int level, const char *format, ...);
+
+/*! DBG_Printf() for code which runs on DDF worker threads, the output is buffered while \c ddfLog is set. */
+#define DDF_Printf(level, ...) \
+    do { if (ddfLog) { DDF_LogBuffered(level, __VA_ARGS__); } else { DBG_Printf(level, __VA_ARGS__); } } while (0)
 
 class DeviceDescriptionsPrivate
 {
@@ -74,6 +96,7 @@ public:
 static bool DDF_ReadConstantsJson(const QString &path, std::map<QString,QString> *constants);
 static DeviceDescription::Item DDF_ReadItemFile(const QString &path);
 static std::vector<DeviceDescription> DDF_ReadDeviceFile(const QString &path);
+static std::vector<DeviceDescription> DDF_ReadDeviceFiles(const QStringList &paths);
 static DDF_SubDeviceDescriptor DDF_ReadSubDeviceFile(const QString &path);
 static DeviceDescription DDF_MergeGenericItems(const std::vector<DeviceDescription::Item> &genericItems, const DeviceDescription &ddf);
 static DeviceDescription::Item *DDF_GetItemMutable(const ResourceItem *item);
@@ -1355,7 +1378,7 @@ void DeviceDescriptions::readAll()
 
     DBG_MEASURE_START(DDF_ReadAllFiles);
 
-    std::vector<DeviceDescription> descriptions;
+    QStringList deviceFiles;
     std::vector<DeviceDescription::Item> genericItems;
     std::vector<DDF_SubDeviceDescriptor> subDevices;
 
@@ -1404,14 +1427,14 @@ void DeviceDescriptions::readAll()
                 }
                 else
                 {
-                    DBG_Printf(DBG_DDF, "read %s\n", qPrintable(it.fileName()));
-                    std::vector<DeviceDescription> result = DDF_ReadDeviceFile(it.filePath());
-                    std::move(result.begin(), result.end(), std::back_inserter(descriptions));
+                    deviceFiles.push_back(it.filePath());
                 }
             }
         }
     }
 
+    std::vector<DeviceDescription> descriptions = DDF_ReadDeviceFiles(deviceFiles);
+
     if (!genericItems.empty())
     {
         d->genericItems = std::move(genericItems);
@@ -1602,6 +1625,8 @@ static DeviceDescription::Item DDF_ParseItem(const QJsonObject &obj)
         return {};
     }
 
+    std::unique_lock<std::mutex> descriptorLock(ddfDescriptorMutex);
+
     // try to create a dynamic ResourceItemDescriptor
     if (!getResourceItemDescriptor(result.name, result.descriptor))
     {
@@ -1647,7 +1672,10 @@ static DeviceDescription::Item DDF_ParseItem(const QJsonObject &obj)
                 }
                 else
                 {
-                    DBG_Assert(rid.type == DataTypeString || rid.type == DataTypeTime || rid.type == DataTypeTimePattern);
+                    if (rid.type != DataTypeString && rid.type != DataTypeTime && rid.type != DataTypeTimePattern)
+                    {
+                        DDF_Printf(DBG_DDF, "DDF unexpected datatype %s for %s\n", qPrintable(dataType), result.name.c_str());
+                    }
                     rid.qVariantType = QVariant::String;
                 }
             }
@@ -1685,17 +1713,20 @@ static DeviceDescription::Item DDF_ParseItem(const QJsonObject &obj)
                 // TODO ResourceItemDescriptor::flags (push, etc.)
                 if (R_AddResourceItemDescriptor(rid))
                 {
-                    DBG_Printf(DBG_DDF, "DDF added dynamic ResourceItemDescriptor %s\n", result.name.c_str());
+                    DDF_Printf(DBG_DDF, "DDF added dynamic ResourceItemDescriptor %s\n", result.name.c_str());
                 }
             }
         }
         else
         {
-            DBG_Printf(DBG_DDF, "DDF unsupported ResourceItem schema: %s\n", qPrintable(schema));
+            DDF_Printf(DBG_DDF, "DDF unsupported ResourceItem schema: %s\n", qPrintable(schema));
         }
     }
 
-    if (getResourceItemDescriptor(result.name, result.descriptor))
+    const bool hasDescriptor = getResourceItemDescriptor(result.name, result.descriptor);
+    descriptorLock.unlock();
+
+    if (hasDescriptor)
     {
         if (obj.contains(QLatin1String("access")))
         {
@@ -1767,11 +1798,11 @@ static DeviceDescription::Item DDF_ParseItem(const QJsonObject &obj)
             }
         }
 
-        DBG_Printf(DBG_DDF, "DDF loaded resource item descriptor: %s, public: %u\n", result.descriptor.suffix, (result.isPublic ? 1 : 0));
+        DDF_Printf(DBG_DDF, "DDF loaded resource item descriptor: %s, public: %u\n", result.descriptor.suffix, (result.isPublic ? 1 : 0));
     }
     else
     {
-        DBG_Printf(DBG_DDF, "DDF failed to load resource item descriptor: %s\n", result.name.c_str());
+        DDF_Printf(DBG_DDF, "DDF failed to load resource item descriptor: %s\n", result.name.c_str());
     }
 
     return result;
@@ -2141,7 +2172,7 @@ static DeviceDescription DDF_ParseDeviceObject(const QJsonObject &obj, const QSt
     const auto keys = obj.keys();
     for (const auto &key : keys)
     {
-        DBG_Printf(DBG_DDF, "DDF %s: %s\n", qPrintable(key), qPrintable(obj.value(key).toString()));
+        DDF_Printf(DBG_DDF, "DDF %s: %s\n", qPrintable(key), qPrintable(obj.value(key).toString()));
     }
 
     const auto subDevicesArr = subDevices.toArray();
@@ -2387,7 +2418,7 @@ static std::vector<DeviceDescription> DDF_ReadDeviceFile(const QString &path)
 
     if (error.error != QJsonParseError::NoError)
     {
-        DBG_Printf(DBG_DDF, "DDF failed to read %s, err: %s, offset: %d\n", qPrintable(path), qPrintable(error.errorString()), error.offset);
+        DDF_Printf(DBG_DDF, "DDF failed to read %s, err: %s, offset: %d\n", qPrintable(path), qPrintable(error.errorString()), error.offset);
         return result;
     }
 
@@ -2418,6 +2449,77 @@ static std::vector<DeviceDescription> DDF_ReadDeviceFile(const QString &path)
     return result;
 }
 
+/*! Formats a DDF_Printf() message into the log buffer of the current worker thread.
+ */
+static void DDF_LogBuffered(int level, const char *format, ...)
+{
+    if (!DBG_IsEnabled(level))
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    ddfLog->push_back({level, QString::vasprintf(format, args).toUtf8()});
+    va_end(args);
+}
+
+/*! Reads the DDF files \p paths in parallel.
+    Each worker claims the next file and stores its descriptions in the slot of that file,
+    so the result has the same order as \p paths regardless of scheduling.
+    Diagnostics are buffered per file and printed in file order after the workers finished,
+    since DBG_Printf() must only be called from the main thread.
+    \returns Vector of parsed DDF objects.
+ */
+static std::vector<DeviceDescription> DDF_ReadDeviceFiles(const QStringList &paths)
+{
+    std::vector<std::vector<DeviceDescription>> files(size_t(paths.size()));
+    std::vector<std::vector<DDF_LogLine>> logs(size_t(paths.size()));
+    std::atomic<int> next{0};
+
+    const auto work = [&paths, &files, &logs, &next]()
+    {
+        for (int i = next++; i < paths.size(); i = next++)
+        {
+            ddfLog = &logs[size_t(i)];
+            DDF_Printf(DBG_DDF, "read %s\n", qPrintable(paths.at(i)));
+            files[size_t(i)] = DDF_ReadDeviceFile(paths.at(i));
+            ddfLog = nullptr;
+        }
+    };
+
+    const int threadCount = qMin(paths.size(), qBound(1, int(std::thread::hardware_concurrency()), DDF_MAX_READ_THREADS));
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; i++)
+    {
+        threads.emplace_back(work);
+    }
+
+    work(); // the calling thread takes part
+
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    for (const auto &log : logs)
+    {
+        for (const auto &line : log)
+        {
+            DBG_Printf(line.level, "%s", line.text.constData());
+        }
+    }
+
+    std::vector<DeviceDescription> result;
+    for (auto &descriptions : files)
+    {
+        std::move(descriptions.begin(), descriptions.end(), std::back_inserter(result));
+    }
+
+    return result;
+}
+
 /*! Merge common properties like "read", "parse" and "write" functions from generic items into DDF items.
     Only properties which are already defined in the DDF file won't be overwritten.
 
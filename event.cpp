@@ -1,4 +1,5 @@
 #include <array>
+#include <QHash>
 #include "event.h"
 #include "resource.h"
 
@@ -23,6 +24,136 @@ quint16 allocDataBuffer()
     return int(_eventDataIter);
 }
 
+/*! Event ids are stored as 32-bit handle to keep Event free of heap allocations.
+
+    0                        empty id
+    EventIdNumeric | n       canonical decimal id like "12", stored inline
+    generation | slot        slot in the table of interned ids, e.g. uniqueids
+
+    The table has a fixed size and slots are recycled round robin like the event data buffers,
+    the generation invalidates handles of recycled slots.
+ */
+constexpr quint32 EventIdNumeric = 0x80000000;
+constexpr int EventIdSlotBits = 12;
+constexpr quint32 MaxEventIds = 1 << EventIdSlotBits;
+constexpr quint32 EventIdSlotMask = MaxEventIds - 1;
+constexpr quint32 MaxEventIdGeneration = EventIdNumeric >> EventIdSlotBits;
+
+struct EventIdSlot
+{
+    quint32 handle = 0;
+    QString id;
+};
+
+static quint32 _eventIdIter = 0;
+static QHash<QString, quint32> _eventIdHandles;
+static EventIdSlot _eventIdSlots[MaxEventIds];
+
+/*! Returns the handle for an event \p id.
+    Non numeric ids are interned on first use, later calls don't allocate.
+ */
+quint32 EventIdHandle(const QString &id)
+{
+    if (id.isEmpty())
+    {
+        return 0;
+    }
+
+    if (id.size() <= 9 && (id.size() == 1 || id.at(0) != QLatin1Char('0')))
+    {
+        quint32 num = 0;
+        int i = 0;
+
+        for (; i < id.size(); i++)
+        {
+            const ushort c = id.at(i).unicode();
+            if (c < '0' || c > '9')
+            {
+                break;
+            }
+            num = num * 10 + (c - '0');
+        }
+
+        if (i == id.size())
+        {
+            return EventIdNumeric | num;
+        }
+    }
+
+    const auto i = _eventIdHandles.constFind(id);
+    if (i != _eventIdHandles.cend())
+    {
+        return i.value();
+    }
+
+    // recycle the oldest slot, events still referring to it get an empty id
+    const quint32 slot = _eventIdIter;
+    _eventIdIter = (_eventIdIter + 1) & EventIdSlotMask;
+
+    EventIdSlot &entry = _eventIdSlots[slot];
+    if (!entry.id.isEmpty())
+    {
+        _eventIdHandles.remove(entry.id);
+    }
+
+    quint32 generation = (entry.handle >> EventIdSlotBits) + 1;
+    if (generation >= MaxEventIdGeneration)
+    {
+        generation = 1;
+    }
+
+    entry.handle = generation << EventIdSlotBits | slot;
+    entry.id = id;
+    _eventIdHandles.insert(id, entry.handle);
+    return entry.handle;
+}
+
+/*! Returns the id string for a \p handle created by EventIdHandle().
+ */
+QString EventIdString(quint32 handle)
+{
+    if (handle & EventIdNumeric)
+    {
+        return QString::number(handle & ~EventIdNumeric);
+    }
+
+    if (handle > 0 && _eventIdSlots[handle & EventIdSlotMask].handle == handle)
+    {
+        return _eventIdSlots[handle & EventIdSlotMask].id;
+    }
+
+    return {};
+}
+
+/*! Resource prefixes are stored as index into a small table to keep Event at 32 bytes.
+    The prefixes are the few RSensors, RLights, ... constants, index 0 is reserved for nullptr.
+ */
+constexpr int MaxEventResources = 32;
+static int _eventResourceCount = 1;
+static const char *_eventResources[MaxEventResources] = { nullptr };
+
+/*! Returns the index of the \p resource prefix, which is registered on first use.
+ */
+quint8 EventResourceIndex(const char *resource)
+{
+    for (int i = 0; i < _eventResourceCount; i++)
+    {
+        if (_eventResources[i] == resource)
+        {
+            return quint8(i);
+        }
+    }
+
+    Q_ASSERT(_eventResourceCount < MaxEventResources);
+    if (_eventResourceCount == MaxEventResources)
+    {
+        return 0;
+    }
+
+    _eventResources[_eventResourceCount] = resource;
+    return quint8(_eventResourceCount++);
+}
+
 #ifdef DECONZ_DEBUG_BUILD
 /*! Verify that ZCL packing functions work as expected
     TODO(mpi) move to separate testing code.
@@ -51,12 +182,12 @@ Event::Event()
 }
 
 Event::Event(const char *resource, const char *what, const QString &id, ResourceItem *item, DeviceKey deviceKey) :
-    m_resource(resource),
     m_what(what),
-    m_id(id),
     m_num(0),
     m_numPrev(0),
     m_deviceKey(deviceKey),
+    m_idHandle(EventIdHandle(id)),
+    m_resourceIndex(EventResourceIndex(resource)),
     m_hasData(0),
     m_urgent(0)
 {
@@ -71,12 +202,12 @@ Event::Event(const char *resource, const char *what, const QString &id, Resource
 /*! Constructor.
  */
 Event::Event(const char *resource, const char *what, const QString &id, DeviceKey deviceKey) :
-    m_resource(resource),
     m_what(what),
-    m_id(id),
     m_num(0),
     m_numPrev(0),
     m_deviceKey(deviceKey),
+    m_idHandle(EventIdHandle(id)),
+    m_resourceIndex(EventResourceIndex(resource)),
     m_hasData(0),
     m_urgent(0)
 {
@@ -86,12 +217,12 @@ Event::Event(const char *resource, const char *what, const QString &id, DeviceKe
 /*! Constructor.
  */
 Event::Event(const char *resource, const char *what, const QString &id, int num, DeviceKey deviceKey) :
-    m_resource(resource),
     m_what(what),
-    m_id(id),
     m_num(num),
     m_numPrev(0),
     m_deviceKey(deviceKey),
+    m_idHandle(EventIdHandle(id)),
+    m_resourceIndex(EventResourceIndex(resource)),
     m_hasData(0),
     m_urgent(0)
 {
@@ -101,24 +232,24 @@ Event::Event(const char *resource, const char *what, const QString &id, int num,
 /*! Constructor.
  */
 Event::Event(const char *resource, const char *what, int num, DeviceKey deviceKey) :
-    m_resource(resource),
     m_what(what),
     m_num(num),
     m_numPrev(0),
     m_deviceKey(deviceKey),
+    m_resourceIndex(EventResourceIndex(resource)),
     m_hasData(0),
     m_urgent(0)
 {
-    if (resource == RGroups)
+    if (resource == RGroups && num >= 0)
     {
-        m_id = QString::number(num);
+        m_idHandle = EventIdNumeric | quint32(num);
     }
 }
 
 Event::Event(const char *resource, const char *what, const void *data, size_t size, DeviceKey deviceKey) :
-    m_resource(resource),
     m_what(what),
     m_deviceKey(deviceKey),
+    m_resourceIndex(EventResourceIndex(resource)),
     m_hasData(1),
     m_urgent(0)
 {
@@ -132,6 +263,20 @@ Event::Event(const char *resource, const char *what, const void *data, size_t si
     memcpy(_eventData[m_dataIndex].data, data, size);
 }
 
+/*! Returns the resource prefix like RSensors.
+ */
+const char *Event::resource() const
+{
+    return _eventResources[m_resourceIndex];
+}
+
+/*! Returns the resource id, either the numeric id or uniqueid.
+ */
+QString Event::id() const
+{
+    return EventIdString(m_idHandle);
+}
+
 bool Event::hasData() const
 {
     if (m_hasData != 1) { return false; }
@@ -153,3 +298,110 @@ bool Event::getData(void *dst, size_t size) const
 
     return false;
 }
+
+/*! Returns a hash over the fields compared by EventIsDuplicate().
+    The data fields are left out since hasData() becomes false when the data buffer is recycled.
+ */
+uint EventHash(const Event &event)
+{
+    uint h = qHash(event.idHandle());
+    h = h * 31 + qHash(event.deviceKey());
+    h = h * 31 + qHash(reinterpret_cast<quintptr>(event.resource()));
+    h = h * 31 + qHash(reinterpret_cast<quintptr>(event.what()));
+    h = h * 31 + qHash(event.num());
+    return h;
+}
+
+/*! Returns true if \p a and \p b describe the same event.
+ */
+bool EventIsDuplicate(const Event &a, const Event &b)
+{
+    if (a.deviceKey() != b.deviceKey()) { return false; }
+    if (a.resource() != b.resource()) { return false; }
+    if (a.what() != b.what()) { return false; }
+    if (a.num() != b.num()) { return false; }
+    if (a.idHandle() != b.idHandle()) { return false; }
+    if (a.hasData() != b.hasData()) { return false; }
+    if (a.hasData() && a.dataSize() != b.dataSize()) { return false; }
+
+    return true;
+}
+
+/*! Constructor, \p capacity is rounded up to the next power of two.
+ */
+EventRingBuffer::EventRingBuffer(quint32 capacity)
+{
+    quint32 size = 2;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+
+    m_entries.resize(size);
+    m_mask = size - 1;
+}
+
+/*! Appends \p event to the queue.
+    \returns false if the queue is full.
+ */
+bool EventRingBuffer::push(const Event &event, quint32 order, qint64 time)
+{
+    if (size() == capacity())
+    {
+        return false;
+    }
+
+    Entry &entry = m_entries[m_tail & m_mask];
+    entry.event = event;
+    entry.order = order;
+    entry.time = time;
+    m_tail++;
+    return true;
+}
+
+/*! Doubles the capacity, pending events keep their sequence numbers.
+ */
+void EventRingBuffer::grow()
+{
+    std::vector<Entry> entries(m_entries.size() * 2);
+    const quint32 mask = quint32(entries.size()) - 1;
+
+    for (quint32 seq = m_head; seq != m_tail; seq++)
+    {
+        entries[seq & mask] = m_entries[seq & m_mask];
+    }
+
+    m_entries.swap(entries);
+    m_mask = mask;
+}
+
+/*! Returns true if a duplicate of \p event is pending in \p queue.
+ */
+bool EventPendingIndex::contains(const Event &event, const EventRingBuffer &queue) const
+{
+    const uint h = EventHash(event);
+
+    for (auto i = m_index.constFind(h); i != m_index.cend() && i.key() == h; ++i)
+    {
+        if (queue.isPending(i.value()) && EventIsDuplicate(event, queue.at(i.value())))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Adds \p event which is stored at sequence number \p seq in the queue.
+ */
+void EventPendingIndex::insert(const Event &event, quint32 seq)
+{
+    m_index.insert(EventHash(event), seq);
+}
+
+/*! Removes \p event at sequence number \p seq, must be called when the event is taken from the queue.
+ */
+void EventPendingIndex::remove(const Event &event, quint32 seq)
+{
+    m_index.remove(EventHash(event), seq);
+}
@@ -1,7 +1,10 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include <QMultiHash>
 #include <QString>
+#include <type_traits>
+#include <vector>
 #include "device.h"
 
 class Resource;
@@ -20,9 +23,10 @@ public:
     //! Don't call following ctor directly use EventWithData() factory function.
     Event(const char *resource, const char *what, const void *data, size_t size, DeviceKey deviceKey = 0);
 
-    const char *resource() const { return m_resource; }
+    const char *resource() const;
     const char *what() const { return m_what; }
-    const QString &id() const { return m_id; }
+    QString id() const;
+    quint32 idHandle() const { return m_idHandle; }
     int num() const { return m_num; }
     int numPrevious() const { return m_numPrev; }
     DeviceKey deviceKey() const { return m_deviceKey; }
@@ -34,9 +38,7 @@ public:
     void setUrgent(bool urgent) { m_urgent = urgent ? 1 : 0; }
 
 private:
-    const char *m_resource = nullptr;
     const char *m_what = nullptr;
-    QString m_id;
     union
     {
         struct
@@ -53,6 +55,8 @@ private:
         };
     };
     DeviceKey m_deviceKey = 0;
+    quint32 m_idHandle = 0; // see EventIdHandle()
+    quint8 m_resourceIndex = 0; // see EventResourceIndex()
     struct
     {
         unsigned char m_hasData : 1;
@@ -61,6 +65,73 @@ private:
     };
 };
 
+// Events are copied by value into the EventEmitter queues, keep them free of heap allocations.
+static_assert(std::is_trivially_copyable<Event>::value, "Event needs to be trivially copyable");
+static_assert(sizeof(Event) <= 32, "Event needs to fit into 32 bytes");
+
+quint32 EventIdHandle(const QString &id);
+QString EventIdString(quint32 handle);
+quint8 EventResourceIndex(const char *resource);
+
+/*! \class EventRingBuffer
+
+    FIFO queue of events without per event allocations.
+    Entries are addressed by a monotonic 32-bit sequence number which wraps around.
+    The capacity only changes by grow(), which keeps the sequence numbers of pending events.
+ */
+class EventRingBuffer
+{
+public:
+    explicit EventRingBuffer(quint32 capacity);
+    bool push(const Event &event, quint32 order = 0, qint64 time = 0);
+    void grow();
+    void pop() { Q_ASSERT(!empty()); m_head++; }
+    void clear() { m_head = m_tail = 0; }
+    const Event &front() const { return m_entries[m_head & m_mask].event; }
+    quint32 frontOrder() const { return m_entries[m_head & m_mask].order; }
+    qint64 frontTime() const { return m_entries[m_head & m_mask].time; }
+    bool empty() const { return m_head == m_tail; }
+    quint32 size() const { return m_tail - m_head; }
+    quint32 capacity() const { return m_mask + 1; }
+    quint32 tailSeq() const { return m_tail; }
+    bool isPending(quint32 seq) const { return quint32(seq - m_head) < size(); }
+    const Event &at(quint32 seq) const { return m_entries[seq & m_mask].event; }
+
+private:
+    struct Entry
+    {
+        Event event;
+        quint32 order; // global enqueue order across multiple queues
+        qint64 time; // LAT_Now() of the origin, kept out of Event to fit it into 32 bytes
+    };
+
+    std::vector<Entry> m_entries;
+    quint32 m_mask = 0;
+    quint32 m_head = 0;
+    quint32 m_tail = 0;
+};
+
+/*! \class EventPendingIndex
+
+    Hash index over the pending events of a queue to detect duplicates in O(1).
+    The index stores queue sequence numbers, candidates with equal hash are verified by EventIsDuplicate().
+ */
+class EventPendingIndex
+{
+public:
+    bool contains(const Event &event, const EventRingBuffer &queue) const;
+    void insert(const Event &event, quint32 seq);
+    void remove(const Event &event, quint32 seq);
+    void clear() { m_index.clear(); }
+    int size() const { return m_index.size(); }
+
+private:
+    QMultiHash<uint, quint32> m_index; // EventHash() -> sequence number in queue
+};
+
+uint EventHash(const Event &event);
+bool EventIsDuplicate(const Event &a, const Event &b);
+
 template <typename D>
 Event EventWithData(const char *resource, const char *what, const D &data, DeviceKey deviceKey)
 {
@@ -11,35 +11,39 @@
 #include <QTimer>
 #include <QElapsedTimer>
 #include "event_emitter.h"
+#include "latency_histogram.h"
 #include "rest_node_base.h"
 #include "de_web_plugin_private.h"
 
 static EventEmitter *instance_ = nullptr;
 
-static bool isDuplicate(size_t pos, const std::vector<Event> &queue, const Event &e)
-{
-    for (size_t i = pos; i < queue.size(); i++)
-    {
-        const Event &x = queue[i];
+constexpr quint32 UrgentQueueCapacity = 512;
+constexpr quint32 QueueCapacity = 4096;
+// full queues grow up to this capacity, only then events are dropped
+constexpr quint32 MaxQueueCapacity = 65536;
 
-        if (e.deviceKey() != x.deviceKey()) {continue;}
-        if (e.resource() != x.resource()) continue;
-        if (e.what() != x.what()) continue;
-        if (e.num() != x.num()) continue;
-        if (e.id() != x.id()) continue;
-        if (e.hasData() != x.hasData()) continue;
-        if (e.hasData() && e.dataSize() != x.dataSize()) continue;
+// default time budget per processing iteration in milliseconds
+constexpr int UrgentBudgetMs = 4;
+constexpr int DeviceBudgetMs = 3;
+constexpr int ResourceBudgetMs = 3;
 
-        return true;
+static EventClass eventClass(const Event &event)
+{
+    if (event.isUrgent())
+    {
+        return EventClassUrgent;
     }
 
-    return false;
+    return event.resource() == RDevices ? EventClassDevice : EventClassResource;
 }
 
 EventEmitter::EventEmitter(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    m_queues{EventRingBuffer(UrgentQueueCapacity), EventRingBuffer(QueueCapacity), EventRingBuffer(QueueCapacity)}
 {
-    m_queue.reserve(64);
+    setBudget(EventClassUrgent, UrgentBudgetMs);
+    setBudget(EventClassDevice, DeviceBudgetMs);
+    setBudget(EventClassResource, ResourceBudgetMs);
 
     m_timer = new QTimer(this);
     m_timer->setSingleShot(true);
@@ -50,10 +54,84 @@ EventEmitter::EventEmitter(QObject *parent) :
     instance_ = this;
 }
 
+/*! Sets the time budget of an event class per processing iteration.
+    At least one event of each class is processed per iteration.
+ */
+void EventEmitter::setBudget(EventClass ec, int budgetMs)
+{
+    Q_ASSERT(ec < EventClassMax);
+    m_budgetNs[ec] = qint64(qMax(budgetMs, 1)) * 1000000;
+}
+
+int EventEmitter::budget(EventClass ec) const
+{
+    Q_ASSERT(ec < EventClassMax);
+    return int(m_budgetNs[ec] / 1000000);
+}
+
+quint32 EventEmitter::capacity(EventClass ec) const
+{
+    Q_ASSERT(ec < EventClassMax);
+    return m_queues[ec].capacity();
+}
+
+void EventEmitter::resetStats()
+{
+    m_stats = { };
+
+    for (int ec = 0; ec < EventClassMax; ec++)
+    {
+        m_stats.queues[ec].depth = m_queues[ec].size();
+        m_stats.queues[ec].highWater = m_queues[ec].size();
+    }
+}
+
+void EventEmitter::push(EventClass ec, const Event &event, qint64 time)
+{
+    EventRingBuffer &queue = m_queues[ec];
+    EventQueueStats &stats = m_stats.queues[ec];
+
+    if (ec != EventClassUrgent && m_pending[ec].contains(event, queue))
+    {
+        stats.duplicates++;
+        return;
+    }
+
+    const quint32 seq = queue.tailSeq();
+
+    if (queue.size() == queue.capacity() && queue.capacity() < MaxQueueCapacity)
+    {
+        // device state machines rely on every event (timeouts, APS confirms), don't drop them on bursts
+        queue.grow();
+        stats.grown++;
+        DBG_Printf(DBG_INFO, "event queue %d full, grow capacity to %u\n", int(ec), queue.capacity());
+    }
+
+    if (!queue.push(event, m_order, time))
+    {
+        stats.dropped++;
+        DBG_Printf(DBG_ERROR, "event queue %d full, drop event %s/%s\n", int(ec), event.resource(), event.what());
+        return;
+    }
+
+    m_order++;
+
+    if (ec != EventClassUrgent)
+    {
+        m_pending[ec].insert(event, seq);
+    }
+
+    stats.depth = queue.size();
+    stats.highWater = qMax(stats.highWater, stats.depth);
+}
+
 void EventEmitter::enqueueEvent(const Event &event)
 {
     RestNodeBase *restNode = nullptr;
 
+    // events created while an APS indication is processed carry its arrival time
+    const qint64 time = LAT_Origin() != 0 ? LAT_Origin() : LAT_Now();
+
     // workaround to attach DeviceKey to an event
     // TODO DDF remove dependency on plugin
     if (event.deviceKey() == 0 && (event.resource() == RSensors || event.resource() == RLights))
@@ -74,23 +152,17 @@ void EventEmitter::enqueueEvent(const Event &event)
 
     if (event.isUrgent())
     {
-        m_urgentQueue.push_back(event);
+        push(EventClassUrgent, event, time);
+    }
+    else if (restNode && restNode->address().ext() > 0)
+    {
+        Event e2 = event;
+        e2.setDeviceKey(restNode->address().ext());
+        push(eventClass(e2), e2, time);
     }
     else
     {
-        if (restNode && restNode->address().ext() > 0)
-        {
-            Event e2 = event;
-            e2.setDeviceKey(restNode->address().ext());
-            if (!isDuplicate(m_pos, m_queue, e2))
-            {
-                m_queue.push_back(e2);
-            }
-        }
-        else if (!isDuplicate(m_pos, m_queue, event))
-        {
-            m_queue.push_back(event);
-        }
+        push(eventClass(event), event, time);
     }
 
     if (!m_timer->isActive())
@@ -104,51 +176,114 @@ EventEmitter::~EventEmitter()
     instance_ = nullptr;
 }
 
+/*! Takes the next event of class \p ec from its queue and emits it.
+ */
+void EventEmitter::processNext(EventClass ec)
+{
+    EventRingBuffer &queue = m_queues[ec];
+    Q_ASSERT(!queue.empty());
+
+    // create a copy of the event, the slot can be reused by events enqueued during processing
+    const quint32 seq = queue.tailSeq() - queue.size();
+    const Event ev = queue.front();
+    const qint64 time = queue.frontTime();
+    queue.pop();
+
+    if (ec != EventClassUrgent)
+    {
+        m_pending[ec].remove(ev, seq);
+        if (queue.empty())
+        {
+            m_pending[ec].clear();
+        }
+    }
+
+    m_stats.queues[ec].depth = queue.size();
+    m_stats.queues[ec].processed++;
+
+    const qint64 prevTime = m_eventTime; // eventNotify() may process events recursively
+    m_eventTime = time;
+    emit eventNotify(ev);
+    m_eventTime = prevTime;
+}
+
+/*! Processes queued events until the queues are empty or the budgets of all classes are used up.
+
+    Urgent events are processed before any other event. Device and resource events are processed in
+    the order they were enqueued, unless the budget of one class is used up, then only the other class
+    continues.
+ */
 void EventEmitter::process()
 {
     QElapsedTimer t;
     t.start();
 
-    while (t.elapsed() < 10 && (m_urgentQueue.size() || m_queue.size()))
+    qint64 spentNs[EventClassMax] = { };
+    EventRingBuffer &urgent = m_queues[EventClassUrgent];
+    EventRingBuffer &device = m_queues[EventClassDevice];
+    EventRingBuffer &resource = m_queues[EventClassResource];
+
+    for (;;)
     {
-        size_t i = 0;
-        while (i < m_urgentQueue.size())
+        while (!urgent.empty() && spentNs[EventClassUrgent] < m_budgetNs[EventClassUrgent])
         {
-            // create a copy of the event, m_queue can be realloced during processing
-            // which would invalidate the event reference
-            const Event ev = m_urgentQueue[i];
-            emit eventNotify(ev);
-            i++;
+            const qint64 t0 = t.nsecsElapsed();
+            processNext(EventClassUrgent);
+            spentNs[EventClassUrgent] += t.nsecsElapsed() - t0;
+        }
 
-            if (i == m_urgentQueue.size())
-            {
-                m_urgentQueue.clear();
-                break;
-            }
+        const bool deviceReady = !device.empty() && spentNs[EventClassDevice] < m_budgetNs[EventClassDevice];
+        const bool resourceReady = !resource.empty() && spentNs[EventClassResource] < m_budgetNs[EventClassResource];
+
+        EventClass ec;
+
+        if (deviceReady && resourceReady)
+        {
+            // wrap around safe comparison of the enqueue order
+            ec = qint32(device.frontOrder() - resource.frontOrder()) < 0 ? EventClassDevice : EventClassResource;
         }
+        else if (deviceReady)
+        {
+            ec = EventClassDevice;
+        }
+        else if (resourceReady)
+        {
+            ec = EventClassResource;
+        }
+        else
+        {
+            break;
+        }
+
+        const qint64 t0 = t.nsecsElapsed();
+        processNext(ec);
+        spentNs[ec] += t.nsecsElapsed() - t0;
+    }
 
-        DBG_Assert(m_urgentQueue.empty());
-        if (m_pos < m_queue.size())
+    for (int ec = 0; ec < EventClassMax; ec++)
+    {
+        if (!m_queues[ec].empty())
         {
-            m_pos++;
-            const Event ev = m_queue[m_pos - 1];
-            emit eventNotify(ev);
-            if (m_pos == m_queue.size())
-            {
-                m_queue.clear();
-                m_pos = 0;
-            }
+            m_stats.queues[ec].deferred++;
         }
     }
+
+    m_stats.iterations++;
+    m_stats.lastIterationUs = t.nsecsElapsed() / 1000;
+    m_stats.maxIterationUs = qMax(m_stats.maxIterationUs, m_stats.lastIterationUs);
 }
 
 void EventEmitter::timerFired()
 {
     process();
 
-    if (!m_queue.empty() && !m_timer->isActive())
+    for (const EventRingBuffer &queue : m_queues)
     {
-        m_timer->start();
+        if (!queue.empty() && !m_timer->isActive())
+        {
+            m_timer->start();
+            break;
+        }
     }
 }
 
@@ -19,6 +19,36 @@ class QTimer;
 
 void enqueueEvent(const Event &event);
 
+/*! Events are queued per class, each class has its own time budget per processing iteration.
+ */
+enum EventClass
+{
+    EventClassUrgent,   //! Event::isUrgent(), processed before any other event
+    EventClassDevice,   //! RDevices events driving the Device state machines
+    EventClassResource, //! sensor, light, group, ... events driving rules and websocket notifications
+
+    EventClassMax
+};
+
+struct EventQueueStats
+{
+    quint32 depth = 0;       //! current number of queued events
+    quint32 highWater = 0;   //! max. number of queued events
+    quint64 processed = 0;
+    quint64 duplicates = 0;  //! events not queued since an equal event was pending
+    quint64 grown = 0;       //! times the queue capacity was doubled since the queue was full
+    quint64 dropped = 0;     //! events not queued since the queue was full at max. capacity
+    quint64 deferred = 0;    //! iterations which left events in the queue since the budget was used up
+};
+
+struct EventEmitterStats
+{
+    EventQueueStats queues[EventClassMax];
+    quint64 iterations = 0;
+    qint64 lastIterationUs = 0;
+    qint64 maxIterationUs = 0;
+};
+
 class EventEmitter : public QObject
 {
     Q_OBJECT
@@ -26,6 +56,12 @@ class EventEmitter : public QObject
 public:
     explicit EventEmitter(QObject *parent = nullptr);
     ~EventEmitter();
+    void setBudget(EventClass ec, int budgetMs);
+    int budget(EventClass ec) const;
+    quint32 capacity(EventClass ec) const;
+    const EventEmitterStats &stats() const { return m_stats; }
+    qint64 eventTime() const { return m_eventTime; }
+    void resetStats();
 
 public Q_SLOTS:
     void process();
@@ -36,10 +72,16 @@ Q_SIGNALS:
     void eventNotify(const Event&);
 
 private:
-    size_t m_pos = 0;
+    void push(EventClass ec, const Event &event, qint64 time);
+    void processNext(EventClass ec);
+
     QTimer *m_timer = nullptr;
-    std::vector<Event> m_queue;
-    std::vector<Event> m_urgentQueue;
+    quint32 m_order = 0; // global enqueue order to keep device and resource events in sequence
+    qint64 m_eventTime = 0; // enqueue time of the event currently emitted, 0 outside of eventNotify()
+    EventRingBuffer m_queues[EventClassMax];
+    EventPendingIndex m_pending[EventClassMax]; // duplicate detection
+    qint64 m_budgetNs[EventClassMax];
+    EventEmitterStats m_stats;
 };
 
 #endif // EVENT_EMITTER_H
@@ -8,16 +8,19 @@ void DeRestPluginPrivate::handleEvent(const Event &e)
 {
     if (e.resource() == RSensors)
     {
+        fullStateCache.invalidate(FullStateCache::SectionSensors, e.id());
         handleSensorEvent(e);
         AS_HandleAlarmSystemDeviceEvent(e, alarmSystemDeviceTable.get(), eventEmitter);
     }
     else if (e.resource() == RLights)
     {
+        fullStateCache.invalidate(FullStateCache::SectionLights, e.id());
         handleLightEvent(e);
         AS_HandleAlarmSystemDeviceEvent(e, alarmSystemDeviceTable.get(), eventEmitter);
     }
     else if (e.resource() == RGroups)
     {
+        fullStateCache.invalidate(FullStateCache::SectionGroups, e.id());
         handleGroupEvent(e);
     }
     else if (e.resource() == RAlarmSystems || e.what() == REventDeviceAlarm)
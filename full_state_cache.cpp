@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "full_state_cache.h"
+
+/*! Returns the cached fragment of resource \p id or nullptr if it must be serialized again.
+ */
+const FullStateFragment *FullStateCache::find(Section section, const QString &id, const QString &etag, const QString &variant)
+{
+    Q_ASSERT(section < SectionMax);
+
+    const auto i = m_fragments[section].constFind(id);
+    if (i != m_fragments[section].cend() && i->etag == etag && i->variant == variant)
+    {
+        m_hits++;
+        return &i.value();
+    }
+
+    m_misses++;
+    return nullptr;
+}
+
+/*! Stores the serialized \p json of resource \p id, replaces the previous fragment.
+ */
+const FullStateFragment *FullStateCache::insert(Section section, const QString &id, const QString &etag, const QString &variant, const QByteArray &json)
+{
+    Q_ASSERT(section < SectionMax);
+
+    FullStateFragment &frag = m_fragments[section][id];
+    frag.etag = etag;
+    frag.variant = variant;
+    frag.json = QByteArray(json.constData(), json.size()); // deep copy, callers reuse their buffer
+    return &frag;
+}
+
+/*! Drops the fragment of resource \p id, if \p id is empty the whole section.
+ */
+void FullStateCache::invalidate(Section section, const QString &id)
+{
+    Q_ASSERT(section < SectionMax);
+
+    if (id.isEmpty())
+    {
+        m_fragments[section].clear();
+    }
+    else
+    {
+        m_fragments[section].remove(id);
+    }
+}
+
+void FullStateCache::clear()
+{
+    for (auto &fragments : m_fragments)
+    {
+        fragments.clear();
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef FULL_STATE_CACHE_H
+#define FULL_STATE_CACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+/*! Serialized JSON object of one resource in GET /api/<apikey>. */
+struct FullStateFragment
+{
+    QString etag;    // resource etag at serialization time
+    QString variant; // request properties which influence the output
+    QByteArray json;
+};
+
+/*! \class FullStateCache
+
+    Keeps the serialized JSON of lights, groups and sensors for the full state
+    response, so that only resources which changed are serialized again.
+
+    A fragment is valid as long as the resource etag and the request variant
+    (API mode and version) are unchanged and no event invalidated it. Events
+    are delivered to invalidate() before they reach the resource handlers.
+    Fragments of deleted resources are dropped when the full state is built.
+ */
+class FullStateCache
+{
+public:
+    enum Section
+    {
+        SectionLights,
+        SectionGroups,
+        SectionSensors,
+        SectionMax
+    };
+
+    const FullStateFragment *find(Section section, const QString &id, const QString &etag, const QString &variant);
+    const FullStateFragment *insert(Section section, const QString &id, const QString &etag, const QString &variant, const QByteArray &json);
+    void invalidate(Section section, const QString &id);
+    void clear();
+
+    quint64 hits() const { return m_hits; }
+    quint64 misses() const { return m_misses; }
+
+private:
+    QHash<QString, FullStateFragment> m_fragments[SectionMax];
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+};
+
+#endif // FULL_STATE_CACHE_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "http_connections.h"
+
+/*! Registers a request on the connection of \p sock.
+    The connection is kept open for at least \p timeout seconds. When the
+    connection reached MaxRequests it will be closed after the response.
+    \return true if the connection is new
+ */
+bool HttpConnectionManager::addRequest(QTcpSocket *sock, int timeout)
+{
+    m_totalRequests++;
+
+    auto i = m_connections.find(sock);
+    const bool isNew = i == m_connections.end();
+
+    if (isNew)
+    {
+        HttpConnection con;
+        con.sock = sock;
+        i = m_connections.insert(sock, con);
+    }
+
+    HttpConnection &con = i.value();
+    if (con.closing)
+    {
+        return isNew;
+    }
+
+    con.requests++;
+
+    if (!keepAlive(con))
+    {
+        schedule(con, m_now + 1);
+    }
+    else if (isNew || con.expires < m_now + timeout)
+    {
+        schedule(con, m_now + timeout);
+    }
+
+    return isNew;
+}
+
+/*! Sets the idle timeout of an open connection, e.g. for authorised clients.
+ */
+void HttpConnectionManager::extend(QTcpSocket *sock, int timeout)
+{
+    auto i = m_connections.find(sock);
+    if (i != m_connections.end() && !i->closing && keepAlive(*i))
+    {
+        schedule(*i, m_now + timeout);
+    }
+}
+
+/*! Removes the connection, called when the socket is destroyed.
+ */
+void HttpConnectionManager::remove(QTcpSocket *sock)
+{
+    auto i = m_connections.find(sock);
+    if (i != m_connections.end())
+    {
+        if (i->slot >= 0)
+        {
+            m_wheel[i->slot].remove(sock);
+        }
+        m_connections.erase(i);
+    }
+}
+
+/*! Advances the wheel by one second.
+    \return all sockets which are expired and should be closed now
+ */
+std::vector<QTcpSocket*> HttpConnectionManager::tick()
+{
+    std::vector<QTcpSocket*> result;
+
+    m_now++;
+    const int slot = int(m_now % WheelSize);
+
+    QSet<QTcpSocket*> due;
+    due.swap(m_wheel[slot]);
+
+    for (QTcpSocket *sock : due)
+    {
+        auto i = m_connections.find(sock);
+        if (i == m_connections.end())
+        {
+            continue;
+        }
+
+        HttpConnection &con = *i;
+        con.slot = -1;
+
+        if (con.expires > m_now)
+        {
+            schedule(con, con.expires); // next rotation
+        }
+        else if (!con.closing)
+        {
+            con.closing = true;
+            m_totalClosed++;
+            result.push_back(sock);
+            schedule(con, m_now + ClosedRetention);
+        }
+        else
+        {
+            m_connections.erase(i); // socket wasn't destroyed in time
+        }
+    }
+
+    return result;
+}
+
+const HttpConnection *HttpConnectionManager::connection(QTcpSocket *sock) const
+{
+    auto i = m_connections.constFind(sock);
+    return i != m_connections.cend() ? &i.value() : nullptr;
+}
+
+bool HttpConnectionManager::keepAlive(const HttpConnection &con) const
+{
+    return !con.closing && con.requests < MaxRequests;
+}
+
+/*! Returns the Connection and Keep-Alive response headers for \p sock.
+ */
+QByteArray HttpConnectionManager::connectionHeaders(QTcpSocket *sock) const
+{
+    const HttpConnection *con = connection(sock);
+
+    if (!con || !keepAlive(*con))
+    {
+        return QByteArray("Connection: close\r\n");
+    }
+
+    QByteArray result("Connection: keep-alive\r\nKeep-Alive: timeout=");
+    result += QByteArray::number(con->expires - m_now);
+    result += ", max=";
+    result += QByteArray::number(MaxRequests - con->requests);
+    result += "\r\n";
+    return result;
+}
+
+void HttpConnectionManager::schedule(HttpConnection &con, qint64 expires)
+{
+    if (expires <= m_now)
+    {
+        expires = m_now + 1; // the current slot is already processed
+    }
+
+    const int slot = int(expires % WheelSize);
+
+    if (con.slot != slot)
+    {
+        if (con.slot >= 0)
+        {
+            m_wheel[con.slot].remove(con.sock);
+        }
+        m_wheel[slot].insert(con.sock);
+        con.slot = slot;
+    }
+
+    con.expires = expires;
+}
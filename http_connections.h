@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef HTTP_CONNECTIONS_H
+#define HTTP_CONNECTIONS_H
+
+#include <vector>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+
+class QTcpSocket;
+
+/*! State of one REST API client connection. */
+struct HttpConnection
+{
+    QTcpSocket *sock = nullptr;
+    qint64 expires = 0;   // tick at which the connection is closed
+    int requests = 0;     // requests handled on this connection
+    int slot = -1;        // timer wheel slot
+    bool closing = false; // closed, waiting for the socket to be destroyed
+};
+
+/*! \class HttpConnectionManager
+
+    Keeps track of open REST API client connections and closes idle ones.
+
+    Connections are kept in a hash table and in a timer wheel with one slot per
+    second, tick() must be called once per second. All connections which are
+    expired in the current slot are returned at once, connections with a
+    timeout larger than the wheel are checked again after each rotation.
+
+    After a socket is closed its entry is kept until the socket is destroyed,
+    stale entries are dropped after ClosedRetention seconds.
+ */
+class HttpConnectionManager
+{
+public:
+    enum Constants
+    {
+        WheelSize = 64,
+        IdleTimeout = 60,     // seconds
+        MaxRequests = 100,    // per connection
+        ClosedRetention = 120 // seconds
+    };
+
+    bool addRequest(QTcpSocket *sock, int timeout);
+    void extend(QTcpSocket *sock, int timeout);
+    void remove(QTcpSocket *sock);
+    std::vector<QTcpSocket*> tick();
+
+    const HttpConnection *connection(QTcpSocket *sock) const;
+    bool keepAlive(const HttpConnection &con) const;
+    QByteArray connectionHeaders(QTcpSocket *sock) const;
+
+    const QHash<QTcpSocket*, HttpConnection> &connections() const { return m_connections; }
+    quint64 totalRequests() const { return m_totalRequests; }
+    quint64 totalClosed() const { return m_totalClosed; }
+
+private:
+    void schedule(HttpConnection &con, qint64 expires);
+
+    QHash<QTcpSocket*, HttpConnection> m_connections;
+    QSet<QTcpSocket*> m_wheel[WheelSize];
+    qint64 m_now = 0;
+    quint64 m_totalRequests = 0;
+    quint64 m_totalClosed = 0;
+};
+
+#endif // HTTP_CONNECTIONS_H
@@ -512,7 +512,7 @@ void DeRestPluginPrivate::processIasZoneStatus(Sensor *sensor, quint16 zoneStatu
     sensor->updateStateTimestamp();
     enqueueEvent(Event(RSensors, RStateLastUpdated, sensor->id()));
 
-    updateEtag(sensor->etag);
+    updateSensorEtag(sensor);
     updateEtag(gwConfigEtag);
     sensor->setNeedSaveDatabase(true);
     queSaveDb(DB_SENSORS, DB_LONG_SAVE_DELAY);
@@ -8,30 +8,12 @@
 #include <QVariant>
 #include <QString>
 
-/**
- * \enum JsonToken
- */
-enum JsonToken
-{
-	JsonTokenNone = 0,
-	JsonTokenCurlyOpen = 1,
-	JsonTokenCurlyClose = 2,
-	JsonTokenSquaredOpen = 3,
-	JsonTokenSquaredClose = 4,
-	JsonTokenColon = 5,
-	JsonTokenComma = 6,
-	JsonTokenString = 7,
-	JsonTokenNumber = 8,
-	JsonTokenTrue = 9,
-	JsonTokenFalse = 10,
-	JsonTokenNull = 11
-};
-
 /**
  * \class Json
  * \brief A JSON data parser
  *
  * Json parses a JSON data into a QVariant hierarchy.
+ * The parsing is done by JsonReader, the serialization by JsonWriter.
  */
 class Json
 {
@@ -51,6 +33,14 @@ class Json
 		 */
 		static QVariant parse(const QString &json, bool &success);
 
+		/**
+		 * Parse UTF-8 encoded JSON data without converting it to QString first
+		 *
+		 * \param json The UTF-8 JSON data
+		 * \param success The success of the parsing
+		 */
+		static QVariant parseUtf8(const QByteArray &json, bool &success);
+
 		/**
 		* This method generates a textual JSON representation
 		*
@@ -68,103 +58,6 @@ class Json
 		* \return QByteArray Textual JSON representation
 		*/
 		static QByteArray serialize(const QVariant &data, bool &success);
-
-	private:
-		/**
-		 * Parses a value starting from index
-		 *
-		 * \param json The JSON data
-		 * \param index The start index
-		 * \param success The success of the parse process
-		 *
-		 * \return QVariant The parsed value
-		 */
-		static QVariant parseValue(const QString &json, int &index,
-								   bool &success);
-
-		/**
-		 * Parses an object starting from index
-		 *
-		 * \param json The JSON data
-		 * \param index The start index
-		 * \param success The success of the object parse
-		 *
-		 * \return QVariant The parsed object map
-		 */
-		static QVariant parseObject(const QString &json, int &index,
-									   bool &success);
-
-		/**
-		 * Parses an array starting from index
-		 *
-		 * \param json The JSON data
-		 * \param index The starting index
-		 * \param success The success of the array parse
-		 *
-		 * \return QVariant The parsed variant array
-		 */
-		static QVariant parseArray(const QString &json, int &index,
-									   bool &success);
-
-		/**
-		 * Parses a string starting from index
-		 *
-		 * \param json The JSON data
-		 * \param index The starting index
-		 * \param success The success of the string parse
-		 *
-		 * \return QVariant The parsed string
-		 */
-		static QVariant parseString(const QString &json, int &index,
-									bool &success);
-
-		/**
-		 * Parses a number starting from index
-		 *
-		 * \param json The JSON data
-		 * \param index The starting index
-		 *
-		 * \return QVariant The parsed number
-		 */
-		static QVariant parseNumber(const QString &json, int &index);
-
-		/**
-		 * Get the last index of a number starting from index
-		 *
-		 * \param json The JSON data
-		 * \param index The starting index
-		 *
-		 * \return The last index of the number
-		 */
-		static int lastIndexOfNumber(const QString &json, int index);
-
-		/**
-		 * Skip unwanted whitespace symbols starting from index
-		 *
-		 * \param json The JSON data
-		 * \param index The start index
-		 */
-		static void eatWhitespace(const QString &json, int &index);
-
-		/**
-		 * Check what token lies ahead
-		 *
-		 * \param json The JSON data
-		 * \param index The starting index
-		 *
-		 * \return int The upcoming token
-		 */
-		static int lookAhead(const QString &json, int index);
-
-		/**
-		 * Get the next JSON token
-		 *
-		 * \param json The JSON data
-		 * \param index The starting index
-		 *
-		 * \return int The next JSON token
-		 */
-		static int nextToken(const QString &json, int &index);
 };
 
 #endif //JSON_H
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <cstring>
+#include "json_reader.h"
+
+static inline bool isNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') { return c - '0'; }
+    if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+    if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+    return -1;
+}
+
+JsonReader::JsonReader(const char *data, int size) :
+    m_p(data),
+    m_end(data + size)
+{
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+    {
+        m_p++;
+    }
+}
+
+void JsonReader::afterValue()
+{
+    if (m_stack.empty())
+    {
+        m_state = StateDone;
+    }
+    else
+    {
+        m_state = m_stack.back() == '{' ? StateMember : StateElement;
+    }
+}
+
+/*! Returns the next token, after TokenEnd and TokenError it doesn't advance anymore.
+ */
+JsonReader::Token JsonReader::next()
+{
+    if (m_token == TokenError)
+    {
+        return m_token;
+    }
+
+    skipWhitespace();
+
+    if (m_state == StateDone)
+    {
+        m_token = TokenEnd; // trailing data is ignored like in the previous parser
+        return m_token;
+    }
+
+    if (m_state == StateMember || m_state == StateElement)
+    {
+        while (m_p < m_end && (*m_p == ',' || *m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+        {
+            m_p++;
+        }
+    }
+
+    if (m_p == m_end)
+    {
+        return error();
+    }
+
+    if (m_state == StateMember)
+    {
+        if (*m_p == '}')
+        {
+            m_p++;
+            m_stack.pop_back();
+            afterValue();
+            m_token = TokenEndObject;
+            return m_token;
+        }
+
+        if (*m_p != '"' || string(TokenKey) == TokenError)
+        {
+            return error();
+        }
+
+        skipWhitespace();
+        if (m_p == m_end || *m_p != ':')
+        {
+            return error();
+        }
+
+        m_p++;
+        m_state = StateValue;
+        return m_token;
+    }
+
+    if (m_state == StateElement && *m_p == ']')
+    {
+        m_p++;
+        m_stack.pop_back();
+        afterValue();
+        m_token = TokenEndArray;
+        return m_token;
+    }
+
+    return value();
+}
+
+JsonReader::Token JsonReader::value()
+{
+    const char c = *m_p;
+
+    if (c == '{' || c == '[')
+    {
+        if (m_stack.size() >= MaxDepth)
+        {
+            return error();
+        }
+
+        m_p++;
+        m_stack.push_back(c);
+        m_state = c == '{' ? StateMember : StateElement;
+        m_token = c == '{' ? TokenBeginObject : TokenBeginArray;
+        return m_token;
+    }
+
+    if (c == '"')
+    {
+        if (string(TokenString) == TokenError)
+        {
+            return m_token;
+        }
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        m_str = m_p;
+        while (m_p < m_end && isNumberChar(*m_p))
+        {
+            m_p++;
+        }
+        m_len = int(m_p - m_str);
+        m_token = TokenNumber;
+    }
+    else if (c == 't') { m_bool = true; if (literal("true", 4, TokenBool) == TokenError) { return m_token; } }
+    else if (c == 'f') { m_bool = false; if (literal("false", 5, TokenBool) == TokenError) { return m_token; } }
+    else if (c == 'n') { if (literal("null", 4, TokenNull) == TokenError) { return m_token; } }
+    else
+    {
+        return error();
+    }
+
+    afterValue();
+    return m_token;
+}
+
+/*! Scans the string at m_p which must point to the opening quote, escapes are decoded later in toString().
+ */
+JsonReader::Token JsonReader::string(Token token)
+{
+    m_p++;
+    m_str = m_p;
+    m_escaped = false;
+
+    while (m_p < m_end)
+    {
+        const char c = *m_p;
+        if (c == '"')
+        {
+            m_len = int(m_p - m_str);
+            m_p++;
+            m_token = token;
+            return m_token;
+        }
+
+        if (c == '\\')
+        {
+            m_escaped = true;
+            m_p++;
+        }
+        m_p++;
+    }
+
+    return error();
+}
+
+JsonReader::Token JsonReader::literal(const char *str, int len, Token token)
+{
+    if (m_end - m_p < len || memcmp(m_p, str, size_t(len)) != 0)
+    {
+        return error();
+    }
+
+    m_p += len;
+    m_token = token;
+    return m_token;
+}
+
+/*! Returns true if the current key equals \p key, without decoding the key.
+ */
+bool JsonReader::isKey(const char *key) const
+{
+    if (m_token != TokenKey)
+    {
+        return false;
+    }
+
+    if (m_escaped)
+    {
+        return toString() == QLatin1String(key);
+    }
+
+    return int(strlen(key)) == m_len && memcmp(m_str, key, size_t(m_len)) == 0;
+}
+
+/*! Returns the decoded key or string, for numbers the textual representation.
+ */
+QString JsonReader::toString() const
+{
+    if (m_token != TokenKey && m_token != TokenString && m_token != TokenNumber)
+    {
+        return QString();
+    }
+
+    if (!m_escaped || m_token == TokenNumber)
+    {
+        return QString::fromUtf8(m_str, m_len);
+    }
+
+    QString result;
+    result.reserve(m_len);
+
+    const char *end = m_str + m_len;
+    const char *seg = m_str;
+    const char *p = m_str;
+
+    while (p < end)
+    {
+        if (*p != '\\')
+        {
+            p++;
+            continue;
+        }
+
+        if (p > seg)
+        {
+            result.append(QString::fromUtf8(seg, int(p - seg)));
+        }
+
+        p++; // backslash
+        if (p == end)
+        {
+            break;
+        }
+
+        const char c = *p++;
+        switch (c)
+        {
+        case '"':  result.append(QLatin1Char('"')); break;
+        case '\\': result.append(QLatin1Char('\\')); break;
+        case '/':  result.append(QLatin1Char('/')); break;
+        case 'b':  result.append(QLatin1Char('\b')); break;
+        case 'f':  result.append(QLatin1Char('\f')); break;
+        case 'n':  result.append(QLatin1Char('\n')); break;
+        case 'r':  result.append(QLatin1Char('\r')); break;
+        case 't':  result.append(QLatin1Char('\t')); break;
+        case 'u':
+        {
+            if (end - p < 4)
+            {
+                p = end;
+                break;
+            }
+
+            int symbol = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                const int h = hexValue(p[i]);
+                if (h < 0)
+                {
+                    symbol = 0; // invalid like QString::toInt()
+                    break;
+                }
+                symbol = (symbol << 4) | h;
+            }
+            p += 4;
+            result.append(QChar(ushort(symbol))); // surrogate pairs are joined in UTF-16
+        }
+            break;
+        default: // unknown escape sequences are dropped
+            break;
+        }
+
+        seg = p;
+    }
+
+    if (seg < end)
+    {
+        result.append(QString::fromUtf8(seg, int(end - seg)));
+    }
+
+    return result;
+}
+
+/*! Returns the current number, 0 if it can't be converted.
+ */
+double JsonReader::toDouble() const
+{
+    if (m_token != TokenNumber || m_len == 0)
+    {
+        return 0;
+    }
+
+    // fast path for integers which are the common case in API requests
+    if (m_len <= 15)
+    {
+        const char *p = m_str;
+        const char *end = m_str + m_len;
+        const bool neg = *p == '-';
+        if (neg)
+        {
+            p++;
+        }
+
+        if (p < end)
+        {
+            qint64 n = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; p++)
+            {
+                n = n * 10 + (*p - '0');
+            }
+
+            if (p == end)
+            {
+                return neg ? -double(n) : double(n);
+            }
+        }
+    }
+
+    return QByteArray(m_str, m_len).toDouble(); // locale independent
+}
+
+/*! Skips the current value, for objects and arrays until the matching end token.
+ */
+bool JsonReader::skipValue()
+{
+    if (m_token != TokenBeginObject && m_token != TokenBeginArray)
+    {
+        return m_token != TokenError;
+    }
+
+    const int d = depth();
+    while (depth() >= d)
+    {
+        if (next() == TokenError)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*! Returns the current value as QVariant hierarchy, for objects and arrays all tokens until the matching end are consumed.
+ */
+QVariant JsonReader::readVariant()
+{
+    switch (m_token)
+    {
+    case TokenBeginObject:
+    {
+        QVariantMap map;
+        while (next() == TokenKey)
+        {
+            const QString key = toString();
+            next();
+            QVariant val = readVariant();
+            if (hasError())
+            {
+                return QVariant();
+            }
+            map.insert(key, val);
+        }
+
+        if (m_token != TokenEndObject)
+        {
+            error();
+            return QVariant();
+        }
+        return map;
+    }
+
+    case TokenBeginArray:
+    {
+        QVariantList list;
+        while (next() != TokenEndArray)
+        {
+            QVariant val = readVariant();
+            if (hasError())
+            {
+                return QVariant();
+            }
+            list.push_back(val);
+        }
+        return list;
+    }
+
+    case TokenString: return toString();
+    case TokenNumber: return toDouble();
+    case TokenBool:   return m_bool;
+    case TokenNull:   return QVariant();
+
+    default:
+        break;
+    }
+
+    error();
+    return QVariant();
+}
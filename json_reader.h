@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <vector>
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+/*! \class JsonReader
+
+    Pull parser which tokenizes UTF-8 JSON in place.
+
+    The reader doesn't copy the input, keys and strings refer to the input
+    buffer until they are explicitly converted with toString(). Keys can be
+    compared without allocation via isKey().
+
+        JsonReader json(body);
+        if (json.next() == JsonReader::TokenBeginObject)
+        {
+            while (json.next() == JsonReader::TokenKey)
+            {
+                if (json.isKey("on") && json.next() == JsonReader::TokenBool) { on = json.toBool(); }
+                else { json.next(); json.skipValue(); }
+            }
+        }
+
+    To stay compatible with the previous Json::parse() implementation commas
+    between elements are optional and numbers are always doubles.
+ */
+class JsonReader
+{
+public:
+    enum Token
+    {
+        TokenError,
+        TokenEnd,
+        TokenBeginObject,
+        TokenEndObject,
+        TokenBeginArray,
+        TokenEndArray,
+        TokenKey,
+        TokenString,
+        TokenNumber,
+        TokenBool,
+        TokenNull
+    };
+
+    enum Constants
+    {
+        MaxDepth = 128
+    };
+
+    JsonReader(const char *data, int size);
+    explicit JsonReader(const QByteArray &utf8) : JsonReader(utf8.constData(), utf8.size()) { }
+
+    Token next();
+    Token token() const { return m_token; }
+    bool hasError() const { return m_token == TokenError; }
+    int depth() const { return int(m_stack.size()); }
+
+    bool isKey(const char *key) const;
+    QString toString() const;
+    double toDouble() const;
+    bool toBool() const { return m_bool; }
+
+    bool skipValue();
+    QVariant readVariant();
+
+private:
+    enum State
+    {
+        StateValue,   // top level value or value after ':'
+        StateMember,  // key or '}'
+        StateElement, // value or ']'
+        StateDone     // top level value complete
+    };
+
+    Token error() { m_token = TokenError; return m_token; }
+    Token value();
+    Token string(Token token);
+    Token literal(const char *str, int len, Token token);
+    void afterValue();
+    void skipWhitespace();
+
+    const char *m_p = nullptr;
+    const char *m_end = nullptr;
+    const char *m_str = nullptr; // key, string or number
+    int m_len = 0;
+    bool m_escaped = false;
+    bool m_bool = false;
+    State m_state = StateValue;
+    Token m_token = TokenEnd;
+    std::vector<char> m_stack;
+};
+
+#endif // JSON_READER_H
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QLocale>
+#include <QStringList>
+#include "json_writer.h"
+#include "resource.h"
+
+static const char hexDigits[] = "0123456789abcdef";
+
+/*! Writes the escape sequence of ASCII character \p c which isn't allowed raw in JSON strings.
+ */
+static char *escapeAscii(char *p, char c)
+{
+    *p++ = '\\';
+    switch (c)
+    {
+    case '"':  *p++ = '"'; break;
+    case '\\': *p++ = '\\'; break;
+    case '\b': *p++ = 'b'; break;
+    case '\f': *p++ = 'f'; break;
+    case '\n': *p++ = 'n'; break;
+    case '\r': *p++ = 'r'; break;
+    case '\t': *p++ = 't'; break;
+    default:
+        *p++ = 'u';
+        *p++ = '0';
+        *p++ = '0';
+        *p++ = hexDigits[(c >> 4) & 0xF];
+        *p++ = hexDigits[c & 0xF];
+        break;
+    }
+    return p;
+}
+
+static inline bool needsEscape(uint c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+JsonWriter::JsonWriter(int reserve)
+{
+    m_buf.reserve(reserve); // also keeps the capacity on resize(0)
+}
+
+/*! Starts a new document, the buffer capacity is kept.
+ */
+void JsonWriter::clear()
+{
+    m_buf.resize(0);
+    m_error = false;
+}
+
+/*! Inserts a comma if the previous element in the same container is complete.
+ */
+void JsonWriter::separator()
+{
+    if (!m_buf.isEmpty())
+    {
+        const char c = m_buf.at(m_buf.size() - 1);
+        if (c != '{' && c != '[' && c != ':')
+        {
+            m_buf.append(',');
+        }
+    }
+}
+
+JsonWriter &JsonWriter::beginObject()
+{
+    separator();
+    m_buf.append('{');
+    return *this;
+}
+
+JsonWriter &JsonWriter::endObject()
+{
+    m_buf.append('}');
+    return *this;
+}
+
+JsonWriter &JsonWriter::beginArray()
+{
+    separator();
+    m_buf.append('[');
+    return *this;
+}
+
+JsonWriter &JsonWriter::endArray()
+{
+    m_buf.append(']');
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(const char *key)
+{
+    return this->key(QLatin1String(key));
+}
+
+JsonWriter &JsonWriter::key(QLatin1String key)
+{
+    separator();
+    appendString(key);
+    m_buf.append(':');
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(const QString &key)
+{
+    separator();
+    appendString(key);
+    m_buf.append(':');
+    return *this;
+}
+
+JsonWriter &JsonWriter::null()
+{
+    separator();
+    m_buf.append("null", 4);
+    return *this;
+}
+
+/*! Appends already serialized JSON, e.g. a cached object, as value.
+ */
+JsonWriter &JsonWriter::rawValue(const QByteArray &json)
+{
+    separator();
+    m_buf.append(json);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(bool val)
+{
+    separator();
+    if (val) { m_buf.append("true", 4); }
+    else     { m_buf.append("false", 5); }
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(qint64 val)
+{
+    separator();
+    if (val < 0)
+    {
+        m_buf.append('-');
+        appendUInt(~quint64(val) + 1);
+    }
+    else
+    {
+        appendUInt(quint64(val));
+    }
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(quint64 val)
+{
+    separator();
+    appendUInt(val);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(double val)
+{
+    // Most doubles are integral values, e.g. from ResourceItem::toVariant(),
+    // they are written without the generic floating point formatting.
+    if (val >= -1e15 && val <= 1e15 && val == double(qint64(val)) && !(val == 0 && std::signbit(val)))
+    {
+        return value(qint64(val));
+    }
+
+    separator();
+#if (QT_VERSION >= QT_VERSION_CHECK(5,7, 0))
+    m_buf.append(QByteArray::number(val, 'f', QLocale::FloatingPointShortest));
+#else
+    m_buf.append(QByteArray::number(val));
+#endif
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(QLatin1String val)
+{
+    separator();
+    appendString(val);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const QString &val)
+{
+    separator();
+    appendString(val);
+    return *this;
+}
+
+/*! Writes a QVariant hierarchy, same rules as Json::serialize().
+    Unsupported types are written as null and set the error flag.
+ */
+JsonWriter &JsonWriter::value(const QVariant &val)
+{
+    if (!val.isValid())
+    {
+        return null();
+    }
+
+    const QVariant::Type type = val.type();
+
+    if (type == QVariant::List)
+    {
+        const QVariantList list = val.toList(); // shared, no deep copy
+        beginArray();
+        for (const QVariant &v : list)
+        {
+            value(v);
+        }
+        return endArray();
+    }
+    else if (type == QVariant::StringList)
+    {
+        const QStringList list = val.toStringList();
+        beginArray();
+        for (const QString &s : list)
+        {
+            if (s.isNull()) { null(); }
+            else            { value(s); }
+        }
+        return endArray();
+    }
+    else if (type == QVariant::Map)
+    {
+        const QVariantMap map = val.toMap();
+        beginObject();
+        for (auto i = map.cbegin(); i != map.cend(); ++i)
+        {
+            key(i.key()).value(i.value());
+        }
+        return endObject();
+    }
+    else if (val.isNull())
+    {
+        return null();
+    }
+    else if (type == QVariant::String || type == QVariant::ByteArray)
+    {
+        return value(val.toString());
+    }
+    else if (type == QVariant::Double)
+    {
+        return value(val.toDouble());
+    }
+    else if (type == QVariant::Bool)
+    {
+        return value(val.toBool());
+    }
+    else if (type == QVariant::ULongLong)
+    {
+        return value(quint64(val.value<qulonglong>()));
+    }
+    else if (val.canConvert<qlonglong>())
+    {
+        return value(qint64(val.value<qlonglong>()));
+    }
+    else if (val.canConvert<QString>()) // QDate, QDateTime, QUrl, ...
+    {
+        return value(val.toString());
+    }
+
+    m_error = true;
+    return null();
+}
+
+/*! Writes the value of \p item, same output as serializing ResourceItem::toVariant().
+ */
+JsonWriter &JsonWriter::value(const ResourceItem &item)
+{
+    if (!item.lastSet().isValid())
+    {
+        return null();
+    }
+
+    switch (item.descriptor().type)
+    {
+    case DataTypeString:
+    case DataTypeTimePattern:
+    case DataTypeTime:
+    {
+        const QString &str = item.toString();
+        return str.isNull() ? null() : value(str);
+    }
+
+    case DataTypeBool:
+        return value(item.toBool());
+
+    case DataTypeReal:
+        return value(item.toVariant());
+
+    default:
+        break;
+    }
+
+    return value(double(item.toNumber()));
+}
+
+/*! Writes an object with all items of \p r which suffix starts with \p prefix.
+    The prefix is stripped from the keys, keys are sorted like in a QVariantMap.
+ */
+JsonWriter &JsonWriter::resourceItems(const Resource &r, const char *prefix)
+{
+    const size_t len = strlen(prefix);
+
+    m_items.clear();
+    for (int i = 0; i < r.itemCount(); i++)
+    {
+        const ResourceItem *item = r.itemForIndex(size_t(i));
+        if (item && strncmp(item->descriptor().suffix, prefix, len) == 0)
+        {
+            m_items.push_back(item);
+        }
+    }
+
+    std::sort(m_items.begin(), m_items.end(), [len](const ResourceItem *a, const ResourceItem *b)
+    {
+        return strcmp(a->descriptor().suffix + len, b->descriptor().suffix + len) < 0;
+    });
+
+    beginObject();
+    for (const ResourceItem *item : m_items)
+    {
+        key(item->descriptor().suffix + len).value(*item);
+    }
+    return endObject();
+}
+
+void JsonWriter::appendUInt(quint64 val)
+{
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+
+    do
+    {
+        *--p = char('0' + val % 10);
+        val /= 10;
+    } while (val);
+
+    m_buf.append(p, int(tmp + sizeof(tmp) - p));
+}
+
+void JsonWriter::appendString(QLatin1String str)
+{
+    const int pos = m_buf.size();
+    m_buf.resize(pos + 2 + str.size() * 6); // worst case every character escaped as \u00XX
+    char *p = m_buf.data() + pos;
+
+    *p++ = '"';
+    const char *s = str.data();
+    const char *end = s + str.size();
+    for (; s < end; s++)
+    {
+        const uchar c = uchar(*s);
+        if (c >= 0x80) // Latin-1 to UTF-8
+        {
+            *p++ = char(0xC0 | (c >> 6));
+            *p++ = char(0x80 | (c & 0x3F));
+        }
+        else if (needsEscape(c))
+        {
+            p = escapeAscii(p, char(c));
+        }
+        else
+        {
+            *p++ = char(c);
+        }
+    }
+    *p++ = '"';
+
+    m_buf.resize(int(p - m_buf.constData()));
+}
+
+void JsonWriter::appendString(const QString &str)
+{
+    const int pos = m_buf.size();
+    m_buf.resize(pos + 2 + str.size() * 6); // worst case every character escaped as \u00XX
+    char *p = m_buf.data() + pos;
+
+    *p++ = '"';
+    const ushort *s = str.utf16();
+    const ushort *end = s + str.size();
+    for (; s < end; s++)
+    {
+        const uint c = *s;
+        if (c < 0x80)
+        {
+            if (needsEscape(c)) { p = escapeAscii(p, char(c)); }
+            else                { *p++ = char(c); }
+        }
+        else if (c < 0x800)
+        {
+            *p++ = char(0xC0 | (c >> 6));
+            *p++ = char(0x80 | (c & 0x3F));
+        }
+        else if (QChar::isHighSurrogate(c) && (s + 1) < end && QChar::isLowSurrogate(s[1]))
+        {
+            const uint ucs4 = QChar::surrogateToUcs4(ushort(c), s[1]);
+            s++;
+            *p++ = char(0xF0 | (ucs4 >> 18));
+            *p++ = char(0x80 | ((ucs4 >> 12) & 0x3F));
+            *p++ = char(0x80 | ((ucs4 >> 6) & 0x3F));
+            *p++ = char(0x80 | (ucs4 & 0x3F));
+        }
+        else if (QChar::isSurrogate(c))
+        {
+            *p++ = '?'; // unpaired surrogate, like QString::toUtf8()
+        }
+        else
+        {
+            *p++ = char(0xE0 | (c >> 12));
+            *p++ = char(0x80 | ((c >> 6) & 0x3F));
+            *p++ = char(0x80 | (c & 0x3F));
+        }
+    }
+    *p++ = '"';
+
+    m_buf.resize(int(p - m_buf.constData()));
+}
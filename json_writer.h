@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <vector>
+#include <QByteArray>
+#include <QLatin1String>
+#include <QString>
+#include <QVariant>
+
+class Resource;
+class ResourceItem;
+
+/*! \class JsonWriter
+
+    Single pass JSON writer which appends UTF-8 directly to a reusable buffer.
+
+    Unlike building a QVariantMap tree and serializing it, no intermediate
+    containers or strings are created. The buffer keeps its capacity between
+    clear() calls, so a long living writer doesn't allocate once warmed up.
+
+    Separators are derived from the last written byte, therefore the caller is
+    responsible for well formed nesting:
+
+        JsonWriter json;
+        json.beginObject();
+        json.key("on").value(true);
+        json.key("bri").value(254);
+        json.endObject();
+
+    The output of value(const QVariant&) matches Json::serialize().
+ */
+class JsonWriter
+{
+public:
+    explicit JsonWriter(int reserve = 1024);
+    void clear();
+    const QByteArray &buffer() const { return m_buf; }
+    bool hasError() const { return m_error; }
+
+    JsonWriter &beginObject();
+    JsonWriter &endObject();
+    JsonWriter &beginArray();
+    JsonWriter &endArray();
+
+    JsonWriter &key(const char *key);
+    JsonWriter &key(QLatin1String key);
+    JsonWriter &key(const QString &key);
+
+    JsonWriter &null();
+    JsonWriter &value(bool val);
+    JsonWriter &value(int val) { return value(qint64(val)); }
+    JsonWriter &value(uint val) { return value(quint64(val)); }
+    JsonWriter &value(qint64 val);
+    JsonWriter &value(quint64 val);
+    JsonWriter &value(double val);
+    JsonWriter &value(const char *val) { return value(QLatin1String(val)); }
+    JsonWriter &value(QLatin1String val);
+    JsonWriter &value(const QString &val);
+    JsonWriter &value(const QVariant &val);
+    JsonWriter &value(const ResourceItem &item);
+    JsonWriter &rawValue(const QByteArray &json);
+
+    JsonWriter &resourceItems(const Resource &r, const char *prefix);
+
+private:
+    void separator();
+    void appendUInt(quint64 val);
+    void appendString(QLatin1String str);
+    void appendString(const QString &str);
+
+    QByteArray m_buf;
+    std::vector<const ResourceItem*> m_items; // scratch for resourceItems()
+    bool m_error = false;
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <QElapsedTimer>
+#include <QtAlgorithms>
+#include "latency_histogram.h"
+
+static qint64 latencyOrigin = 0;
+
+/*! Adds one sample of \p us microseconds.
+ */
+void LatencyHistogram::add(qint64 us)
+{
+    if (us < 0)
+    {
+        us = 0;
+    }
+
+    int n = 0;
+    if (us > 0)
+    {
+        n = 64 - int(qCountLeadingZeroBits(quint64(us))); // bit length
+        if (n >= BucketCount)
+        {
+            n = BucketCount - 1;
+        }
+    }
+
+    m_buckets[n]++;
+
+    if (m_count == 0 || us < m_min)
+    {
+        m_min = us;
+    }
+
+    if (us > m_max)
+    {
+        m_max = us;
+    }
+
+    m_count++;
+    m_sum += quint64(us);
+}
+
+void LatencyHistogram::reset()
+{
+    *this = LatencyHistogram();
+}
+
+/*! Returns the largest duration which falls into bucket \p n.
+ */
+qint64 LatencyHistogram::bucketLimit(int n)
+{
+    if (n <= 0)
+    {
+        return 0;
+    }
+
+    return (qint64(1) << n) - 1;
+}
+
+/*! Returns the upper bound of the bucket which contains the \p p-th percentile.
+ */
+qint64 LatencyHistogram::percentile(int p) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    const quint64 target = qMax<quint64>(1, (m_count * quint64(qBound(0, p, 100)) + 99) / 100);
+    quint64 sum = 0;
+
+    for (int n = 0; n < BucketCount - 1; n++)
+    {
+        sum += m_buckets[n];
+        if (sum >= target)
+        {
+            return qMin(bucketLimit(n), m_max);
+        }
+    }
+
+    return m_max;
+}
+
+/*! Returns count, min, mean, max, percentiles and non empty buckets for the REST API.
+ */
+QVariantMap LatencyHistogram::toMap() const
+{
+    QVariantMap map;
+    map[QLatin1String("count")] = double(m_count);
+    map[QLatin1String("minus")] = double(min());
+    map[QLatin1String("meanus")] = double(mean());
+    map[QLatin1String("maxus")] = double(m_max);
+    map[QLatin1String("p50us")] = double(percentile(50));
+    map[QLatin1String("p90us")] = double(percentile(90));
+    map[QLatin1String("p99us")] = double(percentile(99));
+
+    QVariantMap buckets; // upper bound -> count
+    for (int n = 0; n < BucketCount; n++)
+    {
+        if (m_buckets[n] > 0)
+        {
+            const QString key = n < BucketCount - 1 ? QString::number(bucketLimit(n)) : QLatin1String("inf");
+            buckets[key] = double(m_buckets[n]);
+        }
+    }
+    map[QLatin1String("buckets")] = buckets;
+
+    return map;
+}
+
+/*! Returns a monotonic timestamp in microseconds, never 0.
+ */
+qint64 LAT_Now()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+    {
+        clock.start();
+    }
+
+    return clock.nsecsElapsed() / 1000 + 1;
+}
+
+/*! Sets the origin timestamp for events which are created from now on, 0 to clear.
+    Used to carry the arrival time of an APS indication to the events created from it.
+ */
+void LAT_SetOrigin(qint64 us)
+{
+    latencyOrigin = us;
+}
+
+/*! Returns the current origin timestamp or 0 if not set.
+ */
+qint64 LAT_Origin()
+{
+    return latencyOrigin;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <QVariantMap>
+
+/*! \class LatencyHistogram
+
+    Records durations in microseconds in buckets of powers of two.
+    Bucket 0 counts durations below 1 µs, bucket n durations in [2^(n-1), 2^n) µs,
+    the last bucket everything above. Percentiles are reported as the upper
+    bound of the bucket they fall in, which is exact enough to spot regressions
+    and needs no per sample storage.
+ */
+class LatencyHistogram
+{
+public:
+    enum Constants
+    {
+        BucketCount = 26 // last bucket >= 2^24 µs (~16.7 s)
+    };
+
+    void add(qint64 us);
+    void reset();
+
+    quint64 count() const { return m_count; }
+    qint64 min() const { return m_count ? m_min : 0; }
+    qint64 max() const { return m_max; }
+    qint64 mean() const { return m_count ? qint64(m_sum / m_count) : 0; }
+    qint64 percentile(int p) const;
+    quint64 bucket(int n) const { return (n >= 0 && n < BucketCount) ? m_buckets[n] : 0; }
+    static qint64 bucketLimit(int n);
+
+    QVariantMap toMap() const;
+
+private:
+    quint64 m_buckets[BucketCount] = { };
+    quint64 m_count = 0;
+    quint64 m_sum = 0;
+    qint64 m_min = 0;
+    qint64 m_max = 0;
+};
+
+qint64 LAT_Now();
+void LAT_SetOrigin(qint64 us);
+qint64 LAT_Origin();
+
+#endif // LATENCY_HISTOGRAM_H
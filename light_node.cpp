@@ -9,6 +9,7 @@
  */
 
 #include "de_web_plugin_private.h"
+#include "json_writer.h"
 #include "product_match.h"
 
 /*! Constructor.
@@ -755,14 +756,7 @@ void LightNode::jsonToResourceItems(const QString &json)
 /*! Transfers resource items into JSON string. */
 QString LightNode::resourceItemsToJson()
 {
-    QVariantMap map;
-
-    for (int i = 0; i < itemCount(); i++)
-    {
-        ResourceItem *item = itemForIndex(i);
-        const char *key = item->descriptor().suffix;
-        map[key] = item->toVariant();
-    }
-
-    return Json::serialize(map);
+    JsonWriter json(1024);
+    json.resourceItems(*this, "");
+    return QString::fromUtf8(json.buffer());
 }
@@ -1334,11 +1334,28 @@ void ResourceItem::setIsPublic(bool isPublic)
     m_isPublic = isPublic;
 }
 
+static quint32 resourceGeneration = 1;
+
+/*! Returns a counter which changes whenever a Resource is created, copied,
+    moved or destroyed, or items are added or removed. Pointers to resources
+    and their items which were obtained under an older generation might be dangling.
+ */
+quint32 R_ResourceGeneration()
+{
+    return resourceGeneration;
+}
+
 /*! Initial main constructor. */
 Resource::Resource(const char *prefix) :
     m_prefix(prefix)
 {
     Q_ASSERT(prefix == RSensors || prefix == RLights || prefix == RDevices || prefix == RGroups || prefix == RConfig || prefix == RAlarmSystems);
+    resourceGeneration++;
+}
+
+Resource::~Resource()
+{
+    resourceGeneration++;
 }
 
 /*! Copy constructor. */
@@ -1346,8 +1363,10 @@ Resource::Resource(const Resource &other) :
     m_handle(other.m_handle),
     m_prefix(other.m_prefix),
     m_parent(other.m_parent),
-    m_rItems(other.m_rItems)
+    m_rItems(other.m_rItems),
+    m_itemIndex(other.m_itemIndex)
 {
+    resourceGeneration++;
 }
 
 /*! Move constructor. */
@@ -1361,10 +1380,12 @@ Resource &Resource::operator=(const Resource &other)
 {
     if (this != &other)
     {
+        resourceGeneration++;
         m_handle = other.m_handle;
         m_prefix = other.m_prefix;
         m_parent = other.m_parent;
         m_rItems = other.m_rItems;
+        m_itemIndex = other.m_itemIndex;
     }
     return *this;
 }
@@ -1374,10 +1395,12 @@ Resource &Resource::operator=(Resource &&other) noexcept
 {
     if (this != &other)
     {
+        resourceGeneration++;
         m_handle = other.m_handle;
         m_prefix = other.m_prefix;
         m_parent = other.m_parent;
         m_rItems = std::move(other.m_rItems);
+        m_itemIndex = std::move(other.m_itemIndex);
     }
     return *this;
 }
@@ -1400,7 +1423,9 @@ ResourceItem *Resource::addItem(ApiDataType type, const char *suffix)
         {
             if (i->suffix == suffix && i->type == type)
             {
+                resourceGeneration++;
                 m_rItems.emplace_back(*i);
+                insertItemIndex(m_rItems.size() - 1);
                 return &m_rItems.back();
             }
         }
@@ -1424,40 +1449,133 @@ void Resource::removeItem(const char *suffix)
             continue;
         }
 
+        resourceGeneration++;
         *i = std::move(m_rItems.back());
         m_rItems.pop_back();
+        rebuildItemIndex();
         break;
     }
 }
 
-ResourceItem *Resource::item(const char *suffix)
+/*! Fibonacci hash of the interned \p suffix pointer, to be masked by the table size.
+ */
+static inline size_t R_SuffixHash(const char *suffix)
 {
-    rStats.item++;
+    const quint64 p = static_cast<quint64>(reinterpret_cast<quintptr>(suffix));
+    return static_cast<size_t>((p * Q_UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+}
 
-    for (size_t i = 0; i < m_rItems.size(); i++)
+constexpr quint8 RItemIndexEmpty = 0xFF;
+
+/*! Returns the index of the item with \p suffix in m_rItems or -1 if not found.
+
+    Suffixes are interned `const char*` pointers, the lookup hashes the pointer
+    into a small open addressing table with linear probing.
+ */
+int Resource::indexOf(const char *suffix) const
+{
+    if (m_itemIndex.empty())
     {
-        if (m_rItems[i].descriptor().suffix == suffix)
+        // no index for empty resources or more than 254 items
+        for (size_t i = 0; i < m_rItems.size(); i++)
         {
-            return &m_rItems[i];
+            rStats.itemProbe++;
+            if (m_rItems[i].descriptor().suffix == suffix)
+            {
+                return int(i);
+            }
         }
+        return -1;
     }
 
-    return nullptr;
+    const size_t mask = m_itemIndex.size() - 1;
+
+    for (size_t i = R_SuffixHash(suffix) & mask; ; i = (i + 1) & mask)
+    {
+        rStats.itemProbe++;
+        const quint8 idx = m_itemIndex[i];
+
+        if (idx == RItemIndexEmpty)
+        {
+            return -1;
+        }
+
+        if (m_rItems[idx].descriptor().suffix == suffix)
+        {
+            return idx;
+        }
+    }
 }
 
-const ResourceItem *Resource::item(const char *suffix) const
+/*! Adds the item at \p idx in m_rItems to the index, grows the table if needed.
+ */
+void Resource::insertItemIndex(size_t idx)
 {
-    rStats.item++;
+    if (m_rItems.size() >= RItemIndexEmpty || m_rItems.size() * 2 > m_itemIndex.size())
+    {
+        rebuildItemIndex();
+        return;
+    }
+
+    const size_t mask = m_itemIndex.size() - 1;
+    size_t i = R_SuffixHash(m_rItems[idx].descriptor().suffix) & mask;
+
+    while (m_itemIndex[i] != RItemIndexEmpty)
+    {
+        i = (i + 1) & mask;
+    }
+
+    m_itemIndex[i] = static_cast<quint8>(idx);
+}
+
+/*! Recreates the index for all items in m_rItems.
+ */
+void Resource::rebuildItemIndex()
+{
+    m_itemIndex.clear();
+
+    if (m_rItems.empty() || m_rItems.size() >= RItemIndexEmpty)
+    {
+        return; // indexOf() falls back to linear search
+    }
 
-    for (size_t i = 0; i < m_rItems.size(); i++)
+    // at least twice the slots of items, so every probe sequence ends at an empty slot
+    size_t size = 8;
+    while (size < m_rItems.size() * 2)
     {
-        if (m_rItems[i].descriptor().suffix == suffix)
+        size *= 2;
+    }
+
+    const size_t mask = size - 1;
+    m_itemIndex.resize(size, RItemIndexEmpty);
+
+    for (size_t idx = 0; idx < m_rItems.size(); idx++)
+    {
+        size_t i = R_SuffixHash(m_rItems[idx].descriptor().suffix) & mask;
+
+        while (m_itemIndex[i] != RItemIndexEmpty)
         {
-            return &m_rItems[i];
+            i = (i + 1) & mask;
         }
+
+        m_itemIndex[i] = static_cast<quint8>(idx);
     }
+}
 
-    return nullptr;
+ResourceItem *Resource::item(const char *suffix)
+{
+    rStats.item++;
+
+    const int idx = indexOf(suffix);
+    return idx >= 0 ? &m_rItems[idx] : nullptr;
+}
+
+const ResourceItem *Resource::item(const char *suffix) const
+{
+    rStats.item++;
+
+    const int idx = indexOf(suffix);
+    return idx >= 0 ? &m_rItems[idx] : nullptr;
 }
 
 bool Resource::toBool(const char *suffix) const
@@ -36,6 +36,7 @@ struct R_Stats
     size_t toString = 0;
     size_t toNumber = 0;
     size_t item = 0;
+    size_t itemProbe = 0; // slots visited by Resource::item() lookups
 };
 
 extern R_Stats rStats;
@@ -555,7 +556,7 @@ public:
     };
 
     Resource(const char *prefix);
-    ~Resource() = default;
+    ~Resource();
     Resource(const Resource &other);
     Resource(Resource &&other) noexcept;
     Resource &operator=(const Resource &other);
@@ -587,10 +588,15 @@ public:
 
 private:
     Resource() = delete;
+    int indexOf(const char *suffix) const;
+    void insertItemIndex(size_t idx);
+    void rebuildItemIndex();
+
     Handle m_handle{};
     const char *m_prefix = nullptr;
     Resource *m_parent = nullptr;
     std::vector<ResourceItem> m_rItems;
+    std::vector<quint8> m_itemIndex; // open addressing table: suffix -> index in m_rItems
     std::vector<StateChange> m_stateChanges;
 };
 
@@ -684,6 +690,7 @@ bool isValidRConfigGroup(const QString &str);
 
 uint8_t DDF_GetSubDeviceOrder(const QString &type);
 QLatin1String R_DataTypeToString(ApiDataType type);
+quint32 R_ResourceGeneration();
 inline bool isValid(Resource::Handle hnd) { return hnd.hash != 0 && hnd.index < UINT16_MAX && hnd.type != 0; }
 inline bool operator==(Resource::Handle a, Resource::Handle b) { return a.hash == b.hash && a.type == b.type; }
 
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef RESOURCE_INDEX_H
+#define RESOURCE_INDEX_H
+
+#include <QHash>
+#include <cstddef>
+#include <vector>
+
+/*! \class ResourceIndex
+
+    Maps a lookup key (id, uniqueid, MAC address, group address) to the slot
+    of a resource in its container (`nodes`, `sensors`, `groups`, `m_devices`).
+
+    The resource containers are only ever appended to, but ids, uniqueids and
+    delete states of their elements can change at many places. Therefore every
+    index hit is verified with the \p match predicate against the element in
+    the container. With find() a stale or missing entry falls back to a linear
+    scan which refreshes the index, so the index can never return a wrong resource.
+
+    For keys which never change and are registered for every element (the
+    DeviceKey of `m_devices`) get() returns a miss without scanning.
+ */
+template <typename Key>
+class ResourceIndex
+{
+public:
+    static constexpr size_t NotFound = size_t(-1);
+
+    /*! Returns the slot of the element in \p container matching \p key or \c NotFound.
+        \p match(element) must return true if the element belongs to \p key.
+     */
+    template <typename Container, typename Match>
+    size_t find(const Container &container, const Key &key, Match match)
+    {
+        auto i = m_slots.find(key);
+        if (i != m_slots.end())
+        {
+            const size_t slot = i.value();
+            if (slot < container.size() && match(container[slot]))
+            {
+                return slot;
+            }
+
+            m_slots.erase(i); // stale
+        }
+
+        for (size_t slot = 0; slot < container.size(); slot++)
+        {
+            if (match(container[slot]))
+            {
+                m_slots.insert(key, slot);
+                return slot;
+            }
+        }
+
+        return NotFound;
+    }
+
+    /*! Returns the slot of the element in \p container matching \p key or \c NotFound without scanning.
+     */
+    template <typename Container, typename Match>
+    size_t get(const Container &container, const Key &key, Match match) const
+    {
+        const auto i = m_slots.constFind(key);
+        if (i != m_slots.cend() && i.value() < container.size() && match(container[i.value()]))
+        {
+            return i.value();
+        }
+
+        return NotFound;
+    }
+
+    /*! Registers \p slot for \p key, used when a resource is added to its container.
+     */
+    void insert(const Key &key, size_t slot) { m_slots.insert(key, slot); }
+
+    /*! Unregisters \p key at \p slot and moves the slots behind it down, used when an element is erased.
+     */
+    void erase(const Key &key, size_t slot)
+    {
+        m_slots.remove(key);
+
+        for (auto i = m_slots.begin(); i != m_slots.end(); ++i)
+        {
+            if (i.value() > slot)
+            {
+                i.value()--;
+            }
+        }
+    }
+
+    void remove(const Key &key) { m_slots.remove(key); }
+    void clear() { m_slots.clear(); }
+    int size() const { return m_slots.size(); }
+
+private:
+    QHash<Key, size_t> m_slots;
+};
+
+/*! \class AddressIndex
+
+    Maps a MAC address to the slots of all resources with that address in an
+    append-only container (`nodes`, `sensors`). MAC addresses are assigned before
+    a resource is added and never change, elements appended since the last
+    lookup are indexed on the next one. Therefore a miss is final and needs no
+    scan. Deleted resources stay in their container and in the index, the
+    \p match predicate decides about their state.
+
+    Resources without MAC address (CLIP sensors) are indexed under 0.
+ */
+class AddressIndex
+{
+public:
+    static constexpr size_t NotFound = size_t(-1);
+
+    /*! Returns the first slot in container order of the elements with MAC address \p ext
+        for which \p match(element) returns true, or \c NotFound.
+        If \p withoutExt is set, elements without MAC address are considered as well,
+        these can still be matched by NWK address.
+     */
+    template <typename Container, typename Match>
+    size_t find(Container &container, quint64 ext, bool withoutExt, Match match)
+    {
+        sync(container);
+
+        const std::vector<size_t> &a = slots(ext);
+        const std::vector<size_t> &b = (withoutExt && ext != 0) ? slots(0) : m_empty;
+        size_t ia = 0;
+        size_t ib = 0;
+
+        while (ia < a.size() || ib < b.size())
+        {
+            const size_t slot = (ib == b.size() || (ia < a.size() && a[ia] < b[ib])) ? a[ia++] : b[ib++];
+
+            if (match(container[slot]))
+            {
+                return slot;
+            }
+        }
+
+        return NotFound;
+    }
+
+    void clear() { m_slots.clear(); m_count = 0; }
+
+private:
+    template <typename Container>
+    void sync(const Container &container)
+    {
+        if (container.size() < m_count)
+        {
+            clear();
+        }
+
+        for (; m_count < container.size(); m_count++)
+        {
+            m_slots[container[m_count].address().ext()].push_back(m_count);
+        }
+    }
+
+    const std::vector<size_t> &slots(quint64 ext) const
+    {
+        const auto i = m_slots.constFind(ext);
+        return i != m_slots.cend() ? i.value() : m_empty;
+    }
+
+    QHash<quint64, std::vector<size_t>> m_slots;
+    std::vector<size_t> m_empty;
+    size_t m_count = 0; // indexed elements
+};
+
+#endif // RESOURCE_INDEX_H
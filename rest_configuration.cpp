@@ -8,6 +8,7 @@
  *
  */
 
+#include <algorithm>
 #include <QApplication>
 #include <QCryptographicHash>
 #include <QMessageAuthenticationCode>
@@ -23,11 +24,14 @@
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 #include "json.h"
+#include "json_writer.h"
 #include <stdlib.h>
 #include <time.h>
 #include <QProcess>
 #include "backup.h"
 #include "crypto/password.h"
+#include "database.h"
+#include "database_writer.h"
 #include "crypto/random.h"
 #include "gateway.h"
 #include "utils/utils.h"
@@ -938,6 +942,7 @@ int DeRestPluginPrivate::createUser(const ApiRequest &req, ApiResponse &rsp)
         auth.lastUseDate = QDateTime::currentDateTimeUtc();
         auth.needSaveDatabase = true;
         apiAuths.push_back(auth);
+        invalidateApiAuthCache();
         queSaveDb(DB_AUTH, DB_SHORT_SAVE_DELAY);
         updateEtag(gwConfigEtag);
         DBG_Printf(DBG_INFO, "created username: %s, devicetype: %s\n", qPrintable(auth.apikey), qPrintable(auth.devicetype));
@@ -972,6 +977,8 @@ void DeRestPluginPrivate::configToMap(const ApiRequest &req, QVariantMap &map)
     map["ipaddress"] = gwIPAddress;
     map["netmask"] = gwNetMask;
 
+    flushApiAuthUsage();
+
     std::vector<ApiAuth>::const_iterator i = apiAuths.begin();
     std::vector<ApiAuth>::const_iterator end = apiAuths.end();
     for (; i != end; ++i)
@@ -1174,7 +1181,36 @@ void DeRestPluginPrivate::basicConfigToMap(const ApiRequest &req, QVariantMap &m
     }
 }
 
+/*! Returns the serialized JSON of \p map as deep copy, \p json is reused.
+ */
+static QByteArray toJsonFragment(JsonWriter &json, const QVariantMap &map)
+{
+    json.clear();
+    json.value(QVariant(map));
+    return QByteArray(json.buffer().constData(), json.buffer().size());
+}
+
+/*! Appends a section of cached fragments as JSON object sorted by id.
+ */
+static void writeFragments(JsonWriter &json, const char *key, std::vector<std::pair<QString, FullStateFragment>> &fragments)
+{
+    std::sort(fragments.begin(), fragments.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    json.key(key).beginObject();
+    for (const auto &f : fragments)
+    {
+        json.key(f.first).rawValue(f.second.json);
+    }
+    json.endObject();
+}
+
 /*! GET /api/<apikey>
+
+    Lights, groups and sensors are assembled from serialized fragments in
+    fullStateCache, only changed resources are serialized again. The ETag is
+    a SHA-1 over the etags of lights, groups and sensors, gwConfigEtag and the
+    small sections which are serialized on each request anyway.
+
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
@@ -1182,103 +1218,123 @@ int DeRestPluginPrivate::getFullState(const ApiRequest &req, ApiResponse &rsp)
 {
     checkRfConnectState();
 
-    // handle ETag
-    if (req.hdr.hasKey(QLatin1String("If-None-Match")))
+    static JsonWriter fragmentJson(4096);
+
+    // lightToMap() and sensorToMap() depend on the API mode and version, in v2 on the request path
+    const QString variant = QString::number(req.mode) + QLatin1Char('/') + QString::number(req.apiVersion()) +
+                            (req.apiVersion() >= ApiVersion_2_DDEL ? req.hdr.path() : QString());
+
+    QCryptographicHash etagHash(QCryptographicHash::Sha1);
+    const auto addString = [&etagHash](const QString &str)
     {
-        QString etag = req.hdr.value(QLatin1String("If-None-Match"));
+        etagHash.addData(reinterpret_cast<const char*>(str.constData()), str.size() * int(sizeof(QChar)));
+        etagHash.addData("", 1); // separator
+    };
 
-        if (gwConfigEtag == etag)
-        {
-            rsp.httpStatus = HttpStatusNotModified;
-            rsp.etag = etag;
-            return REQ_READY_SEND;
-        }
-    }
+    addString(variant);
+    addString(gwConfigEtag);
 
-    QVariantMap lightsMap;
-    QVariantMap groupsMap;
-    QVariantMap schedulesMap;
-    QVariantMap scenesMap;
-    QVariantMap sensorsMap;
-    QVariantMap rulesMap;
-    QVariantMap configMap;
-    QVariantMap resourcelinksMap;
+    std::vector<std::pair<QString, FullStateFragment>> lightFragments;
+    std::vector<std::pair<QString, FullStateFragment>> groupFragments;
+    std::vector<std::pair<QString, FullStateFragment>> sensorFragments;
 
     // lights
+    for (const LightNode &lightNode : nodes)
     {
-        std::vector<LightNode>::const_iterator i = nodes.begin();
-        std::vector<LightNode>::const_iterator end = nodes.end();
-
-        for (; i != end; ++i)
+        if (lightNode.state() == LightNode::StateDeleted)
         {
-            if (i->state() == LightNode::StateDeleted)
-            {
-                continue;
-            }
+            fullStateCache.invalidate(FullStateCache::SectionLights, lightNode.id());
+            continue;
+        }
 
+        const FullStateFragment *frag = fullStateCache.find(FullStateCache::SectionLights, lightNode.id(), lightNode.etag, variant);
+        if (!frag)
+        {
             QVariantMap map;
-            if (lightToMap(req, &(*i), map))
+            if (!lightToMap(req, &lightNode, map))
             {
-                lightsMap[i->id()] = map;
+                continue;
             }
+            frag = fullStateCache.insert(FullStateCache::SectionLights, lightNode.id(), lightNode.etag, variant, toJsonFragment(fragmentJson, map));
         }
+
+        addString(lightNode.id());
+        addString(lightNode.etag);
+        lightFragments.emplace_back(lightNode.id(), *frag); // copy, further inserts may rehash
     }
 
     // groups
+    for (const Group &group : groups)
     {
-        std::vector<Group>::const_iterator i = groups.begin();
-        std::vector<Group>::const_iterator end = groups.end();
+        // ignore deleted groups
+        if (group.state() == Group::StateDeleted || group.state() == Group::StateDeleteFromDB)
+        {
+            fullStateCache.invalidate(FullStateCache::SectionGroups, group.id());
+            continue;
+        }
 
-        for (; i != end; ++i)
+        if (group.address() == gwGroup0) // don't return special group 0
         {
-            // ignore deleted groups
-            if (i->state() == Group::StateDeleted || i->state() == Group::StateDeleteFromDB)
-            {
-                continue;
-            }
+            continue;
+        }
 
-            if (i->address() != gwGroup0) // don't return special group 0
+        const FullStateFragment *frag = fullStateCache.find(FullStateCache::SectionGroups, group.id(), group.etag, variant);
+        if (!frag)
+        {
+            QVariantMap map;
+            if (!groupToMap(req, &group, map))
             {
-                QVariantMap map;
-                if (groupToMap(req, &(*i), map))
-                {
-                    groupsMap[i->id()] = map;
-                }
+                continue;
             }
+            frag = fullStateCache.insert(FullStateCache::SectionGroups, group.id(), group.etag, variant, toJsonFragment(fragmentJson, map));
         }
+
+        addString(group.id());
+        addString(group.etag);
+        groupFragments.emplace_back(group.id(), *frag);
     }
 
-    // schedules
+    // sensors
+    for (const Sensor &sensor : sensors)
     {
-        std::vector<Schedule>::const_iterator i = schedules.begin();
-        std::vector<Schedule>::const_iterator end = schedules.end();
+        if (sensor.deletedState() == Sensor::StateDeleted)
+        {
+            fullStateCache.invalidate(FullStateCache::SectionSensors, sensor.id());
+            continue;
+        }
 
-        for (; i != end; ++i)
+        const FullStateFragment *frag = fullStateCache.find(FullStateCache::SectionSensors, sensor.id(), sensor.etag, variant);
+        if (!frag)
         {
-            if (i->state == Schedule::StateDeleted)
+            QVariantMap map;
+            if (!sensorToMap(&sensor, map, req))
             {
                 continue;
             }
-            schedulesMap[i->id] = i->jsonMap;
+            frag = fullStateCache.insert(FullStateCache::SectionSensors, sensor.id(), sensor.etag, variant, toJsonFragment(fragmentJson, map));
         }
+
+        addString(sensor.id());
+        addString(sensor.etag);
+        sensorFragments.emplace_back(sensor.id(), *frag);
     }
 
-    // sensors
+    QVariantMap schedulesMap;
+    QVariantMap rulesMap;
+    QVariantMap resourcelinksMap;
+
+    // schedules
     {
-        std::vector<Sensor>::const_iterator i = sensors.begin();
-        std::vector<Sensor>::const_iterator end = sensors.end();
+        std::vector<Schedule>::const_iterator i = schedules.begin();
+        std::vector<Schedule>::const_iterator end = schedules.end();
 
         for (; i != end; ++i)
         {
-            if (i->deletedState() == Sensor::StateDeleted)
+            if (i->state == Schedule::StateDeleted)
             {
                 continue;
             }
-            QVariantMap map;
-            if (sensorToMap(&(*i), map, req))
-            {
-                sensorsMap[i->id()] = map;
-            }
+            schedulesMap[i->id] = i->jsonMap;
         }
     }
 
@@ -1316,20 +1372,57 @@ int DeRestPluginPrivate::getFullState(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
-    // alarm systems
-    rsp.map[QLatin1String("alarmsystems")] = AS_AlarmSystemsToMap(*alarmSystems);
+    // small sections are serialized on each request
+    const QByteArray alarmSystemsJson = toJsonFragment(fragmentJson, AS_AlarmSystemsToMap(*alarmSystems));
+    const QByteArray schedulesJson = toJsonFragment(fragmentJson, schedulesMap);
+    const QByteArray rulesJson = toJsonFragment(fragmentJson, rulesMap);
+    const QByteArray resourcelinksJson = toJsonFragment(fragmentJson, resourcelinksMap);
 
+    etagHash.addData(alarmSystemsJson);
+    etagHash.addData(schedulesJson);
+    etagHash.addData(rulesJson);
+    etagHash.addData(resourcelinksJson);
+
+    // quotes are mandatory as described in w3 spec
+    const QString etag = QLatin1Char('"') + QString::fromLatin1(etagHash.result().toHex()) + QLatin1Char('"');
+
+    // handle ETag
+    if (req.hdr.hasKey(QLatin1String("If-None-Match")))
+    {
+        if (req.hdr.value(QLatin1String("If-None-Match")) == etag)
+        {
+            rsp.httpStatus = HttpStatusNotModified;
+            rsp.etag = etag;
+            return REQ_READY_SEND;
+        }
+    }
+
+    QVariantMap configMap;
     configToMap(req, configMap);
 
-    rsp.map["lights"] = lightsMap;
-    rsp.map["groups"] = groupsMap;
-    rsp.map["schedules"] = schedulesMap;
-    rsp.map["scenes"] = scenesMap;
-    rsp.map["sensors"] = sensorsMap;
-    rsp.map["rules"] = rulesMap;
-    rsp.map["config"] = configMap;
-    rsp.map["resourcelinks"] = resourcelinksMap;
-    rsp.etag = gwConfigEtag;
+    static JsonWriter json(64 * 1024); // reused, keeps its capacity
+    json.clear();
+
+    // keys in the same order as the previous QVariantMap based response
+    json.beginObject();
+    json.key("alarmsystems").rawValue(alarmSystemsJson);
+    json.key("config").value(QVariant(configMap));
+    writeFragments(json, "groups", groupFragments);
+    writeFragments(json, "lights", lightFragments);
+    json.key("resourcelinks").rawValue(resourcelinksJson);
+    json.key("rules").rawValue(rulesJson);
+    json.key("scenes").beginObject().endObject();
+    json.key("schedules").rawValue(schedulesJson);
+    writeFragments(json, "sensors", sensorFragments);
+    json.endObject();
+
+    if (json.hasError())
+    {
+        return REQ_NOT_HANDLED;
+    }
+
+    rsp.json = json.buffer(); // shared until the response is written
+    rsp.etag = etag;
     rsp.httpStatus = HttpStatusOk;
     return REQ_READY_SEND;
 }
@@ -2304,6 +2397,7 @@ int DeRestPluginPrivate::deleteUser(const ApiRequest &req, ApiResponse &rsp)
         {
             i->needSaveDatabase = true;
             i->state = ApiAuth::StateDeleted;
+            invalidateApiAuthCache();
             queSaveDb(DB_AUTH, DB_LONG_SAVE_DELAY);
 
             QVariantMap rspItem;
@@ -2473,6 +2567,7 @@ int DeRestPluginPrivate::exportConfig(const ApiRequest &req, ApiResponse &rsp)
         return REQ_READY_SEND;
     }
 
+    DB_CloseWriter();
     ttlDataBaseConnection = 0;
     closeDb();
 
@@ -2480,10 +2575,14 @@ int DeRestPluginPrivate::exportConfig(const ApiRequest &req, ApiResponse &rsp)
     {
         DBG_Printf(DBG_ERROR, "backup: failed to export - database busy\n");
         rsp.httpStatus = HttpStatusServiceUnavailable;
+        DB_StartWriter(sqliteDatabaseName);
         return REQ_READY_SEND;
     }
 
-    if (BAK_ExportConfiguration(deCONZ::ApsController::instance()))
+    const bool exported = BAK_ExportConfiguration(deCONZ::ApsController::instance());
+    DB_StartWriter(sqliteDatabaseName);
+
+    if (exported)
     {
         rsp.httpStatus = HttpStatusOk;
         QVariantMap rspItem;
@@ -2508,6 +2607,7 @@ int DeRestPluginPrivate::importConfig(const ApiRequest &req, ApiResponse &rsp)
 {
     // prevent overwrite database with content of current memory
     // will be reset after application soft restart
+    DB_CloseWriter();
     ttlDataBaseConnection = 0;
     saveDatabaseItems |= DB_NOSAVE;
     closeDb();
@@ -2598,6 +2698,7 @@ int DeRestPluginPrivate::resetConfig(const ApiRequest &req, ApiResponse &rsp)
 
     // prevent overwrite database with content of current memory
     // will be reset after application soft restart
+    DB_CloseWriter();
     ttlDataBaseConnection = 0;
     saveDatabaseItems |= DB_NOSAVE;
     closeDb();
@@ -115,6 +115,7 @@ bool deleteSensor(Sensor *sensor, DeRestPluginPrivate *plugin)
         sensor->setDeletedState(Sensor::StateDeleted);
         sensor->setNeedSaveDatabase(true);
         sensor->setResetRetryCount(10);
+        plugin->updateSensorEtag(sensor); // ?since= clients get the null tombstone
 
         enqueueEvent(Event(sensor->prefix(), REventDeleted, sensor->id()));
         return true;
@@ -149,6 +150,8 @@ bool deleteLight(LightNode *lightNode, DeRestPluginPrivate *plugin)
             }
         }
 
+        plugin->updateLightEtag(lightNode); // ?since= clients get the null tombstone
+
         enqueueEvent(Event(lightNode->prefix(), REventDeleted, lightNode->id()));
         return true;
     }
@@ -205,14 +208,25 @@ void RestDevices::handleEvent(const Event &event)
  */
 int RestDevices::getAllDevices(const ApiRequest &req, ApiResponse &rsp)
 {
-    Q_UNUSED(req)
-
     rsp.httpStatus = HttpStatusOk;
 
+    uint hash = uint(plugin->m_devices.size());
     for (const auto &d : plugin->m_devices)
     {
         Q_ASSERT(d);
-        rsp.list.push_back(d->item(RAttrUniqueId)->toString());
+        const QString uniqueId = d->item(RAttrUniqueId)->toString();
+        hash = qHash(uniqueId, hash);
+        rsp.list.push_back(uniqueId);
+    }
+
+    // the list only changes when devices are added or removed
+    rsp.etag = QString("\"devices-%1\"").arg(hash, 8, 16, QLatin1Char('0'));
+
+    if (req.hdr.value(QLatin1String("If-None-Match")) == rsp.etag)
+    {
+        rsp.httpStatus = HttpStatusNotModified;
+        rsp.list.clear();
+        return REQ_READY_SEND;
     }
 
     if (rsp.list.isEmpty())
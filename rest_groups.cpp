@@ -16,6 +16,8 @@
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 #include "json.h"
+#include "json_reader.h"
+#include "utils/utils.h"
 
 /*! Groups and scenes REST API broker.
     \param req - request data
@@ -104,7 +106,8 @@ int DeRestPluginPrivate::handleGroupsApi(const ApiRequest &req, ApiResponse &rsp
     return REQ_NOT_HANDLED;
 }
 
-/*! GET /api/<apikey>/groups
+/*! GET /api/<apikey>/groups[?since=<version>]
+    With since only groups changed after the version are returned, deleted ones as null.
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
@@ -126,23 +129,40 @@ int DeRestPluginPrivate::getAllGroups(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
+    const quint64 since = req.sinceVersion();
+
     std::vector<Group>::const_iterator i = groups.begin();
     std::vector<Group>::const_iterator end = groups.end();
 
     for (; i != end; ++i)
     {
-        // ignore deleted groups
-        if (i->state() == Group::StateDeleted || i->state() == Group::StateDeleteFromDB)
+        if (i->address() == gwGroup0) // don't return special group 0
         {
             continue;
         }
 
-        if (i->address() != gwGroup0) // don't return special group 0
+        if (since > 0)
         {
-            QVariantMap mnode;
-            groupToMap(req, &(*i), mnode);
-            rsp.map[i->id()] = mnode;
+            const quint64 version = U_EtagVersion(i->etag);
+            if (version != 0 && version <= since)
+            {
+                continue; // unchanged
+            }
         }
+
+        // ignore deleted groups
+        if (i->state() == Group::StateDeleted || i->state() == Group::StateDeleteFromDB)
+        {
+            if (since > 0)
+            {
+                rsp.map[i->id()] = QVariant();
+            }
+            continue;
+        }
+
+        QVariantMap mnode;
+        groupToMap(req, &(*i), mnode);
+        rsp.map[i->id()] = mnode;
     }
 
     if (rsp.map.isEmpty())
@@ -726,6 +746,34 @@ static void copyTaskReq(TaskItem &a, TaskItem &b)
     b.transitionTime = a.transitionTime;
 }
 
+/*! Parameters of PUT /groups/<id>/action, the body keys are matched with JsonReader::isKey(). */
+enum GroupActionParam
+{
+    ActionOn,
+    ActionOnTime,
+    ActionOnOffControl,
+    ActionOpen,
+    ActionBri,
+    ActionBriInc,
+    ActionHue,
+    ActionSat,
+    ActionXy,
+    ActionCt,
+    ActionCtInc,
+    ActionEffect,
+    ActionColorloopSpeed,
+    ActionAlert,
+    ActionToggle,
+    ActionWrap,
+    ActionTransitionTime,
+    ActionParamCount
+};
+
+static const char *const groupActionParams[ActionParamCount] = {
+    "on", "ontime", "onoffcontrol", "open", "bri", "bri_inc", "hue", "sat", "xy",
+    "ct", "ct_inc", "effect", "colorloopspeed", "alert", "toggle", "wrap", "transitiontime"
+};
+
 /*! PUT, PATCH /api/<apikey>/groups/<id>/action
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
@@ -764,31 +812,59 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     taskRef.req.setSrcEndpoint(getSrcEndpoint(0, taskRef.req));
 
     bool ok;
-    QVariant var = Json::parse(req.content, ok);
-    QVariantMap map = var.toMap();
+    bool hasParam = false;
+    QVariant values[ActionParamCount]; // known parameters of the body
+    bool present[ActionParamCount] = { };
+    const QByteArray body = req.contentUtf8.isEmpty() ? req.content.toUtf8() : req.contentUtf8;
+    JsonReader json(body);
 
-    if (!ok || map.isEmpty())
+    if (json.next() == JsonReader::TokenBeginObject)
+    {
+        while (json.next() == JsonReader::TokenKey)
+        {
+            int param = ActionOn;
+            while (param < ActionParamCount && !json.isKey(groupActionParams[param]))
+            {
+                param++;
+            }
+
+            json.next();
+            hasParam = true;
+
+            if (param < ActionParamCount)
+            {
+                values[param] = json.readVariant();
+                present[param] = true;
+            }
+            else
+            {
+                json.skipValue();
+            }
+        }
+    }
+
+    if (json.hasError() || !hasParam)
     {
         rsp.list.append(errorToMap(ERR_INVALID_JSON, QString("/groups/%1/action").arg(id), QString("body contains invalid JSON")));
         rsp.httpStatus = HttpStatusBadRequest;
         return REQ_READY_SEND;
     }
 
-    bool hasOn = map.contains("on");
-    bool hasOnTime = map.contains("ontime");
-    bool hasOpen = map.contains("open");
-    bool hasBri = map.contains("bri");
-    bool hasHue = map.contains("hue");
-    bool hasSat = map.contains("sat");
-    bool hasXy = map.contains("xy");
-    bool hasCt = map.contains("ct");
-    bool hasCtInc = map.contains("ct_inc");
-    bool hasBriInc = map.contains("bri_inc");
-    bool hasEffect = map.contains("effect");
+    bool hasOn = present[ActionOn];
+    bool hasOnTime = present[ActionOnTime];
+    bool hasOpen = present[ActionOpen];
+    bool hasBri = present[ActionBri];
+    bool hasHue = present[ActionHue];
+    bool hasSat = present[ActionSat];
+    bool hasXy = present[ActionXy];
+    bool hasCt = present[ActionCt];
+    bool hasCtInc = present[ActionCtInc];
+    bool hasBriInc = present[ActionBriInc];
+    bool hasEffect = present[ActionEffect];
     bool hasEffectColorLoop = false;
-    bool hasAlert = map.contains("alert");
-    bool hasToggle = map.contains("toggle");
-    bool hasWrap = map.contains("wrap");
+    bool hasAlert = present[ActionAlert];
+    bool hasToggle = present[ActionToggle];
+    bool hasWrap = present[ActionWrap];
 
     bool on = false;
     bool targetOpen = false;
@@ -800,9 +876,9 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     uint ct = 0;
 
     // transition time
-    if (map.contains("transitiontime"))
+    if (present[ActionTransitionTime])
     {
-        uint tt = map["transitiontime"].toUInt(&ok);
+        uint tt = values[ActionTransitionTime].toUInt(&ok);
 
         if (ok && tt < 0xFFFFUL)
         {
@@ -813,17 +889,17 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     // toggle
     if (hasToggle)
     {
-        if (map["toggle"].type() == QVariant::Bool)
+        if (values[ActionToggle].type() == QVariant::Bool)
         {
-            if (map["toggle"] == true)
+            if (values[ActionToggle] == true)
             {
-                map["on"] = group->item(RStateAnyOn)->toBool() ? false : true;
+                values[ActionOn] = group->item(RStateAnyOn)->toBool() ? false : true;
                 hasOn = true;
             }
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/toggle").arg(id), QString("invalid value, %1, for parameter, toggle").arg(map["toggle"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/toggle").arg(id), QString("invalid value, %1, for parameter, toggle").arg(values[ActionToggle].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -833,28 +909,28 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     if (hasOn)
     {
         hasOn = false;
-        if (map["on"].type() == QVariant::Bool)
+        if (values[ActionOn].type() == QVariant::Bool)
         {
             hasOn = true;
-            on = map["on"].toBool();
+            on = values[ActionOn].toBool();
             group->setIsOn(on);
             quint16 ontime = 0;
             quint8 command = on ? ONOFF_COMMAND_ON : ONOFF_COMMAND_OFF;
             quint8 flags = 0;
             if (on)
             {
-                if (hasOnTime && map["ontime"].type() == QVariant::Double)
+                if (hasOnTime && values[ActionOnTime].type() == QVariant::Double)
                 {
-                    uint ot = map["ontime"].toUInt(&ok);
+                    uint ot = values[ActionOnTime].toUInt(&ok);
                     if (ok && ot <= 65535)
                     {
                         ontime = static_cast<quint16>(ot);
                         command = ONOFF_COMMAND_ON_WITH_TIMED_OFF;
                     }
 
-                    if (ok && map.contains("onoffcontrol"))
+                    if (ok && present[ActionOnOffControl])
                     {
-                        uint ooc = map["onoffcontrol"].toUInt(&ok);
+                        uint ooc = values[ActionOnOffControl].toUInt(&ok);
                         if (ok && ooc & 1) // accept only when on
                         {
                             flags |= 1;
@@ -911,7 +987,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/on").arg(id), QString("invalid value, %1, for parameter, on").arg(map["on"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/on").arg(id), QString("invalid value, %1, for parameter, on").arg(values[ActionOn].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -920,10 +996,10 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     if (hasOpen)
     {
         hasOpen = false;
-        if (map["open"].type() == QVariant::Bool)
+        if (values[ActionOpen].type() == QVariant::Bool)
         {
             hasOpen = true;
-            targetOpen = map["open"].toBool();
+            targetOpen = values[ActionOpen].toBool();
 
             TaskItem task;
             copyTaskReq(taskRef, task);
@@ -942,7 +1018,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/open").arg(id), QString("invalid value, %1, for parameter, on").arg(map["on"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/open").arg(id), QString("invalid value, %1, for parameter, on").arg(values[ActionOn].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -952,9 +1028,9 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     if (hasBri)
     {
         hasBri = false;
-        bri = map["bri"].toUInt(&ok);
+        bri = values[ActionBri].toUInt(&ok);
 
-        if ((map["bri"].type() == QVariant::String) && map["bri"].toString() == "stop")
+        if ((values[ActionBri].type() == QVariant::String) && values[ActionBri].toString() == "stop")
         {
             TaskItem task;
             copyTaskReq(taskRef, task);
@@ -962,7 +1038,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
             {
                 QVariantMap rspItem;
                 QVariantMap rspItemState;
-                rspItemState[QString("/groups/%1/action/bri").arg(id)] = map["bri"];
+                rspItemState[QString("/groups/%1/action/bri").arg(id)] = values[ActionBri];
                 rspItem["success"] = rspItemState;
                 rsp.list.append(rspItem);
                 taskToLocalData(task);
@@ -972,7 +1048,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
                 rsp.list.append(errorToMap(ERR_INTERNAL_ERROR, QString("/groups/%1").arg(id), QString("Internal error, %1").arg(ERR_BRIDGE_BUSY)));
             }
         }
-        else if (ok && (map["bri"].type() == QVariant::Double) && (bri < 256))
+        else if (ok && (values[ActionBri].type() == QVariant::Double) && (bri < 256))
         {
             hasBri = true;
             group->level = bri;
@@ -982,7 +1058,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
             {
                 QVariantMap rspItem;
                 QVariantMap rspItemState;
-                rspItemState[QString("/groups/%1/action/bri").arg(id)] = map["bri"];
+                rspItemState[QString("/groups/%1/action/bri").arg(id)] = values[ActionBri];
                 rspItem["success"] = rspItemState;
                 rsp.list.append(rspItem);
             }
@@ -993,7 +1069,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/bri").arg(id), QString("invalid value, %1, for parameter, bri").arg(map["bri"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/bri").arg(id), QString("invalid value, %1, for parameter, bri").arg(values[ActionBri].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1003,9 +1079,9 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     if (hasHue)
     {
         hasHue = false;
-        uint hue2 = map["hue"].toUInt(&ok);
+        uint hue2 = values[ActionHue].toUInt(&ok);
 
-        if (ok && (map["hue"].type() == QVariant::Double) && (hue2 <= MAX_ENHANCED_HUE))
+        if (ok && (values[ActionHue].type() == QVariant::Double) && (hue2 <= MAX_ENHANCED_HUE))
         {
             TaskItem task;
             copyTaskReq(taskRef, task);
@@ -1069,7 +1145,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
             {
                 QVariantMap rspItem;
                 QVariantMap rspItemState;
-                rspItemState[QString("/groups/%1/action/hue").arg(id)] = map["hue"];
+                rspItemState[QString("/groups/%1/action/hue").arg(id)] = values[ActionHue];
                 rspItem["success"] = rspItemState;
                 rsp.list.append(rspItem);
             }
@@ -1080,7 +1156,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/hue").arg(id), QString("invalid value, %1, for parameter, hue").arg(map["hue"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/hue").arg(id), QString("invalid value, %1, for parameter, hue").arg(values[ActionHue].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1090,9 +1166,9 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     if (hasSat)
     {
         hasSat = false;
-        uint sat2 = map["sat"].toUInt(&ok);
+        uint sat2 = values[ActionSat].toUInt(&ok);
 
-        if (ok && (map["sat"].type() == QVariant::Double) && (sat2 < 256))
+        if (ok && (values[ActionSat].type() == QVariant::Double) && (sat2 < 256))
         {
             hasSat = true;
             if (sat2 >= 255)
@@ -1142,7 +1218,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
             {
                 QVariantMap rspItem;
                 QVariantMap rspItemState;
-                rspItemState[QString("/groups/%1/action/sat").arg(id)] = map["sat"];
+                rspItemState[QString("/groups/%1/action/sat").arg(id)] = values[ActionSat];
                 rspItem["success"] = rspItemState;
                 rsp.list.append(rspItem);
             }
@@ -1153,7 +1229,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/sat").arg(id), QString("invalid value, %1, for parameter, sat").arg(map["sat"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/sat").arg(id), QString("invalid value, %1, for parameter, sat").arg(values[ActionSat].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1194,7 +1270,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     if (hasXy && supportColorModeXyForGroups)
     {
         hasXy = false;
-        QVariantList ls = map["xy"].toList();
+        QVariantList ls = values[ActionXy].toList();
 
         if ((ls.size() == 2) && (ls[0].type() == QVariant::Double) && (ls[1].type() == QVariant::Double))
         {
@@ -1213,7 +1289,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
             {
                 QVariantMap rspItem;
                 QVariantMap rspItemState;
-                rspItemState[QString("/groups/%1/action/xy").arg(id)] = map["xy"];
+                rspItemState[QString("/groups/%1/action/xy").arg(id)] = values[ActionXy];
                 rspItem["success"] = rspItemState;
                 rsp.list.append(rspItem);
                 hasXy = true;
@@ -1234,7 +1310,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/xy").arg(id), QString("invalid value, %1, for parameter, xy").arg(map["xy"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/xy").arg(id), QString("invalid value, %1, for parameter, xy").arg(values[ActionXy].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1243,13 +1319,13 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     // ct_inc
     if (hasCtInc)
     {
-        int ct_inc = map["ct_inc"].toInt(&ok);
+        int ct_inc = values[ActionCtInc].toInt(&ok);
 
         if (hasCt)
         {
             rsp.list.append(errorToMap(ERR_PARAMETER_NOT_MODIFIABLE, QString("/groups/%1").arg(id), QString("parameter, /lights/%1/ct_inc, is not modifiable. ct was specified.").arg(id)));
         }
-        else if (ok && (map["ct_inc"].type() == QVariant::Double) && (ct_inc >= -65534 && ct_inc <= 65534))
+        else if (ok && (values[ActionCtInc].type() == QVariant::Double) && (ct_inc >= -65534 && ct_inc <= 65534))
         {
             TaskItem task;
             copyTaskReq(taskRef, task);
@@ -1274,7 +1350,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/ct_inc").arg(id), QString("invalid value, %1, for parameter, ct_inc").arg(map["ct_inc"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/ct_inc").arg(id), QString("invalid value, %1, for parameter, ct_inc").arg(values[ActionCtInc].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1283,8 +1359,8 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     // bri_inc
     if (hasBriInc && !hasBri)
     {
-        int briInc = map["bri_inc"].toInt(&ok);
-        if (hasWrap && map["wrap"].type() == QVariant::Bool && map["wrap"].toBool() == true)
+        int briInc = values[ActionBriInc].toInt(&ok);
+        if (hasWrap && values[ActionWrap].type() == QVariant::Bool && values[ActionWrap].toBool() == true)
         {
             std::vector<LightNode>::iterator i = nodes.begin();
             std::vector<LightNode>::iterator end = nodes.end();
@@ -1319,7 +1395,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
             }
         }
 
-        if (ok && (map["bri_inc"].type() == QVariant::Double) && (briInc >= -254 && briInc <= 254))
+        if (ok && (values[ActionBriInc].type() == QVariant::Double) && (briInc >= -254 && briInc <= 254))
         {
             TaskItem task;
             copyTaskReq(taskRef, task);
@@ -1342,7 +1418,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/bri_inc").arg(id), QString("invalid value, %1, for parameter, bri_inc").arg(map["bri_inc"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/bri_inc").arg(id), QString("invalid value, %1, for parameter, bri_inc").arg(values[ActionBriInc].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1352,9 +1428,9 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     if (hasCt)
     {
         hasCt = false;
-        ct = map["ct"].toUInt(&ok);
+        ct = values[ActionCt].toUInt(&ok);
 
-        if (ok && (map["ct"].type() == QVariant::Double))
+        if (ok && (values[ActionCt].type() == QVariant::Double))
         {
             TaskItem task;
             copyTaskReq(taskRef, task);
@@ -1365,7 +1441,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
                 hasCt = true;
                 QVariantMap rspItem;
                 QVariantMap rspItemState;
-                rspItemState[QString("/groups/%1/action/ct").arg(id)] = map["ct"];
+                rspItemState[QString("/groups/%1/action/ct").arg(id)] = values[ActionCt];
                 rspItem["success"] = rspItemState;
                 rsp.list.append(rspItem);
             }
@@ -1376,7 +1452,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/ct").arg(id), QString("invalid value, %1, for parameter, ct").arg(map["ct"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/ct").arg(id), QString("invalid value, %1, for parameter, ct").arg(values[ActionCt].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1387,7 +1463,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     {
         TaskItem task;
         copyTaskReq(taskRef, task);
-        QString alert = map["alert"].toString();
+        QString alert = values[ActionAlert].toString();
 
         if (alert == "none")
         {
@@ -1436,7 +1512,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/alert").arg(id), QString("invalid value, %1, for parameter, alert").arg(map["alert"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/alert").arg(id), QString("invalid value, %1, for parameter, alert").arg(values[ActionAlert].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -1449,7 +1525,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         {
             QVariantMap rspItem;
             QVariantMap rspItemState;
-            rspItemState[QString("/groups/%1/action/alert").arg(id)] = map["alert"];
+            rspItemState[QString("/groups/%1/action/alert").arg(id)] = values[ActionAlert];
             rspItem["success"] = rspItemState;
             rsp.list.append(rspItem);
         }
@@ -1462,7 +1538,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
     // colorloop
     if (hasEffect)
     {
-        QString effect = map["effect"].toString();
+        QString effect = values[ActionEffect].toString();
 
         if ((effect == "none") || (effect == "colorloop"))
         {
@@ -1471,10 +1547,10 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
 
             if (hasEffectColorLoop)
             {
-                if (map.contains("colorloopspeed"))
+                if (present[ActionColorloopSpeed])
                 {
-                    speed = map["colorloopspeed"].toUInt(&ok);
-                    if (ok && (map["colorloopspeed"].type() == QVariant::Double) && (speed < 256) && (speed > 0))
+                    speed = values[ActionColorloopSpeed].toUInt(&ok);
+                    if (ok && (values[ActionColorloopSpeed].type() == QVariant::Double) && (speed < 256) && (speed > 0))
                     {
                         // ok
                         std::vector<LightNode>::iterator i = nodes.begin();
@@ -1490,7 +1566,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
                     }
                     else
                     {
-                        rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/lights/%1/state/colorloopspeed").arg(id), QString("invalid value, %1, for parameter, colorloopspeed").arg(map["colorloopspeed"].toString())));
+                        rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/lights/%1/state/colorloopspeed").arg(id), QString("invalid value, %1, for parameter, colorloopspeed").arg(values[ActionColorloopSpeed].toString())));
                     }
                 }
             }
@@ -1501,7 +1577,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
             {
                 QVariantMap rspItem;
                 QVariantMap rspItemState;
-                rspItemState[QString("/groups/%1/action/effect").arg(id)] = map["effect"];
+                rspItemState[QString("/groups/%1/action/effect").arg(id)] = values[ActionEffect];
                 rspItem["success"] = rspItemState;
                 rsp.list.append(rspItem);
                 taskToLocalData(task);
@@ -1513,7 +1589,7 @@ int DeRestPluginPrivate::setGroupState(const ApiRequest &req, ApiResponse &rsp)
         }
         else
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/effect").arg(id), QString("invalid value, %1, for parameter, effect").arg(map["effect"].toString())));
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/groups/%1/action/effect").arg(id), QString("invalid value, %1, for parameter, effect").arg(values[ActionEffect].toString())));
             rsp.httpStatus = HttpStatusBadRequest;
             return REQ_READY_SEND;
         }
@@ -3502,7 +3578,7 @@ void DeRestPluginPrivate::handleGroupEvent(const Event &e)
             if (!state.isEmpty())
             {
                 map["state"] = state;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map);
                 updateGroupEtag(group);
                 plugin->saveDatabaseItems |= DB_GROUPS;
                 plugin->queSaveDb(DB_GROUPS, DB_SHORT_SAVE_DELAY);
@@ -3521,7 +3597,7 @@ void DeRestPluginPrivate::handleGroupEvent(const Event &e)
             map["id"] = group->id();
             map[e.what() + 5] = item->toVariant();
 
-            webSocketServer->broadcastTextMessage(Json::serialize(map));
+            webSocketServer->broadcastEvent(map);
         }
     }
     else if (e.what() == REventAdded)
@@ -3532,7 +3608,7 @@ void DeRestPluginPrivate::handleGroupEvent(const Event &e)
         map["r"] = QLatin1String("groups");
         map["id"] = e.id();
 
-        webSocketServer->broadcastTextMessage(Json::serialize(map));
+        webSocketServer->broadcastEvent(map);
     }
     else if (e.what() == REventDeleted)
     {
@@ -3542,6 +3618,6 @@ void DeRestPluginPrivate::handleGroupEvent(const Event &e)
         map["r"] = QLatin1String("groups");
         map["id"] = e.id();
 
-        webSocketServer->broadcastTextMessage(Json::serialize(map));
+        webSocketServer->broadcastEvent(map);
     }
 }
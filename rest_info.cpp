@@ -8,6 +8,8 @@
  *
  */
 
+#include <QHostAddress>
+#include <QTcpSocket>
 #include "de_web_plugin.h"
 #include "de_web_plugin_private.h"
 
@@ -24,6 +26,26 @@ int DeRestPluginPrivate::handleInfoApi(const ApiRequest &req, ApiResponse &rsp)
     {
         return getInfoTimezones(req, rsp);
     }
+    // GET /api/<apikey>/info/events
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[3] == "events"))
+    {
+        return getInfoEvents(req, rsp);
+    }
+    // GET /api/<apikey>/info/connections
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[3] == "connections"))
+    {
+        return getInfoConnections(req, rsp);
+    }
+    // GET /api/<apikey>/info/websockets
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[3] == "websockets"))
+    {
+        return getInfoWebsockets(req, rsp);
+    }
+    // GET /api/<apikey>/info/rules
+    else if ((req.path.size() == 4) && (req.hdr.method() == "GET") && (req.path[3] == "rules"))
+    {
+        return getInfoRuleLatency(req, rsp);
+    }
 
     return REQ_NOT_HANDLED;
 }
@@ -41,3 +63,145 @@ int DeRestPluginPrivate::getInfoTimezones(const ApiRequest &req, ApiResponse &rs
     rsp.httpStatus = HttpStatusOk;
     return REQ_READY_SEND;
 }
+
+/*! GET /api/<apikey>/info/events
+    Returns the event queue statistics of the EventEmitter.
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getInfoEvents(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    if (!eventEmitter)
+    {
+        return REQ_NOT_HANDLED;
+    }
+
+    const EventEmitterStats &stats = eventEmitter->stats();
+    const char *names[EventClassMax] = { "urgent", "device", "resource" };
+
+    QVariantMap queues;
+
+    for (int ec = 0; ec < EventClassMax; ec++)
+    {
+        const EventQueueStats &q = stats.queues[ec];
+        QVariantMap queue;
+
+        queue[QLatin1String("depth")] = q.depth;
+        queue[QLatin1String("highwater")] = q.highWater;
+        queue[QLatin1String("capacity")] = eventEmitter->capacity(EventClass(ec));
+        queue[QLatin1String("budgetms")] = eventEmitter->budget(EventClass(ec));
+        queue[QLatin1String("processed")] = double(q.processed);
+        queue[QLatin1String("duplicates")] = double(q.duplicates);
+        queue[QLatin1String("grown")] = double(q.grown);
+        queue[QLatin1String("dropped")] = double(q.dropped);
+        queue[QLatin1String("deferred")] = double(q.deferred);
+
+        queues[QLatin1String(names[ec])] = queue;
+    }
+
+    rsp.map[QLatin1String("queues")] = queues;
+    rsp.map[QLatin1String("iterations")] = double(stats.iterations);
+    rsp.map[QLatin1String("lastiterationus")] = double(stats.lastIterationUs);
+    rsp.map[QLatin1String("maxiterationus")] = double(stats.maxIterationUs);
+
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! GET /api/<apikey>/info/connections
+    \return REQ_READY_SEND
+ */
+int DeRestPluginPrivate::getInfoConnections(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    QVariantList clients;
+    const auto &connections = httpConnections.connections();
+
+    for (auto i = connections.cbegin(); i != connections.cend(); ++i)
+    {
+        const HttpConnection &con = i.value();
+        if (con.closing || !con.sock)
+        {
+            continue;
+        }
+
+        QVariantMap client;
+        client[QLatin1String("address")] = con.sock->peerAddress().toString();
+        client[QLatin1String("port")] = double(con.sock->peerPort());
+        client[QLatin1String("requests")] = double(con.requests);
+        clients.append(client);
+    }
+
+    rsp.map[QLatin1String("clients")] = clients;
+    rsp.map[QLatin1String("connections")] = double(connections.size());
+    rsp.map[QLatin1String("requests")] = double(httpConnections.totalRequests());
+    rsp.map[QLatin1String("closed")] = double(httpConnections.totalClosed());
+
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! GET /api/<apikey>/info/websockets
+    Returns the send queue state of each websocket client.
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getInfoWebsockets(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    if (!webSocketServer)
+    {
+        return REQ_NOT_HANDLED;
+    }
+
+    QVariantList clients;
+
+#ifdef USE_WEBSOCKETS
+    for (const WebSocketClient &client : webSocketServer->clients())
+    {
+        QVariantMap map;
+        map[QLatin1String("address")] = client.sock->peerAddress().toString();
+        map[QLatin1String("port")] = double(client.sock->peerPort());
+        map[QLatin1String("sent")] = double(client.sent);
+        map[QLatin1String("pendingbytes")] = double(client.pendingBytes);
+        map[QLatin1String("queued")] = double(client.queue.size());
+        map[QLatin1String("lagms")] = double(webSocketServer->lag(client));
+        map[QLatin1String("coalesced")] = double(client.queue.coalesced());
+        map[QLatin1String("dropped")] = double(client.queue.dropped());
+        clients.append(map);
+    }
+#endif
+
+    rsp.list = clients;
+    if (rsp.list.isEmpty())
+    {
+        rsp.str = QLatin1String("[]"); // return empty list
+    }
+
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
+
+/*! GET /api/<apikey>/info/rules
+    Returns latency histograms of the rule engine, from the APS indication
+    which created an event to the APS requests sent by the triggered rules.
+    \return REQ_READY_SEND
+            REQ_NOT_HANDLED
+ */
+int DeRestPluginPrivate::getInfoRuleLatency(const ApiRequest &req, ApiResponse &rsp)
+{
+    Q_UNUSED(req);
+
+    rsp.map[QLatin1String("eventqueue")] = ruleLatency[RuleLatencyEventQueue].toMap();
+    rsp.map[QLatin1String("evaluate")] = ruleLatency[RuleLatencyEvaluate].toMap();
+    rsp.map[QLatin1String("trigger")] = ruleLatency[RuleLatencyTrigger].toMap();
+    rsp.map[QLatin1String("taskqueue")] = ruleLatency[RuleLatencyTaskQueue].toMap();
+    rsp.map[QLatin1String("total")] = ruleLatency[RuleLatencyTotal].toMap();
+
+    rsp.httpStatus = HttpStatusOk;
+    return REQ_READY_SEND;
+}
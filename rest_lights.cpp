@@ -18,8 +18,10 @@
 #include "de_web_plugin_private.h"
 #include "device_descriptions.h"
 #include "json.h"
+#include "json_reader.h"
 #include "colorspace.h"
 #include "product_match.h"
+#include "utils/utils.h"
 
 /*! Lights REST API broker.
     \param req - request data
@@ -93,7 +95,8 @@ int DeRestPluginPrivate::handleLightsApi(const ApiRequest &req, ApiResponse &rsp
     return REQ_NOT_HANDLED;
 }
 
-/*! GET /api/<apikey>/lights
+/*! GET /api/<apikey>/lights[?since=<version>]
+    With since only lights changed after the version are returned, deleted ones as null.
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
@@ -115,13 +118,28 @@ int DeRestPluginPrivate::getAllLights(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
+    const quint64 since = req.sinceVersion();
+
     std::vector<LightNode>::const_iterator i = nodes.begin();
     std::vector<LightNode>::const_iterator end = nodes.end();
 
     for (; i != end; ++i)
     {
+        if (since > 0)
+        {
+            const quint64 version = U_EtagVersion(i->etag);
+            if (version != 0 && version <= since)
+            {
+                continue; // unchanged
+            }
+        }
+
         if (i->state() == LightNode::StateDeleted)
         {
+            if (since > 0)
+            {
+                rsp.map[i->id()] = QVariant();
+            }
             continue;
         }
 
@@ -507,7 +525,8 @@ bool DeRestPluginPrivate::lightToMap(const ApiRequest &req, const LightNode *lig
     return true;
 }
 
-/*! GET /api/<apikey>/lights/<id>/data?maxrecords=<maxrecords>&fromtime=<ISO 8601>
+/*! GET /api/<apikey>/lights/<id>/data?maxrecords=<maxrecords>&fromtime=<ISO 8601>[&totime=<ISO 8601>][&bucket=<seconds>]
+    With bucket each record contains min, max, avg, last and count of the bucket instead of the raw value.
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
@@ -552,10 +571,34 @@ int DeRestPluginPrivate::getLightData(const ApiRequest &req, ApiResponse &rsp)
     }
 
     const qint64 fromTime = dt.toMSecsSinceEpoch() / 1000;
+    qint64 toTime = QDateTime::currentMSecsSinceEpoch() / 1000;
 
-    openDb();
-    loadLightDataFromDb(lightNode, rsp.list, fromTime, maxRecords);
-    closeDb();
+    if (query.hasQueryItem(QLatin1String("totime")))
+    {
+        dt = QDateTime::fromString(query.queryItemValue(QLatin1String("totime")), QLatin1String("yyyy-MM-ddTHH:mm:ss"));
+        if (!dt.isValid())
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QLatin1String("/totime"), QString("invalid value, %1, for parameter, totime").arg(query.queryItemValue("totime"))));
+            rsp.httpStatus = HttpStatusNotFound;
+            return REQ_READY_SEND;
+        }
+        toTime = dt.toMSecsSinceEpoch() / 1000;
+    }
+
+    qint64 bucket = 0;
+
+    if (query.hasQueryItem(QLatin1String("bucket")))
+    {
+        bucket = query.queryItemValue(QLatin1String("bucket")).toLongLong(&ok);
+        if (!ok || bucket <= 0)
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QLatin1String("/bucket"), QString("invalid value, %1, for parameter, bucket").arg(query.queryItemValue("bucket"))));
+            rsp.httpStatus = HttpStatusNotFound;
+            return REQ_READY_SEND;
+        }
+    }
+
+    loadLightDataFromDb(lightNode, rsp.list, fromTime, toTime, maxRecords, bucket);
 
     if (rsp.list.isEmpty())
     {
@@ -626,6 +669,35 @@ static void copyTaskReq(TaskItem &a, TaskItem &b)
     b.lightNode = a.lightNode;
 }
 
+/*! Parameters of PUT /lights/<id>/state, the body keys are matched with JsonReader::isKey(). */
+enum LightStateParam
+{
+    ParamOn,
+    ParamBri,
+    ParamBriInc,
+    ParamXy,
+    ParamCt,
+    ParamCtInc,
+    ParamHue,
+    ParamSat,
+    ParamEffect,
+    ParamMusicSync,
+    ParamColorloopSpeed,
+    ParamGradient,
+    ParamColorMode,
+    ParamAlert,
+    ParamSpeed,
+    ParamTransitionTime,
+    ParamOnTime,
+    ParamWrap,
+    ParamUnknown
+};
+
+static const char *const lightStateParams[ParamUnknown] = {
+    "on", "bri", "bri_inc", "xy", "ct", "ct_inc", "hue", "sat", "effect", "music_sync",
+    "colorloopspeed", "gradient", "colormode", "alert", "speed", "transitiontime", "ontime", "wrap"
+};
+
 /*! PUT, PATCH /api/<apikey>/lights/<id>/state
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
@@ -674,32 +746,24 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
     taskRef.onTime = 0;
 
     bool ok;
-    QVariant var = Json::parse(req.content, ok);
-    QVariantMap map = var.toMap();
-
-    if (!ok || map.isEmpty())
-    {
-        rsp.list.append(errorToMap(ERR_INVALID_JSON, QString("/lights/%1/state").arg(id), QString("body contains invalid JSON")));
-        rsp.httpStatus = HttpStatusBadRequest;
-        return REQ_READY_SEND;
-    }
+    int (DeRestPluginPrivate::*setDeviceState)(const ApiRequest &, ApiResponse &, TaskItem &, QVariantMap &) = nullptr;
 
     // FIXME: use cluster instead of device type.
     if (taskRef.lightNode->type() == QLatin1String("Window covering controller") ||
         taskRef.lightNode->type() == QLatin1String("Window covering device"))
     {
-        return setWindowCoveringState(req, rsp, taskRef, map);
+        setDeviceState = &DeRestPluginPrivate::setWindowCoveringState;
     }
     else if (isXmasLightStrip(taskRef.lightNode))
     {
-        return setXmasLightStripState(req, rsp, taskRef, map);
+        setDeviceState = &DeRestPluginPrivate::setXmasLightStripState;
     }
     else if (UseTuyaCluster(taskRef.lightNode->manufacturer()))
     {
         //tuya window covering
         if (R_GetProductId(taskRef.lightNode).startsWith(QLatin1String("Tuya_COVD")))
         {
-            return setWindowCoveringState(req, rsp, taskRef, map);
+            setDeviceState = &DeRestPluginPrivate::setWindowCoveringState;
         }
         // light, don't use tuya stuff (for the moment)
         else if (taskRef.lightNode->item(RStateColorMode))
@@ -712,16 +776,41 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
         //switch and siren
         else
         {
-            return setTuyaDeviceState(req, rsp, taskRef, map);
+            setDeviceState = &DeRestPluginPrivate::setTuyaDeviceState;
         }
     }
     else if (taskRef.lightNode->type() == QLatin1String("Warning device")) // Put it here because some tuya device are Warning device but need to be process by tuya part
     {
-        return setWarningDeviceState(req, rsp, taskRef, map);
+        setDeviceState = &DeRestPluginPrivate::setWarningDeviceState;
     }
     else if (taskRef.lightNode->type() == QLatin1String("Door Lock"))
     {
-        return setDoorLockState(req, rsp, taskRef, map);
+        setDeviceState = &DeRestPluginPrivate::setDoorLockState;
+    }
+
+    if (setDeviceState)
+    {
+        QVariantMap map = req.parseContent(ok).toMap();
+
+        if (!ok || map.isEmpty())
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_JSON, QString("/lights/%1/state").arg(id), QString("body contains invalid JSON")));
+            rsp.httpStatus = HttpStatusBadRequest;
+            return REQ_READY_SEND;
+        }
+
+        return (this->*setDeviceState)(req, rsp, taskRef, map);
+    }
+
+    // common lights read the body in place, without building a QVariantMap
+    const QByteArray body = req.contentUtf8.isEmpty() ? req.content.toUtf8() : req.contentUtf8;
+    JsonReader json(body);
+
+    if (json.next() != JsonReader::TokenBeginObject)
+    {
+        rsp.list.append(errorToMap(ERR_INVALID_JSON, QString("/lights/%1/state").arg(id), QString("body contains invalid JSON")));
+        rsp.httpStatus = HttpStatusBadRequest;
+        return REQ_READY_SEND;
     }
 
     const QStringList *alertList = &RStateAlertValuesTriggerEffect; // TODO: check RCapAlertTriggerEffect
@@ -767,31 +856,46 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
     bool hasSpeed = false;
     quint8 targetSpeed = 0;
     bool hasTransitionTime = false;
+    bool hasParam = false;
 
     // Check parameters.
-    for (QVariantMap::const_iterator p = map.begin(); p != map.end(); p++)
+    while (json.next() == JsonReader::TokenKey)
     {
         bool paramOk = false;
         bool valueOk = false;
-        QString param = p.key();
-        if (param == "on" && taskRef.lightNode->item(RStateOn))
+        int param = ParamOn;
+        while (param < ParamUnknown && !json.isKey(lightStateParams[param]))
+        {
+            param++;
+        }
+        const QString unknownParam = param == ParamUnknown ? json.toString() : QString();
+
+        json.next();
+        const QVariant value = json.readVariant();
+        if (json.hasError())
+        {
+            break;
+        }
+        hasParam = true;
+
+        if (param == ParamOn && taskRef.lightNode->item(RStateOn))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::Bool)
+            if (value.type() == QVariant::Bool)
             {
                 valueOk = true;
                 hasOn = true;
-                targetOn = map[param].toBool();
+                targetOn = value.toBool();
             }
         }
-        else if (param == "bri" && taskRef.lightNode->item(RStateBri))
+        else if (param == ParamBri && taskRef.lightNode->item(RStateBri))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::Double)
+            if (value.type() == QVariant::Double)
             {
-                const uint bri = map[param].toUInt(&ok);
+                const uint bri = value.toUInt(&ok);
                 if (ok && bri <= 0xFF)
                 {
                     valueOk = true;
@@ -800,13 +904,13 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "bri_inc"  && taskRef.lightNode->item(RStateBri))
+        else if (param == ParamBriInc  && taskRef.lightNode->item(RStateBri))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::Double)
+            if (value.type() == QVariant::Double)
             {
-                const int briInc = map[param].toInt(&ok);
+                const int briInc = value.toInt(&ok);
                 if (ok && briInc >= -0xFF && briInc <= 0xFF)
                 {
                     valueOk = true;
@@ -815,15 +919,15 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "xy"  && taskRef.lightNode->item(RStateX) && taskRef.lightNode->item(RStateY) &&
+        else if (param == ParamXy  && taskRef.lightNode->item(RStateX) && taskRef.lightNode->item(RStateY) &&
                  taskRef.lightNode->modelId() != QLatin1String("FLS-PP"))
         {
             // @manup: is check for FLS-PP needed, or is this already handled by check for state.x and state.y?
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::List)
+            if (value.type() == QVariant::List)
             {
-                QVariantList xy = map["xy"].toList();
+                QVariantList xy = value.toList();
                 if (xy[0].type() == QVariant::Double && xy[1].type() == QVariant::Double)
                 {
                     const double x = xy[0].toDouble(&ok);
@@ -843,16 +947,16 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "ct") // FIXME workaround for lights that support color tempeature, but API doesn't expose ct.
-        // else if (param == "ct"  && (taskRef.lightNode->item(RStateCt))
+        else if (param == ParamCt) // FIXME workaround for lights that support color tempeature, but API doesn't expose ct.
+        // else if (param == ParamCt  && (taskRef.lightNode->item(RStateCt))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::Double)
+            if (value.type() == QVariant::Double)
             {
                 const quint16 ctMin = taskRef.lightNode->toNumber(RCapColorCtMin);
                 const quint16 ctMax = taskRef.lightNode->toNumber(RCapColorCtMax);
-                const uint ct = map[param].toUInt(&ok);
+                const uint ct = value.toUInt(&ok);
                 if (ok && ct <= 0xFFFF)
                 {
                     valueOk = true;
@@ -861,16 +965,16 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "ct_inc"  && taskRef.lightNode->item(RStateCt))
+        else if (param == ParamCtInc  && taskRef.lightNode->item(RStateCt))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::Double)
+            if (value.type() == QVariant::Double)
             {
                 int ct = taskRef.lightNode->toNumber(RStateCt);
                 const quint16 ctMin = taskRef.lightNode->toNumber(RCapColorCtMin);
                 const quint16 ctMax = taskRef.lightNode->toNumber(RCapColorCtMax);
-                const int ctInc = map[param].toInt(&ok);
+                const int ctInc = value.toInt(&ok);
                 if (ok && ctInc >= -0xFFFF && ctInc <= 0xFFFF)
                 {
                     valueOk = true;
@@ -882,11 +986,11 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "hue" && taskRef.lightNode->item(RStateHue) && taskRef.lightNode->item(RStateSat))
+        else if (param == ParamHue && taskRef.lightNode->item(RStateHue) && taskRef.lightNode->item(RStateSat))
         {
             paramOk = true;
             hasCmd = true;
-            const uint hue = map[param].toUInt(&ok);
+            const uint hue = value.toUInt(&ok);
             if (ok && hue <= 0xFFFF)
             {
                 valueOk = true;
@@ -894,11 +998,11 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 targetHue = hue; // Funny: max CurrentHue is 0xFE, max EnhancedCurrentHue is 0xFFFF
             }
         }
-        else if (param == "sat" && taskRef.lightNode->item(RStateHue) && taskRef.lightNode->item(RStateSat))
+        else if (param == ParamSat && taskRef.lightNode->item(RStateHue) && taskRef.lightNode->item(RStateSat))
         {
             paramOk = true;
             hasCmd = true;
-            const uint sat = map[param].toUInt(&ok);
+            const uint sat = value.toUInt(&ok);
             if (ok && sat <= 0xFF)
             {
                 valueOk = true;
@@ -906,31 +1010,31 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 targetSat = sat > 0xFE ? 0xFE : sat;
             }
         }
-        else if (param == "effect" && taskRef.lightNode->item(RStateEffect))
+        else if (param == ParamEffect && taskRef.lightNode->item(RStateEffect))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::String)
+            if (value.type() == QVariant::String)
             {
-                effect = effectList.indexOf(map[param].toString());
+                effect = effectList.indexOf(value.toString());
                 valueOk = effect >= 0;
             }
         }
-        else if (param == "music_sync" && taskRef.lightNode->item(RStateMusicSync))
+        else if (param == ParamMusicSync && taskRef.lightNode->item(RStateMusicSync))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::Bool)
+            if (value.type() == QVariant::Bool)
             {
                 valueOk = true;
                 hasMusicSync = true;
-                targetMusicSync = map[param].toBool();
+                targetMusicSync = value.toBool();
             }
         }
-        else if (param == "colorloopspeed" && taskRef.lightNode->item(RStateEffect))
+        else if (param == ParamColorloopSpeed && taskRef.lightNode->item(RStateEffect))
         {
             paramOk = true;
-            const uint speed = map[param].toUInt(&ok);
+            const uint speed = value.toUInt(&ok);
             if (ok && speed <= 0xFFFF)
             {
                 valueOk = true;
@@ -938,13 +1042,13 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 colorloopSpeed = speed < 1 ? 1 : speed;
             }
         }
-        else if (param == "gradient" && taskRef.lightNode->item(RStateGradient))
+        else if (param == ParamGradient && taskRef.lightNode->item(RStateGradient))
         {
             quint16 styleBitmap = taskRef.lightNode->toNumber(RCapColorGradientStyles);
             paramOk = true;
-            if (map[param].type() == QVariant::Map)
+            if (value.type() == QVariant::Map)
             {
-                gradient = map[param].toMap();
+                gradient = value.toMap();
                 if (validateHueGradient(req, rsp, gradient, styleBitmap))
                 {
                     hasCmd = true;
@@ -953,29 +1057,29 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 valueOk = true;
             }
         }
-        else if (param == "colormode" && taskRef.lightNode->item(RStateColorMode))
+        else if (param == ParamColorMode && taskRef.lightNode->item(RStateColorMode))
         {
             paramOk = true;
             valueOk = true;
-            rsp.list.append(errorToMap(ERR_PARAMETER_NOT_MODIFIABLE, QString("/lights/%1/state/colormode").arg(id).arg(param), QString("parameter, colormode, is not modifiable.")));
+            rsp.list.append(errorToMap(ERR_PARAMETER_NOT_MODIFIABLE, QString("/lights/%1/state/colormode").arg(id), QString("parameter, colormode, is not modifiable.")));
         }
-        else if (param == "alert" && taskRef.lightNode->item(RStateAlert))
+        else if (param == ParamAlert && taskRef.lightNode->item(RStateAlert))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::String)
+            if (value.type() == QVariant::String)
             {
-                alert = map[param].toString();
+                alert = value.toString();
                 valueOk = alertList->contains(alert);
             }
         }
-        else if (param == "speed" && taskRef.lightNode->item(RStateSpeed))
+        else if (param == ParamSpeed && taskRef.lightNode->item(RStateSpeed))
         {
             paramOk = true;
             hasCmd = true;
-            if (map[param].type() == QVariant::Double)
+            if (value.type() == QVariant::Double)
             {
-                const uint speed = map[param].toUInt(&ok);
+                const uint speed = value.toUInt(&ok);
                 if (ok && speed <= 0xFF)
                 {
                     valueOk = true;
@@ -984,12 +1088,12 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "transitiontime")
+        else if (param == ParamTransitionTime)
         {
             paramOk = true;
-            if (map[param].type() == QVariant::Double)
+            if (value.type() == QVariant::Double)
             {
-                const uint tt = map[param].toUInt(&ok);
+                const uint tt = value.toUInt(&ok);
                 if (ok && tt <= 0xFFFF)
                 {
                     valueOk = true;
@@ -998,12 +1102,12 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "ontime")
+        else if (param == ParamOnTime)
         {
             paramOk = true;
-            if (map[param].type() == QVariant::Double)
+            if (value.type() == QVariant::Double)
             {
-                const uint ot = map[param].toUInt(&ok);
+                const uint ot = value.toUInt(&ok);
                 if (ok && ot <= 0xFFFF)
                 {
                     valueOk = true;
@@ -1011,25 +1115,37 @@ int DeRestPluginPrivate::setLightState(const ApiRequest &req, ApiResponse &rsp)
                 }
             }
         }
-        else if (param == "wrap")
+        else if (param == ParamWrap)
         {
             paramOk = true;
-            if (map[param].type() == QVariant::Bool)
+            if (value.type() == QVariant::Bool)
             {
                 valueOk = true;
                 hasWrap = true;
-                wrap = map[param].toBool();
+                wrap = value.toBool();
             }
         }
-        if (!paramOk)
-        {
-            rsp.list.append(errorToMap(ERR_PARAMETER_NOT_AVAILABLE, QString("/lights/%1/state/%2").arg(id).arg(param), QString("parameter, %1, not available").arg(param)));
-        }
-        else if (!valueOk)
+        if (!paramOk || !valueOk)
         {
-            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/lights/%1/state/%2").arg(id).arg(param), QString("invalid value, %1, for parameter, %2").arg(map[param].toString()).arg(param)));
+            const QString paramName = param == ParamUnknown ? unknownParam : QString(QLatin1String(lightStateParams[param]));
+            if (!paramOk)
+            {
+                rsp.list.append(errorToMap(ERR_PARAMETER_NOT_AVAILABLE, QString("/lights/%1/state/%2").arg(id).arg(paramName), QString("parameter, %1, not available").arg(paramName)));
+            }
+            else
+            {
+                rsp.list.append(errorToMap(ERR_INVALID_VALUE, QString("/lights/%1/state/%2").arg(id).arg(paramName), QString("invalid value, %1, for parameter, %2").arg(value.toString()).arg(paramName)));
+            }
         }
     }
+    if (json.hasError() || !hasParam)
+    {
+        rsp.list.clear();
+        rsp.list.append(errorToMap(ERR_INVALID_JSON, QString("/lights/%1/state").arg(id), QString("body contains invalid JSON")));
+        rsp.httpStatus = HttpStatusBadRequest;
+        return REQ_READY_SEND;
+    }
+
     if (taskRef.onTime > 0 && !hasOn && alert.isEmpty())
     {
         rsp.list.append(errorToMap(ERR_MISSING_PARAMETER, QString("/lights/%1/state").arg(id), QString("missing parameter, on or alert, for parameter, ontime")));
@@ -3822,6 +3938,8 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
             QVariantMap configOn;
 
             QVariantMap state;
+            WebSocketEventItems stateItems;
+            stateItems.prefix = "state/";
             ResourceItem *ialert = nullptr;
             const QStringList *capabilitiesAlerts = &RStateAlertValues;
             ResourceItem *ix = nullptr;
@@ -3912,9 +4030,9 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
                     else if (rid.suffix == RConfigOnStartup) { configOn["startup"] = item->toNumber() == 0xFF ? QVariant(QLatin1String("previous")) : item->toBool(); }
                     else if (rid.suffix == RConfigReversed) { config["reversed"] = item->toBool(); }
                     else if (rid.suffix == RConfigSpeed) { config["speed"] = item->toNumber(); }
-                    else if (rid.suffix == RStateBri) { state["bri"] = item->toNumber(); }
+                    else if (rid.suffix == RStateBri) { state["bri"] = item->toNumber(); stateItems.items.push_back(item); }
                     else if (rid.suffix == RStateColorMode) { state["colormode"] = item->toString(); }
-                    else if (rid.suffix == RStateCt) { state["ct"] = item->toNumber(); }
+                    else if (rid.suffix == RStateCt) { state["ct"] = item->toNumber(); stateItems.items.push_back(item); }
                     else if (rid.suffix == RStateEffect) { state["effect"] = item->toString(); }
                     else if (rid.suffix == RStateGradient)
                     {
@@ -3926,15 +4044,15 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
                             state["gradient"] = map;
                         }
                     }
-                    else if (rid.suffix == RStateHue) { state["hue"] = item->toNumber(); }
-                    else if (rid.suffix == RStateLift) { state["lift"] = item->toNumber(); }
-                    else if (rid.suffix == RStateOn) { state["on"] = item->toBool(); }
-                    else if (rid.suffix == RStateOpen) { state["open"] = item->toBool(); }
-                    else if (rid.suffix == RStateMusicSync) { state["music_sync"] = item->toBool(); }
-                    else if (rid.suffix == RStateReachable) { state["reachable"] = item->toBool(); }
-                    else if (rid.suffix == RStateSat) { state["sat"] = item->toNumber(); }
-                    else if (rid.suffix == RStateSpeed) { state["speed"] = item->toNumber(); }
-                    else if (rid.suffix == RStateTilt) { state["tilt"] = item->toNumber(); }
+                    else if (rid.suffix == RStateHue) { state["hue"] = item->toNumber(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateLift) { state["lift"] = item->toNumber(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateOn) { state["on"] = item->toBool(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateOpen) { state["open"] = item->toBool(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateMusicSync) { state["music_sync"] = item->toBool(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateReachable) { state["reachable"] = item->toBool(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateSat) { state["sat"] = item->toNumber(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateSpeed) { state["speed"] = item->toNumber(); stateItems.items.push_back(item); }
+                    else if (rid.suffix == RStateTilt) { state["tilt"] = item->toNumber(); stateItems.items.push_back(item); }
                     else
                     {
                         item->clearNeedPush();
@@ -4068,7 +4186,7 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
                 map["id"] = e.id();
                 map["uniqueid"] = lightNode->uniqueId();
                 map["attr"] = attr;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map);
                 updateLightEtag(lightNode);
                 plugin->saveDatabaseItems |= DB_LIGHTS;
                 plugin->queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -4093,7 +4211,7 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
                 map["id"] = e.id();
                 map["uniqueid"] = lightNode->uniqueId();
                 map["capabilities"] = capabilities;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map);
                 updateLightEtag(lightNode);
                 plugin->saveDatabaseItems |= DB_LIGHTS;
                 plugin->queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -4114,7 +4232,7 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
                 map["id"] = e.id();
                 map["uniqueid"] = lightNode->uniqueId();
                 map["config"] = config;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map);
                 updateLightEtag(lightNode);
                 plugin->saveDatabaseItems |= DB_LIGHTS;
                 plugin->queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -4129,7 +4247,7 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
                 map["id"] = e.id();
                 map["uniqueid"] = lightNode->uniqueId();
                 map["state"] = state;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map, stateItems);
                 updateLightEtag(lightNode);
                 plugin->saveDatabaseItems |= DB_LIGHTS;
                 plugin->queSaveDb(DB_LIGHTS, DB_SHORT_SAVE_DELAY);
@@ -4157,7 +4275,7 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
         map["uniqueid"] = lightNode->uniqueId();
         map["light"] = lmap;
 
-        webSocketServer->broadcastTextMessage(Json::serialize(map));
+        webSocketServer->broadcastEvent(map);
     }
     else if (e.what() == REventDeleted)
     {
@@ -4168,7 +4286,7 @@ void DeRestPluginPrivate::handleLightEvent(const Event &e)
         map["id"] = e.id();
         map["uniqueid"] = lightNode->uniqueId();
 
-        webSocketServer->broadcastTextMessage(Json::serialize(map));
+        webSocketServer->broadcastEvent(map);
     }
 }
 
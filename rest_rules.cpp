@@ -19,6 +19,7 @@
 #include "de_web_plugin_private.h"
 #include "json.h"
 #include "rest_alarmsystems.h"
+#include "rule_engine.h"
 
 #define MAX_RULES_COUNT 500
 #define FAST_RULE_CHECK_INTERVAL_MS 10
@@ -530,7 +531,11 @@ int DeRestPluginPrivate::createRule(const ApiRequest &req, ApiResponse &rsp)
 
             DBG_Printf(DBG_INFO, "create rule %s: %s\n", qPrintable(rule.id()), qPrintable(rule.name()));
             rules.push_back(rule);
-            indexRulesTriggers();
+            ruleHandleIndex.insert(rule.handle(), rules.size() - 1);
+            if (rules.back().isEnabled())
+            {
+                indexRuleTriggers(rules.back());
+            }
             queSaveDb(DB_RULES, DB_SHORT_SAVE_DELAY);
 
             rspItemState["id"] = rule.id();
@@ -793,7 +798,10 @@ int DeRestPluginPrivate::updateRule(const ApiRequest &req, ApiResponse &rsp)
             rspItemState[QString("/rules/%1/conditions").arg(id)] = conditionsList;
             rspItem["success"] = rspItemState;
             rsp.list.append(rspItem);
-            indexRulesTriggers();
+            if (rule->isEnabled())
+            {
+                indexRuleTriggers(*rule); // only the changed rule
+            }
         }
         else
         {
@@ -955,6 +963,22 @@ int DeRestPluginPrivate::deleteRule(const ApiRequest &req, ApiResponse &rsp)
     return REQ_READY_SEND;
 }
 
+// Used by the rule engine to drop cached condition items.
+// Testing code uses a mocked implementation.
+bool RULE_IsDeletedResource(const Resource *r)
+{
+    if (r->prefix() == RSensors)
+    {
+        return static_cast<const Sensor*>(r)->deletedState() != Sensor::StateNormal;
+    }
+    else if (r->prefix() == RLights)
+    {
+        return static_cast<const LightNode*>(r)->state() != LightNode::StateNormal;
+    }
+
+    return false;
+}
+
 /*! Evaluates rule.
     \param rule - the rule to check
     \param e - the trigger event
@@ -970,263 +994,7 @@ bool DeRestPluginPrivate::evaluateRule(Rule &rule, const Event &e, Resource *eRe
         return false;
     }
 
-    if (rule.state() != Rule::StateNormal || !rule.isEnabled())
-    {
-        return false;
-    }
-
-    if (rule.triggerPeriodic() < 0)
-    {
-        return false;
-    }
-
-    if (rule.triggerPeriodic() > 0)
-    {
-        if (rule.lastTriggered().isValid() &&
-            rule.lastTriggered().addMSecs(rule.triggerPeriodic()) > now)
-        {
-            // not yet time
-            return false;
-        }
-    }
-
-    auto c = rule.conditions().cbegin();
-    const auto cend = rule.conditions().cend();
-
-    for (; c != cend; ++c)
-    {
-        Resource *resource = getResource(c->resource(), c->id());
-        ResourceItem *item = resource ? resource->item(c->suffix()) : nullptr;
-
-        // the condition value might refer to another resource
-        Resource *valueResource = c->valueResource() ? getResource(c->valueResource(), c->valueId()) : nullptr;
-        ResourceItem *valueItem = valueResource ? valueResource->item(c->valueSuffix()) : nullptr;
-
-        if (!resource || !item)
-        {
-            DBG_Printf(DBG_INFO, "rule: %s, resource %s : %s id: %s (cond: %s) not found\n",
-                       qPrintable(rule.id()), c->resource(), c->suffix(),
-                       qPrintable(c->id()), qPrintable(c->address()));
-
-            if (!resource)
-            {
-                DBG_Printf(DBG_INFO, "\tdisable rule %s: %s\n", qPrintable(rule.id()), qPrintable(rule.name()));
-                rule.setStatus(QLatin1String("disabled"));
-            }
-            return false;
-        }
-
-        if (!item->lastSet().isValid()) { return false; }
-
-        if (resource->prefix() == RSensors && c->suffix() != RConfigOn)
-        {
-            // don't trigger rule if sensor is disabled
-            ResourceItem *item2 = resource->item(RConfigOn);
-            if (item2 && !item2->toBool())
-            {
-                return false;
-            }
-        }
-
-        if (c->op() == RuleCondition::OpEqual)
-        {
-            if (c->numericValue() != item->toNumber())
-            {
-                return false;
-            }
-
-            if (item == eItem && e.num() == e.numPrevious())
-            {
-                return false; // item was not changed
-            }
-        }
-        else if (c->op() == RuleCondition::OpNotEqual)
-        {
-            if (c->numericValue() == item->toNumber())
-            {
-                return false;
-            }
-
-            if (item == eItem && e.num() == e.numPrevious())
-            {
-                return false; // item was not changed
-            }
-        }
-        else if (c->op() == RuleCondition::OpGreaterThan && item->descriptor().suffix == RStateLocaltime)
-        {
-            if (valueItem && valueItem->descriptor().suffix == RStateLocaltime)
-            {
-                if (valueItem->toNumber() < item->toNumber())
-                {
-                    return false;
-                }
-            }
-            else if (valueItem && valueItem->descriptor().suffix == RConfigLocalTime)
-            {
-                const QDateTime t1 = QDateTime::fromMSecsSinceEpoch(item->toNumber());
-                if (now.time() < t1.time())
-                {
-                    return false;
-                }
-            }
-        }
-        else if (c->op() == RuleCondition::OpLowerThan && item->descriptor().suffix == RStateLocaltime)
-        {
-            if (valueItem && valueItem->descriptor().suffix == RStateLocaltime)
-            {
-                if (valueItem->toNumber() > item->toNumber())
-                {
-                    return false;
-                }
-            }
-            else if (valueItem && valueItem->descriptor().suffix == RConfigLocalTime)
-            {
-                const QDateTime t1 = QDateTime::fromMSecsSinceEpoch(item->toNumber());
-                if (now.time() > t1.time())
-                {
-                    return false;
-                }
-            }
-        }
-        else if (c->op() == RuleCondition::OpGreaterThan)
-        {
-            if (item->toNumber() <= c->numericValue())
-            {
-                return false;
-            }
-
-            if (item == eItem && e.numPrevious() > c->numericValue())
-            {
-                return false; // must become >
-            }
-        }
-        else if (c->op() == RuleCondition::OpLowerThan)
-        {
-            if (item->toNumber() >= c->numericValue())
-            {
-                return false;
-            }
-
-            if (item == eItem && e.numPrevious() < c->numericValue())
-            {
-                return false; // must become <
-            }
-        }
-        else if (c->op() == RuleCondition::OpDx)
-        {
-            if (item != eItem)
-            {
-                return false;
-            }
-
-            if (eItem->descriptor().suffix == RStateLastUpdated)
-            {}
-            else if (eItem->descriptor().suffix == RAttrLastAnnounced)
-            {}
-            else if (eItem->descriptor().suffix == RConfigLocalTime)
-            {}
-            else if (e.num() == e.numPrevious())
-            {
-                return false;
-            }
-        }
-        else if (c->op() == RuleCondition::OpDdx)
-        {
-            if (eItem->descriptor().suffix != RConfigLocalTime)
-            {
-                return false;
-            }
-
-            if (!item->lastChanged().isValid())
-            {
-                return false;
-            }
-
-            QDateTime dt = item->lastChanged().addSecs(c->seconds());
-            if (dt <= previousNow || dt > now)
-            {
-                return false;
-            }
-        }
-        else if (c->op() == RuleCondition::OpStable)
-        {
-            if (!item->lastSet().isValid())
-            {
-                return false;
-            }
-
-            QDateTime dt = item->lastChanged().addSecs(c->seconds());
-            if (now.secsTo(dt) > 0)
-            {
-                return false;
-            }
-        }
-        else if (c->op() == RuleCondition::OpIn && c->suffix() == RConfigLocalTime)
-        {
-            const QTime t = now.time();
-            const QTime pt = previousNow.time();
-
-            if (eItem->descriptor().suffix == RConfigLocalTime && (c->time0() <= pt || c->time0() > t))
-            {
-                return false; // Only trigger on start time
-            }
-
-            if (!c->weekDayEnabled(now.date().dayOfWeek()))
-            {
-                return false;
-            }
-
-            if (c->time0() < c->time1() && // 8:00 - 16:00
-                (t >= c->time0() && t <= c->time1()))
-            {
-            }
-            else if (c->time0() > c->time1() && // 20:00 - 4:00
-                (t >= c->time0() || t <= c->time1()))
-                // 20:00 - 0:00  ||  0:00 - 4:00
-            {
-            }
-            else
-            {
-                return false;
-            }
-        }
-        else if (c->op() == RuleCondition::OpNotIn && c->suffix() == RConfigLocalTime)
-        {
-            const QTime t = now.time();
-            const QTime pt = previousNow.time();
-
-            if (eItem->descriptor().suffix == RConfigLocalTime && (c->time1() <= pt || c->time1() > t))
-            {
-                return false; // Only trigger on end time
-            }
-
-            if (!c->weekDayEnabled(now.date().dayOfWeek()))
-            {
-                return false;
-            }
-
-            if (c->time0() < c->time1() && // 8:00 - 16:00
-                (t <= c->time0() || t >= c->time1()))
-                // 0:00 - 8:00   || 16.00 - 0.00
-            {
-            }
-            else if (c->time0() > c->time1() && // 20:00 - 4:00
-                (t <= c->time0() && t >= c->time1()))
-            {
-            }
-            else
-            {
-                return false;
-            }
-        }
-        else
-        {
-            DBG_Printf(DBG_ERROR, "error: rule (%s) operator %s not supported\n", qPrintable(rule.id()), qPrintable(c->ooperator()));
-            return false;
-        }
-    }
-
-    return true;
+    return RULE_Evaluate(rule, e, eItem, now, previousNow);
 }
 
 /*! Index rules related resource item triggers.
@@ -1324,7 +1092,7 @@ void DeRestPluginPrivate::triggerRule(Rule &rule)
     for (; ai != aend; ++ai)
     {
         // check webhook
-        if (ai->address().startsWith(QLatin1String("http")))
+        if (ai->target() == RuleAction::TargetWebHook)
         {
             if (handleWebHook(*ai) == REQ_NOT_HANDLED)
             {
@@ -1338,14 +1106,13 @@ void DeRestPluginPrivate::triggerRule(Rule &rule)
             return;
 
 
-        QStringList path = ai->address().split(QChar('/'), SKIP_EMPTY_PARTS);
-
-        if (path.isEmpty()) // at least: /config, /groups, /lights, /sensors
+        if (ai->target() == RuleAction::TargetUnknown) // at least: /config, /groups, /lights, /sensors
             return;
 
         QHttpRequestHeader hdr(ai->method(), ai->address());
 
         // paths start with /api/<apikey/ ...>
+        QStringList path = ai->path();
         path.prepend(rule.owner()); // apikey
         path.prepend(QLatin1String("api")); // api
 
@@ -1353,8 +1120,38 @@ void DeRestPluginPrivate::triggerRule(Rule &rule)
         ApiResponse rsp;
         rsp.httpStatus = HttpStatusServiceUnavailable;
 
-        // todo, dispatch request function
-        if (path[2] == QLatin1String("groups"))
+        if (ai->content().isValid())
+        {
+            req.contentParsed = &ai->content(); // parsed when the rule was created
+            req.contentUtf8 = ai->bodyUtf8();
+        }
+
+        // common actions are handled directly, others are dispatched like HTTP requests
+        if (ai->target() == RuleAction::TargetGroupAction)
+        {
+            if (setGroupState(req, rsp) == REQ_NOT_HANDLED)
+            {
+                return;
+            }
+            triggered = true;
+        }
+        else if (ai->target() == RuleAction::TargetLightState)
+        {
+            if (setLightState(req, rsp) == REQ_NOT_HANDLED)
+            {
+                return;
+            }
+            triggered = true;
+        }
+        else if (ai->target() == RuleAction::TargetSceneRecall)
+        {
+            if (recallScene(req, rsp) == REQ_NOT_HANDLED)
+            {
+                return;
+            }
+            triggered = true;
+        }
+        else if (path[2] == QLatin1String("groups"))
         {
             if (handleGroupsApi(req, rsp) == REQ_NOT_HANDLED)
             {
@@ -1530,18 +1327,16 @@ void DeRestPluginPrivate::fastRuleCheckTimerFired()
             continue;  // already checked
         }
 
-        for (Rule &rule: rules)
+        Rule *rule = getRuleForHandle(handle);
+        handle = 0; // mark checked
+
+        if (rule)
         {
-            if (rule.handle() == handle)
-            {
-                DBG_Printf(DBG_INFO_L2, "index resource items for rules, handle: %d (%s)\n", rule.handle(), qPrintable(rule.name()));
-                indexRuleTriggers(rule);
-                fastRuleCheckTimer->start(); // handle in next event loop cycle
-                handle = 0; // mark checked
-                return;
-            }
+            DBG_Printf(DBG_INFO_L2, "index resource items for rules, handle: %d (%s)\n", rule->handle(), qPrintable(rule->name()));
+            indexRuleTriggers(*rule);
+            fastRuleCheckTimer->start(); // handle in next event loop cycle
+            return;
         }
-        handle = 0; // mark checked (2)
     }
 
     // all done
@@ -1581,37 +1376,51 @@ void DeRestPluginPrivate::handleRuleEvent(const Event &e)
     }
 
 
-    // QElapsedTimer t;
-    // t.start();
-    std::vector<size_t> rulesToTrigger;
+    const qint64 t0 = LAT_Now();
+    const qint64 eventTime = eventEmitter ? eventEmitter->eventTime() : 0;
+    if (eventTime != 0)
+    {
+        ruleLatency[RuleLatencyEventQueue].add(t0 - eventTime);
+    }
+
+    std::vector<int> rulesToTrigger;
     for (int handle : item->rulesInvolved())
     {
-        for (size_t i = 0; i < rules.size(); i++)
-        {
-            if (rules[i].handle() != handle)
-            {
-                continue;
-            }
+        Rule *rule = getRuleForHandle(handle);
 
-            if (evaluateRule(rules[i], e, resource, item, now, previousNow))
-            {
-                rulesToTrigger.push_back(i);
-            }
+        if (rule && evaluateRule(*rule, e, resource, item, now, previousNow))
+        {
+            rulesToTrigger.push_back(handle);
         }
     }
 
-    for (size_t i : rulesToTrigger)
+    const qint64 t1 = LAT_Now();
+    ruleLatency[RuleLatencyEvaluate].add(t1 - t0);
+
+    if (rulesToTrigger.empty())
     {
-        DBG_Assert(i < rules.size());
-        if (i < rules.size())
+        return;
+    }
+
+    // tasks added by the actions are stamped in addTask()
+    ruleLatencyOrigin = eventTime;
+    ruleLatencyTrigger = t1;
+
+    // rules might be added by actions, lookup again
+    for (int handle : rulesToTrigger)
+    {
+        Rule *rule = getRuleForHandle(handle);
+        DBG_Assert(rule != nullptr);
+        if (rule)
         {
-            triggerRule(rules[i]);
+            triggerRule(*rule);
         }
     }
 
-    // int dt = t.elapsed();
-    // if (dt > 0)
-    // {
-    //     DBG_Printf(DBG_INFO_L2, "trigger rule events took %d ms\n", dt);
-    // }
+    ruleLatencyOrigin = 0;
+    ruleLatencyTrigger = 0;
+
+    const qint64 dt = LAT_Now() - t1;
+    ruleLatency[RuleLatencyTrigger].add(dt);
+    DBG_Printf(DBG_INFO_L2, "trigger rule events took %lld us\n", dt);
 }
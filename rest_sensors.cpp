@@ -94,7 +94,7 @@ int DeRestPluginPrivate::handleSensorsApi(const ApiRequest &req, ApiResponse &rs
     {
         return getSensor(req, rsp);
     }
-    // GET /api/<apikey>/sensors/<id>/data?maxrecords=<maxrecords>&fromtime=<ISO 8601>
+    // GET /api/<apikey>/sensors/<id>/data?maxrecords=<maxrecords>&fromtime=<ISO 8601>[&totime=<ISO 8601>][&bucket=<seconds>]
     else if ((req.path.size() == 5) && (req.hdr.method() == QLatin1String("GET")) && (req.path[4] == QLatin1String("data")))
     {
         return getSensorData(req, rsp);
@@ -144,7 +144,8 @@ int DeRestPluginPrivate::handleSensorsApi(const ApiRequest &req, ApiResponse &rs
     return REQ_NOT_HANDLED;
 }
 
-/*! GET /api/<apikey>/sensors
+/*! GET /api/<apikey>/sensors[?since=<version>]
+    With since only sensors changed after the version are returned, deleted ones as null.
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
@@ -166,14 +167,29 @@ int DeRestPluginPrivate::getAllSensors(const ApiRequest &req, ApiResponse &rsp)
         }
     }
 
+    const quint64 since = req.sinceVersion();
+
     std::vector<Sensor>::iterator i = sensors.begin();
     std::vector<Sensor>::iterator end = sensors.end();
 
     for (; i != end; ++i)
     {
+        if (since > 0)
+        {
+            const quint64 version = U_EtagVersion(i->etag);
+            if (version != 0 && version <= since)
+            {
+                continue; // unchanged
+            }
+        }
+
         // ignore deleted sensors
         if (i->deletedState() == Sensor::StateDeleted)
         {
+            if (since > 0)
+            {
+                rsp.map[i->id()] = QVariant();
+            }
             continue;
         }
 
@@ -243,7 +259,8 @@ int DeRestPluginPrivate::getSensor(const ApiRequest &req, ApiResponse &rsp)
     return REQ_READY_SEND;
 }
 
-/*! GET /api/<apikey>/sensors/<id>/data?maxrecords=<maxrecords>&fromtime=<ISO 8601>
+/*! GET /api/<apikey>/sensors/<id>/data?maxrecords=<maxrecords>&fromtime=<ISO 8601>[&totime=<ISO 8601>][&bucket=<seconds>]
+    With bucket each record contains min, max, avg, last and count of the bucket instead of the raw value.
     \return REQ_READY_SEND
             REQ_NOT_HANDLED
  */
@@ -288,10 +305,34 @@ int DeRestPluginPrivate::getSensorData(const ApiRequest &req, ApiResponse &rsp)
     }
 
     const qint64 fromTime = dt.toMSecsSinceEpoch() / 1000;
+    qint64 toTime = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+    if (query.hasQueryItem(QLatin1String("totime")))
+    {
+        dt = QDateTime::fromString(query.queryItemValue(QLatin1String("totime")), QLatin1String("yyyy-MM-ddTHH:mm:ss"));
+        if (!dt.isValid())
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QLatin1String("/totime"), QString("invalid value, %1, for parameter, totime").arg(query.queryItemValue("totime"))));
+            rsp.httpStatus = HttpStatusNotFound;
+            return REQ_READY_SEND;
+        }
+        toTime = dt.toMSecsSinceEpoch() / 1000;
+    }
+
+    qint64 bucket = 0;
+
+    if (query.hasQueryItem(QLatin1String("bucket")))
+    {
+        bucket = query.queryItemValue(QLatin1String("bucket")).toLongLong(&ok);
+        if (!ok || bucket <= 0)
+        {
+            rsp.list.append(errorToMap(ERR_INVALID_VALUE, QLatin1String("/bucket"), QString("invalid value, %1, for parameter, bucket").arg(query.queryItemValue("bucket"))));
+            rsp.httpStatus = HttpStatusNotFound;
+            return REQ_READY_SEND;
+        }
+    }
 
-    openDb();
-    loadSensorDataFromDb(sensor, rsp.list, fromTime, maxRecords);
-    closeDb();
+    loadSensorDataFromDb(sensor, rsp.list, fromTime, toTime, maxRecords, bucket);
 
     if (rsp.list.isEmpty())
     {
@@ -654,7 +695,7 @@ int DeRestPluginPrivate::updateSensor(const ApiRequest &req, ApiResponse &rsp)
             rspItemState[QString("/sensors/%1/mode").arg(id)] = (double)mode;
             rspItem[QLatin1String("success")] = rspItemState;
             rsp.list.append(rspItem);
-            updateEtag(sensor->etag);
+            updateSensorEtag(sensor);
             updateEtag(gwConfigEtag);
             queSaveDb(DB_SENSORS | DB_GROUPS, DB_SHORT_SAVE_DELAY);
         }
@@ -3002,6 +3043,8 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
             map[QLatin1String("id")] = e.id();
             map[QLatin1String("uniqueid")] = sensor->uniqueId();
             QVariantMap state;
+            WebSocketEventItems stateItems;
+            stateItems.prefix = "state/";
             ResourceItem *iox = nullptr;
             ResourceItem *ioy = nullptr;
             ResourceItem *ioz = nullptr;
@@ -3040,6 +3083,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
                     else if (item->isPublic() && (gwWebSocketNotifyAll || rid.suffix == RStateButtonEvent || item->needPushChange()))
                     {
                         state[key] = item->toVariant();
+                        stateItems.items.push_back(item);
                         item->clearNeedPush();
                     }
                 }
@@ -3078,7 +3122,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
             if (!state.isEmpty())
             {
                 map[QLatin1String("state")] = state;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map, stateItems);
                 updateSensorEtag(sensor);
                 plugin->saveDatabaseItems |= DB_SENSORS;
                 plugin->queSaveDb(DB_SENSORS, DB_SHORT_SAVE_DELAY);
@@ -3112,6 +3156,8 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
             map[QLatin1String("id")] = e.id();
             map[QLatin1String("uniqueid")] = sensor->uniqueId();
             QVariantMap config;
+            WebSocketEventItems configItems;
+            configItems.prefix = "config/";
             ResourceItem *ilcs = nullptr;
             ResourceItem *ilca = nullptr;
             ResourceItem *ilct = nullptr;
@@ -3163,6 +3209,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
                         else
                         {
                             config[key] = item->toVariant();
+                            configItems.items.push_back(item);
                         }
                         item->clearNeedPush();
                     }
@@ -3187,7 +3234,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
             if (!config.isEmpty())
             {
                 map[QLatin1String("config")] = config;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map, configItems);
                 updateSensorEtag(sensor);
                 plugin->saveDatabaseItems |= DB_SENSORS;
                 plugin->queSaveDb(DB_SENSORS, DB_SHORT_SAVE_DELAY);
@@ -3245,7 +3292,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
             if (!cap.isEmpty())
             {
                 map[QLatin1String("capabilities")] = cap;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map);
                 updateSensorEtag(sensor);
                 plugin->saveDatabaseItems |= DB_SENSORS;
                 plugin->queSaveDb(DB_SENSORS, DB_SHORT_SAVE_DELAY);
@@ -3291,7 +3338,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
             if (!attr.isEmpty())
             {
                 map["attr"] = attr;
-                webSocketServer->broadcastTextMessage(Json::serialize(map));
+                webSocketServer->broadcastEvent(map);
                 updateSensorEtag(sensor);
                 plugin->saveDatabaseItems |= DB_SENSORS;
                 plugin->queSaveDb(DB_SENSORS, DB_SHORT_SAVE_DELAY);
@@ -3328,7 +3375,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
         smap[QLatin1String("id")] = sensor->id();
         map[QLatin1String("sensor")] = smap;
 
-        webSocketServer->broadcastTextMessage(Json::serialize(map));
+        webSocketServer->broadcastEvent(map);
     }
     else if (e.what() == REventDeleted)
     {
@@ -3345,7 +3392,7 @@ void DeRestPluginPrivate::handleSensorEvent(const Event &e)
         smap[QLatin1String("id")] = e.id();
         map[QLatin1String("sensor")] = smap;
 
-        webSocketServer->broadcastTextMessage(Json::serialize(map));
+        webSocketServer->broadcastEvent(map);
     }
     else if (e.what() == REventValidGroup)
     {
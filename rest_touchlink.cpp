@@ -670,7 +670,7 @@ void DeRestPluginPrivate::sendTouchlinkConfirm(deCONZ::TouchlinkStatus status)
                     {
                         // TODO: remove the node from groups
                         i->item(RStateReachable)->setValue(false);
-                        updateEtag(i->etag);
+                        updateLightEtag(&*i);
                         updateEtag(gwConfigEtag);
                     }
                 }
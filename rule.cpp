@@ -168,6 +168,8 @@ const std::vector<RuleCondition> &Rule::conditions() const
 void Rule::setConditions(const std::vector<RuleCondition> &conditions)
 {
     this->m_conditions = conditions;
+    conditionRefs.clear();
+    conditionRefsGeneration = 0;
 }
 
 /*! Returns the rule actions.
@@ -322,6 +324,8 @@ RuleAction::RuleAction() :
 void RuleAction::setAddress(const QString &address)
 {
     m_address = address;
+    m_path = m_address.split(QChar('/'), SKIP_EMPTY_PARTS);
+    updateTarget();
 }
 
 /*! Returns the action address.
@@ -345,6 +349,7 @@ void RuleAction::setMethod(const QString &method)
         return;
     }
     m_method = method;
+    updateTarget();
 }
 
 /*! Returns the action method.
@@ -362,6 +367,48 @@ void RuleAction::setBody(const QString &body)
 {
     QString str = body;
     m_body = str.replace( " ", "" );
+    m_bodyUtf8 = m_body.toUtf8();
+
+    bool ok;
+    m_content = Json::parse(m_body, ok);
+    if (!ok)
+    {
+        m_content = QVariant();
+    }
+}
+
+/*! Determines the target of the action from address and method.
+ */
+void RuleAction::updateTarget()
+{
+    if (m_address.startsWith(QLatin1String("http")))
+    {
+        m_target = TargetWebHook;
+    }
+    else if (m_path.isEmpty())
+    {
+        m_target = TargetUnknown;
+    }
+    else if (m_method != QLatin1String("PUT"))
+    {
+        m_target = TargetRest;
+    }
+    else if (m_path.size() == 3 && m_path[0] == QLatin1String("groups") && m_path[2] == QLatin1String("action"))
+    {
+        m_target = TargetGroupAction;
+    }
+    else if (m_path.size() == 3 && m_path[0] == QLatin1String("lights") && m_path[2] == QLatin1String("state"))
+    {
+        m_target = TargetLightState;
+    }
+    else if (m_path.size() == 5 && m_path[0] == QLatin1String("groups") && m_path[2] == QLatin1String("scenes") && m_path[4] == QLatin1String("recall"))
+    {
+        m_target = TargetSceneRecall;
+    }
+    else
+    {
+        m_target = TargetRest;
+    }
 }
 
 bool RuleAction::operator==(const RuleAction &other) const
@@ -13,6 +13,7 @@
 
 #include <stdint.h>
 #include <QString>
+#include <QStringList>
 #include <vector>
 #include <QDateTime>
 #include <deconz.h>
@@ -24,6 +25,16 @@ class RuleCondition;
 class RuleAction;
 class RestNodeBase;
 
+/*! Resolved resource items of a RuleCondition, see RULE_ResolveConditions(). */
+struct RuleConditionRef
+{
+    Resource *resource = nullptr;
+    ResourceItem *item = nullptr;
+    ResourceItem *valueItem = nullptr; // the condition value refers to another item
+    ResourceItem *configOn = nullptr; // for sensors if the condition isn't on config/on
+    bool localtime = false; // item is state/localtime
+};
+
 /*! Helper class to handle ZigBee binding/unbinding for Rules. */
 class BindingTask
 {
@@ -121,6 +132,10 @@ public:
     QDateTime lastVerify;
     QDateTime m_lastTriggered;
 
+    // cached condition items, valid while R_ResourceGeneration() doesn't change
+    std::vector<RuleConditionRef> conditionRefs;
+    quint32 conditionRefsGeneration = 0;
+
 private:
     State m_state;
     QString m_id;
@@ -138,6 +153,17 @@ private:
 class RuleAction
 {
 public:
+    /*! Precompiled target of the action, to skip the REST API dispatch when triggered. */
+    enum Target
+    {
+        TargetUnknown,
+        TargetWebHook,     // http:// or https:// address
+        TargetRest,        // other local address, dispatched like a HTTP request
+        TargetGroupAction, // PUT /groups/<id>/action
+        TargetLightState,  // PUT /lights/<id>/state
+        TargetSceneRecall  // PUT /groups/<id>/scenes/<sid>/recall
+    };
+
     RuleAction();
 
     const QString &address() const;
@@ -148,10 +174,23 @@ public:
     void setBody(const QString &body);
     bool operator==(const RuleAction &other) const;
 
+    Target target() const { return m_target; }
+    const QStringList &path() const { return m_path; }
+    const QVariant &content() const { return m_content; }
+    const QByteArray &bodyUtf8() const { return m_bodyUtf8; }
+
 private:
+    void updateTarget();
+
     QString m_address;
     QString m_method;
     QString m_body;
+
+    // internal calculated values for faster access
+    Target m_target = TargetUnknown;
+    QStringList m_path; // address split at '/'
+    QVariant m_content; // parsed body, invalid if the body isn't valid JSON
+    QByteArray m_bodyUtf8; // body for handlers which read it with JsonReader
 };
 
 
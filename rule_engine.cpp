@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "deconz/dbg_trace.h"
+#include "event.h"
+#include "rule.h"
+#include "rule_engine.h"
+
+/*! Returns a Rule for its given \p handle or nullptr if not found.
+    The returned pointer is only valid until rules are added.
+ */
+Rule *RULE_GetForHandle(std::vector<Rule> &rules, ResourceIndex<int> &index, int handle)
+{
+    const size_t slot = index.find(rules, handle, [handle](const Rule &r)
+    {
+        return r.handle() == handle;
+    });
+
+    return slot != ResourceIndex<int>::NotFound ? &rules[slot] : nullptr;
+}
+
+/*! Resolves the resource items of all rule conditions.
+    The result is cached in the rule until resources are added, moved or deleted.
+    Conditions which can't be resolved have a nullptr item.
+    \param rule - the rule to resolve
+ */
+void RULE_ResolveConditions(Rule &rule)
+{
+    const quint32 generation = R_ResourceGeneration();
+
+    if (rule.conditionRefsGeneration == generation && rule.conditionRefs.size() == rule.conditions().size())
+    {
+        bool valid = true;
+        for (const RuleConditionRef &ref : rule.conditionRefs)
+        {
+            if (ref.resource && RULE_IsDeletedResource(ref.resource))
+            {
+                valid = false;
+                break;
+            }
+        }
+
+        if (valid)
+        {
+            return;
+        }
+    }
+
+    rule.conditionRefs.clear();
+    rule.conditionRefs.reserve(rule.conditions().size());
+
+    for (const RuleCondition &c : rule.conditions())
+    {
+        RuleConditionRef ref;
+        ref.resource = DEV_GetResource(c.resource(), c.id());
+        ref.item = ref.resource ? ref.resource->item(c.suffix()) : nullptr;
+
+        if (c.valueResource())
+        {
+            Resource *valueResource = DEV_GetResource(c.valueResource(), c.valueId());
+            ref.valueItem = valueResource ? valueResource->item(c.valueSuffix()) : nullptr;
+        }
+
+        if (ref.item)
+        {
+            ref.localtime = ref.item->descriptor().suffix == RStateLocaltime;
+
+            if (ref.resource->prefix() == RSensors && c.suffix() != RConfigOn)
+            {
+                ref.configOn = ref.resource->item(RConfigOn);
+            }
+        }
+
+        rule.conditionRefs.push_back(ref);
+    }
+
+    rule.conditionRefsGeneration = generation;
+}
+
+/*! Evaluates rule.
+    \param rule - the rule to check
+    \param e - the trigger event
+    \param eItem - the event resource item
+    \param now - the current date/time to check the rule against
+    \param previousNow - the date/time of the former check
+    \return true if rule can be triggered
+ */
+bool RULE_Evaluate(Rule &rule, const Event &e, ResourceItem *eItem, const QDateTime &now, const QDateTime &previousNow)
+{
+    if (rule.state() != Rule::StateNormal || !rule.isEnabled())
+    {
+        return false;
+    }
+
+    if (rule.triggerPeriodic() < 0)
+    {
+        return false;
+    }
+
+    if (rule.triggerPeriodic() > 0)
+    {
+        if (rule.lastTriggered().isValid() &&
+            rule.lastTriggered().addMSecs(rule.triggerPeriodic()) > now)
+        {
+            // not yet time
+            return false;
+        }
+    }
+
+    RULE_ResolveConditions(rule);
+    DBG_Assert(rule.conditionRefs.size() == rule.conditions().size());
+
+    auto ref = rule.conditionRefs.cbegin();
+    auto c = rule.conditions().cbegin();
+    const auto cend = rule.conditions().cend();
+
+    for (; c != cend; ++c, ++ref)
+    {
+        Resource *resource = ref->resource;
+        ResourceItem *item = ref->item;
+
+        // the condition value might refer to another resource
+        ResourceItem *valueItem = ref->valueItem;
+
+        if (!resource || !item)
+        {
+            DBG_Printf(DBG_INFO, "rule: %s, resource %s : %s id: %s (cond: %s) not found\n",
+                       qPrintable(rule.id()), c->resource(), c->suffix(),
+                       qPrintable(c->id()), qPrintable(c->address()));
+
+            if (!resource)
+            {
+                DBG_Printf(DBG_INFO, "\tdisable rule %s: %s\n", qPrintable(rule.id()), qPrintable(rule.name()));
+                rule.setStatus(QLatin1String("disabled"));
+            }
+            return false;
+        }
+
+        if (!item->lastSet().isValid()) { return false; }
+
+        if (ref->configOn && !ref->configOn->toBool())
+        {
+            return false; // don't trigger rule if sensor is disabled
+        }
+
+        if (c->op() == RuleCondition::OpEqual)
+        {
+            if (c->numericValue() != item->toNumber())
+            {
+                return false;
+            }
+
+            if (item == eItem && e.num() == e.numPrevious())
+            {
+                return false; // item was not changed
+            }
+        }
+        else if (c->op() == RuleCondition::OpNotEqual)
+        {
+            if (c->numericValue() == item->toNumber())
+            {
+                return false;
+            }
+
+            if (item == eItem && e.num() == e.numPrevious())
+            {
+                return false; // item was not changed
+            }
+        }
+        else if (c->op() == RuleCondition::OpGreaterThan && ref->localtime)
+        {
+            if (valueItem && valueItem->descriptor().suffix == RStateLocaltime)
+            {
+                if (valueItem->toNumber() < item->toNumber())
+                {
+                    return false;
+                }
+            }
+            else if (valueItem && valueItem->descriptor().suffix == RConfigLocalTime)
+            {
+                const QDateTime t1 = QDateTime::fromMSecsSinceEpoch(item->toNumber());
+                if (now.time() < t1.time())
+                {
+                    return false;
+                }
+            }
+        }
+        else if (c->op() == RuleCondition::OpLowerThan && ref->localtime)
+        {
+            if (valueItem && valueItem->descriptor().suffix == RStateLocaltime)
+            {
+                if (valueItem->toNumber() > item->toNumber())
+                {
+                    return false;
+                }
+            }
+            else if (valueItem && valueItem->descriptor().suffix == RConfigLocalTime)
+            {
+                const QDateTime t1 = QDateTime::fromMSecsSinceEpoch(item->toNumber());
+                if (now.time() > t1.time())
+                {
+                    return false;
+                }
+            }
+        }
+        else if (c->op() == RuleCondition::OpGreaterThan)
+        {
+            if (item->toNumber() <= c->numericValue())
+            {
+                return false;
+            }
+
+            if (item == eItem && e.numPrevious() > c->numericValue())
+            {
+                return false; // must become >
+            }
+        }
+        else if (c->op() == RuleCondition::OpLowerThan)
+        {
+            if (item->toNumber() >= c->numericValue())
+            {
+                return false;
+            }
+
+            if (item == eItem && e.numPrevious() < c->numericValue())
+            {
+                return false; // must become <
+            }
+        }
+        else if (c->op() == RuleCondition::OpDx)
+        {
+            if (item != eItem)
+            {
+                return false;
+            }
+
+            if (eItem->descriptor().suffix == RStateLastUpdated)
+            {}
+            else if (eItem->descriptor().suffix == RAttrLastAnnounced)
+            {}
+            else if (eItem->descriptor().suffix == RConfigLocalTime)
+            {}
+            else if (e.num() == e.numPrevious())
+            {
+                return false;
+            }
+        }
+        else if (c->op() == RuleCondition::OpDdx)
+        {
+            if (eItem->descriptor().suffix != RConfigLocalTime)
+            {
+                return false;
+            }
+
+            if (!item->lastChanged().isValid())
+            {
+                return false;
+            }
+
+            QDateTime dt = item->lastChanged().addSecs(c->seconds());
+            if (dt <= previousNow || dt > now)
+            {
+                return false;
+            }
+        }
+        else if (c->op() == RuleCondition::OpStable)
+        {
+            if (!item->lastSet().isValid())
+            {
+                return false;
+            }
+
+            QDateTime dt = item->lastChanged().addSecs(c->seconds());
+            if (now.secsTo(dt) > 0)
+            {
+                return false;
+            }
+        }
+        else if (c->op() == RuleCondition::OpIn && c->suffix() == RConfigLocalTime)
+        {
+            const QTime t = now.time();
+            const QTime pt = previousNow.time();
+
+            if (eItem->descriptor().suffix == RConfigLocalTime && (c->time0() <= pt || c->time0() > t))
+            {
+                return false; // Only trigger on start time
+            }
+
+            if (!c->weekDayEnabled(now.date().dayOfWeek()))
+            {
+                return false;
+            }
+
+            if (c->time0() < c->time1() && // 8:00 - 16:00
+                (t >= c->time0() && t <= c->time1()))
+            {
+            }
+            else if (c->time0() > c->time1() && // 20:00 - 4:00
+                (t >= c->time0() || t <= c->time1()))
+                // 20:00 - 0:00  ||  0:00 - 4:00
+            {
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (c->op() == RuleCondition::OpNotIn && c->suffix() == RConfigLocalTime)
+        {
+            const QTime t = now.time();
+            const QTime pt = previousNow.time();
+
+            if (eItem->descriptor().suffix == RConfigLocalTime && (c->time1() <= pt || c->time1() > t))
+            {
+                return false; // Only trigger on end time
+            }
+
+            if (!c->weekDayEnabled(now.date().dayOfWeek()))
+            {
+                return false;
+            }
+
+            if (c->time0() < c->time1() && // 8:00 - 16:00
+                (t <= c->time0() || t >= c->time1()))
+                // 0:00 - 8:00   || 16.00 - 0.00
+            {
+            }
+            else if (c->time0() > c->time1() && // 20:00 - 4:00
+                (t <= c->time0() && t >= c->time1()))
+            {
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else
+        {
+            DBG_Printf(DBG_ERROR, "error: rule (%s) operator %s not supported\n", qPrintable(rule.id()), qPrintable(c->ooperator()));
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <vector>
+#include "resource_index.h"
+
+class Event;
+class QDateTime;
+class Resource;
+class ResourceItem;
+class Rule;
+
+/*! Rule lookup and condition evaluation of the rule engine.
+
+    The functions don't depend on the plugin instance, resources are looked up
+    via DEV_GetResource(). The plugin triggers the actions of matching rules.
+ */
+
+Rule *RULE_GetForHandle(std::vector<Rule> &rules, ResourceIndex<int> &index, int handle);
+void RULE_ResolveConditions(Rule &rule);
+bool RULE_Evaluate(Rule &rule, const Event &e, ResourceItem *eItem, const QDateTime &now, const QDateTime &previousNow);
+
+/*! Returns true if \p r is marked as deleted and shouldn't be used by rules anymore.
+    Testing code uses a mocked implementation.
+ */
+bool RULE_IsDeletedResource(const Resource *r);
+
+#endif // RULE_ENGINE_H
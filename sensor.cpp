@@ -11,6 +11,7 @@
 #include "de_web_plugin_private.h"
 #include "sensor.h"
 #include "json.h"
+#include "json_writer.h"
 #include "product_match.h"
 
 /*! Returns a fingerprint as JSON string. */
@@ -410,42 +411,18 @@ void Sensor::setLastAnnounced(const QString &lastannounced)
  */
 QString Sensor::stateToString()
 {
-    QVariantMap map;
-
-    for (int i = 0; i < itemCount(); i++)
-    {
-        ResourceItem *item = itemForIndex(i);
-        const ResourceItemDescriptor &rid = item->descriptor();
-
-        if (strncmp(rid.suffix, "state/", 6) == 0)
-        {
-            const char *key = item->descriptor().suffix + 6;
-            map[key] = item->toVariant();
-        }
-    }
-
-    return Json::serialize(map);
+    JsonWriter json(256);
+    json.resourceItems(*this, "state/");
+    return QString::fromUtf8(json.buffer());
 }
 
 /*! Transfers config into JSONString.
  */
 QString Sensor::configToString()
 {
-    QVariantMap map;
-
-    for (int i = 0; i < itemCount(); i++)
-    {
-        ResourceItem *item = itemForIndex(i);
-        const ResourceItemDescriptor &rid = item->descriptor();
-
-        if (strncmp(rid.suffix, "config/", 7) == 0)
-        {
-            const char *key = item->descriptor().suffix + 7;
-            map[key] = item->toVariant();
-        }
-    }
-
-    return Json::serialize(map);
+    JsonWriter json(512);
+    json.resourceItems(*this, "config/");
+    return QString::fromUtf8(json.buffer());
 }
 
 /*! Parse the sensor state from a JSON string. */
@@ -0,0 +1,158 @@
+#include <vector>
+#include "catch2/catch.hpp"
+#include "resource.h"
+#include "resource_index.h"
+
+TEST_CASE("102: Resource item index", "[Resource]")
+{
+    initResourceDescriptors();
+
+    const char *suffixes[] = {
+        RAttrId, RAttrUniqueId, RAttrName, RAttrType, RAttrModelId, RAttrManufacturerName,
+        RAttrSwVersion, RAttrLastSeen, RAttrLastAnnounced, RStateOn, RStateBri, RStateCt,
+        RStateX, RStateY, RStateHue, RStateSat, RStateColorMode, RStateReachable, RStateAlert,
+        RStateEffect, RConfigOn, RConfigBattery, RConfigReachable, RStateLastUpdated
+    };
+
+    Resource r(RLights);
+
+    for (const char *suffix : suffixes)
+    {
+        ResourceItemDescriptor rid;
+        REQUIRE(getResourceItemDescriptor(QLatin1String(suffix), rid));
+        REQUIRE(r.addItem(rid.type, rid.suffix) != nullptr);
+    }
+
+    REQUIRE(r.itemCount() == int(sizeof(suffixes) / sizeof(suffixes[0])));
+
+    SECTION("all items are found by their interned suffix")
+    {
+        for (const char *suffix : suffixes)
+        {
+            const ResourceItem *item = r.item(suffix);
+            REQUIRE(item != nullptr);
+            REQUIRE(item->descriptor().suffix == suffix);
+        }
+
+        REQUIRE(r.item(RStateButtonEvent) == nullptr);
+    }
+
+    SECTION("index is consistent after remove and copy")
+    {
+        r.removeItem(RStateBri);
+        r.removeItem(RAttrId);
+
+        const Resource copy = r;
+
+        REQUIRE(r.item(RStateBri) == nullptr);
+        REQUIRE(copy.item(RAttrId) == nullptr);
+
+        for (const char *suffix : suffixes)
+        {
+            if (suffix == RStateBri || suffix == RAttrId)
+            {
+                continue;
+            }
+
+            REQUIRE(r.item(suffix) != nullptr);
+            REQUIRE(copy.item(suffix) != nullptr);
+            REQUIRE(copy.item(suffix)->descriptor().suffix == suffix);
+        }
+    }
+
+    SECTION("generation changes when item pointers may become invalid")
+    {
+        quint32 gen = R_ResourceGeneration();
+        REQUIRE(r.item(RStateOn) != nullptr);
+        REQUIRE(R_ResourceGeneration() == gen);
+
+        r.removeItem(RStateOn);
+        REQUIRE(R_ResourceGeneration() != gen);
+
+        gen = R_ResourceGeneration();
+        r.addItem(DataTypeBool, RStateOn);
+        REQUIRE(R_ResourceGeneration() != gen);
+
+        gen = R_ResourceGeneration();
+        r.addItem(DataTypeBool, RStateOn); // already exists
+        REQUIRE(R_ResourceGeneration() == gen);
+
+        {
+            const Resource copy = r;
+        }
+        REQUIRE(R_ResourceGeneration() != gen);
+    }
+
+    BENCHMARK("item() lookup")
+    {
+        return r.item(RStateLastUpdated);
+    };
+}
+
+namespace {
+
+struct FakeAddress
+{
+    quint64 m_ext;
+    quint64 ext() const { return m_ext; }
+};
+
+struct FakeNode
+{
+    FakeAddress addr;
+    quint8 endpoint;
+    bool deleted;
+    const FakeAddress &address() const { return addr; }
+};
+
+} // namespace
+
+TEST_CASE("102: Resource address index", "[Resource]")
+{
+    std::vector<FakeNode> nodes;
+    AddressIndex index;
+
+    nodes.push_back({{0x1111}, 1, false});
+    nodes.push_back({{0}, 0, false}); // no MAC address
+    nodes.push_back({{0x2222}, 1, false});
+    nodes.push_back({{0x1111}, 2, false});
+
+    const auto endpoint = [](quint8 ep) { return [ep](FakeNode &n) { return !n.deleted && n.endpoint == ep; }; };
+
+    REQUIRE(index.find(nodes, 0x1111, false, endpoint(2)) == 3);
+    REQUIRE(index.find(nodes, 0x1111, true, endpoint(0)) == 1);
+    REQUIRE(index.find(nodes, 0x3333, false, endpoint(1)) == size_t(AddressIndex::NotFound));
+
+    SECTION("appended elements are indexed on the next lookup")
+    {
+        nodes.push_back({{0x3333}, 1, false});
+        REQUIRE(index.find(nodes, 0x3333, false, endpoint(1)) == 4);
+    }
+
+    SECTION("deleted elements are rejected by the predicate")
+    {
+        nodes[0].deleted = true;
+        REQUIRE(index.find(nodes, 0x1111, false, endpoint(1)) == size_t(AddressIndex::NotFound));
+    }
+}
+
+TEST_CASE("102: Resource index without scan", "[Resource]")
+{
+    std::vector<quint64> keys = { 10, 20, 30 };
+    ResourceIndex<quint64> index;
+    const auto match = [](quint64 key) { return [key](quint64 k) { return k == key; }; };
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        index.insert(keys[i], i);
+    }
+
+    REQUIRE(index.get(keys, 30, match(30)) == 2);
+
+    index.erase(20, 1);
+    keys.erase(keys.begin() + 1);
+
+    REQUIRE(index.get(keys, 20, match(20)) == size_t(ResourceIndex<quint64>::NotFound));
+    REQUIRE(index.get(keys, 30, match(30)) == 1);
+    REQUIRE(index.get(keys, 10, match(10)) == 0);
+}
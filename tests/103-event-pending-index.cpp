@@ -0,0 +1,212 @@
+#include <vector>
+#include "catch2/catch.hpp"
+#include "event.h"
+#include "resource.h"
+
+static bool linearIsDuplicate(const EventRingBuffer &queue, const Event &e)
+{
+    for (quint32 seq = queue.tailSeq() - queue.size(); seq != queue.tailSeq(); seq++)
+    {
+        if (EventIsDuplicate(e, queue.at(seq)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void fillQueue(EventRingBuffer &queue, EventPendingIndex &index, int count)
+{
+    queue.clear();
+    index.clear();
+
+    for (int i = 0; i < count; i++)
+    {
+        const Event e(RSensors, RStateButtonEvent, QString::number(i % 400), i, 0x00212EFFFF000000 + (i % 400));
+        index.insert(e, queue.tailSeq());
+        queue.push(e);
+    }
+}
+
+TEST_CASE("103: Event pending index", "[Event]")
+{
+    EventRingBuffer queue(1024);
+    EventPendingIndex index;
+
+    fillQueue(queue, index, 1000);
+
+    SECTION("detects duplicates like the linear scan")
+    {
+        const Event dup(RSensors, RStateButtonEvent, QLatin1String("7"), 7, 0x00212EFFFF000007);
+        const Event other(RSensors, RStateButtonEvent, QLatin1String("7"), 8, 0x00212EFFFF000007);
+
+        REQUIRE(linearIsDuplicate(queue, dup));
+        REQUIRE(index.contains(dup, queue));
+
+        REQUIRE(!linearIsDuplicate(queue, other));
+        REQUIRE(!index.contains(other, queue));
+    }
+
+    SECTION("processed events are no duplicates")
+    {
+        const Event first = queue.front();
+        index.remove(first, 0);
+        queue.pop();
+
+        REQUIRE(!index.contains(first, queue));
+        REQUIRE(index.size() == 999);
+        REQUIRE(queue.size() == 999);
+    }
+}
+
+TEST_CASE("103: Event ring buffer", "[Event]")
+{
+    EventRingBuffer queue(5);
+
+    REQUIRE(queue.capacity() == 8);
+    REQUIRE(queue.empty());
+
+    for (int i = 0; i < 8; i++)
+    {
+        REQUIRE(queue.push(Event(RSensors, RStateButtonEvent, i), quint32(i)));
+    }
+
+    SECTION("rejects events when full")
+    {
+        REQUIRE(!queue.push(Event(RSensors, RStateButtonEvent, 8)));
+        REQUIRE(queue.size() == 8);
+    }
+
+    SECTION("keeps FIFO order across wrap around")
+    {
+        for (int i = 8; i < 20; i++)
+        {
+            REQUIRE(queue.front().num() == i - 8);
+            REQUIRE(queue.frontOrder() == quint32(i - 8));
+            queue.pop();
+            REQUIRE(queue.push(Event(RSensors, RStateButtonEvent, i), quint32(i)));
+        }
+
+        REQUIRE(queue.size() == 8);
+        REQUIRE(queue.front().num() == 12);
+    }
+
+    SECTION("grow keeps order and sequence numbers")
+    {
+        queue.pop();
+        queue.pop();
+        REQUIRE(queue.push(Event(RSensors, RStateButtonEvent, 8), 8));
+        REQUIRE(queue.push(Event(RSensors, RStateButtonEvent, 9), 9)); // wrapped around
+
+        const quint32 seq = queue.tailSeq() - 1;
+        queue.grow();
+
+        REQUIRE(queue.capacity() == 16);
+        REQUIRE(queue.size() == 8);
+        REQUIRE(queue.at(seq).num() == 9);
+        REQUIRE(queue.push(Event(RSensors, RStateButtonEvent, 10), 10));
+
+        for (int i = 2; i <= 10; i++)
+        {
+            REQUIRE(queue.front().num() == i);
+            REQUIRE(queue.frontOrder() == quint32(i));
+            queue.pop();
+        }
+        REQUIRE(queue.empty());
+    }
+}
+
+TEST_CASE("103: Event id handles", "[Event]")
+{
+    const auto id = GENERATE(as<QString>{}, "1", "12", "999999999", "0", "007", "00:21:2e:ff:ff:00:a6:fd-02", "");
+
+    const Event e(RSensors, RStateButtonEvent, id, 0);
+
+    REQUIRE(e.id() == id);
+    REQUIRE(e.idHandle() == EventIdHandle(id));
+    REQUIRE(e.resource() == RSensors);
+}
+
+TEST_CASE("103: Event id table is recycled", "[Event]")
+{
+    const QString uniqueid = QLatin1String("00:21:2e:ff:ff:00:a6:fd-01");
+    const quint32 handle = EventIdHandle(uniqueid);
+
+    REQUIRE(EventIdString(handle) == uniqueid);
+
+    for (int i = 0; i < 5000; i++)
+    {
+        EventIdHandle(QString("id-%1").arg(i));
+    }
+
+    // the slot was reused, the stale handle doesn't resolve to another id
+    REQUIRE(EventIdString(handle).isEmpty());
+    REQUIRE(EventIdString(EventIdHandle(uniqueid)) == uniqueid);
+}
+
+TEST_CASE("103: Event ring buffer keeps enqueue time", "[Event]")
+{
+    EventRingBuffer queue(4);
+
+    REQUIRE(queue.push(Event(RLights, RStateOn, 1), 0, 1000));
+    REQUIRE(queue.push(Event(RSensors, RStateButtonEvent, 2), 1, 2000));
+
+    REQUIRE(queue.front().resource() == RLights);
+    REQUIRE(queue.frontTime() == 1000);
+    queue.pop();
+    REQUIRE(queue.front().resource() == RSensors);
+    REQUIRE(queue.frontTime() == 2000);
+}
+
+TEST_CASE("103: Event pending index enqueue cost", "[Event][!benchmark]")
+{
+    EventRingBuffer queue(16384);
+    EventPendingIndex index;
+
+    std::vector<QString> ids;
+    for (int i = 0; i < 400; i++)
+    {
+        ids.push_back(QString::number(i));
+    }
+
+    // steady state like EventEmitter: each iteration enqueues a new event with duplicate check and processes the oldest
+    for (int count : {100, 1000, 10000})
+    {
+        int num = count;
+        fillQueue(queue, index, count);
+
+        BENCHMARK("hashed push and pop, " + std::to_string(count) + " pending")
+        {
+            const Event e(RSensors, RStateButtonEvent, ids[size_t(num % 400)], num, 0x00212EFFFF000000 + (num % 400));
+            num++;
+
+            if (!index.contains(e, queue))
+            {
+                index.insert(e, queue.tailSeq());
+                queue.push(e);
+            }
+
+            index.remove(queue.front(), queue.tailSeq() - queue.size());
+            queue.pop();
+            return queue.size();
+        };
+
+        num = count;
+        fillQueue(queue, index, count);
+
+        BENCHMARK("linear push and pop, " + std::to_string(count) + " pending")
+        {
+            const Event e(RSensors, RStateButtonEvent, ids[size_t(num % 400)], num, 0x00212EFFFF000000 + (num % 400));
+            num++;
+
+            if (!linearIsDuplicate(queue, e))
+            {
+                queue.push(e);
+            }
+
+            queue.pop();
+            return queue.size();
+        };
+    }
+}
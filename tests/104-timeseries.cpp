@@ -0,0 +1,265 @@
+#include <QDir>
+#include <QTemporaryDir>
+#include "catch2/catch.hpp"
+#include "timeseries.h"
+
+TEST_CASE("104: Time series varint encoding", "[TimeSeries]")
+{
+    const auto value = GENERATE(as<qint64>{}, 0, 1, -1, 63, -64, 64, 300, -300, 0x7FFFFFFFFFFFFFFFLL, -0x7FFFFFFFFFFFFFFFLL - 1);
+
+    QByteArray buf;
+    TS_PutVarint(buf, value);
+
+    const char *p = buf.constData();
+    qint64 decoded = 0;
+
+    REQUIRE(TS_GetVarint(p, buf.constData() + buf.size(), &decoded));
+    REQUIRE(decoded == value);
+    REQUIRE(p == buf.constData() + buf.size());
+}
+
+TEST_CASE("104: Time series block", "[TimeSeries]")
+{
+    TS_BlockEncoder enc;
+    std::vector<TS_Sample> expected;
+
+    qint64 t = 1700000000;
+    qint64 v = 2150;
+
+    while (enc.append(t, v))
+    {
+        expected.push_back({t, v});
+        t += 60;
+        v += (expected.size() % 3) - 1;
+    }
+
+    const QByteArray block = enc.block();
+
+    REQUIRE(enc.count() == int(expected.size()));
+    REQUIRE(block.size() <= TS_BlockHeaderSize + TS_BlockPayloadMax);
+    REQUIRE(expected.size() > 50); // small deltas need about 2 bytes per sample
+
+    SECTION("decodes all samples")
+    {
+        std::vector<TS_Sample> out;
+        REQUIRE(TS_DecodeBlocks(block, 0, t, out));
+        REQUIRE(out.size() == expected.size());
+
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            REQUIRE(out[i].timestamp == expected[i].timestamp);
+            REQUIRE(out[i].value == expected[i].value);
+        }
+    }
+
+    SECTION("filters by time range")
+    {
+        std::vector<TS_Sample> out;
+        REQUIRE(TS_DecodeBlocks(block, expected[10].timestamp, expected[19].timestamp, out));
+        REQUIRE(out.size() == 10);
+        REQUIRE(out.front().value == expected[10].value);
+    }
+
+    SECTION("detects truncated data")
+    {
+        std::vector<TS_Sample> out;
+        REQUIRE(!TS_DecodeBlocks(block.left(block.size() - 1), 0, t, out));
+    }
+}
+
+TEST_CASE("104: Time series store", "[TimeSeries]")
+{
+    QTemporaryDir tmp;
+    REQUIRE(tmp.isValid());
+
+    TS_Store store(tmp.path());
+    TS_Key key;
+    key.extAddress = 0x00212EFFFF001234;
+    key.endpoint = 1;
+    key.clusterId = 0x0402;
+    key.attributeId = 0x0000;
+
+    const qint64 start = 1700000000;
+    const int count = 60000; // several segments
+
+    for (int i = 0; i < count; i++)
+    {
+        store.append(key, start + i * 30, 2000 + (i % 100));
+    }
+
+    SECTION("query includes written and pending samples")
+    {
+        const auto samples = store.query(key, start, start + count * 30);
+        REQUIRE(samples.size() == size_t(count));
+        REQUIRE(samples.back().value == 2000 + ((count - 1) % 100));
+        REQUIRE(store.keys().size() == 1);
+    }
+
+    SECTION("retention drops old segments")
+    {
+        store.flush(start + count * 30, true);
+
+        const QDir root(tmp.path());
+        const auto seriesDirs = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        REQUIRE(seriesDirs.size() == 1);
+        REQUIRE(QDir(root.filePath(seriesDirs.first())).entryList(QDir::Files).size() > 1);
+
+        store.setMaxAge(3600);
+        store.applyRetention(start + count * 30);
+
+        const auto samples = store.query(key, 0, start + count * 30);
+        REQUIRE(!samples.empty());
+        REQUIRE(samples.size() < size_t(count));
+        REQUIRE(samples.back().timestamp == start + (count - 1) * 30);
+    }
+
+    SECTION("retention drops expired series")
+    {
+        store.flush(start + count * 30, true);
+
+        store.setMaxAge(3600);
+        store.applyRetention(start + count * 30 + 2 * 3600);
+
+        REQUIRE(QDir(tmp.path()).entryList(QDir::Dirs | QDir::NoDotAndDotDot).isEmpty());
+        REQUIRE(store.keys().empty());
+        REQUIRE(store.query(key, 0, start + count * 30).empty());
+    }
+}
+
+TEST_CASE("104: Time series store with worker thread", "[TimeSeries]")
+{
+    QTemporaryDir tmp;
+    REQUIRE(tmp.isValid());
+
+    TS_Key key;
+    key.extAddress = 0x00212EFFFF001234;
+    key.endpoint = 1;
+    key.clusterId = 0x0402;
+
+    const qint64 start = 1700000000 - (1700000000 % 3600);
+    const int count = 2000;
+
+    {
+        auto worker = std::make_shared<TS_Worker>();
+        TS_Store store(tmp.path());
+        store.setExecutor([worker](std::function<void()> job) { worker->post(std::move(job)); });
+
+        for (int i = 0; i < count; i++)
+        {
+            store.append(key, start + i * 30, 2000 + (i % 100));
+        }
+
+        REQUIRE(store.query(key, start, start + count * 30).size() == size_t(count));
+        store.flush(start + count * 30, true);
+    } // the worker executes the pending jobs
+
+    TS_Store store(tmp.path());
+    const auto samples = store.query(key, start, start + count * 30);
+    REQUIRE(samples.size() == size_t(count));
+    REQUIRE(samples.back().value == 2000 + ((count - 1) % 100));
+}
+
+TEST_CASE("104: Time series store with deferred file jobs", "[TimeSeries]")
+{
+    QTemporaryDir tmp;
+    REQUIRE(tmp.isValid());
+
+    std::vector<std::function<void()>> jobs;
+    TS_Store store(tmp.path());
+    store.setExecutor([&jobs](std::function<void()> job) { jobs.push_back(std::move(job)); });
+
+    TS_Key key;
+    key.extAddress = 0x00212EFFFF001234;
+    key.endpoint = 1;
+    key.clusterId = 0x0402;
+
+    const qint64 start = 1700000000 - (1700000000 % 3600);
+    const int count = 2000;
+
+    for (int i = 0; i < count; i++)
+    {
+        store.append(key, start + i * 30, 2000 + (i % 100));
+    }
+
+    const auto expected = store.aggregate(key, start, start + count * 30, 3600);
+    REQUIRE(!jobs.empty());
+    REQUIRE(store.query(key, start, start + count * 30).size() == size_t(count));
+
+    // no sample is missing or counted twice while the jobs complete
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        jobs[i]();
+        REQUIRE(store.query(key, start, start + count * 30).size() == size_t(count));
+    }
+
+    const auto buckets = store.aggregate(key, start, start + count * 30, 3600);
+    REQUIRE(buckets.size() == expected.size());
+    REQUIRE(buckets.back().count == expected.back().count);
+    REQUIRE(buckets.front().sum == expected.front().sum);
+}
+
+TEST_CASE("104: Time series rollups", "[TimeSeries]")
+{
+    QTemporaryDir tmp;
+    REQUIRE(tmp.isValid());
+
+    TS_Store store(tmp.path());
+    TS_Key key;
+    key.extAddress = 0x00212EFFFF001234;
+    key.endpoint = 1;
+    key.clusterId = 0x0402;
+
+    const qint64 start = 1700000000 - (1700000000 % 3600);
+    const qint64 end = start + 7 * 24 * 3600;
+
+    for (qint64 t = start; t < end; t += 45)
+    {
+        store.append(key, t, (t / 45) % 500);
+    }
+
+    const auto bucket = GENERATE(as<qint64>{}, 600, 3600, 86400, 450);
+
+    SECTION("match aggregates of the raw samples")
+    {
+        const auto expected = TS_AggregateSamples(store.query(key, start, end), bucket);
+        const auto buckets = store.aggregate(key, start, end, bucket);
+
+        REQUIRE(buckets.size() == expected.size());
+
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            REQUIRE(buckets[i].timestamp == expected[i].timestamp);
+            REQUIRE(buckets[i].min == expected[i].min);
+            REQUIRE(buckets[i].max == expected[i].max);
+            REQUIRE(buckets[i].sum == expected[i].sum);
+            REQUIRE(buckets[i].last == expected[i].last);
+            REQUIRE(buckets[i].count == expected[i].count);
+        }
+    }
+}
+
+TEST_CASE("104: Time series rollup query cost", "[TimeSeries][!benchmark]")
+{
+    QTemporaryDir tmp;
+    TS_Store store(tmp.path());
+    TS_Key key;
+    key.extAddress = 0x00212EFFFF001234;
+
+    const qint64 start = 1700000000;
+    const qint64 end = start + 7 * 24 * 3600;
+
+    for (qint64 t = start; t < end; t += 10)
+    {
+        store.append(key, t, t % 1000);
+    }
+
+    BENCHMARK("one week hourly from rollups")
+    {
+        return store.aggregate(key, start, end, 3600).size();
+    };
+
+    BENCHMARK("one week hourly from raw samples")
+    {
+        return TS_AggregateSamples(store.query(key, start, end), 3600).size();
+    };
+}
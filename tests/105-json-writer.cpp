@@ -0,0 +1,304 @@
+#include <QDateTime>
+#include <QLocale>
+#include <deque>
+#include "catch2/catch.hpp"
+#include "json.h"
+#include "json_writer.h"
+#include "resource.h"
+
+// Json::serialize() before the JsonWriter, used as reference and benchmark baseline.
+static QString legacySanitizeString(QString str)
+{
+    str.replace(QLatin1String("\\"), QLatin1String("\\\\"));
+    str.replace(QLatin1String("\""), QLatin1String("\\\""));
+    str.replace(QLatin1String("\b"), QLatin1String("\\b"));
+    str.replace(QLatin1String("\f"), QLatin1String("\\f"));
+    str.replace(QLatin1String("\n"), QLatin1String("\\n"));
+    str.replace(QLatin1String("\r"), QLatin1String("\\r"));
+    str.replace(QLatin1String("\t"), QLatin1String("\\t"));
+    return QString(QLatin1String("\"%1\"")).arg(str);
+}
+
+static QByteArray legacyJoin(const QList<QByteArray> &list, const QByteArray &sep)
+{
+    QByteArray res;
+    for (const QByteArray &i : list)
+    {
+        if (!res.isEmpty())
+        {
+            res += sep;
+        }
+        res += i;
+    }
+    return res;
+}
+
+static QByteArray legacySerialize(const QVariant &data)
+{
+    QByteArray str;
+
+    if (!data.isValid())
+    {
+        str = "null";
+    }
+    else if (data.type() == QVariant::List || data.type() == QVariant::StringList)
+    {
+        QList<QByteArray> values;
+        const QVariantList list = data.toList();
+        for (const QVariant &v : list)
+        {
+            values << legacySerialize(v);
+        }
+        str = "[" + legacyJoin(values, ",") + "]";
+    }
+    else if (data.type() == QVariant::Map)
+    {
+        const QVariantMap vmap = data.toMap();
+        QList<QByteArray> pairs;
+        for (auto it = vmap.cbegin(); it != vmap.cend(); ++it)
+        {
+            pairs << legacySanitizeString(it.key()).toUtf8() + ":" + legacySerialize(it.value());
+        }
+        str = "{" + legacyJoin(pairs, ",") + "}";
+    }
+    else if (data.isNull())
+    {
+        str = "null";
+    }
+    else if (data.type() == QVariant::String || data.type() == QVariant::ByteArray)
+    {
+        str = legacySanitizeString(data.toString()).toUtf8();
+    }
+    else if (data.type() == QVariant::Double)
+    {
+        str = QByteArray::number(data.toDouble(), 'f', QLocale::FloatingPointShortest);
+    }
+    else if (data.type() == QVariant::Bool)
+    {
+        str = data.toBool() ? "true" : "false";
+    }
+    else if (data.type() == QVariant::ULongLong)
+    {
+        str = QByteArray::number(data.value<qulonglong>());
+    }
+    else if (data.canConvert<qlonglong>())
+    {
+        str = QByteArray::number(data.value<qlonglong>());
+    }
+    else
+    {
+        str = legacySanitizeString(data.toString()).toUtf8();
+    }
+
+    return str;
+}
+
+static QVariantMap itemsToMap(const Resource &r, const char *prefix)
+{
+    QVariantMap map;
+    const size_t len = strlen(prefix);
+
+    for (int i = 0; i < r.itemCount(); i++)
+    {
+        const ResourceItem *item = r.itemForIndex(size_t(i));
+        if (strncmp(item->descriptor().suffix, prefix, len) == 0)
+        {
+            map[QLatin1String(item->descriptor().suffix + len)] = item->toVariant();
+        }
+    }
+
+    return map;
+}
+
+static void initLight(Resource &r, int id)
+{
+    r.addItem(DataTypeString, RAttrName)->setValue(QString("Light %1 \"kitchen\"").arg(id));
+    r.addItem(DataTypeString, RAttrType)->setValue(QString("Extended color light"));
+    r.addItem(DataTypeString, RAttrUniqueId)->setValue(QString("00:21:2e:ff:ff:00:%1:%2-0b").arg(id / 256, 2, 16, QChar('0')).arg(id % 256, 2, 16, QChar('0')));
+    r.addItem(DataTypeBool, RStateOn)->setValue(id & 1);
+    r.addItem(DataTypeUInt8, RStateBri)->setValue(id % 255);
+    r.addItem(DataTypeUInt16, RStateHue)->setValue(id * 100);
+    r.addItem(DataTypeBool, RStateReachable)->setValue(true);
+    r.addItem(DataTypeBool, RConfigOn); // not set -> null
+}
+
+static void initSensor(Resource &r, int id)
+{
+    r.addItem(DataTypeString, RAttrName)->setValue(QString::fromUtf8("Temperatur Küche %1").arg(id));
+    r.addItem(DataTypeString, RAttrType)->setValue(QString("ZHATemperature"));
+    r.addItem(DataTypeString, RAttrUniqueId)->setValue(QString("00:15:8d:00:01:02:%1:%2-01-0402").arg(id / 256, 2, 16, QChar('0')).arg(id % 256, 2, 16, QChar('0')));
+    r.addItem(DataTypeInt16, RStateTemperature)->setValue(qint64(-1000 + id * 13));
+    r.addItem(DataTypeTime, RStateLastUpdated)->setValue(QDateTime::fromMSecsSinceEpoch(1618597220000 + id * 1000, Qt::UTC));
+    r.addItem(DataTypeUInt8, RConfigBattery)->setValue(id % 101);
+    r.addItem(DataTypeInt16, RConfigOffset)->setValue(qint64(0));
+    r.addItem(DataTypeBool, RConfigOn)->setValue(true);
+    r.addItem(DataTypeBool, RConfigReachable)->setValue(true);
+}
+
+// mimics lightToMap()/sensorToMap() for the items used above
+static QVariantMap resourceToMap(const Resource &r)
+{
+    QVariantMap map;
+    map[QLatin1String("name")] = r.item(RAttrName)->toVariant();
+    map[QLatin1String("type")] = r.item(RAttrType)->toVariant();
+    map[QLatin1String("uniqueid")] = r.item(RAttrUniqueId)->toVariant();
+    map[QLatin1String("state")] = itemsToMap(r, "state/");
+    map[QLatin1String("config")] = itemsToMap(r, "config/");
+    return map;
+}
+
+static void writeResource(JsonWriter &json, const Resource &r)
+{
+    json.beginObject();
+    json.key("config").resourceItems(r, "config/");
+    json.key("name").value(*r.item(RAttrName));
+    json.key("state").resourceItems(r, "state/");
+    json.key("type").value(*r.item(RAttrType));
+    json.key("uniqueid").value(*r.item(RAttrUniqueId));
+    json.endObject();
+}
+
+TEST_CASE("105: Json writer matches Json::serialize", "[Json]")
+{
+    QVariantMap map;
+    map["str"] = QString::fromUtf8("a\"b\\c\n\r\t\b\f/ äöü € \xF0\x9F\x92\xA1");
+    map["empty"] = QString("");
+    map["nullstr"] = QString();
+    map["invalid"] = QVariant();
+    map["t"] = true;
+    map["f"] = false;
+    map["int"] = -42;
+    map["uint"] = 4000000000U;
+    map["ll"] = Q_INT64_C(-9000000000000);
+    map["ull"] = Q_UINT64_C(18446744073709551615);
+    map["double"] = 0.1;
+    map["dint"] = 254.0;
+    map["dneg"] = -3.5;
+    map["dbig"] = 1e20;
+    map["dnegzero"] = -0.0;
+    map["list"] = QVariantList{1, QString("x"), QVariantList{}, QVariantMap{}};
+    map["strlist"] = QStringList{"a", "b\"c"};
+    map["nested"] = QVariantMap{{"k", QVariantMap{{"x", 1.5}, {"y", QVariant()}}}};
+
+    const QByteArray expected = legacySerialize(map);
+
+    REQUIRE(Json::serialize(map) == expected);
+
+    JsonWriter json;
+    json.value(QVariant(map));
+    REQUIRE(!json.hasError());
+    REQUIRE(json.buffer() == expected);
+
+    SECTION("writer is reusable")
+    {
+        json.clear();
+        json.beginArray().value(1).value("a").null().endArray();
+        REQUIRE(json.buffer() == QByteArray("[1,\"a\",null]"));
+    }
+
+    SECTION("control characters are escaped")
+    {
+        json.clear();
+        json.value(QString(QChar(0x01)));
+        REQUIRE(json.buffer() == QByteArray("\"\\u0001\""));
+    }
+}
+
+TEST_CASE("105: Json writer resource items", "[Json]")
+{
+    initResourceDescriptors();
+
+    Resource r(RSensors);
+    initSensor(r, 7);
+    r.addItem(DataTypeBool, RStateOn); // not set
+
+    JsonWriter json;
+
+    for (const char *prefix : {"state/", "config/", "attr/", ""})
+    {
+        CAPTURE(prefix);
+        json.clear();
+        json.resourceItems(r, prefix);
+        REQUIRE(json.buffer() == legacySerialize(itemsToMap(r, prefix)));
+    }
+}
+
+TEST_CASE("105: Full state serialization cost", "[Json][!benchmark]")
+{
+    initResourceDescriptors();
+
+    std::deque<Resource> lights;
+    std::deque<Resource> sensors;
+
+    for (int i = 0; i < 100; i++)
+    {
+        lights.emplace_back(RLights);
+        initLight(lights.back(), i);
+    }
+
+    for (int i = 0; i < 200; i++)
+    {
+        sensors.emplace_back(RSensors);
+        initSensor(sensors.back(), i);
+    }
+
+    const auto fullStateMap = [&]()
+    {
+        QVariantMap lightsMap;
+        QVariantMap sensorsMap;
+        for (size_t i = 0; i < lights.size(); i++) { lightsMap[QString::number(i)] = resourceToMap(lights[i]); }
+        for (size_t i = 0; i < sensors.size(); i++) { sensorsMap[QString::number(i)] = resourceToMap(sensors[i]); }
+
+        QVariantMap map;
+        map[QLatin1String("lights")] = lightsMap;
+        map[QLatin1String("sensors")] = sensorsMap;
+        return map;
+    };
+
+    // QVariantMap orders the ids as strings
+    const auto sortedIds = [](size_t count)
+    {
+        QStringList ids;
+        for (size_t i = 0; i < count; i++) { ids.append(QString::number(i)); }
+        ids.sort();
+        return ids;
+    };
+    const QStringList lightIds = sortedIds(lights.size());
+    const QStringList sensorIds = sortedIds(sensors.size());
+
+    JsonWriter json(64 * 1024);
+
+    const auto writeFullState = [&]()
+    {
+        json.clear();
+        json.beginObject();
+        json.key("lights").beginObject();
+        for (const QString &id : lightIds) { json.key(id); writeResource(json, lights[id.toUInt()]); }
+        json.endObject();
+        json.key("sensors").beginObject();
+        for (const QString &id : sensorIds) { json.key(id); writeResource(json, sensors[id.toUInt()]); }
+        json.endObject();
+        json.endObject();
+        return json.buffer().size();
+    };
+
+    const QByteArray expected = legacySerialize(fullStateMap());
+    writeFullState();
+    REQUIRE(Json::serialize(fullStateMap()) == expected);
+    REQUIRE(json.buffer() == expected);
+
+    BENCHMARK("QVariantMap + legacy serialize")
+    {
+        return legacySerialize(fullStateMap()).size();
+    };
+
+    BENCHMARK("QVariantMap + Json::serialize")
+    {
+        return Json::serialize(fullStateMap()).size();
+    };
+
+    BENCHMARK("JsonWriter from resources")
+    {
+        return writeFullState();
+    };
+}
@@ -0,0 +1,122 @@
+#include "catch2/catch.hpp"
+#include "json.h"
+#include "json_reader.h"
+
+TEST_CASE("106: Json reader tokens", "[Json]")
+{
+    const QByteArray body = R"({"on": true, "bri": 254, "xy": [0.3, 0.4], "alert": "nä\"", "ct": null})";
+    JsonReader json(body);
+
+    REQUIRE(json.next() == JsonReader::TokenBeginObject);
+    REQUIRE(json.next() == JsonReader::TokenKey);
+    REQUIRE(json.isKey("on"));
+    REQUIRE(json.next() == JsonReader::TokenBool);
+    REQUIRE(json.toBool() == true);
+
+    REQUIRE(json.next() == JsonReader::TokenKey);
+    REQUIRE(json.isKey("bri"));
+    REQUIRE(json.next() == JsonReader::TokenNumber);
+    REQUIRE(json.toDouble() == 254.0);
+
+    REQUIRE(json.next() == JsonReader::TokenKey);
+    REQUIRE(json.isKey("xy"));
+    REQUIRE(json.next() == JsonReader::TokenBeginArray);
+    REQUIRE(json.depth() == 2);
+    REQUIRE(json.skipValue());
+    REQUIRE(json.depth() == 1);
+
+    REQUIRE(json.next() == JsonReader::TokenKey);
+    REQUIRE(json.isKey("alert"));
+    REQUIRE(json.next() == JsonReader::TokenString);
+    REQUIRE(json.toString() == QString::fromUtf8("nä\""));
+
+    REQUIRE(json.next() == JsonReader::TokenKey);
+    REQUIRE(json.next() == JsonReader::TokenNull);
+    REQUIRE(json.next() == JsonReader::TokenEndObject);
+    REQUIRE(json.next() == JsonReader::TokenEnd);
+}
+
+TEST_CASE("106: Json::parse", "[Json]")
+{
+    bool ok = false;
+
+    SECTION("object")
+    {
+        const QVariantMap map = Json::parse(QString::fromUtf8(R"({"name":"Küche 💡","on":false,"bri":-12.5e1,"list":[1,"a",[],{}],"n":null})"), ok).toMap();
+        REQUIRE(ok);
+        REQUIRE(map.size() == 5);
+        REQUIRE(map["name"].toString() == QString::fromUtf8("Küche \xF0\x9F\x92\xA1"));
+        REQUIRE(map["on"].type() == QVariant::Bool);
+        REQUIRE(map["on"].toBool() == false);
+        REQUIRE(map["bri"].type() == QVariant::Double);
+        REQUIRE(map["bri"].toDouble() == -125.0);
+        REQUIRE(map["list"].toList().size() == 4);
+        REQUIRE(map["list"].toList()[0].type() == QVariant::Double);
+        REQUIRE(map.contains("n"));
+        REQUIRE(!map["n"].isValid());
+    }
+
+    SECTION("round trip")
+    {
+        const QByteArray json = R"({"a":[1,2.5,"x\ny"],"b":{"c":true,"d":null}})";
+        REQUIRE(Json::serialize(Json::parseUtf8(json, ok)) == json);
+        REQUIRE(ok);
+    }
+
+    SECTION("commas are optional like in the previous parser")
+    {
+        const QVariantList list = Json::parse("[1 2,,3,]", ok).toList();
+        REQUIRE(ok);
+        REQUIRE(list.size() == 3);
+    }
+
+    SECTION("invalid input")
+    {
+        auto input = GENERATE(as<QString>{}, "", "{", "{\"a\"}", "{\"a\":}", "[1,", "\"abc", "tru", "{a:1}", "}");
+        CAPTURE(input);
+
+        Json::parse(input, ok);
+        REQUIRE(!ok);
+    }
+
+    SECTION("nesting is limited")
+    {
+        QByteArray deep(JsonReader::MaxDepth + 1, '[');
+        deep += QByteArray(JsonReader::MaxDepth + 1, ']');
+        Json::parseUtf8(deep, ok);
+        REQUIRE(!ok);
+    }
+}
+
+TEST_CASE("106: Json parse cost", "[Json][!benchmark]")
+{
+    const QByteArray body = R"({"on": true, "bri": 180, "ct": 370, "transitiontime": 4, "xy": [0.4573, 0.41], "alert": "none"})";
+    const QString bodyStr = QString::fromUtf8(body);
+
+    BENCHMARK("light state from QString")
+    {
+        bool ok;
+        return Json::parse(bodyStr, ok).toMap().size();
+    };
+
+    BENCHMARK("light state from UTF-8")
+    {
+        bool ok;
+        return Json::parseUtf8(body, ok).toMap().size();
+    };
+
+    BENCHMARK("light state pull parser")
+    {
+        JsonReader json(body);
+        int bri = 0;
+        if (json.next() == JsonReader::TokenBeginObject)
+        {
+            while (json.next() == JsonReader::TokenKey)
+            {
+                if (json.isKey("bri") && json.next() == JsonReader::TokenNumber) { bri = int(json.toDouble()); }
+                else { json.next(); json.skipValue(); }
+            }
+        }
+        return bri;
+    };
+}
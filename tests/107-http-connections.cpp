@@ -0,0 +1,92 @@
+#include <algorithm>
+#include "catch2/catch.hpp"
+#include "http_connections.h"
+
+// sockets are only used as keys
+static QTcpSocket *fakeSocket(quintptr n)
+{
+    return reinterpret_cast<QTcpSocket*>(n * 16);
+}
+
+static std::vector<QTcpSocket*> runTicks(HttpConnectionManager &mgr, int ticks)
+{
+    std::vector<QTcpSocket*> closed;
+    for (int i = 0; i < ticks; i++)
+    {
+        const auto expired = mgr.tick();
+        closed.insert(closed.end(), expired.begin(), expired.end());
+    }
+    return closed;
+}
+
+TEST_CASE("107: HTTP connection idle expiry", "[HTTP]")
+{
+    HttpConnectionManager mgr;
+
+    SECTION("all expired connections are closed in the same tick")
+    {
+        for (quintptr n = 1; n <= 500; n++)
+        {
+            REQUIRE(mgr.addRequest(fakeSocket(n), 10));
+        }
+
+        REQUIRE(runTicks(mgr, 9).empty());
+        REQUIRE(mgr.tick().size() == 500);
+        REQUIRE(mgr.connections().size() == 500); // until destroyed
+
+        for (quintptr n = 1; n <= 500; n++)
+        {
+            mgr.remove(fakeSocket(n));
+        }
+        REQUIRE(mgr.connections().empty());
+    }
+
+    SECTION("requests keep the connection open")
+    {
+        QTcpSocket *sock = fakeSocket(1);
+        REQUIRE(mgr.addRequest(sock, 10));
+        REQUIRE(runTicks(mgr, 8).empty());
+        REQUIRE(!mgr.addRequest(sock, 10));
+        REQUIRE(runTicks(mgr, 9).empty());
+        REQUIRE(mgr.tick().size() == 1);
+        REQUIRE(mgr.connection(sock)->requests == 2);
+    }
+
+    SECTION("timeouts larger than the wheel")
+    {
+        QTcpSocket *sock = fakeSocket(1);
+        mgr.addRequest(sock, 10);
+        mgr.extend(sock, 240);
+        REQUIRE(runTicks(mgr, 239).empty());
+        REQUIRE(mgr.tick().size() == 1);
+    }
+
+    SECTION("stale entries are dropped")
+    {
+        mgr.addRequest(fakeSocket(1), 1);
+        REQUIRE(mgr.tick().size() == 1);
+        REQUIRE(runTicks(mgr, HttpConnectionManager::ClosedRetention).empty());
+        REQUIRE(mgr.connections().empty());
+    }
+}
+
+TEST_CASE("107: HTTP keep-alive headers", "[HTTP]")
+{
+    HttpConnectionManager mgr;
+    QTcpSocket *sock = fakeSocket(1);
+
+    mgr.addRequest(sock, HttpConnectionManager::IdleTimeout);
+    REQUIRE(mgr.connectionHeaders(sock) == QByteArray("Connection: keep-alive\r\nKeep-Alive: timeout=60, max=99\r\n"));
+    REQUIRE(mgr.connectionHeaders(fakeSocket(2)) == QByteArray("Connection: close\r\n"));
+
+    for (int i = 1; i < HttpConnectionManager::MaxRequests; i++)
+    {
+        mgr.addRequest(sock, HttpConnectionManager::IdleTimeout);
+    }
+
+    REQUIRE(mgr.connection(sock)->requests == HttpConnectionManager::MaxRequests);
+    REQUIRE(mgr.connectionHeaders(sock) == QByteArray("Connection: close\r\n"));
+
+    mgr.extend(sock, 240); // doesn't reopen
+    REQUIRE(mgr.tick().size() == 1);
+}
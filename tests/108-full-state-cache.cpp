@@ -0,0 +1,47 @@
+#include "catch2/catch.hpp"
+#include "full_state_cache.h"
+
+TEST_CASE("108: Full state fragment cache", "[FullState]")
+{
+    FullStateCache cache;
+    const QString variant = QLatin1String("0/1");
+    const QString etag = QLatin1String("\"a1\"");
+
+    REQUIRE(cache.find(FullStateCache::SectionLights, "1", etag, variant) == nullptr);
+
+    QByteArray buf = R"({"name":"Light 1"})";
+    const FullStateFragment *frag = cache.insert(FullStateCache::SectionLights, "1", etag, variant, buf);
+    buf.resize(0); // writer buffers are reused
+    REQUIRE(frag->json == QByteArray(R"({"name":"Light 1"})"));
+
+    SECTION("hit while unchanged")
+    {
+        frag = cache.find(FullStateCache::SectionLights, "1", etag, variant);
+        REQUIRE(frag != nullptr);
+        REQUIRE(frag->etag == etag);
+        REQUIRE(cache.hits() == 1);
+        REQUIRE(cache.misses() == 1);
+    }
+
+    SECTION("sections are separate")
+    {
+        REQUIRE(cache.find(FullStateCache::SectionSensors, "1", etag, variant) == nullptr);
+    }
+
+    SECTION("etag or request variant changed")
+    {
+        REQUIRE(cache.find(FullStateCache::SectionLights, "1", QLatin1String("\"a2\""), variant) == nullptr);
+        REQUIRE(cache.find(FullStateCache::SectionLights, "1", etag, QLatin1String("3/1")) == nullptr);
+    }
+
+    SECTION("invalidated by events")
+    {
+        cache.insert(FullStateCache::SectionLights, "2", etag, variant, "{}");
+        cache.invalidate(FullStateCache::SectionLights, "1");
+        REQUIRE(cache.find(FullStateCache::SectionLights, "1", etag, variant) == nullptr);
+        REQUIRE(cache.find(FullStateCache::SectionLights, "2", etag, variant) != nullptr);
+
+        cache.invalidate(FullStateCache::SectionLights, QString()); // whole section
+        REQUIRE(cache.find(FullStateCache::SectionLights, "2", etag, variant) == nullptr);
+    }
+}
@@ -0,0 +1,109 @@
+#include "catch2/catch.hpp"
+#include "websocket_queue.h"
+
+static void push(WebSocketSendQueue &q, const char *msg, qint64 now = 0)
+{
+    const QByteArray utf8(msg);
+    q.push(QString::fromUtf8(utf8), WebSocketSendQueue::messageKey(utf8), now);
+}
+
+TEST_CASE("109: Websocket message key", "[WebSocket]")
+{
+    WebSocketMessageKey key = WebSocketSendQueue::messageKey(R"({"e":"changed","id":"5","r":"lights","state":{"on":true},"t":"event"})");
+    REQUIRE(key.resource == QLatin1String("lights/5"));
+    REQUIRE(key.mergeable);
+
+    key = WebSocketSendQueue::messageKey(R"({"e":"deleted","id":"5","r":"lights","t":"event"})");
+    REQUIRE(key.resource == QLatin1String("lights/5"));
+    REQUIRE(!key.mergeable);
+
+    key = WebSocketSendQueue::messageKey(R"({"e":"changed","t":"event"})");
+    REQUIRE(key.resource.isEmpty());
+
+    key = WebSocketSendQueue::messageKey(R"({"e":"changed","id":"3","r":"sensors","state":{"buttonevent":1002,"lastupdated":"none"},"t":"event"})");
+    REQUIRE(key.resource == QLatin1String("sensors/3"));
+    REQUIRE(!key.mergeable);
+}
+
+TEST_CASE("109: Websocket send queue", "[WebSocket]")
+{
+    SECTION("changed events of one resource are merged")
+    {
+        WebSocketSendQueue q;
+        push(q, R"({"e":"changed","id":"1","r":"lights","state":{"on":true}})", 10);
+        push(q, R"({"e":"changed","id":"2","r":"lights","state":{"on":true}})", 20);
+        push(q, R"({"e":"changed","id":"1","r":"lights","state":{"bri":5}})", 30);
+
+        REQUIRE(q.size() == 2);
+        REQUIRE(q.coalesced() == 1);
+        REQUIRE(q.lag(40) == 30);
+        REQUIRE(q.front() == QLatin1String(R"({"e":"changed","id":"1","r":"lights","state":{"bri":5,"on":true}})"));
+    }
+
+    SECTION("other events keep the order")
+    {
+        WebSocketSendQueue q;
+        push(q, R"({"e":"changed","id":"1","r":"sensors","state":{"buttonevent":1002}})");
+        push(q, R"({"e":"deleted","id":"1","r":"sensors"})");
+        push(q, R"({"e":"changed","id":"1","r":"sensors","state":{"buttonevent":2002}})");
+        REQUIRE(q.size() == 3);
+        REQUIRE(q.coalesced() == 0);
+    }
+
+    SECTION("merging continues after the front was sent")
+    {
+        WebSocketSendQueue q;
+        push(q, R"({"e":"changed","id":"1","r":"lights","state":{"on":true}})");
+        q.pop();
+        push(q, R"({"e":"changed","id":"1","r":"lights","state":{"on":false}})");
+        push(q, R"({"e":"changed","id":"1","r":"lights","state":{"bri":1}})");
+        REQUIRE(q.size() == 1);
+        REQUIRE(q.coalesced() == 1);
+    }
+
+    SECTION("button events are never merged")
+    {
+        WebSocketSendQueue q;
+        push(q, R"({"e":"changed","id":"1","r":"sensors","state":{"buttonevent":1002}})");
+        push(q, R"({"e":"changed","id":"1","r":"sensors","state":{"buttonevent":1002}})");
+        push(q, R"({"e":"changed","id":"1","r":"sensors","state":{"buttonevent":2002}})");
+        REQUIRE(q.size() == 3);
+        REQUIRE(q.coalesced() == 0);
+    }
+
+    SECTION("full queue drops the oldest message")
+    {
+        WebSocketSendQueue q;
+        for (int i = 0; i < WebSocketSendQueue::MaxMessages + 10; i++)
+        {
+            push(q, R"({"e":"changed","id":"1","r":"sensors","state":{"buttonevent":1002}})");
+        }
+        REQUIRE(q.size() == WebSocketSendQueue::MaxMessages);
+        REQUIRE(q.dropped() == 10);
+        REQUIRE(q.coalesced() == 0);
+    }
+}
+
+TEST_CASE("109: Websocket event merge", "[WebSocket]")
+{
+    QVariantMap on{{"e", "changed"}, {"r", "lights"}, {"id", "1"}, {"state", QVariantMap{{"on", true}, {"bri", 1}}}};
+    const QVariantMap bri{{"e", "changed"}, {"r", "lights"}, {"id", "1"}, {"state", QVariantMap{{"bri", 254}}}, {"attr", QVariantMap{{"name", "L1"}}}};
+
+    WebSocketSendQueue::mergeEvent(on, bri);
+
+    const QVariantMap state = on["state"].toMap();
+    REQUIRE(state["on"].toBool() == true);
+    REQUIRE(state["bri"].toInt() == 254);
+    REQUIRE(on["attr"].toMap()["name"].toString() == QLatin1String("L1"));
+}
+
+TEST_CASE("109: Websocket event items", "[WebSocket]")
+{
+    const QVariantMap button{{"e", "changed"}, {"r", "sensors"}, {"id", "1"}, {"state", QVariantMap{{"buttonevent", 1002}}}};
+    const QVariantMap presence{{"e", "changed"}, {"r", "sensors"}, {"id", "2"}, {"state", QVariantMap{{"presence", true}}}};
+
+    REQUIRE(WebSocketSendQueue::hasEventItem(button));
+    REQUIRE(!WebSocketSendQueue::hasEventItem(presence));
+    REQUIRE(WebSocketSendQueue::isEventItem(QLatin1String("rotaryevent")));
+    REQUIRE(!WebSocketSendQueue::isEventItem(QLatin1String("on")));
+}
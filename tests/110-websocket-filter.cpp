@@ -0,0 +1,88 @@
+#include "catch2/catch.hpp"
+#include "websocket_filter.h"
+
+static QVariantMap event(const char *e, const char *r, const char *id)
+{
+    QVariantMap map;
+    map["t"] = QLatin1String("event");
+    map["e"] = QLatin1String(e);
+    map["r"] = QLatin1String(r);
+    map["id"] = QLatin1String(id);
+    return map;
+}
+
+TEST_CASE("110: Websocket subscription filter", "[WebSocket]")
+{
+    WebSocketFilter filter;
+    QString error;
+
+    QVariantMap buttons = event("changed", "sensors", "5");
+    QVariantMap state;
+    state["buttonevent"] = 1002;
+    buttons["state"] = state;
+
+    QVariantMap light = event("changed", "lights", "1");
+    light["state"] = QVariantMap{{"on", true}};
+
+    REQUIRE(filter.matchesAll());
+    REQUIRE(filter.match(light));
+
+    SECTION("buttons of some sensors")
+    {
+        QVariantMap sub;
+        sub["resources"] = QVariantList{"sensors"};
+        sub["ids"] = QVariantList{"5", "7"};
+        sub["attrs"] = QVariantList{"state/buttonevent"};
+        REQUIRE(filter.parse(sub, &error));
+
+        REQUIRE(filter.match(buttons));
+        REQUIRE(!filter.match(light));
+
+        QVariantMap other = event("changed", "sensors", "6");
+        other["state"] = state;
+        REQUIRE(!filter.match(other));
+
+        QVariantMap config = event("changed", "sensors", "5");
+        config["config"] = QVariantMap{{"battery", 90}};
+        REQUIRE(!filter.match(config));
+
+        REQUIRE(filter.match(event("deleted", "sensors", "7"))); // attrs only restrict changed events
+    }
+
+    SECTION("event kinds and whole sections")
+    {
+        QVariantMap sub;
+        sub["events"] = QVariantList{"changed"};
+        sub["attrs"] = QVariantList{"state/*"};
+        REQUIRE(filter.parse(sub, &error));
+
+        REQUIRE(filter.match(buttons));
+        REQUIRE(filter.match(light));
+        REQUIRE(!filter.match(event("added", "lights", "2")));
+    }
+
+    SECTION("coalesce option")
+    {
+        QVariantMap sub;
+        sub["coalesce"] = true;
+        REQUIRE(filter.parse(sub, &error));
+        REQUIRE(filter.coalesce());
+        REQUIRE(filter.matchesAll());
+
+        sub["coalesce"] = 1;
+        REQUIRE(!filter.parse(sub, &error));
+    }
+
+    SECTION("invalid subscriptions keep the previous filter")
+    {
+        QVariantMap sub;
+        sub["resources"] = QVariantList{"rules"};
+        REQUIRE(!filter.parse(sub, &error));
+        REQUIRE(!error.isEmpty());
+
+        sub.clear();
+        sub["ids"] = QLatin1String("5");
+        REQUIRE(!filter.parse(sub, &error));
+        REQUIRE(filter.matchesAll());
+    }
+}
@@ -0,0 +1,112 @@
+#include "catch2/catch.hpp"
+#include "cbor_writer.h"
+#include "resource.h"
+
+// expected encodings from RFC 8949, Appendix A
+static QByteArray hex(const char *str)
+{
+    return QByteArray::fromHex(str);
+}
+
+TEST_CASE("111: CBOR writer data items", "[CBOR]")
+{
+    CborWriter cbor;
+
+    SECTION("integers")
+    {
+        cbor.value(0).value(23).value(24).value(1000).value(1000000).value(-1).value(-1000);
+        REQUIRE(cbor.buffer() == hex("00" "17" "1818" "1903e8" "1a000f4240" "20" "3903e7"));
+    }
+
+    SECTION("numbers without fraction are integers")
+    {
+        cbor.value(254.0).value(-5.0);
+        REQUIRE(cbor.buffer() == hex("18fe" "24"));
+    }
+
+    SECTION("floats")
+    {
+        cbor.value(1.5).value(1.1);
+        REQUIRE(cbor.buffer() == hex("fa3fc00000" "fb3ff199999999999a"));
+    }
+
+    SECTION("simple values and strings")
+    {
+        cbor.value(false).value(true).null().value("a").value(QString::fromUtf8("\xc3\xbc"));
+        REQUIRE(cbor.buffer() == hex("f4" "f5" "f6" "6161" "62c3bc"));
+    }
+
+    SECTION("event map with same schema as JSON")
+    {
+        QVariantMap state;
+        state["on"] = true;
+        QVariantMap event;
+        event["e"] = QLatin1String("changed");
+        event["state"] = state;
+        event["xy"] = QVariantList{0.5, 1};
+
+        cbor.value(QVariant(event));
+        REQUIRE(cbor.buffer() == hex("bf" "6165" "676368616e676564" "657374617465" "bf" "626f6e" "f5" "ff" "627879" "9f" "fa3f000000" "01" "ff" "ff"));
+        REQUIRE(!cbor.hasError());
+    }
+}
+
+static QVariantMap itemsToMap(const Resource &r, const char *prefix)
+{
+    QVariantMap map;
+    const size_t len = strlen(prefix);
+
+    for (int i = 0; i < r.itemCount(); i++)
+    {
+        const ResourceItem *item = r.itemForIndex(size_t(i));
+        if (strncmp(item->descriptor().suffix, prefix, len) == 0)
+        {
+            map[QLatin1String(item->descriptor().suffix + len)] = item->toVariant();
+        }
+    }
+
+    return map;
+}
+
+TEST_CASE("111: CBOR writer resource items", "[CBOR]")
+{
+    initResourceDescriptors();
+
+    Resource r(RSensors);
+    r.addItem(DataTypeString, RAttrName)->setValue(QString("Plug"));
+    r.addItem(DataTypeInt16, RStatePower)->setValue(qint64(-12));
+    r.addItem(DataTypeUInt16, RStateCurrent)->setValue(qint64(1234));
+    r.addItem(DataTypeBool, RStateOn)->setValue(true);
+    r.addItem(DataTypeBool, RConfigOn); // not set -> null
+    r.addItem(DataTypeUInt8, RConfigBattery)->setValue(qint64(100));
+
+    CborWriter cbor;
+    CborWriter expected;
+
+    SECTION("item values are written like ResourceItem::toVariant()")
+    {
+        for (int i = 0; i < r.itemCount(); i++)
+        {
+            const ResourceItem *item = r.itemForIndex(size_t(i));
+            CAPTURE(item->descriptor().suffix);
+            cbor.clear();
+            expected.clear();
+            cbor.value(*item);
+            expected.value(item->toVariant());
+            REQUIRE(cbor.buffer() == expected.buffer());
+        }
+    }
+
+    SECTION("resourceItems() has the same schema as the QVariantMap")
+    {
+        for (const char *prefix : {"state/", "config/", "attr/", ""})
+        {
+            CAPTURE(prefix);
+            cbor.clear();
+            expected.clear();
+            cbor.resourceItems(r, prefix);
+            expected.value(QVariant(itemsToMap(r, prefix)));
+            REQUIRE(cbor.buffer() == expected.buffer());
+        }
+    }
+}
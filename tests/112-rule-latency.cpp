@@ -0,0 +1,235 @@
+#include "catch2/catch.hpp"
+#include "event.h"
+#include "latency_histogram.h"
+#include "rule.h"
+#include "rule_engine.h"
+
+TEST_CASE("112: Latency histogram", "[Rules]")
+{
+    LatencyHistogram hist;
+
+    REQUIRE(hist.count() == 0);
+    REQUIRE(hist.percentile(50) == 0);
+
+    SECTION("samples are counted in power of two buckets")
+    {
+        hist.add(0);
+        hist.add(1);
+        hist.add(3);
+        hist.add(4);
+        hist.add(1000);
+        hist.add(-5); // clock skew counts as 0
+
+        REQUIRE(hist.count() == 6);
+        REQUIRE(hist.bucket(0) == 2);
+        REQUIRE(hist.bucket(1) == 1); // 1
+        REQUIRE(hist.bucket(2) == 1); // 2..3
+        REQUIRE(hist.bucket(3) == 1); // 4..7
+        REQUIRE(hist.bucket(10) == 1); // 512..1023
+        REQUIRE(hist.min() == 0);
+        REQUIRE(hist.max() == 1000);
+        REQUIRE(hist.mean() == 168);
+    }
+
+    SECTION("percentiles report the bucket upper bound")
+    {
+        for (int i = 0; i < 90; i++) { hist.add(100); }
+        for (int i = 0; i < 9; i++) { hist.add(5000); }
+        hist.add(40000000); // above the last limit
+
+        REQUIRE(hist.percentile(50) == 127);
+        REQUIRE(hist.percentile(90) == 127);
+        REQUIRE(hist.percentile(99) == 8191);
+        REQUIRE(hist.percentile(100) == 40000000);
+        REQUIRE(hist.bucket(LatencyHistogram::BucketCount - 1) == 1);
+
+        const QVariantMap map = hist.toMap();
+        REQUIRE(map["count"].toDouble() == 100);
+        REQUIRE(map["p99us"].toDouble() == 8191);
+        REQUIRE(map["buckets"].toMap()["inf"].toDouble() == 1);
+
+        hist.reset();
+        REQUIRE(hist.count() == 0);
+        REQUIRE(hist.max() == 0);
+    }
+
+    SECTION("timestamps are monotonic and never 0")
+    {
+        const qint64 t0 = LAT_Now();
+        REQUIRE(t0 > 0);
+        REQUIRE(LAT_Now() >= t0);
+
+        REQUIRE(LAT_Origin() == 0);
+        LAT_SetOrigin(t0);
+        REQUIRE(LAT_Origin() == t0);
+        LAT_SetOrigin(0);
+    }
+}
+
+namespace {
+
+struct RuleSet
+{
+    std::vector<Resource> sensors;
+    std::vector<Rule> rules;
+    ResourceIndex<int> index;
+};
+
+RuleSet *ruleSet = nullptr; // used by DEV_GetResource()
+
+} // namespace
+
+// The rule engine looks up condition resources via DEV_GetResource().
+// Testing code uses a mocked implementation.
+Resource *DEV_GetResource(const char *resource, const QString &identifier)
+{
+    if (!ruleSet || resource != RSensors)
+    {
+        return nullptr;
+    }
+
+    for (Resource &r : ruleSet->sensors)
+    {
+        if (r.item(RAttrId)->toString() == identifier)
+        {
+            return &r;
+        }
+    }
+
+    return nullptr;
+}
+
+bool RULE_IsDeletedResource(const Resource *)
+{
+    return false;
+}
+
+int IAS_PanelStatusFromString(const QString &)
+{
+    return -1;
+}
+
+bool Binding::operator==(const Binding &) const
+{
+    return false;
+}
+
+/*! Creates \p ruleCount button rules like the ones of a 4 button switch,
+    each with a buttonevent and lastupdated condition, the latter triggers the rule.
+ */
+static void createRuleSet(RuleSet &set, int ruleCount)
+{
+    const int sensorCount = ruleCount / 4 + 1;
+
+    for (int i = 0; i < sensorCount; i++)
+    {
+        Resource r(RSensors);
+        r.addItem(DataTypeString, RAttrId)->setValue(QString::number(i + 1));
+        r.addItem(DataTypeInt32, RStateButtonEvent)->setValue(qint64(0));
+        r.addItem(DataTypeTime, RStateLastUpdated);
+        r.addItem(DataTypeBool, RConfigOn)->setValue(QVariant(true));
+        set.sensors.push_back(r);
+    }
+
+    for (int i = 0; i < ruleCount; i++)
+    {
+        const QString sensorId = QString::number(i / 4 + 1);
+        const QString address = QString("/sensors/%1/state/").arg(sensorId);
+
+        QVariantMap button;
+        button["address"] = address + "buttonevent";
+        button["operator"] = "eq";
+        button["value"] = QString::number((i % 4 + 1) * 1000 + 2);
+
+        QVariantMap lastUpdated;
+        lastUpdated["address"] = address + "lastupdated";
+        lastUpdated["operator"] = "dx";
+
+        Rule rule;
+        rule.setId(QString::number(i + 1));
+        rule.setName(QString("Switch %1 button %2").arg(sensorId).arg(i % 4 + 1));
+        rule.setConditions({ RuleCondition(button), RuleCondition(lastUpdated) });
+        set.rules.push_back(rule);
+    }
+
+    // index the triggers after the containers don't grow anymore
+    for (Rule &rule : set.rules)
+    {
+        Resource *r = DEV_GetResource(RSensors, rule.conditions().front().id());
+        r->item(RStateButtonEvent)->inRule(rule.handle());
+        r->item(RStateLastUpdated)->inRule(rule.handle());
+    }
+}
+
+/*! Mirrors the lookup and evaluation in DeRestPluginPrivate::handleRuleEvent().
+    \returns the number of rules which would be triggered
+ */
+static int handleButtonEvent(RuleSet &set, Resource &sensor, int buttonevent, const QDateTime &now)
+{
+    sensor.item(RStateButtonEvent)->setValue(qint64(buttonevent));
+    ResourceItem *item = sensor.item(RStateLastUpdated);
+    item->setValue(now);
+
+    const Event e(RSensors, RStateLastUpdated, sensor.item(RAttrId)->toString(), item);
+    int triggered = 0;
+
+    for (int handle : item->rulesInvolved())
+    {
+        Rule *rule = RULE_GetForHandle(set.rules, set.index, handle);
+
+        if (rule && RULE_Evaluate(*rule, e, item, now, now.addSecs(-1)))
+        {
+            triggered++;
+        }
+    }
+
+    return triggered;
+}
+
+TEST_CASE("112: Rule engine lookup and evaluation", "[Rules]")
+{
+    initResourceDescriptors();
+
+    RuleSet set;
+    ruleSet = &set;
+    createRuleSet(set, 100);
+
+    const QDateTime now = QDateTime::currentDateTime();
+    Resource &sensor = set.sensors[3];
+
+    REQUIRE(sensor.item(RStateLastUpdated)->rulesInvolved().size() == 4);
+    REQUIRE(RULE_GetForHandle(set.rules, set.index, set.rules[42].handle()) == &set.rules[42]);
+
+    REQUIRE(handleButtonEvent(set, sensor, 1002, now) == 1);
+    REQUIRE(handleButtonEvent(set, sensor, 4002, now) == 1);
+    REQUIRE(handleButtonEvent(set, sensor, 4002, now) == 1); // pressed again
+    REQUIRE(handleButtonEvent(set, sensor, 5002, now) == 0); // no rule
+
+    sensor.item(RConfigOn)->setValue(QVariant(false));
+    REQUIRE(handleButtonEvent(set, sensor, 2002, now) == 0);
+
+    ruleSet = nullptr;
+}
+
+TEST_CASE("112: Rule engine benchmark", "[Rules][!benchmark]")
+{
+    initResourceDescriptors();
+
+    auto ruleCount = GENERATE(10, 100, 1000);
+
+    RuleSet set;
+    ruleSet = &set;
+    createRuleSet(set, ruleCount);
+
+    const QDateTime now = QDateTime::currentDateTime();
+    size_t n = 0;
+
+    BENCHMARK(QString("button event, %1 rules").arg(ruleCount).toStdString())
+    {
+        n++;
+        Resource &sensor = set.sensors[n % set.sensors.size()];
+        return handleButtonEvent(set, sensor, int((n / set.sensors.size()) % 4 + 1) * 1000 + 2, now);
+    };
+
+    ruleSet = nullptr;
+}
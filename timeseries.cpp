@@ -0,0 +1,878 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <algorithm>
+#include <QDir>
+#include <QFile>
+#include "timeseries.h"
+
+#define TS_FLUSH_INTERVAL     (10 * 60)  // seconds after which partially filled blocks are written
+#define TS_RETENTION_INTERVAL (60 * 60)  // seconds between retention runs
+#define TS_SEGMENT_SUFFIX     ".tss"
+#define TS_ROLLUP_SUFFIX      ".tsr"
+
+const qint64 TS_RollupResolutions[TS_RollupCount] = { 300, 3600 };
+
+static qint64 floorTo(qint64 t, qint64 step)
+{
+    const qint64 r = t % step;
+    return r < 0 ? t - r - step : t - r;
+}
+
+static quint64 zigzagEncode(qint64 v)
+{
+    return (quint64(v) << 1) ^ quint64(v >> 63);
+}
+
+static qint64 zigzagDecode(quint64 v)
+{
+    return qint64(v >> 1) ^ -qint64(v & 1);
+}
+
+static void putLE(char *p, quint64 v, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        p[i] = char(v & 0xFF);
+        v >>= 8;
+    }
+}
+
+static quint64 getLE(const char *p, int size)
+{
+    quint64 v = 0;
+    for (int i = size - 1; i >= 0; i--)
+    {
+        v = (v << 8) | quint8(p[i]);
+    }
+    return v;
+}
+
+/*! Appends \p value as zigzag encoded LEB128 varint.
+ */
+void TS_PutVarint(QByteArray &out, qint64 value)
+{
+    quint64 v = zigzagEncode(value);
+
+    while (v >= 0x80)
+    {
+        out.append(char((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.append(char(v));
+}
+
+/*! Reads a zigzag encoded varint at \p p and advances \p p.
+    \returns false if the data is truncated or invalid.
+ */
+bool TS_GetVarint(const char *&p, const char *end, qint64 *value)
+{
+    quint64 v = 0;
+
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        const quint8 b = quint8(*p++);
+        v |= quint64(b & 0x7F) << shift;
+
+        if ((b & 0x80) == 0)
+        {
+            *value = zigzagDecode(v);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Appends a sample to the block.
+    \returns false if the block is full, the sample is not added then.
+ */
+bool TS_BlockEncoder::append(qint64 timestamp, qint64 value)
+{
+    const int size = m_payload.size();
+
+    if (m_count == 0)
+    {
+        TS_PutVarint(m_payload, value);
+        m_first = { timestamp, value };
+    }
+    else
+    {
+        if (m_count == 0xFFFF)
+        {
+            return false;
+        }
+
+        TS_PutVarint(m_payload, timestamp - m_last.timestamp);
+        TS_PutVarint(m_payload, value - m_last.value);
+
+        if (m_payload.size() > TS_BlockPayloadMax)
+        {
+            m_payload.truncate(size);
+            return false;
+        }
+    }
+
+    m_last = { timestamp, value };
+    m_count++;
+    return true;
+}
+
+void TS_BlockEncoder::clear()
+{
+    m_payload.clear();
+    m_count = 0;
+    m_first = {};
+    m_last = {};
+}
+
+/*! Returns the encoded block including its header.
+ */
+QByteArray TS_BlockEncoder::block() const
+{
+    QByteArray result(TS_BlockHeaderSize, '\0');
+    char *p = result.data();
+
+    p[0] = char(TS_BlockMagic);
+    p[1] = char(TS_BlockVersion);
+    putLE(&p[2], quint64(m_count), 2);
+    putLE(&p[4], quint64(m_payload.size()), 4);
+    putLE(&p[8], quint64(m_first.timestamp), 8);
+    putLE(&p[16], quint64(m_last.timestamp), 8);
+
+    result.append(m_payload);
+    return result;
+}
+
+/*! Decodes all samples of the blocks in \p data within [from, to] and appends them to \p out.
+    Blocks outside the range are skipped without decoding their payload.
+    \returns false if the data is corrupt, samples decoded before are kept.
+ */
+bool TS_DecodeBlocks(const QByteArray &data, qint64 from, qint64 to, std::vector<TS_Sample> &out)
+{
+    const char *p = data.constData();
+    const char *end = p + data.size();
+
+    while (p < end)
+    {
+        if (end - p < TS_BlockHeaderSize || quint8(p[0]) != TS_BlockMagic || p[1] != TS_BlockVersion)
+        {
+            return false;
+        }
+
+        const int count = int(getLE(&p[2], 2));
+        const qint64 payloadSize = qint64(getLE(&p[4], 4));
+        const qint64 first = qint64(getLE(&p[8], 8));
+        const qint64 last = qint64(getLE(&p[16], 8));
+        const char *payload = p + TS_BlockHeaderSize;
+
+        if (payloadSize > end - payload)
+        {
+            return false;
+        }
+
+        p = payload + payloadSize;
+
+        if (last < from || first > to || count == 0)
+        {
+            continue;
+        }
+
+        TS_Sample s;
+        s.timestamp = first;
+        const char *q = payload;
+
+        for (int i = 0; i < count; i++)
+        {
+            qint64 dt = 0;
+            qint64 dv = 0;
+
+            if (i == 0)
+            {
+                if (!TS_GetVarint(q, p, &s.value))
+                {
+                    return false;
+                }
+            }
+            else if (TS_GetVarint(q, p, &dt) && TS_GetVarint(q, p, &dv))
+            {
+                s.timestamp += dt;
+                s.value += dv;
+            }
+            else
+            {
+                return false;
+            }
+
+            if (s.timestamp >= from && s.timestamp <= to)
+            {
+                out.push_back(s);
+            }
+        }
+    }
+
+    return true;
+}
+
+void TS_Aggregate::add(qint64 value)
+{
+    if (count == 0)
+    {
+        min = max = value;
+    }
+    else
+    {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    sum += value;
+    last = value;
+    count++;
+}
+
+/*! Merges \p other which must not be older than this aggregate.
+ */
+void TS_Aggregate::merge(const TS_Aggregate &other)
+{
+    if (other.count == 0)
+    {
+        return;
+    }
+
+    if (count == 0)
+    {
+        const qint64 t = timestamp;
+        *this = other;
+        timestamp = t;
+        return;
+    }
+
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    last = other.last;
+    count += other.count;
+}
+
+/*! Appends the fixed size rollup record of \p agg.
+ */
+void TS_PutRollupRecord(QByteArray &out, const TS_Aggregate &agg)
+{
+    char rec[TS_RollupRecordSize];
+
+    putLE(&rec[0], quint64(agg.timestamp), 8);
+    putLE(&rec[8], quint64(agg.min), 8);
+    putLE(&rec[16], quint64(agg.max), 8);
+    putLE(&rec[24], quint64(agg.sum), 8);
+    putLE(&rec[32], quint64(agg.last), 8);
+    putLE(&rec[40], agg.count, 4);
+
+    out.append(rec, TS_RollupRecordSize);
+}
+
+/*! Decodes all rollup records of \p data with bucket start within [from, to] and appends them to \p out.
+    \returns false if the data has a truncated record.
+ */
+bool TS_DecodeRollupRecords(const QByteArray &data, qint64 from, qint64 to, std::vector<TS_Aggregate> &out)
+{
+    const char *p = data.constData();
+    const int n = data.size() / TS_RollupRecordSize;
+
+    for (int i = 0; i < n; i++, p += TS_RollupRecordSize)
+    {
+        TS_Aggregate agg;
+        agg.timestamp = qint64(getLE(&p[0], 8));
+
+        if (agg.timestamp < from || agg.timestamp > to)
+        {
+            continue;
+        }
+
+        agg.min = qint64(getLE(&p[8], 8));
+        agg.max = qint64(getLE(&p[16], 8));
+        agg.sum = qint64(getLE(&p[24], 8));
+        agg.last = qint64(getLE(&p[32], 8));
+        agg.count = quint32(getLE(&p[40], 4));
+        out.push_back(agg);
+    }
+
+    return data.size() % TS_RollupRecordSize == 0;
+}
+
+/*! Aggregates \p samples sorted by timestamp into buckets of \p bucket seconds.
+ */
+std::vector<TS_Aggregate> TS_AggregateSamples(const std::vector<TS_Sample> &samples, qint64 bucket)
+{
+    std::vector<TS_Aggregate> result;
+
+    for (const TS_Sample &s : samples)
+    {
+        const qint64 start = floorTo(s.timestamp, bucket);
+
+        if (result.empty() || result.back().timestamp != start)
+        {
+            result.emplace_back();
+            result.back().timestamp = start;
+        }
+
+        result.back().add(s.value);
+    }
+
+    return result;
+}
+
+/*! Merges rollup \p aggregates into buckets of \p bucket seconds which must be a multiple of their resolution.
+    Aggregates with equal bucket start are merged in their given order.
+ */
+std::vector<TS_Aggregate> TS_MergeAggregates(std::vector<TS_Aggregate> aggregates, qint64 bucket)
+{
+    std::vector<TS_Aggregate> result;
+
+    std::stable_sort(aggregates.begin(), aggregates.end(), [](const TS_Aggregate &a, const TS_Aggregate &b) { return a.timestamp < b.timestamp; });
+
+    for (const TS_Aggregate &agg : aggregates)
+    {
+        const qint64 start = floorTo(agg.timestamp, bucket);
+
+        if (result.empty() || result.back().timestamp != start)
+        {
+            result.emplace_back();
+            result.back().timestamp = start;
+        }
+
+        result.back().merge(agg);
+    }
+
+    return result;
+}
+
+TS_Worker::TS_Worker()
+{
+    m_thread = std::thread(&TS_Worker::run, this);
+}
+
+/*! Executes all queued jobs and stops the thread.
+ */
+TS_Worker::~TS_Worker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+void TS_Worker::post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_cond.notify_one();
+}
+
+void TS_Worker::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        m_cond.wait(lock, [this]{ return m_stop || !m_jobs.empty(); });
+
+        if (m_jobs.empty())
+        {
+            break; // stopped
+        }
+
+        std::function<void()> job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+TS_Store::TS_Store(const QString &path) :
+    m_path(path),
+    m_jobs(std::make_shared<Jobs>())
+{
+    m_executor = [](std::function<void()> job) { job(); };
+}
+
+TS_Store::~TS_Store()
+{
+    // partially filled blocks must be written with flush() before
+}
+
+QString TS_Store::seriesPath(const TS_Key &key) const
+{
+    return QString("%1/%2-%3-%4-%5")
+            .arg(m_path)
+            .arg(key.extAddress, 16, 16, QLatin1Char('0'))
+            .arg(key.endpoint, 2, 16, QLatin1Char('0'))
+            .arg(key.clusterId, 4, 16, QLatin1Char('0'))
+            .arg(key.attributeId, 4, 16, QLatin1Char('0'));
+}
+
+/*! Extracts the series key from a series directory name, see seriesPath().
+ */
+static bool keyFromDirName(const QString &name, TS_Key *key)
+{
+    const auto parts = name.split(QLatin1Char('-'));
+    bool ok[4] = { };
+
+    if (parts.size() != 4)
+    {
+        return false;
+    }
+
+    key->extAddress = parts[0].toULongLong(&ok[0], 16);
+    key->endpoint = quint8(parts[1].toUInt(&ok[1], 16));
+    key->clusterId = quint16(parts[2].toUInt(&ok[2], 16));
+    key->attributeId = quint16(parts[3].toUInt(&ok[3], 16));
+
+    return ok[0] && ok[1] && ok[2] && ok[3];
+}
+
+/*! Appends a sample to the series of \p key.
+    Full blocks are written immediately, partially filled ones after TS_FLUSH_INTERVAL.
+ */
+void TS_Store::append(const TS_Key &key, qint64 timestamp, qint64 value)
+{
+    Series &series = m_series[key];
+    series.last = std::max(series.last, timestamp);
+
+    if (!series.block.append(timestamp, value))
+    {
+        writeBlock(key, series);
+        series.block.append(timestamp, value);
+    }
+
+    for (int i = 0; i < TS_RollupCount; i++)
+    {
+        TS_Aggregate &rollup = series.rollups[i];
+        const qint64 start = floorTo(timestamp, TS_RollupResolutions[i]);
+
+        if (rollup.count > 0 && rollup.timestamp != start)
+        {
+            writeRollup(key, series, i);
+        }
+
+        if (rollup.count == 0)
+        {
+            rollup.timestamp = start;
+        }
+
+        rollup.add(value);
+    }
+
+    if (m_nextFlush == 0)
+    {
+        m_nextFlush = timestamp + TS_FLUSH_INTERVAL;
+        m_nextRetention = timestamp + TS_RETENTION_INTERVAL;
+    }
+    else if (timestamp >= m_nextFlush)
+    {
+        flush(timestamp, false);
+    }
+
+    if (timestamp >= m_nextRetention)
+    {
+        m_nextRetention = timestamp + TS_RETENTION_INTERVAL;
+        applyRetention(timestamp);
+    }
+}
+
+/*! Writes blocks which are older than TS_FLUSH_INTERVAL or all blocks and open rollups if \p all is true.
+ */
+void TS_Store::flush(qint64 now, bool all)
+{
+    for (auto i = m_series.begin(); i != m_series.end(); ++i)
+    {
+        Series &series = i.value();
+
+        if (!series.block.empty() && (all || series.block.firstTimestamp() + TS_FLUSH_INTERVAL <= now))
+        {
+            writeBlock(i.key(), series);
+        }
+
+        for (int r = 0; all && r < TS_RollupCount; r++)
+        {
+            if (series.rollups[r].count > 0)
+            {
+                writeRollup(i.key(), series, r); // merged with a later record of the same bucket on query
+            }
+        }
+    }
+
+    m_nextFlush = now + TS_FLUSH_INTERVAL;
+}
+
+/*! Executes \p job on the executor after the file jobs submitted before, e.g. to record
+    that data handed to the store has been written.
+ */
+void TS_Store::post(std::function<void()> job)
+{
+    submit(std::move(job));
+}
+
+/*! Hands \p job to the executor.
+    \returns Sequence number of the job, see Jobs::completed.
+ */
+quint64 TS_Store::submit(std::function<void()> job)
+{
+    const quint64 seq = ++m_submitted;
+    const auto jobs = m_jobs;
+
+    m_executor([jobs, seq, job]()
+    {
+        std::lock_guard<std::mutex> lock(jobs->mutex);
+        job();
+        jobs->completed = seq;
+    });
+
+    return seq;
+}
+
+/*! Keeps \p pending until its job completed and drops those which are written.
+ */
+void TS_Store::addPending(Series &series, Pending pending)
+{
+    const quint64 completed = m_jobs->completed;
+
+    series.pending.erase(std::remove_if(series.pending.begin(), series.pending.end(), [completed](const Pending &p)
+    {
+        return p.seq <= completed;
+    }), series.pending.end());
+
+    if (pending.seq > completed)
+    {
+        series.pending.push_back(std::move(pending));
+    }
+}
+
+void TS_Store::writeBlock(const TS_Key &key, Series &series)
+{
+    const QByteArray block = series.block.block();
+
+    if (series.segment.isEmpty() || series.segmentSize + block.size() > TS_SegmentMaxSize)
+    {
+        // the zero padded start timestamp keeps segment files sorted by name
+        series.segment = QString("%1/%2" TS_SEGMENT_SUFFIX).arg(seriesPath(key)).arg(series.block.firstTimestamp(), 12, 10, QLatin1Char('0'));
+        series.segmentSize = 0;
+    }
+
+    series.segmentSize += block.size();
+    series.block.clear();
+
+    const QString dir = seriesPath(key);
+    const QString segment = series.segment;
+
+    Pending pending;
+    pending.block = block;
+    pending.seq = submit([dir, segment, block]()
+    {
+        QDir().mkpath(dir);
+        QFile file(segment);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Append))
+        {
+            file.write(block);
+        }
+    });
+
+    addPending(series, std::move(pending));
+}
+
+/*! Appends the open rollup bucket of \p resolution to its rollup file and resets it.
+ */
+void TS_Store::writeRollup(const TS_Key &key, Series &series, int resolution)
+{
+    TS_Aggregate &agg = series.rollups[resolution];
+
+    Pending pending;
+    pending.resolution = resolution;
+    pending.agg = agg;
+
+    QByteArray rec;
+    TS_PutRollupRecord(rec, agg);
+
+    const QString dir = seriesPath(key);
+    const QString file = QString("%1/r%2-%3" TS_ROLLUP_SUFFIX)
+            .arg(dir)
+            .arg(TS_RollupResolutions[resolution])
+            .arg(floorTo(agg.timestamp, TS_RollupFilePeriod), 12, 10, QLatin1Char('0'));
+
+    agg = {};
+
+    pending.seq = submit([dir, file, rec]()
+    {
+        QDir().mkpath(dir);
+        QFile f(file);
+        if (f.open(QIODevice::WriteOnly | QIODevice::Append))
+        {
+            f.write(rec);
+        }
+    });
+
+    addPending(series, std::move(pending));
+}
+
+/*! Returns the newest timestamp of the blocks in \p data or -1 if there is none.
+ */
+static qint64 lastBlockTimestamp(const QByteArray &data)
+{
+    qint64 result = -1;
+    const char *p = data.constData();
+    const char *end = p + data.size();
+
+    while (end - p >= TS_BlockHeaderSize && quint8(p[0]) == TS_BlockMagic && p[1] == TS_BlockVersion)
+    {
+        const qint64 payloadSize = qint64(getLE(&p[4], 4));
+        result = std::max(result, qint64(getLE(&p[16], 8)));
+
+        if (payloadSize > end - p - TS_BlockHeaderSize)
+        {
+            break;
+        }
+
+        p += TS_BlockHeaderSize + payloadSize;
+    }
+
+    return result;
+}
+
+/*! Deletes segments which only contain samples older than the max. age.
+    A series is deleted entirely once its newest sample is older than the max. age.
+ */
+void TS_Store::applyRetention(qint64 now)
+{
+    if (m_maxAge <= 0)
+    {
+        return;
+    }
+
+    const qint64 cutoff = now - m_maxAge;
+    const QString path = m_path;
+
+    // the blocks of expired series are written before the retention job runs
+    for (auto i = m_series.begin(); i != m_series.end(); )
+    {
+        if (i->last < cutoff)
+        {
+            i = m_series.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    submit([path, cutoff]()
+    {
+        const QDir root(path);
+        const auto seriesDirs = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+
+        for (const QString &name : seriesDirs)
+        {
+            QDir dir(root.filePath(name));
+            const auto segments = dir.entryList(QStringList() << "*" TS_SEGMENT_SUFFIX, QDir::Files, QDir::Name);
+
+            if (!segments.isEmpty())
+            {
+                QFile newest(dir.filePath(segments.last()));
+                const qint64 last = newest.open(QIODevice::ReadOnly) ? lastBlockTimestamp(newest.readAll()) : -1;
+                newest.close();
+
+                if (last >= 0 && last < cutoff)
+                {
+                    dir.removeRecursively(); // includes the rollups
+                    continue;
+                }
+            }
+
+            // segment i only has samples older than the start of segment i + 1
+            for (int i = 0; i + 1 < segments.size(); i++)
+            {
+                const qint64 nextStart = segments[i + 1].section(QLatin1Char('.'), 0, 0).toLongLong();
+                if (nextStart > cutoff)
+                {
+                    break;
+                }
+
+                dir.remove(segments[i]);
+            }
+
+            const auto rollups = dir.entryList(QStringList() << "*" TS_ROLLUP_SUFFIX, QDir::Files);
+            for (const QString &rollup : rollups)
+            {
+                const qint64 periodStart = rollup.section(QLatin1Char('-'), 1, 1).section(QLatin1Char('.'), 0, 0).toLongLong();
+                if (periodStart + TS_RollupFilePeriod <= cutoff)
+                {
+                    dir.remove(rollup);
+                }
+            }
+        }
+    });
+}
+
+/*! Returns the keys of all series on disk and in memory.
+ */
+std::vector<TS_Key> TS_Store::keys() const
+{
+    std::vector<TS_Key> result;
+
+    for (auto i = m_series.cbegin(); i != m_series.cend(); ++i)
+    {
+        result.push_back(i.key());
+    }
+
+    const auto seriesDirs = QDir(m_path).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &name : seriesDirs)
+    {
+        TS_Key key;
+        if (keyFromDirName(name, &key) && !m_series.contains(key))
+        {
+            result.push_back(key);
+        }
+    }
+
+    return result;
+}
+
+/*! Returns the samples of \p key within [from, to] sorted by timestamp, including not yet written ones.
+ */
+std::vector<TS_Sample> TS_Store::query(const TS_Key &key, qint64 from, qint64 to) const
+{
+    std::vector<TS_Sample> result;
+
+    std::unique_lock<std::mutex> lock(m_jobs->mutex); // waits at most for one running file job
+    const quint64 completed = m_jobs->completed;
+
+    const QDir dir(seriesPath(key));
+    const auto segments = dir.entryList(QStringList() << "*" TS_SEGMENT_SUFFIX, QDir::Files, QDir::Name);
+
+    for (int i = 0; i < segments.size(); i++)
+    {
+        if (i + 1 < segments.size() && segments[i + 1].section(QLatin1Char('.'), 0, 0).toLongLong() < from)
+        {
+            continue; // all samples before 'from'
+        }
+
+        if (segments[i].section(QLatin1Char('.'), 0, 0).toLongLong() > to)
+        {
+            break;
+        }
+
+        QFile file(dir.filePath(segments[i]));
+        if (file.open(QIODevice::ReadOnly))
+        {
+            TS_DecodeBlocks(file.readAll(), from, to, result);
+        }
+    }
+
+    lock.unlock();
+
+    const auto s = m_series.constFind(key);
+    if (s != m_series.cend())
+    {
+        for (const Pending &p : s->pending)
+        {
+            if (p.seq > completed && p.resolution < 0)
+            {
+                TS_DecodeBlocks(p.block, from, to, result);
+            }
+        }
+
+        if (!s->block.empty())
+        {
+            TS_DecodeBlocks(s->block.block(), from, to, result);
+        }
+    }
+
+    std::stable_sort(result.begin(), result.end(), [](const TS_Sample &a, const TS_Sample &b) { return a.timestamp < b.timestamp; });
+
+    return result;
+}
+
+/*! Returns min/max/sum/count/last aggregates per bucket of \p bucket seconds within [from, to].
+    Buckets are aligned to multiples of \p bucket. If \p bucket is a multiple of a rollup
+    resolution the pre-aggregated rollups are used, otherwise the raw samples are aggregated.
+ */
+std::vector<TS_Aggregate> TS_Store::aggregate(const TS_Key &key, qint64 from, qint64 to, qint64 bucket) const
+{
+    if (bucket <= 0)
+    {
+        return {};
+    }
+
+    int r = TS_RollupCount - 1;
+    for (; r >= 0; r--)
+    {
+        if (bucket % TS_RollupResolutions[r] == 0)
+        {
+            break;
+        }
+    }
+
+    if (r < 0)
+    {
+        return TS_AggregateSamples(query(key, floorTo(from, bucket), to), bucket);
+    }
+
+    const qint64 resolution = TS_RollupResolutions[r];
+    const qint64 first = floorTo(from, bucket);
+    std::vector<TS_Aggregate> rollups;
+
+    std::unique_lock<std::mutex> lock(m_jobs->mutex);
+    const quint64 completed = m_jobs->completed;
+
+    const QDir dir(seriesPath(key));
+    const auto files = dir.entryList(QStringList() << QString("r%1-*" TS_ROLLUP_SUFFIX).arg(resolution), QDir::Files, QDir::Name);
+
+    for (const QString &name : files)
+    {
+        const qint64 periodStart = name.section(QLatin1Char('-'), 1, 1).section(QLatin1Char('.'), 0, 0).toLongLong();
+        if (periodStart + TS_RollupFilePeriod <= first || periodStart > to)
+        {
+            continue;
+        }
+
+        QFile file(dir.filePath(name));
+        if (file.open(QIODevice::ReadOnly))
+        {
+            TS_DecodeRollupRecords(file.readAll(), first, to, rollups);
+        }
+    }
+
+    lock.unlock();
+
+    const auto s = m_series.constFind(key);
+    if (s != m_series.cend())
+    {
+        for (const Pending &p : s->pending)
+        {
+            if (p.seq > completed && p.resolution == r && p.agg.timestamp >= first && p.agg.timestamp <= to)
+            {
+                rollups.push_back(p.agg);
+            }
+        }
+
+        const TS_Aggregate &open = s->rollups[r];
+        if (open.count > 0 && open.timestamp >= first && open.timestamp <= to)
+        {
+            rollups.push_back(open);
+        }
+    }
+
+    return TS_MergeAggregates(std::move(rollups), bucket);
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+/*! Append-only time-series store for ZCL attribute history.
+
+    Each (device, endpoint, cluster, attribute) has its own series stored in a
+    directory below the store path. A series consists of segment files which are
+    a sequence of self contained blocks:
+
+        u8  magic (TS_BlockMagic)
+        u8  version
+        u16 sample count
+        u32 payload size
+        i64 first timestamp
+        i64 last timestamp
+        payload: zigzag varint first value,
+                 then per further sample zigzag varint timestamp delta and value delta
+
+    All integers in the block header are little endian. Retention drops whole
+    segment files which only contain samples older than the max. age and whole
+    series once their newest sample is older than the max. age.
+
+    For fast history queries each series also maintains rollups with
+    min/max/sum/count/last per 5 minute and 1 hour bucket. Rollup records have
+    a fixed size of TS_RollupRecordSize bytes and are stored in one file per
+    TS_RollupFilePeriod seconds.
+ */
+
+struct TS_Key
+{
+    quint64 extAddress = 0;
+    quint16 clusterId = 0;
+    quint16 attributeId = 0;
+    quint8 endpoint = 0;
+};
+
+inline bool operator==(const TS_Key &a, const TS_Key &b)
+{
+    return a.extAddress == b.extAddress && a.clusterId == b.clusterId &&
+           a.attributeId == b.attributeId && a.endpoint == b.endpoint;
+}
+
+inline uint qHash(const TS_Key &key, uint seed = 0)
+{
+    return ::qHash(key.extAddress, seed) ^ ::qHash((quint64(key.endpoint) << 32) | (quint64(key.clusterId) << 16) | key.attributeId, seed);
+}
+
+struct TS_Sample
+{
+    qint64 timestamp = 0; // seconds since Epoch
+    qint64 value = 0;
+};
+
+/*! Aggregate of all samples within a bucket. */
+struct TS_Aggregate
+{
+    qint64 timestamp = 0; // bucket start, seconds since Epoch
+    qint64 min = 0;
+    qint64 max = 0;
+    qint64 sum = 0;
+    qint64 last = 0;
+    quint32 count = 0;
+
+    void add(qint64 value);
+    void merge(const TS_Aggregate &other);
+    double avg() const { return count ? double(sum) / count : 0.0; }
+};
+
+enum TS_Constants
+{
+    TS_BlockMagic = 0xA7,
+    TS_BlockVersion = 1,
+    TS_BlockHeaderSize = 24,
+    TS_BlockPayloadMax = 232, // a block (header + payload) fits in 256 bytes
+    TS_SegmentMaxSize = 64 * 1024,
+    TS_RollupCount = 2, // see TS_RollupResolutions
+    TS_RollupRecordSize = 44,
+    TS_RollupFilePeriod = 30 * 24 * 3600
+};
+
+extern const qint64 TS_RollupResolutions[TS_RollupCount];
+
+/*! Delta/varint encoder for one block. */
+class TS_BlockEncoder
+{
+public:
+    bool append(qint64 timestamp, qint64 value);
+    void clear();
+    bool empty() const { return m_count == 0; }
+    int count() const { return m_count; }
+    qint64 firstTimestamp() const { return m_first.timestamp; }
+    qint64 lastTimestamp() const { return m_last.timestamp; }
+    QByteArray block() const;
+
+private:
+    QByteArray m_payload;
+    TS_Sample m_first;
+    TS_Sample m_last;
+    int m_count = 0;
+};
+
+void TS_PutVarint(QByteArray &out, qint64 value);
+bool TS_GetVarint(const char *&p, const char *end, qint64 *value);
+bool TS_DecodeBlocks(const QByteArray &data, qint64 from, qint64 to, std::vector<TS_Sample> &out);
+void TS_PutRollupRecord(QByteArray &out, const TS_Aggregate &agg);
+bool TS_DecodeRollupRecords(const QByteArray &data, qint64 from, qint64 to, std::vector<TS_Aggregate> &out);
+std::vector<TS_Aggregate> TS_AggregateSamples(const std::vector<TS_Sample> &samples, qint64 bucket);
+std::vector<TS_Aggregate> TS_MergeAggregates(std::vector<TS_Aggregate> aggregates, qint64 bucket);
+
+/*! Background thread which executes file jobs in order, used as TS_Store executor.
+    The file I/O doesn't block the main thread and isn't part of database transactions.
+ */
+class TS_Worker
+{
+public:
+    TS_Worker();
+    ~TS_Worker();
+    void post(std::function<void()> job);
+
+private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+class TS_Store
+{
+public:
+    /*! Executes file jobs in order, can be used to move the file I/O to a background thread.
+        Queries don't wait for pending jobs, data handed to a job is kept in memory until the job completed.
+     */
+    using Executor = std::function<void(std::function<void()>)>;
+
+    explicit TS_Store(const QString &path);
+    ~TS_Store();
+    void setExecutor(Executor executor) { m_executor = std::move(executor); }
+    void setMaxAge(qint64 seconds) { m_maxAge = seconds; }
+    qint64 maxAge() const { return m_maxAge; }
+    void append(const TS_Key &key, qint64 timestamp, qint64 value);
+    void flush(qint64 now, bool all);
+    void post(std::function<void()> job);
+    void applyRetention(qint64 now);
+    std::vector<TS_Key> keys() const;
+    std::vector<TS_Sample> query(const TS_Key &key, qint64 from, qint64 to) const;
+    std::vector<TS_Aggregate> aggregate(const TS_Key &key, qint64 from, qint64 to, qint64 bucket) const;
+
+private:
+    /*! Block or rollup record handed to the file job \c seq. */
+    struct Pending
+    {
+        quint64 seq = 0;
+        int resolution = -1; // rollup index, -1 for a block
+        QByteArray block;
+        TS_Aggregate agg;
+    };
+
+    struct Series
+    {
+        TS_BlockEncoder block;
+        QString segment; // current segment file
+        qint64 segmentSize = 0;
+        TS_Aggregate rollups[TS_RollupCount]; // open rollup buckets
+        std::vector<Pending> pending; // maybe not yet written
+        qint64 last = 0; // newest sample
+    };
+
+    /*! State shared with the file jobs. A job holds the mutex while accessing files,
+        so files read under the mutex contain exactly the jobs up to \c completed.
+     */
+    struct Jobs
+    {
+        std::mutex mutex;
+        std::atomic<quint64> completed{0};
+    };
+
+    QString seriesPath(const TS_Key &key) const;
+    quint64 submit(std::function<void()> job);
+    void addPending(Series &series, Pending pending);
+    void writeBlock(const TS_Key &key, Series &series);
+    void writeRollup(const TS_Key &key, Series &series, int resolution);
+
+    QString m_path;
+    qint64 m_maxAge = 0;
+    qint64 m_nextFlush = 0;
+    qint64 m_nextRetention = 0;
+    QHash<TS_Key, Series> m_series;
+    Executor m_executor;
+    quint64 m_submitted = 0;
+    std::shared_ptr<Jobs> m_jobs;
+};
+
+#endif // TIMESERIES_H
@@ -63,6 +63,21 @@ uint64_t U_ParseUint64(const char *str, int len, int base)
     return result;
 }
 
+/*! Returns the version of an ETag created by DeRestPluginPrivate::updateEtag().
+    \return the version or 0 for empty and legacy (MD5) ETags
+ */
+quint64 U_EtagVersion(const QString &etag)
+{
+    if (etag.size() < 3 || etag.at(0) != QLatin1Char('"'))
+    {
+        return 0;
+    }
+
+    bool ok = false;
+    const quint64 version = etag.midRef(1, etag.size() - 2).toULongLong(&ok, 10);
+    return ok ? version : 0;
+}
+
 /*! Generates a new uniqueid in various formats based on the input parameters.
 
     extAddress           endpoint  cluster    result
@@ -63,6 +63,7 @@ struct RestData
 
 unsigned U_StringLength(const char *str);
 uint64_t U_ParseUint64(const char *str, int len, int base);
+quint64 U_EtagVersion(const QString &etag);
 
 
 QString generateUniqueId(quint64 extAddress, quint8 endpoint, quint16 clusterId);
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "websocket_filter.h"
+
+static const char *resourceNames[] = { "lights", "sensors", "groups", "scenes", "alarmsystems", nullptr };
+static const char *eventNames[] = { "added", "changed", "deleted", "scene-called", nullptr };
+static const quint32 EventChanged = 1 << 1;
+
+/*! Returns the bit of \p name in \p names or 0 if unknown.
+ */
+static quint32 bitForName(const char **names, const QString &name)
+{
+    for (int i = 0; names[i]; i++)
+    {
+        if (name == QLatin1String(names[i]))
+        {
+            return 1u << i;
+        }
+    }
+
+    return 0;
+}
+
+/*! Compiles the bit mask of a list of names.
+    \return false if the list contains an unknown name
+ */
+static bool parseMask(const QVariant &list, const char **names, quint32 *mask, QString *error)
+{
+    *mask = 0;
+
+    for (const QVariant &v : list.toList())
+    {
+        const quint32 bit = bitForName(names, v.toString());
+        if (bit == 0)
+        {
+            *error = QString("unknown value, %1").arg(v.toString());
+            return false;
+        }
+        *mask |= bit;
+    }
+
+    return true;
+}
+
+/*! Compiles a subscription message, on error the previous filter is kept.
+ */
+bool WebSocketFilter::parse(const QVariantMap &subscription, QString *error)
+{
+    WebSocketFilter f;
+
+    for (const char *param : { "resources", "ids", "events", "attrs" })
+    {
+        const QVariant v = subscription.value(QLatin1String(param));
+        if (v.isValid() && v.type() != QVariant::List)
+        {
+            *error = QString("invalid value for parameter, %1").arg(QLatin1String(param));
+            return false;
+        }
+    }
+
+    if (!parseMask(subscription.value(QLatin1String("resources")), resourceNames, &f.m_resources, error) ||
+        !parseMask(subscription.value(QLatin1String("events")), eventNames, &f.m_events, error))
+    {
+        return false;
+    }
+
+    for (const QVariant &id : subscription.value(QLatin1String("ids")).toList())
+    {
+        f.m_ids.insert(id.toString());
+    }
+
+    for (const QVariant &v : subscription.value(QLatin1String("attrs")).toList())
+    {
+        const QString pattern = v.toString();
+        const int slash = pattern.indexOf(QLatin1Char('/'));
+
+        Attr attr;
+        attr.section = slash < 0 ? pattern : pattern.left(slash);
+        attr.key = slash < 0 ? QString() : pattern.mid(slash + 1);
+
+        if (attr.key == QLatin1String("*"))
+        {
+            attr.key.clear();
+        }
+
+        if (attr.section.isEmpty())
+        {
+            *error = QString("invalid attribute pattern, %1").arg(pattern);
+            return false;
+        }
+
+        f.m_attrs.push_back(attr);
+    }
+
+    const QVariant coalesce = subscription.value(QLatin1String("coalesce"));
+    if (coalesce.isValid() && coalesce.type() != QVariant::Bool)
+    {
+        *error = QLatin1String("invalid value for parameter, coalesce");
+        return false;
+    }
+    f.m_coalesce = coalesce.toBool();
+
+    const QString encoding = subscription.value(QLatin1String("encoding"), QLatin1String("json")).toString();
+    if (encoding != QLatin1String("json") && encoding != QLatin1String("cbor"))
+    {
+        *error = QString("unknown value, %1, for parameter, encoding").arg(encoding);
+        return false;
+    }
+    f.m_binary = encoding == QLatin1String("cbor");
+
+    f.m_all = f.m_resources == 0 && f.m_events == 0 && f.m_ids.isEmpty() && f.m_attrs.empty();
+    *this = f;
+    return true;
+}
+
+/*! Returns true if the client wants to receive \p event.
+ */
+bool WebSocketFilter::match(const QVariantMap &event) const
+{
+    if (m_all)
+    {
+        return true;
+    }
+
+    static const QString keyR = QLatin1String("r");
+    static const QString keyE = QLatin1String("e");
+    static const QString keyId = QLatin1String("id");
+
+    if (m_resources != 0 && (m_resources & bitForName(resourceNames, event.value(keyR).toString())) == 0)
+    {
+        return false;
+    }
+
+    const quint32 e = bitForName(eventNames, event.value(keyE).toString());
+    if (m_events != 0 && (m_events & e) == 0)
+    {
+        return false;
+    }
+
+    if (!m_ids.isEmpty() && !m_ids.contains(event.value(keyId).toString()))
+    {
+        return false;
+    }
+
+    if (m_attrs.empty() || e != EventChanged)
+    {
+        return true;
+    }
+
+    for (const Attr &attr : m_attrs)
+    {
+        const auto section = event.constFind(attr.section);
+        if (section == event.cend())
+        {
+            continue;
+        }
+
+        if (attr.key.isEmpty())
+        {
+            return true;
+        }
+
+        if (section->type() == QVariant::Map && section->toMap().contains(attr.key))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
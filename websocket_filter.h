@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef WEBSOCKET_FILTER_H
+#define WEBSOCKET_FILTER_H
+
+#include <vector>
+#include <QSet>
+#include <QString>
+#include <QVariantMap>
+
+/*! \class WebSocketFilter
+
+    Compiled subscription of a websocket client.
+
+    A client narrows the events it receives by sending:
+
+        {
+          "t": "subscribe",
+          "resources": ["sensors"],
+          "ids": ["5", "7"],
+          "events": ["changed"],
+          "attrs": ["state/buttonevent", "config/*"],
+          "coalesce": true,
+          "encoding": "cbor"
+        }
+
+    All fields are optional, a missing or empty field matches everything, so
+    {"t": "subscribe"} restores the default of receiving all events.
+    Attribute patterns only apply to "changed" events, which are delivered
+    when they contain at least one matching attribute. A pattern without key
+    or with "*" matches the whole section like "state" or "name".
+
+    Matching is done on the event QVariantMap before it is serialized.
+
+    With "coalesce" all "changed" events of one resource within an event loop
+    iteration are merged into a single message, events with buttonevent,
+    rotaryevent or gesture are always sent separately. With "encoding": "cbor" the
+    events are sent as binary CBOR messages instead of JSON text.
+ */
+class WebSocketFilter
+{
+public:
+    bool parse(const QVariantMap &subscription, QString *error);
+    bool match(const QVariantMap &event) const;
+    bool matchesAll() const { return m_all; }
+    bool coalesce() const { return m_coalesce; }
+    bool binary() const { return m_binary; }
+
+private:
+    struct Attr
+    {
+        QString section; // "state", "config", ...
+        QString key;     // empty matches the whole section
+    };
+
+    bool m_all = true;
+    bool m_coalesce = false;
+    bool m_binary = false;
+    quint32 m_resources = 0; // bit mask of resource types, 0 = all
+    quint32 m_events = 0;    // bit mask of event types, 0 = all
+    QSet<QString> m_ids;
+    std::vector<Attr> m_attrs;
+};
+
+#endif // WEBSOCKET_FILTER_H
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "json.h"
+#include "json_reader.h"
+#include "websocket_queue.h"
+
+/*! Appends \p msg or merges it into a queued event of the same resource.
+ */
+void WebSocketSendQueue::push(const QString &msg, const WebSocketMessageKey &key, qint64 now)
+{
+    if (!key.resource.isEmpty())
+    {
+        const auto i = m_mergeable.constFind(key.resource);
+
+        if (i != m_mergeable.cend())
+        {
+            if (key.mergeable)
+            {
+                Entry &e = m_queue[size_t(i.value() - m_frontSeq)];
+                e.msg = merge(e.msg, msg);
+                m_coalesced++;
+                return;
+            }
+
+            m_mergeable.erase(i); // keep the order of events of one resource
+        }
+    }
+
+    if (m_queue.size() >= MaxMessages)
+    {
+        pop();
+        m_dropped++;
+    }
+
+    Entry e;
+    e.msg = msg;
+    e.queued = now;
+
+    if (key.mergeable && !key.resource.isEmpty())
+    {
+        e.resource = key.resource;
+        m_mergeable.insert(key.resource, m_frontSeq + m_queue.size());
+    }
+
+    m_queue.push_back(e);
+}
+
+/*! Appends a binary message, these aren't merged.
+ */
+void WebSocketSendQueue::pushBinary(const QByteArray &data, qint64 now)
+{
+    if (m_queue.size() >= MaxMessages)
+    {
+        pop();
+        m_dropped++;
+    }
+
+    Entry e;
+    e.data = data;
+    e.queued = now;
+    m_queue.push_back(e);
+}
+
+void WebSocketSendQueue::pop()
+{
+    if (m_queue.empty())
+    {
+        return;
+    }
+
+    const Entry &e = m_queue.front();
+    if (!e.resource.isEmpty())
+    {
+        const auto i = m_mergeable.find(e.resource);
+        if (i != m_mergeable.end() && i.value() == m_frontSeq)
+        {
+            m_mergeable.erase(i);
+        }
+    }
+
+    m_queue.pop_front();
+    m_frontSeq++;
+}
+
+/*! Returns the age of the oldest queued message in milliseconds.
+ */
+qint64 WebSocketSendQueue::lag(qint64 now) const
+{
+    return m_queue.empty() ? 0 : now - m_queue.front().queued;
+}
+
+/*! Returns true if \p key is a state item of which every update is a discrete event, not a state.
+ */
+bool WebSocketSendQueue::isEventItem(const QString &key)
+{
+    return key == QLatin1String("buttonevent") ||
+           key == QLatin1String("rotaryevent") ||
+           key == QLatin1String("gesture");
+}
+
+/*! Returns true if the "state" of \p event has an event item, such events must not be merged.
+ */
+bool WebSocketSendQueue::hasEventItem(const QVariantMap &event)
+{
+    const auto state = event.constFind(QLatin1String("state"));
+    if (state == event.cend() || state->type() != QVariant::Map)
+    {
+        return false;
+    }
+
+    const QVariantMap map = state->toMap();
+    for (auto i = map.cbegin(); i != map.cend(); ++i)
+    {
+        if (isEventItem(i.key()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! Extracts "r", "id" and "e" of a serialized event without decoding the whole message.
+    The "state" object is scanned for event items.
+ */
+WebSocketMessageKey WebSocketSendQueue::messageKey(const QByteArray &msg)
+{
+    WebSocketMessageKey result;
+    QString r;
+    QString id;
+    bool changed = false;
+    bool eventItem = false;
+
+    JsonReader json(msg);
+    if (json.next() != JsonReader::TokenBeginObject)
+    {
+        return result;
+    }
+
+    while (json.next() == JsonReader::TokenKey)
+    {
+        if (json.isKey("r") && json.next() == JsonReader::TokenString)
+        {
+            r = json.toString();
+        }
+        else if (json.isKey("id") && json.next() == JsonReader::TokenString)
+        {
+            id = json.toString();
+        }
+        else if (json.isKey("e") && json.next() == JsonReader::TokenString)
+        {
+            changed = json.toString() == QLatin1String("changed");
+        }
+        else if (json.isKey("state") && json.next() == JsonReader::TokenBeginObject)
+        {
+            while (json.next() == JsonReader::TokenKey)
+            {
+                if (json.isKey("buttonevent") || json.isKey("rotaryevent") || json.isKey("gesture")) // see isEventItem()
+                {
+                    eventItem = true;
+                }
+
+                json.next();
+                json.skipValue();
+            }
+        }
+        else
+        {
+            json.next();
+            json.skipValue();
+        }
+    }
+
+    if (!r.isEmpty() && !id.isEmpty())
+    {
+        result.resource = r + QLatin1Char('/') + id;
+        result.mergeable = changed && !eventItem;
+    }
+
+    return result;
+}
+
+/*! Merges the fields of \p src into \p dst recursively, values of \p src take precedence.
+ */
+void WebSocketSendQueue::mergeEvent(QVariantMap &dst, const QVariantMap &src)
+{
+    for (auto i = src.cbegin(); i != src.cend(); ++i)
+    {
+        auto d = dst.find(i.key());
+        if (d != dst.end() && d->type() == QVariant::Map && i->type() == QVariant::Map)
+        {
+            QVariantMap m = d->toMap();
+            mergeEvent(m, i->toMap());
+            *d = m;
+        }
+        else
+        {
+            dst.insert(i.key(), *i);
+        }
+    }
+}
+
+/*! Merges two "changed" events of one resource, values of \p newer take precedence.
+ */
+QString WebSocketSendQueue::merge(const QString &older, const QString &newer)
+{
+    bool ok1 = false;
+    bool ok2 = false;
+    QVariantMap map = Json::parse(older, ok1).toMap();
+    const QVariantMap map2 = Json::parse(newer, ok2).toMap();
+
+    if (!ok1 || !ok2)
+    {
+        return newer;
+    }
+
+    mergeEvent(map, map2);
+    return QString::fromUtf8(Json::serialize(map));
+}
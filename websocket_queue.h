@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef WEBSOCKET_QUEUE_H
+#define WEBSOCKET_QUEUE_H
+
+#include <deque>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVariantMap>
+
+/*! Identifies the resource of a websocket event for coalescing. */
+struct WebSocketMessageKey
+{
+    QString resource;       // "r/id", empty if the event has no resource
+    bool mergeable = false; // "changed" events without event items can be merged into each other
+};
+
+/*! \class WebSocketSendQueue
+
+    Bounded outgoing message queue of one websocket client.
+
+    Messages are only queued while the client doesn't keep up, otherwise they
+    are handed to the socket directly. A "changed" event is merged into the last
+    queued "changed" event of the same resource, as long as no other event of
+    that resource is queued after it. Events which carry an event item like
+    state/buttonevent are never merged, each of them is a separate press.
+    When the queue is full the oldest message is dropped.
+ */
+class WebSocketSendQueue
+{
+public:
+    enum Constants
+    {
+        MaxMessages = 512
+    };
+
+    void push(const QString &msg, const WebSocketMessageKey &key, qint64 now);
+    void pushBinary(const QByteArray &data, qint64 now);
+    bool isEmpty() const { return m_queue.empty(); }
+    size_t size() const { return m_queue.size(); }
+    const QString &front() const { return m_queue.front().msg; }
+    bool frontIsBinary() const { return !m_queue.front().data.isEmpty(); }
+    const QByteArray &frontBinary() const { return m_queue.front().data; }
+    void pop();
+    qint64 lag(qint64 now) const;
+
+    quint64 dropped() const { return m_dropped; }
+    quint64 coalesced() const { return m_coalesced; }
+
+    static WebSocketMessageKey messageKey(const QByteArray &msg);
+    static bool isEventItem(const QString &key);
+    static bool hasEventItem(const QVariantMap &event);
+    static QString merge(const QString &older, const QString &newer);
+    static void mergeEvent(QVariantMap &dst, const QVariantMap &src);
+
+private:
+    struct Entry
+    {
+        QString msg;
+        QByteArray data; // binary message, never merged
+        QString resource;
+        qint64 queued = 0; // time in ms
+    };
+
+    std::deque<Entry> m_queue;
+    quint64 m_frontSeq = 0; // sequence number of m_queue.front()
+    QHash<QString, quint64> m_mergeable; // resource -> sequence number of last queued "changed" event
+    quint64 m_dropped = 0;
+    quint64 m_coalesced = 0;
+};
+
+#endif // WEBSOCKET_QUEUE_H
@@ -11,7 +11,13 @@
 #ifdef USE_WEBSOCKETS
 
 #include "deconz/dbg_trace.h"
+#include <QTimer>
+#include <algorithm>
+#include <cstring>
 #include "deconz/util.h"
+#include "cbor_writer.h"
+#include "json.h"
+#include "resource.h"
 #include "websocket_server.h"
 
 /*! Constructor.
@@ -19,6 +25,7 @@
 WebSocketServer::WebSocketServer(QObject *parent, quint16 port) :
     QObject(parent)
 {
+    m_clock.start();
     srv = new QWebSocketServer("deconz", QWebSocketServer::NonSecureMode, this);
 
     quint16 p = 0;
@@ -77,7 +84,12 @@ void WebSocketServer::onNewConnection()
         DBG_Printf(DBG_INFO, "New websocket %s:%u (state: %d) \n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), sock->state());
         connect(sock, SIGNAL(disconnected()), this, SLOT(onSocketDisconnected()));
         connect(sock, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onSocketError(QAbstractSocket::SocketError)));
-        clients.push_back(sock);
+        connect(sock, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten(qint64)));
+        connect(sock, SIGNAL(textMessageReceived(QString)), this, SLOT(onTextMessageReceived(QString)));
+
+        WebSocketClient client;
+        client.sock = sock;
+        m_clients.push_back(client);
     }
 }
 
@@ -85,17 +97,12 @@ void WebSocketServer::onNewConnection()
  */
 void WebSocketServer::onSocketDisconnected()
 {
-    for (size_t i = 0; i < clients.size(); i++)
+    QWebSocket *sock = qobject_cast<QWebSocket*>(sender());
+    DBG_Assert(sock);
+    if (sock)
     {
-        QWebSocket *sock = qobject_cast<QWebSocket*>(sender());
-        DBG_Assert(sock);
-        if (sock && clients[i] == sock)
-        {
-            DBG_Printf(DBG_INFO, "Websocket disconnected %s:%u, state: %d, close-code: %d, reason: %s\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), sock->state(), sock->closeCode(), qPrintable(sock->closeReason()));
-            sock->deleteLater();
-            clients[i] = clients.back();
-            clients.pop_back();
-        }
+        DBG_Printf(DBG_INFO, "Websocket disconnected %s:%u, state: %d, close-code: %d, reason: %s\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), sock->state(), sock->closeCode(), qPrintable(sock->closeReason()));
+        removeClient(sock);
     }
 }
 
@@ -105,52 +112,409 @@ void WebSocketServer::onSocketDisconnected()
 void WebSocketServer::onSocketError(QAbstractSocket::SocketError err)
 {
     Q_UNUSED(err);
-    for (size_t i = 0; i < clients.size(); i++)
+    QWebSocket *sock = qobject_cast<QWebSocket*>(sender());
+    DBG_Assert(sock);
+    if (sock)
+    {
+        DBG_Printf(DBG_INFO, "Remove websocket %s:%u after error %s, close-code: %d, reason: %s\n",
+                   qPrintable(sock->peerAddress().toString()), sock->peerPort(), qPrintable(sock->errorString()), sock->closeCode(), qPrintable(sock->closeReason()));
+        removeClient(sock);
+    }
+}
+
+/*! Handle bytes written by the socket of a client and send queued messages.
+ */
+void WebSocketServer::onBytesWritten(qint64 bytes)
+{
+    WebSocketClient *c = client(qobject_cast<QWebSocket*>(sender()));
+
+    if (c)
+    {
+        // frame headers and control frames are counted as well
+        c->pendingBytes = qMax(qint64(0), c->pendingBytes - bytes);
+        drain(*c);
+    }
+}
+
+/*! Handles messages from a client, currently only subscriptions.
+ */
+void WebSocketServer::onTextMessageReceived(const QString &msg)
+{
+    WebSocketClient *c = client(qobject_cast<QWebSocket*>(sender()));
+
+    if (!c)
+    {
+        return;
+    }
+
+    bool ok = false;
+    const QVariantMap map = Json::parse(msg, ok).toMap();
+
+    if (!ok || map.value(QLatin1String("t")).toString() != QLatin1String("subscribe"))
+    {
+        return;
+    }
+
+    QString error;
+    QVariantMap rsp;
+    rsp[QLatin1String("t")] = QLatin1String("subscribe");
+
+    if (c->filter.parse(map, &error))
+    {
+        rsp[QLatin1String("success")] = true;
+        DBG_Printf(DBG_INFO, "Websocket %s:%u subscription: %s\n", qPrintable(c->sock->peerAddress().toString()), c->sock->peerPort(), qPrintable(msg));
+    }
+    else
+    {
+        rsp[QLatin1String("error")] = error;
+    }
+
+    send(*c, QString::fromUtf8(Json::serialize(rsp))); // not queued, the client awaits it
+}
+
+WebSocketClient *WebSocketServer::client(QWebSocket *sock)
+{
+    for (WebSocketClient &c : m_clients)
     {
-        QWebSocket *sock = qobject_cast<QWebSocket*>(sender());
-        DBG_Assert(sock);
-        if (sock && clients[i] == sock)
+        if (c.sock == sock)
         {
-            DBG_Printf(DBG_INFO, "Remove websocket %s:%u after error %s, close-code: %d, reason: %s\n",
-                       qPrintable(sock->peerAddress().toString()), sock->peerPort(), qPrintable(sock->errorString()), sock->closeCode(), qPrintable(sock->closeReason()));
+            return &c;
+        }
+    }
+
+    return nullptr;
+}
+
+void WebSocketServer::removeClient(QWebSocket *sock)
+{
+    for (size_t i = 0; i < m_clients.size(); i++)
+    {
+        if (m_clients[i].sock == sock)
+        {
+            if (m_clients[i].queue.dropped() > 0)
+            {
+                DBG_Printf(DBG_INFO, "Websocket %s:%u dropped %u messages\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), unsigned(m_clients[i].queue.dropped()));
+            }
             sock->deleteLater();
-            clients[i] = clients.back();
-            clients.pop_back();
+            m_clients[i] = m_clients.back();
+            m_clients.pop_back();
+            break;
         }
     }
 }
 
-/*! Broadcasts a message to all connected clients.
-    \param msg the message as JSON string
+/*! Returns the lag of a client in milliseconds, that is the age of its oldest queued message.
  */
-void WebSocketServer::broadcastTextMessage(const QString &msg)
+qint64 WebSocketServer::lag(const WebSocketClient &client) const
+{
+    return client.queue.lag(m_clock.elapsed());
+}
+
+void WebSocketServer::send(WebSocketClient &client, const QString &msg)
+{
+    QWebSocket *sock = client.sock;
+
+    if (sock->state() != QAbstractSocket::ConnectedState)
+    {
+        DBG_Printf(DBG_INFO, "Websocket %s:%u unexpected state: %d\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), sock->state());
+    }
+
+    const qint64 ret = sock->sendTextMessage(msg);
+    client.pendingBytes += qMax(qint64(0), ret);
+    client.sent++;
+
+    if (DBG_IsEnabled(DBG_INFO_L2))
+    {
+        DBG_Printf(DBG_INFO_L2, "Websocket %s:%u send message: %s (ret = %d)\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), qPrintable(msg), int(ret));
+    }
+}
+
+void WebSocketServer::sendBinary(WebSocketClient &client, const QByteArray &data)
+{
+    const qint64 ret = client.sock->sendBinaryMessage(data);
+    client.pendingBytes += qMax(qint64(0), ret);
+    client.sent++;
+}
+
+/*! Writes \p event as CBOR map, the values of \p items are taken directly from the resource items.
+ */
+static void writeEventItems(CborWriter &cbor, const QVariantMap &event, const WebSocketEventItems &items)
+{
+    const size_t len = strlen(items.prefix);
+    const QLatin1String section(items.prefix, int(len) - 1); // without slash
+
+    cbor.beginObject();
+    for (auto i = event.cbegin(); i != event.cend(); ++i)
+    {
+        cbor.key(i.key());
+
+        if (i.key() != section)
+        {
+            cbor.value(i.value());
+            continue;
+        }
+
+        const QVariantMap map = i.value().toMap();
+
+        cbor.beginObject();
+        for (auto j = map.cbegin(); j != map.cend(); ++j)
+        {
+            const QString &key = j.key();
+            const auto item = std::find_if(items.items.cbegin(), items.items.cend(), [&key, len](const ResourceItem *x)
+            {
+                return key == QLatin1String(x->descriptor().suffix + len);
+            });
+
+            cbor.key(key);
+            if (item != items.items.cend() && (*item)->lastSet().isValid())
+            {
+                cbor.value(**item);
+            }
+            else
+            {
+                cbor.value(j.value()); // computed values like "xy"
+            }
+        }
+        cbor.endObject();
+    }
+    cbor.endObject();
+}
+
+/*! Encodes an event as CBOR, if \p event isn't available from the JSON message \p msg.
+    If \p items is set the item values are written directly.
+ */
+static QByteArray toCbor(const QByteArray &msg, const QVariantMap *event, const WebSocketEventItems *items)
+{
+    static CborWriter cbor(1024);
+    cbor.clear();
+
+    if (event && items)
+    {
+        writeEventItems(cbor, *event, *items);
+    }
+    else if (event)
+    {
+        cbor.value(QVariant(*event));
+    }
+    else
+    {
+        bool ok = false;
+        cbor.value(Json::parseUtf8(msg, ok));
+    }
+
+    return QByteArray(cbor.buffer().constData(), cbor.buffer().size()); // shared by all binary clients
+}
+
+/*! Hands queued messages to the socket as long as the client keeps up.
+ */
+void WebSocketServer::drain(WebSocketClient &client)
 {
-    for (size_t i = 0; i < clients.size(); i++)
+    while (!client.queue.isEmpty() && client.pendingBytes < MaxPendingBytes)
     {
-        QWebSocket *sock = clients[i];
+        if (client.queue.frontIsBinary())
+        {
+            sendBinary(client, client.queue.frontBinary());
+        }
+        else
+        {
+            send(client, client.queue.front());
+        }
+        client.queue.pop();
+    }
+}
+
+/*! Broadcasts an event to all clients which subscribed to it.
+    The event is only serialized when at least one client matches.
+    \param event the event with "t", "e", "r" and "id" fields
+ */
+void WebSocketServer::broadcastEvent(const QVariantMap &event)
+{
+    dispatchEvent(event, nullptr);
+}
+
+/*! Broadcasts a "changed" event, CBOR clients get the values of \p items written directly.
+    The items are only accessed during the call, merged events of coalescing clients use the map.
+    \param event the event with "t", "e", "r" and "id" fields
+    \param items the items which values are in the event map as ResourceItem::toVariant()
+ */
+void WebSocketServer::broadcastEvent(const QVariantMap &event, const WebSocketEventItems &items)
+{
+    dispatchEvent(event, items.items.empty() ? nullptr : &items);
+}
+
+void WebSocketServer::dispatchEvent(const QVariantMap &event, const WebSocketEventItems *items)
+{
+    bool direct = false;
+    bool coalesced = false;
+
+    for (const WebSocketClient &client : m_clients)
+    {
+        if (client.filter.match(event))
+        {
+            if (client.filter.coalesce()) { coalesced = true; }
+            else                          { direct = true; }
+        }
+    }
+
+    if (direct)
+    {
+        broadcast(QByteArray(), &event, TargetDirect, items);
+    }
+
+    if (!coalesced)
+    {
+        return;
+    }
+
+    const QString r = event.value(QLatin1String("r")).toString();
+    const QString id = event.value(QLatin1String("id")).toString();
+
+    if (event.value(QLatin1String("e")).toString() != QLatin1String("changed") || r.isEmpty() || id.isEmpty() ||
+        WebSocketSendQueue::hasEventItem(event)) // every button event is delivered
+    {
+        flushCoalesced(); // keep the order
+        broadcast(QByteArray(), &event, TargetCoalesced, items);
+        return;
+    }
+
+    const QString key = r + QLatin1Char('/') + id;
+    const auto i = m_coalescedIndex.constFind(key);
+
+    if (i != m_coalescedIndex.cend())
+    {
+        WebSocketSendQueue::mergeEvent(m_coalesced[i.value()], event);
+    }
+    else
+    {
+        m_coalescedIndex.insert(key, m_coalesced.size());
+        m_coalesced.push_back(event);
+    }
+
+    if (!m_flushScheduled)
+    {
+        m_flushScheduled = true;
+        QTimer::singleShot(0, this, SLOT(flushCoalesced()));
+    }
+}
+
+/*! Sends the merged "changed" events to the clients which subscribed with "coalesce".
+ */
+void WebSocketServer::flushCoalesced()
+{
+    m_flushScheduled = false;
+
+    if (m_coalesced.empty())
+    {
+        return;
+    }
+
+    std::vector<QVariantMap> events;
+    events.swap(m_coalesced);
+    m_coalescedIndex.clear();
+
+    for (const QVariantMap &event : events)
+    {
+        broadcast(QByteArray(), &event, TargetCoalesced);
+    }
+}
+
+/*! Broadcasts a message to all connected clients, subscriptions aren't considered.
+    \param msg the message as UTF-8 encoded JSON
+ */
+void WebSocketServer::broadcastTextMessage(const QByteArray &msg)
+{
+    flushCoalesced(); // keep the order
+    broadcast(msg, nullptr, TargetAll);
+}
+
+/*! Sends \p msg to the \p target clients, if \p event is set only to the ones subscribed to it.
+    The JSON \p msg may be empty if \p event is set, each encoding is only created
+    when a client needs it and is shared by all clients using it.
+    The sockets write asynchronously when control returns to the event loop.
+ */
+void WebSocketServer::broadcast(const QByteArray &msg, const QVariantMap *event, Target target, const WebSocketEventItems *items)
+{
+    if (m_clients.empty())
+    {
+        return;
+    }
+
+    QByteArray json = msg;
+    QString text;
+    QByteArray cbor;
+    WebSocketMessageKey key;
+    bool hasKey = false;
+
+    for (WebSocketClient &client : m_clients)
+    {
+        if (target != TargetAll && client.filter.coalesce() != (target == TargetCoalesced))
+        {
+            continue;
+        }
+
+        if (event && !client.filter.match(*event))
+        {
+            continue;
+        }
+
+        const bool direct = client.queue.isEmpty() && client.pendingBytes < MaxPendingBytes;
+
+        if (client.filter.binary())
+        {
+            if (cbor.isEmpty())
+            {
+                cbor = toCbor(json, event, items);
+            }
+
+            if (direct) { sendBinary(client, cbor); }
+            else        { client.queue.pushBinary(cbor, m_clock.elapsed()); }
+            continue;
+        }
+
+        if (json.isEmpty() && event)
+        {
+            json = Json::serialize(*event);
+        }
+
+        if (text.isNull())
+        {
+            text = QString::fromUtf8(json);
+        }
 
-        if (sock->state() != QAbstractSocket::ConnectedState)
+        if (direct)
         {
-            DBG_Printf(DBG_INFO, "Websocket %s:%u unexpected state: %d\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), sock->state());
+            send(client, text);
+            continue;
         }
 
-        qint64 ret = sock->sendTextMessage(msg);
-        DBG_Printf(DBG_INFO_L2, "Websocket %s:%u send message: %s (ret = %d)\n", qPrintable(sock->peerAddress().toString()), sock->peerPort(), qPrintable(msg), ret);
-        sock->flush();
+        if (!hasKey) // only needed for slow clients
+        {
+            key = WebSocketSendQueue::messageKey(json);
+            hasKey = true;
+        }
+
+        client.queue.push(text, key, m_clock.elapsed());
     }
 }
 
+/*! Broadcasts a message to all connected clients.
+    \param msg the message as JSON string
+ */
+void WebSocketServer::broadcastTextMessage(const QString &msg)
+{
+    broadcastTextMessage(msg.toUtf8());
+}
+
 /*! Flush the sockets of all connected clients.
  */
 void WebSocketServer::flush()
 {
-    for (size_t i = 0; i < clients.size(); i++)
+    for (WebSocketClient &client : m_clients)
     {
-        QWebSocket *sock = clients[i];
-
-        if (sock->state() == QAbstractSocket::ConnectedState)
+        if (client.sock->state() == QAbstractSocket::ConnectedState)
         {
-            sock->flush();
+            drain(client);
+            client.sock->flush();
         }
     }
 }
@@ -160,6 +524,10 @@ void WebSocketServer::flush()
       QObject(parent)
   { }
   void WebSocketServer::onNewConnection() { }
+  void WebSocketServer::broadcastEvent(const QVariantMap &) { }
+  void WebSocketServer::broadcastEvent(const QVariantMap &, const WebSocketEventItems &) { }
+  void WebSocketServer::flushCoalesced() { }
+  void WebSocketServer::broadcastTextMessage(const QByteArray &) { }
   void WebSocketServer::broadcastTextMessage(const QString &) { }
   quint16 WebSocketServer::port() const {  return 0; }
 #endif
@@ -1,41 +1,111 @@
 #ifndef WEBSOCKET_SERVER_H
 #define WEBSOCKET_SERVER_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <vector>
 #ifdef USE_WEBSOCKETS
 #include <QWebSocket>
 #include <QWebSocketServer>
 #endif // USE_WEBSOCKETS
+#include "websocket_filter.h"
+#include "websocket_queue.h"
 
 class QWebSocket;
 class QWebSocketServer;
+class ResourceItem;
+
+/*! State of one websocket client. */
+struct WebSocketClient
+{
+    QWebSocket *sock = nullptr;
+    qint64 pendingBytes = 0; // handed to the socket but not yet written
+    quint64 sent = 0;        // messages handed to the socket
+    WebSocketFilter filter;  // events the client subscribed to
+    WebSocketSendQueue queue;
+};
+
+/*! Resource items of a "changed" event which values are in the event map as
+    ResourceItem::toVariant(). CBOR clients get these values written directly
+    from the items instead of converting the QVariants.
+ */
+struct WebSocketEventItems
+{
+    const char *prefix = nullptr; // "state/", "config/", the section without slash is the event key
+    std::vector<const ResourceItem*> items;
+};
 
 /*! \class WebSocketServer
 
     Basic websocket server to broadcast messages to clients.
+
+    Each message is converted once and shared between all clients. A client
+    which has more than MaxPendingBytes not yet written gets further messages
+    queued in its WebSocketSendQueue, so that a slow consumer doesn't stall
+    the others.
+
+    Events passed to broadcastEvent() are matched against the WebSocketFilter
+    of each client and only serialized when at least one client wants them.
+    For clients which subscribed with "coalesce" the "changed" events of one
+    resource are merged until the current event loop iteration is finished,
+    except events which carry an event item like state/buttonevent.
+    Clients which subscribed with "encoding": "cbor" receive binary messages
+    with the same schema, values of WebSocketEventItems are written without
+    the QVariant conversion.
  */
 class WebSocketServer : public QObject
 {
     Q_OBJECT
 public:
+    enum Constants
+    {
+        MaxPendingBytes = 256 * 1024
+    };
+
     explicit WebSocketServer(QObject *parent, quint16 port);
     quint16 port() const;
+    const std::vector<WebSocketClient> &clients() const { return m_clients; }
+    qint64 lag(const WebSocketClient &client) const;
+    void broadcastEvent(const QVariantMap &event, const WebSocketEventItems &items);
 
 signals:
 
 public slots:
+    void broadcastEvent(const QVariantMap &event);
+    void broadcastTextMessage(const QByteArray &msg);
     void broadcastTextMessage(const QString &msg);
     void flush();
+    void flushCoalesced();
 
 private slots:
     void onNewConnection();
     void onSocketDisconnected();
     void onSocketError(QAbstractSocket::SocketError err);
+    void onBytesWritten(qint64 bytes);
+    void onTextMessageReceived(const QString &msg);
 
 private:
+    enum Target
+    {
+        TargetAll,
+        TargetDirect,    // clients without coalescing
+        TargetCoalesced  // clients with coalescing
+    };
+
+    void dispatchEvent(const QVariantMap &event, const WebSocketEventItems *items);
+    void broadcast(const QByteArray &msg, const QVariantMap *event, Target target, const WebSocketEventItems *items = nullptr);
+    WebSocketClient *client(QWebSocket *sock);
+    void removeClient(QWebSocket *sock);
+    void send(WebSocketClient &client, const QString &msg);
+    void sendBinary(WebSocketClient &client, const QByteArray &data);
+    void drain(WebSocketClient &client);
+
     QWebSocketServer *srv;
-    std::vector<QWebSocket*> clients;
+    QElapsedTimer m_clock;
+    std::vector<WebSocketClient> m_clients;
+    std::vector<QVariantMap> m_coalesced; // merged "changed" events in order of arrival
+    QHash<QString, size_t> m_coalescedIndex; // "r/id" -> index in m_coalesced
+    bool m_flushScheduled = false;
 };
 
 #endif // WEBSOCKET_SERVER_H
@@ -120,6 +120,7 @@ void DeRestPluginPrivate::handleDeviceAnnceIndication(const deCONZ::ApsDataIndic
 
             if (item)
             {
+                const bool changed = !item->toBool();
                 item->setValue(true); // refresh timestamp after device announce
                 if (i->state() == LightNode::StateNormal)
                 {
@@ -127,6 +128,11 @@ void DeRestPluginPrivate::handleDeviceAnnceIndication(const deCONZ::ApsDataIndic
                     enqueueEvent(e);
                 }
 
+                if (changed)
+                {
+                    updateLightEtag(&*i);
+                }
+
                 updateEtag(gwConfigEtag);
             }
 
@@ -153,8 +159,6 @@ void DeRestPluginPrivate::handleDeviceAnnceIndication(const deCONZ::ApsDataIndic
             }
 
             queryTime = queryTime.addSecs(1);
-            updateEtag(i->etag);
-
         }
     }
 